@@ -0,0 +1,434 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <lib/flipper_format/flipper_format.h>
+#include <storage/storage.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/convert.h>
+#include <src/include/file_handling.h>
+#include <src/include/fgp_palette.h>
+#include <src/include/png.h>
+#include <src/include/rle.h>
+#include <src/include/thumb.h>
+#include <src/include/tile_tools.h>
+
+#define NAME_LEN	128
+
+/* Kept in the app data folder. Done is the newest dated folder that, along with
+ * every folder older than it, has no captures left to convert. Converted and
+ * Errors are totals over every run.
+ */
+#define STATE_FILE	".convert"
+
+struct convert {
+	Storage *storage;
+	File *dir;
+	File *in;
+	File *out;
+	bool dir_open;
+
+	FuriString *base_path; // App data folder, with the trailing /
+	FuriString *done; // From the state file
+	FuriString *in_path;
+	FuriString *out_path;
+	FuriString *tmp_path;
+	char today[FGP_FOLDER_LEN];
+	char *name;
+
+	/* Folders still to walk, oldest first */
+	char (*folders)[FGP_FOLDER_LEN];
+	size_t folder_cnt;
+	size_t folder;
+	unsigned int folder_errors;
+
+	unsigned int palette_idx;
+	void *png_stream;
+	uint8_t *band;
+	uint8_t *rle; // One compressed row of tiles
+	uint8_t *scan_row;
+	uint8_t lut[256];
+	void *thumb;
+
+	uint32_t total_done;
+	uint32_t total_errors;
+	struct convert_stats stats;
+};
+
+static size_t convert_write(void *ctx, const void *buf, size_t len)
+{
+	return storage_file_write(ctx, buf, len);
+}
+
+static void convert_state_load(struct convert *conv)
+{
+	FlipperFormat *format = flipper_format_file_alloc(conv->storage);
+	FuriString *fs_tmp = furi_string_alloc_printf("%s%s", furi_string_get_cstr(conv->base_path), STATE_FILE);
+
+	if (flipper_format_file_open_existing(format, furi_string_get_cstr(fs_tmp))) {
+		flipper_format_read_string(format, "Done", conv->done);
+		flipper_format_read_uint32(format, "Converted", &conv->total_done, 1);
+		flipper_format_read_uint32(format, "Errors", &conv->total_errors, 1);
+	}
+	flipper_format_file_close(format);
+	flipper_format_free(format);
+
+	furi_string_free(fs_tmp);
+}
+
+static void convert_state_save(struct convert *conv)
+{
+	FlipperFormat *format = flipper_format_file_alloc(conv->storage);
+	FuriString *fs_tmp = furi_string_alloc_printf("%s%s", furi_string_get_cstr(conv->base_path), STATE_FILE);
+
+	if (flipper_format_file_open_always(format, furi_string_get_cstr(fs_tmp))) {
+		flipper_format_write_string(format, "Done", conv->done);
+		flipper_format_write_uint32(format, "Converted", &conv->total_done, 1);
+		flipper_format_write_uint32(format, "Errors", &conv->total_errors, 1);
+	} else {
+		FURI_LOG_E("conv", "failed to save state");
+	}
+	flipper_format_file_close(format);
+	flipper_format_free(format);
+
+	furi_string_free(fs_tmp);
+}
+
+/* Read the next row of tiles of a record to conv->band, decompressing it if
+ * the record is RLE compressed.
+ */
+static bool convert_band_read(struct convert *conv, const struct capture_rec *rec, size_t band_sz)
+{
+	uint16_t len;
+
+	if (rec->type == 'P')
+		return (storage_file_read(conv->in, conv->band, band_sz) == band_sz);
+
+	if (storage_file_read(conv->in, &len, sizeof(len)) != sizeof(len))
+		return false;
+
+	if (len == (band_sz | CAPTURE_ROW_RAW))
+		return (storage_file_read(conv->in, conv->band, band_sz) == band_sz);
+
+	/* Only rows that got smaller are compressed */
+	if (len >= band_sz || storage_file_read(conv->in, conv->rle, len) != len)
+		return false;
+
+	return rle_decode(conv->band, band_sz, conv->rle, len);
+}
+
+/* Add up the rows of tiles of every record of the capture, for the thumbnail
+ * that needs the size of the whole image before its first row. Only the record
+ * headers, and the length of each row of an RLE record, are read. Leaves the
+ * capture at its first record again.
+ */
+static bool convert_size_get(struct convert *conv, size_t *tiles_w, size_t *tiles_h)
+{
+	struct capture_rec rec;
+	uint16_t len;
+	size_t band;
+	bool error = false;
+
+	*tiles_w = 0;
+	*tiles_h = 0;
+
+	while (!error && storage_file_read(conv->in, &rec, sizeof(rec)) == sizeof(rec)) {
+		if (!*tiles_w)
+			*tiles_w = rec.tiles_w;
+		*tiles_h += rec.tiles_h;
+
+		if (rec.type != 'R') {
+			error |= !storage_file_seek(conv->in, rec.tiles_w * rec.tiles_h * 16, false);
+			continue;
+		}
+		for (band = 0; !error && band < rec.tiles_h; band++) {
+			error |= (storage_file_read(conv->in, &len, sizeof(len)) != sizeof(len));
+			error |= !storage_file_seek(conv->in, len & ~CAPTURE_ROW_RAW, false);
+		}
+	}
+
+	error |= !storage_file_seek(conv->in, sizeof(CAPTURE_MAGIC) - 1, true);
+
+	return !error;
+}
+
+/* Convert the capture at in_path to a PNG at out_path. The PNG is written under
+ * a temporary name and only renamed once complete, so a PNG that exists is
+ * always a finished one and an interrupted run just starts that capture over.
+ * Only one row of tiles is ever read in at a time. The thumbnail of the image is
+ * made from the same rows, Fast Capture leaves it for now.
+ */
+static bool convert_capture(struct convert *conv)
+{
+	struct capture_rec rec;
+	char magic[sizeof(CAPTURE_MAGIC) - 1];
+	size_t tiles_w = 0;
+	size_t img_w;
+	size_t img_h;
+	size_t band_sz;
+	size_t band;
+	size_t row;
+	size_t len;
+	const uint8_t *lut;
+	bool error = false;
+
+	furi_string_printf(conv->tmp_path, "%s.tmp", furi_string_get_cstr(conv->out_path));
+
+	if (!storage_file_open(conv->in, furi_string_get_cstr(conv->in_path), FSAM_READ, FSOM_OPEN_EXISTING)) {
+		storage_file_close(conv->in);
+		return false;
+	}
+	if (!storage_file_open(conv->out, furi_string_get_cstr(conv->tmp_path), FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+		storage_file_close(conv->out);
+		storage_file_close(conv->in);
+		return false;
+	}
+
+	error |= (storage_file_read(conv->in, magic, sizeof(magic)) != sizeof(magic));
+	error |= !!memcmp(magic, CAPTURE_MAGIC, sizeof(magic));
+	error |= !convert_size_get(conv, &img_w, &img_h);
+	if (!error) {
+		thumb_start(conv->thumb, img_w * 8, img_h * 8);
+		thumb_rec_get(conv->thumb)->px_w = img_w * 8;
+		thumb_rec_get(conv->thumb)->px_h = img_h * 8;
+	}
+
+	while (!error) {
+		len = storage_file_read(conv->in, &rec, sizeof(rec));
+		if (!len)
+			break;
+
+		/* Every print of an image is the same width */
+		if (len != sizeof(rec) || (rec.type != 'P' && rec.type != 'R') || !rec.tiles_w ||
+		    rec.tiles_w > (160 / 8) || (tiles_w && rec.tiles_w != tiles_w)) {
+			error = true;
+			break;
+		}
+
+		if (!tiles_w) {
+			tiles_w = rec.tiles_w;
+			png_stream_reset(conv->png_stream, tiles_w * 8, 1);
+			png_stream_palette_set(conv->png_stream, palette_plte_get(conv->palette_idx));
+			png_stream_start(conv->png_stream, convert_write, conv->out, false);
+		}
+
+		/* The palette byte can differ from one print to the next */
+		lut = tile_palette_lut(conv->lut, rec.palette) ? conv->lut : NULL;
+		band_sz = tiles_w * 16;
+		for (band = 0; band < rec.tiles_h; band++) {
+			if (!convert_band_read(conv, &rec, band_sz)) {
+				error = true;
+				break;
+			}
+			for (row = 0; row < 8; row++) {
+				tile_row_get(conv->scan_row, conv->band, tiles_w, row, lut);
+				png_stream_row(conv->png_stream, conv->scan_row);
+				thumb_row(conv->thumb, conv->scan_row);
+			}
+		}
+	}
+
+	/* Nothing but the magic */
+	error |= !tiles_w;
+
+	if (!error) {
+		error |= !png_stream_finish(conv->png_stream);
+		error |= !storage_file_seek(conv->out, 0, true);
+		error |= (storage_file_write(conv->out,
+					     png_stream_buf_get(conv->png_stream, IHDR),
+					     png_stream_len_get(conv->png_stream, IHDR)) !=
+			  png_stream_len_get(conv->png_stream, IHDR));
+	}
+
+	storage_file_close(conv->in);
+	error |= !storage_file_close(conv->out);
+
+	if (!error)
+		error |= (storage_common_rename(conv->storage,
+						furi_string_get_cstr(conv->tmp_path),
+						furi_string_get_cstr(conv->out_path)) != FSE_OK);
+	if (error) {
+		FURI_LOG_E("conv", "failed on %s", furi_string_get_cstr(conv->in_path));
+		storage_simply_remove(conv->storage, furi_string_get_cstr(conv->tmp_path));
+	}
+
+	return !error;
+}
+
+/* Add the thumbnail of the capture just converted to the thumbnail index of its
+ * folder, as if the PNG had been saved while receiving. name is the capture.
+ */
+static bool convert_thumb_save(struct convert *conv, const char *folder, const char *name)
+{
+	struct thumb_rec *rec = thumb_rec_get(conv->thumb);
+	size_t len = strlen(name) - strlen(CAPTURE_EXT);
+	bool error = false;
+
+	/* The count is the four digits right before the extension */
+	rec->count = (len >= 4) ? strtoul(name + len - 4, NULL, 10) : 0;
+	rec->palette = conv->palette_idx;
+	snprintf(rec->ext, sizeof(rec->ext), "-%s.png", palette_shortname_get(conv->palette_idx));
+
+	furi_string_printf(conv->tmp_path, "%s%s/%s", furi_string_get_cstr(conv->base_path), folder, THUMB_FILE);
+	if (!storage_file_open(conv->out, furi_string_get_cstr(conv->tmp_path), FSAM_WRITE, FSOM_OPEN_APPEND))
+		error = true;
+	else
+		error |= (storage_file_write(conv->out, rec, sizeof(struct thumb_rec)) != sizeof(struct thumb_rec));
+	error |= !storage_file_close(conv->out);
+
+	if (error)
+		FURI_LOG_E("conv", "thumbnail not saved");
+
+	return !error;
+}
+
+bool convert_batch(void *convert_handle, unsigned int max)
+{
+	struct convert *conv = convert_handle;
+	const char *folder;
+	FileInfo info;
+	unsigned int cnt = 0;
+	size_t len;
+
+	while (conv->folder < conv->folder_cnt) {
+		folder = conv->folders[conv->folder];
+
+		if (!conv->dir_open) {
+			furi_string_printf(conv->in_path, "%s%s", furi_string_get_cstr(conv->base_path), folder);
+			conv->dir_open = storage_dir_open(conv->dir, furi_string_get_cstr(conv->in_path));
+			conv->folder_errors = 0;
+			if (!conv->dir_open) {
+				storage_dir_close(conv->dir);
+				conv->stats.errors++;
+				conv->total_errors++;
+				conv->folder++;
+				continue;
+			}
+		}
+
+		while (cnt < max && storage_dir_read(conv->dir, &info, conv->name, NAME_LEN)) {
+			len = strlen(conv->name);
+			if (file_info_is_dir(&info) || len <= strlen(CAPTURE_EXT) ||
+			    strcmp(conv->name + len - strlen(CAPTURE_EXT), CAPTURE_EXT))
+				continue;
+
+			/* Already converted by an earlier run */
+			furi_string_printf(conv->out_path, "%s%s/%.*s-%s.png",
+					   furi_string_get_cstr(conv->base_path), folder,
+					   (int)(len - strlen(CAPTURE_EXT)), conv->name,
+					   palette_shortname_get(conv->palette_idx));
+			if (storage_file_exists(conv->storage, furi_string_get_cstr(conv->out_path)))
+				continue;
+
+			furi_string_printf(conv->in_path, "%s%s/%s",
+					   furi_string_get_cstr(conv->base_path), folder, conv->name);
+			if (convert_capture(conv)) {
+				/* A missing thumbnail only leaves a gap in the Gallery */
+				convert_thumb_save(conv, folder, conv->name);
+				conv->stats.done++;
+				conv->total_done++;
+			} else {
+				conv->stats.errors++;
+				conv->total_errors++;
+				conv->folder_errors++;
+			}
+			cnt++;
+		}
+
+		if (cnt == max)
+			break;
+
+		/* Every capture in the folder was looked at. Only a folder from
+		 * before today can't get any new ones.
+		 */
+		storage_dir_close(conv->dir);
+		conv->dir_open = false;
+		if (!conv->folder_errors && strcmp(folder, conv->today) < 0 &&
+		    strcmp(folder, furi_string_get_cstr(conv->done)) > 0)
+			furi_string_set(conv->done, folder);
+		conv->folder++;
+	}
+
+	convert_state_save(conv);
+
+	return (conv->folder < conv->folder_cnt);
+}
+
+void convert_stats_get(void *convert_handle, struct convert_stats *stats)
+{
+	struct convert *conv = convert_handle;
+
+	memcpy(stats, &conv->stats, sizeof(struct convert_stats));
+}
+
+void *convert_alloc(unsigned int idx)
+{
+	struct convert *conv = malloc(sizeof(struct convert));
+
+	memset(conv, 0, sizeof(struct convert));
+
+	conv->storage = furi_record_open(RECORD_STORAGE);
+	conv->dir = storage_file_alloc(conv->storage);
+	conv->in = storage_file_alloc(conv->storage);
+	conv->out = storage_file_alloc(conv->storage);
+	conv->base_path = furi_string_alloc_set(APP_DATA_PATH(""));
+	conv->done = furi_string_alloc();
+	conv->in_path = furi_string_alloc();
+	conv->out_path = furi_string_alloc();
+	conv->tmp_path = furi_string_alloc();
+	conv->name = malloc(NAME_LEN);
+	conv->palette_idx = idx;
+	conv->png_stream = png_stream_alloc(160);
+	conv->band = malloc((160 / 8) * 16);
+	conv->rle = malloc((160 / 8) * 16);
+	conv->scan_row = malloc(160 / 4);
+	conv->thumb = thumb_alloc();
+
+	storage_common_resolve_path_and_ensure_app_directory(conv->storage, conv->base_path);
+
+	fgp_storage_today_get(conv->today);
+
+	convert_state_load(conv);
+
+	/* Folders are walked oldest first so that Done only ever moves
+	 * forward.
+	 */
+	conv->folder_cnt = fgp_storage_folders_get(conv->storage, furi_string_get_cstr(conv->base_path),
+						   furi_string_get_cstr(conv->done), &conv->folders);
+
+	FURI_LOG_I("conv", "%u folders after %s", conv->folder_cnt, furi_string_get_cstr(conv->done));
+
+	return conv;
+}
+
+void convert_free(void *convert_handle)
+{
+	struct convert *conv = convert_handle;
+
+	if (conv->dir_open)
+		storage_dir_close(conv->dir);
+
+	convert_state_save(conv);
+
+	free(conv->folders);
+	thumb_free(conv->thumb);
+	free(conv->scan_row);
+	free(conv->rle);
+	free(conv->band);
+	png_stream_free(conv->png_stream);
+	free(conv->name);
+	furi_string_free(conv->tmp_path);
+	furi_string_free(conv->out_path);
+	furi_string_free(conv->in_path);
+	furi_string_free(conv->done);
+	furi_string_free(conv->base_path);
+	storage_file_free(conv->out);
+	storage_file_free(conv->in);
+	storage_file_free(conv->dir);
+	furi_record_close(RECORD_STORAGE);
+
+	free(conv);
+}
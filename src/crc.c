@@ -75,15 +75,14 @@ static const uint32_t crc_table[256] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
 };
 
-/* Update a running CRC with the bytes buf[0..len-1]--the CRC
-   should be initialized to all 1's, and the transmitted value
-   is the 1's complement of the final running CRC (see the
-   crc() routine below)). */
-
-uint32_t crc(uint8_t *buf, size_t len)
+/* Update a running CRC with the bytes buf[0..len-1]--the running
+   CRC is initialized to all 1's, and the transmitted value is the
+   1's complement of the final running CRC. crc is taken and returned
+   as the transmitted value, so a CRC can be continued across any
+   number of calls (see the crc() routine below). */
+uint32_t crc_update(uint32_t crc, const uint8_t *buf, size_t len)
 {
-
-	uint32_t c = 0xffffffff;
+	uint32_t c = crc ^ 0xffffffff;
 	size_t i;
 
 	for (i = 0; i < len; i++)
@@ -92,3 +91,7 @@ uint32_t crc(uint8_t *buf, size_t len)
 	return c ^ 0xffffffff;
 }
 
+uint32_t crc(uint8_t *buf, size_t len)
+{
+	return crc_update(0, buf, len);
+}
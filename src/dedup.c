@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <src/include/dedup.h>
+#include <src/include/file_handling.h>
+
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x00000100000001b3ULL
+
+struct dedup {
+	char folder[FGP_FOLDER_LEN]; // Folder the index was loaded from
+	size_t cnt; // Records held
+	size_t next; // Where the next record goes, the oldest once full
+	struct dedup_rec recs[DEDUP_MAX];
+};
+
+uint64_t dedup_copy(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	uint64_t hash = FNV_OFFSET;
+
+	/* Every byte is hashed while it is still in a register */
+	while (len--) {
+		hash ^= *src;
+		hash *= FNV_PRIME;
+		*dst++ = *src++;
+	}
+
+	return hash;
+}
+
+void *dedup_alloc(void)
+{
+	struct dedup *dd = malloc(sizeof(struct dedup));
+
+	dd->folder[0] = '\0';
+	dd->cnt = 0;
+	dd->next = 0;
+
+	return dd;
+}
+
+void dedup_free(void *dedup)
+{
+	free(dedup);
+}
+
+void dedup_folder_set(void *dedup, const char *folder)
+{
+	struct dedup *dd = dedup;
+	Storage *storage;
+	FuriString *path;
+	File *file;
+	uint64_t size;
+	size_t len;
+
+	if (!strcmp(dd->folder, folder))
+		return;
+
+	snprintf(dd->folder, sizeof(dd->folder), "%s", folder);
+	dd->cnt = 0;
+	dd->next = 0;
+
+	storage = furi_record_open(RECORD_STORAGE);
+	path = furi_string_alloc_set(APP_DATA_PATH(""));
+	storage_common_resolve_path_and_ensure_app_directory(storage, path);
+	furi_string_cat_printf(path, "%s/%s", folder, DEDUP_FILE);
+
+	file = storage_file_alloc(storage);
+	if (storage_file_open(file, furi_string_get_cstr(path), FSAM_READ, FSOM_OPEN_EXISTING)) {
+		/* Only the newest records are of use, a partial record at the
+		 * end from a save that didn't finish is left out.
+		 */
+		size = storage_file_size(file);
+		size -= size % sizeof(struct dedup_rec);
+		len = size / sizeof(struct dedup_rec);
+		if (len > DEDUP_MAX)
+			len = DEDUP_MAX;
+
+		if (storage_file_seek(file, size - (len * sizeof(struct dedup_rec)), true) &&
+		    storage_file_read(file, dd->recs, len * sizeof(struct dedup_rec)) ==
+		    len * sizeof(struct dedup_rec)) {
+			dd->cnt = len;
+			dd->next = len % DEDUP_MAX;
+		}
+	}
+	storage_file_close(file);
+	storage_file_free(file);
+	furi_record_close(RECORD_STORAGE);
+	furi_string_free(path);
+
+	FURI_LOG_D("dedup", "%s: %u records", folder, dd->cnt);
+}
+
+const struct dedup_rec *dedup_find(void *dedup, const struct dedup_rec *rec)
+{
+	struct dedup *dd = dedup;
+	size_t i;
+
+	/* Newest first, a reprint is most likely of something just printed */
+	for (i = 1; i <= dd->cnt; i++) {
+		const struct dedup_rec *cur = &dd->recs[(dd->next + DEDUP_MAX - i) % DEDUP_MAX];
+
+		if (cur->hash == rec->hash && cur->len == rec->len &&
+		    cur->tiles_w == rec->tiles_w && cur->palette == rec->palette)
+			return cur;
+	}
+
+	return NULL;
+}
+
+void dedup_add(void *dedup, const struct dedup_rec *rec)
+{
+	struct dedup *dd = dedup;
+
+	dd->recs[dd->next] = *rec;
+	dd->next = (dd->next + 1) % DEDUP_MAX;
+	if (dd->cnt < DEDUP_MAX)
+		dd->cnt++;
+}
@@ -13,6 +13,10 @@
 #include <src/include/fgp_app.h>
 #include <src/scenes/include/fgp_scene.h>
 #include <src/views/include/receive_view.h>
+#include <src/views/include/gallery_view.h>
+#include <src/include/tile_tools.h>
+#include <src/include/fgp_palette.h>
+#include <src/include/recompress.h>
 
 #include <protocols/printer/include/printer_proto.h>
 #include <gblink/include/gblink_pinconf.h>
@@ -41,12 +45,21 @@ static struct fgp_app *fgp_alloc(void)
 
 	fgp = malloc(sizeof(struct fgp_app));
 
+	// Pick the fastest image conversion routines that pass self-check
+	tile_tools_init();
+
+	// Built-in palettes, and any from the SD card
+	palette_load();
+
 	storage = furi_record_open(RECORD_STORAGE);
 	fs_path = furi_string_alloc_set(APP_DATA_PATH(""));
 	storage_common_resolve_path_and_ensure_app_directory(storage, fs_path);
 	furi_string_free(fs_path);
 	furi_record_close(RECORD_STORAGE);
 
+	// Recompression of saved PNGs, runs while nothing else needs the SD card
+	fgp->recompress = recompress_alloc();
+
 	// View Dispatcher
 	fgp->view_dispatcher = view_dispatcher_alloc();
 	view_dispatcher_set_event_callback_context(fgp->view_dispatcher, fgp);
@@ -69,6 +82,10 @@ static struct fgp_app *fgp_alloc(void)
 	// Receive
 	fgp->receive_view = fgp_receive_view_alloc(fgp);
 	view_dispatcher_add_view(fgp->view_dispatcher, fgpViewReceive, fgp_receive_view_get_view(fgp->receive_view));
+
+	// Gallery
+	fgp->gallery_view = fgp_gallery_view_alloc(fgp);
+	view_dispatcher_add_view(fgp->view_dispatcher, fgpViewGallery, fgp_gallery_view_get_view(fgp->gallery_view));
 	
 	// Scene manager
 	fgp->scene_manager = scene_manager_alloc(&fgp_scene_handlers, fgp);
@@ -91,6 +108,10 @@ static void fgp_free(struct fgp_app *fgp)
 	// Scene manager
 	scene_manager_free(fgp->scene_manager);
 
+	// Gallery View
+	view_dispatcher_remove_view(fgp->view_dispatcher, fgpViewGallery);
+	fgp_gallery_view_free(fgp->gallery_view);
+
 	// Receive View
 	view_dispatcher_remove_view(fgp->view_dispatcher, fgpViewReceive);
 	fgp_receive_view_free(fgp->receive_view);
@@ -106,6 +127,10 @@ static void fgp_free(struct fgp_app *fgp)
 	// View dispatcher
 	view_dispatcher_free(fgp->view_dispatcher);
 
+	recompress_free(fgp->recompress);
+
+	palette_unload();
+
 	free(fgp);
 }
 
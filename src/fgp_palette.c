@@ -5,58 +5,224 @@
 #include <furi.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include <lib/flipper_format/flipper_format.h>
+#include <storage/storage.h>
+
+#include <src/include/crc.h>
+#include <src/include/fgp_palette.h>
+
+/* Each palette is kept as a complete PNG PLTE chunk, CRC and all, that can be
+ * written to a file as is.
+ */
+struct __attribute__((__packed__)) palette_plte {
+	uint32_t data_len; // Always 12, big endian
+	uint8_t type[4];
+	uint8_t rgb[4][3];
+	uint32_t crc; // CRC of type and rgb, big endian
+};
 
 struct palette {
 	char *name;
 	char *shortname;
-	uint8_t rgb[4][3];
+	struct palette_plte plte;
 };
 
-static struct palette palettes[] = {
-	{ "B&W",	"bw",		{{ 0xff, 0xff, 0xff }, { 0xaa, 0xaa, 0xaa }, { 0x55, 0x55, 0x55 }, { 0x00, 0x00, 0x00 }}},
-	{ "DMG",	"dmg",		{{ 0x9b, 0xbc, 0x0f }, { 0x77, 0xa1, 0x12 }, { 0x30, 0x62, 0x30 }, { 0x0f, 0x38, 0x0f }}},
-	{ "GBP",	"gbp",		{{ 0xc4, 0xcf, 0xa1 }, { 0x8b, 0x95, 0x6d }, { 0x4d, 0x53, 0x3c }, { 0x1f, 0x1f, 0x1f }}},
-	{ "BGB",	"bgb",		{{ 0xe0, 0xf8, 0xd0 }, { 0x88, 0xc0, 0x70 }, { 0x34, 0x68, 0x56 }, { 0x08, 0x18, 0x20 }}},
-	{ "GBL",	"gbli",		{{ 0x1d, 0xde, 0xce }, { 0x19, 0xc7, 0xb3 }, { 0x16, 0xa5, 0x96 }, { 0x0b, 0x7a, 0x6d }}},
-	{ "GBCJP",	"gbcjp",	{{ 0xff, 0xff, 0xff }, { 0xff, 0xce, 0x00 }, { 0x9c, 0x63, 0x00 }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC D",	"gbcd",		{{ 0xff, 0xff, 0xa5 }, { 0xff, 0x94, 0x94 }, { 0x94, 0x94, 0xff }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC D+A",	"gbcda",	{{ 0xff, 0xff, 0xff }, { 0xff, 0xff, 0x00 }, { 0xff, 0x00, 0x00 }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC D+B", 	"gbcdb", 	{{ 0xff, 0xff, 0xff }, { 0xff, 0xff, 0x00 }, { 0x7b, 0x4a, 0x00 }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC L",	"gbcl",		{{ 0xff, 0xff, 0xff }, { 0x63, 0xa5, 0xff }, { 0x00, 0x00, 0xff }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC L+A",	"gbcla",	{{ 0xff, 0xff, 0xff }, { 0x8c, 0x8c, 0xde }, { 0x52, 0x52, 0x8c }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC L+B",	"gbclb",	{{ 0xff, 0xff, 0xff }, { 0xa5, 0xa5, 0xa5 }, { 0x52, 0x52, 0x52 }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC R",	"gbcr",		{{ 0xff, 0xff, 0xff }, { 0x52, 0xff, 0x00 }, { 0xff, 0x42, 0x00 }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC R+A",	"gbcra",	{{ 0xff, 0xff, 0xff }, { 0x7b, 0xff, 0x31 }, { 0x00, 0x63, 0xc5 }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC R+B",	"gbcrb",	{{ 0x00, 0x00, 0x00 }, { 0x00, 0x84, 0x84 }, { 0xff, 0xde, 0x00 }, { 0xff, 0xff, 0xff }}},
-	{ "GBC U",	"gbcu",		{{ 0xff, 0xff, 0xff }, { 0xff, 0xad, 0x63 }, { 0x84, 0x31, 0x00 }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC U+A",	"gbcua",	{{ 0xff, 0xff, 0xff }, { 0xff, 0x84, 0x84 }, { 0x94, 0x3a, 0x3a }, { 0x00, 0x00, 0x00 }}},
-	{ "GBC U+B",	"gbcub",	{{ 0xff, 0xe6, 0xc5 }, { 0xce, 0x9c, 0x84 }, { 0x84, 0x6b, 0x29 }, { 0x5a, 0x31, 0x08 }}},
+/* The CRC of each built-in palette is worked out ahead of time, run
+ * tools/palette_crc.py after adding or changing any of them.
+ */
+#define PALETTE(_name, _shortname, _crc, ...) \
+	{ _name, _shortname, { .data_len = 201326592, /* (uint32_t)__builtin_bswap32(12) */ \
+			       .type = { 'P', 'L', 'T', 'E' }, \
+			       .rgb = __VA_ARGS__, \
+			       .crc = _crc } }
+
+/* Palettes are referred to by index, which is also their bit in a palette set
+ * mask. This limits the total, built-in and loaded from SD, to 32.
+ */
+#define PALETTE_MAX	32
+#define PALETTE_BUILTIN	18 // Must match the number of palettes in palettes[]
+
+static struct palette palettes[PALETTE_MAX] = {
+	PALETTE("B&W",	"bw",		0x345b3301, {{ 0xff, 0xff, 0xff }, { 0xaa, 0xaa, 0xaa }, { 0x55, 0x55, 0x55 }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("DMG",	"dmg",		0xd25f8515, {{ 0x9b, 0xbc, 0x0f }, { 0x77, 0xa1, 0x12 }, { 0x30, 0x62, 0x30 }, { 0x0f, 0x38, 0x0f }}),
+	PALETTE("GBP",	"gbp",		0x1468215a, {{ 0xc4, 0xcf, 0xa1 }, { 0x8b, 0x95, 0x6d }, { 0x4d, 0x53, 0x3c }, { 0x1f, 0x1f, 0x1f }}),
+	PALETTE("BGB",	"bgb",		0x35c88735, {{ 0xe0, 0xf8, 0xd0 }, { 0x88, 0xc0, 0x70 }, { 0x34, 0x68, 0x56 }, { 0x08, 0x18, 0x20 }}),
+	PALETTE("GBL",	"gbli",		0x72e579e2, {{ 0x1d, 0xde, 0xce }, { 0x19, 0xc7, 0xb3 }, { 0x16, 0xa5, 0x96 }, { 0x0b, 0x7a, 0x6d }}),
+	PALETTE("GBCJP",	"gbcjp",	0xa680d96a, {{ 0xff, 0xff, 0xff }, { 0xff, 0xce, 0x00 }, { 0x9c, 0x63, 0x00 }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC D",	"gbcd",		0xd723ccd3, {{ 0xff, 0xff, 0xa5 }, { 0xff, 0x94, 0x94 }, { 0x94, 0x94, 0xff }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC D+A",	"gbcda",	0x2ca34c73, {{ 0xff, 0xff, 0xff }, { 0xff, 0xff, 0x00 }, { 0xff, 0x00, 0x00 }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC D+B", 	"gbcdb", 	0x0ab52ee4, {{ 0xff, 0xff, 0xff }, { 0xff, 0xff, 0x00 }, { 0x7b, 0x4a, 0x00 }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC L",	"gbcl",		0x051afc33, {{ 0xff, 0xff, 0xff }, { 0x63, 0xa5, 0xff }, { 0x00, 0x00, 0xff }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC L+A",	"gbcla",	0x4f259f23, {{ 0xff, 0xff, 0xff }, { 0x8c, 0x8c, 0xde }, { 0x52, 0x52, 0x8c }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC L+B",	"gbclb",	0xb12210c3, {{ 0xff, 0xff, 0xff }, { 0xa5, 0xa5, 0xa5 }, { 0x52, 0x52, 0x52 }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC R",	"gbcr",		0xbecd9444, {{ 0xff, 0xff, 0xff }, { 0x52, 0xff, 0x00 }, { 0xff, 0x42, 0x00 }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC R+A",	"gbcra",	0xece4243d, {{ 0xff, 0xff, 0xff }, { 0x7b, 0xff, 0x31 }, { 0x00, 0x63, 0xc5 }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC R+B",	"gbcrb",	0xb13e7e4c, {{ 0x00, 0x00, 0x00 }, { 0x00, 0x84, 0x84 }, { 0xff, 0xde, 0x00 }, { 0xff, 0xff, 0xff }}),
+	PALETTE("GBC U",	"gbcu",		0xdb6db523, {{ 0xff, 0xff, 0xff }, { 0xff, 0xad, 0x63 }, { 0x84, 0x31, 0x00 }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC U+A",	"gbcua",	0x70a71be8, {{ 0xff, 0xff, 0xff }, { 0xff, 0x84, 0x84 }, { 0x94, 0x3a, 0x3a }, { 0x00, 0x00, 0x00 }}),
+	PALETTE("GBC U+B",	"gbcub",	0xb789c139, {{ 0xff, 0xe6, 0xc5 }, { 0xce, 0x9c, 0x84 }, { 0x84, 0x6b, 0x29 }, { 0x5a, 0x31, 0x08 }}),
 };
 
+/* Sets of palettes that a PNG can be saved in, on top of the palette already
+ * selected. Each is a mask of indices in to palettes[] above.
+ */
+struct palette_set {
+	char *name;
+	uint32_t mask;
+};
+
+static struct palette_set palette_sets[] = {
+	{ "None",	0x00000000 },
+	{ "Classic",	0x0000000f }, // B&W, DMG, GBP, BGB
+	{ "GBC",	0x0003ffe0 }, // All GBC palettes
+	{ "All",	0xffffffff },
+};
+
+static size_t palette_count = PALETTE_BUILTIN;
+
+/* Load any extra palettes from palettes.txt in the app data folder, e.g.:
+ *
+ *   Filetype: Flipper GB Printer Palettes
+ *   Version: 1
+ *   Name: Mint
+ *   Short: mint
+ *   Colors: E0 F8 D0 88 C0 70 34 68 56 08 18 20
+ *
+ * with a Name, Short, and Colors, lightest first, for each palette. The PLTE
+ * chunk and its CRC are built once here so nothing is left to do at save time.
+ */
+void palette_load(void)
+{
+	Storage *storage = furi_record_open(RECORD_STORAGE);
+	FlipperFormat *format = flipper_format_file_alloc(storage);
+	FuriString *fs_tmp = furi_string_alloc_set(APP_DATA_PATH(""));
+	FuriString *name = furi_string_alloc();
+	struct palette *pal;
+	uint32_t version;
+
+	furi_assert(palettes[PALETTE_BUILTIN - 1].name && !palettes[PALETTE_BUILTIN].name);
+
+	storage_common_resolve_path_and_ensure_app_directory(storage, fs_tmp);
+	furi_string_cat(fs_tmp, "palettes.txt");
+
+	if (!flipper_format_file_open_existing(format, furi_string_get_cstr(fs_tmp)))
+		goto out;
+
+	if (!flipper_format_read_header(format, fs_tmp, &version) ||
+	    furi_string_cmp_str(fs_tmp, "Flipper GB Printer Palettes") || version != 1) {
+		FURI_LOG_E("pal", "palettes.txt has a bad header");
+		goto out;
+	}
+
+	while (palette_count < PALETTE_MAX) {
+		pal = &palettes[palette_count];
+
+		if (!flipper_format_read_string(format, "Name", name))
+			break;
+		if (!flipper_format_read_string(format, "Short", fs_tmp) ||
+		    !flipper_format_read_hex(format, "Colors", (uint8_t *)pal->plte.rgb, sizeof(pal->plte.rgb))) {
+			FURI_LOG_E("pal", "%s is missing Short or Colors", furi_string_get_cstr(name));
+			break;
+		}
+
+		/* Shortnames end up in file names, they must be unique */
+		if (palette_idx_get(furi_string_get_cstr(fs_tmp)) >= 0) {
+			FURI_LOG_W("pal", "%s already exists, skipping", furi_string_get_cstr(fs_tmp));
+			continue;
+		}
+
+		pal->name = strdup(furi_string_get_cstr(name));
+		pal->shortname = strdup(furi_string_get_cstr(fs_tmp));
+		pal->plte.data_len = palettes[0].plte.data_len;
+		memcpy(pal->plte.type, palettes[0].plte.type, sizeof(pal->plte.type));
+		pal->plte.crc = __builtin_bswap32(crc(pal->plte.type, sizeof(pal->plte.type) + sizeof(pal->plte.rgb)));
+		palette_count++;
+	}
+
+	FURI_LOG_I("pal", "%u palettes", palette_count);
+
+out:
+	furi_string_free(name);
+	furi_string_free(fs_tmp);
+	flipper_format_free(format);
+	furi_record_close(RECORD_STORAGE);
+}
+
+void palette_unload(void)
+{
+	while (palette_count > PALETTE_BUILTIN) {
+		palette_count--;
+		free(palettes[palette_count].name);
+		free(palettes[palette_count].shortname);
+	}
+}
+
 size_t palette_count_get(void)
 {
-	return COUNT_OF(palettes);
+	return palette_count;
 }
 
 char *palette_name_get(unsigned int idx)
 {
-	if (idx > palette_count_get())
+	if (idx >= palette_count_get())
 		return NULL;
 
 	return palettes[idx].name;
 }
 char *palette_shortname_get(unsigned int idx)
 {
-	if (idx > palette_count_get())
+	if (idx >= palette_count_get())
 		return NULL;
 
 	return palettes[idx].shortname;
 }
 
+int palette_idx_get(const char *shortname)
+{
+	unsigned int i;
+
+	for (i = 0; i < palette_count_get(); i++) {
+		if (!strcmp(palettes[i].shortname, shortname))
+			return i;
+	}
+
+	return -1;
+}
+
 void *palette_rgb16_get(unsigned int idx)
 {
-	if (idx > palette_count_get())
+	if (idx >= palette_count_get())
+		return NULL;
+
+	return palettes[idx].plte.rgb;
+}
+
+const uint8_t *palette_plte_get(unsigned int idx)
+{
+	if (idx >= palette_count_get())
 		return NULL;
 
-	return palettes[idx].rgb;
+	return (const uint8_t *)&palettes[idx].plte;
+}
+
+size_t palette_set_count_get(void)
+{
+	return COUNT_OF(palette_sets);
+}
+
+char *palette_set_name_get(unsigned int idx)
+{
+	if (idx >= palette_set_count_get())
+		return NULL;
+
+	return palette_sets[idx].name;
+}
+
+uint32_t palette_set_mask_get(unsigned int idx)
+{
+	if (idx >= palette_set_count_get())
+		return 0;
+
+	return palette_sets[idx].mask;
 }
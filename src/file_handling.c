@@ -4,12 +4,15 @@
 #include <lib/flipper_format/flipper_format.h>
 #include <storage/storage.h>
 
+#include <src/include/file_handling.h>
+
 struct fgp_storage {
 	Storage *storage;
 	File *file;
 	FuriString *base_path;
 	FuriString *file_name;
 	FuriString *date;
+	FuriString *session_path; // Name of session files, without extension
 	DateTime saved_date;
 	uint32_t count;
 };
@@ -42,7 +45,6 @@ static void fgp_build_path_and_dir(struct fgp_storage *storage)
 void fgp_storage_next_count(void *fgp_storage)
 {
 	struct fgp_storage *storage = fgp_storage;
-	DateTime cur_date = {0};
 	FlipperFormat *format = NULL;
 	FuriString *fs_tmp = furi_string_alloc();
 
@@ -87,6 +89,14 @@ void fgp_storage_next_count(void *fgp_storage)
 	storage->count++;
 	if (storage->count > 9999)
 		storage->count = 0;
+	fgp_storage_date_refresh(storage);
+};
+
+void fgp_storage_date_refresh(void *fgp_storage)
+{
+	struct fgp_storage *storage = fgp_storage;
+	DateTime cur_date = {0};
+
 	furi_hal_rtc_get_datetime(&cur_date);
 	/* XXX: If this does rollover, it can take a lot of time to create the new
 	 * directory. Is this worth doing? Maybe update the file string but not
@@ -94,21 +104,34 @@ void fgp_storage_next_count(void *fgp_storage)
 	 */
 	if (cur_date.day != storage->saved_date.day)
 		fgp_build_path_and_dir(storage);
-};
+}
 
 /* TODO: Add a tell() function... Why? */
 
+uint32_t fgp_storage_count_get(void *fgp_storage)
+{
+	struct fgp_storage *storage = fgp_storage;
+
+	return storage->count;
+}
+
+/* Full path of the current file with extension */
+static FuriString *fgp_storage_path_alloc(struct fgp_storage *storage, const char *extension)
+{
+	return furi_string_alloc_printf("%s/%s%s_%04d%s", furi_string_get_cstr(storage->base_path),
+							 furi_string_get_cstr(storage->file_name),
+							 furi_string_get_cstr(storage->date),
+							 (uint16_t)storage->count,
+							 extension);
+}
+
 /* True if file opened successfully */
 bool fgp_storage_open(void *fgp_storage, const char *extension)
 {
 	struct fgp_storage *storage = fgp_storage;
 	bool ret = false;
 
-	FuriString *fs_tmp = furi_string_alloc_printf("%s/%s%s_%04d%s", furi_string_get_cstr(storage->base_path),
-								 furi_string_get_cstr(storage->file_name),
-								 furi_string_get_cstr(storage->date),
-								 (uint16_t)storage->count,
-								 extension);
+	FuriString *fs_tmp = fgp_storage_path_alloc(storage, extension);
 
 	ret = storage_file_open(storage->file,
 				furi_string_get_cstr(fs_tmp),
@@ -120,6 +143,113 @@ bool fgp_storage_open(void *fgp_storage, const char *extension)
 	return ret;
 }
 
+/* True if file opened successfully */
+bool fgp_storage_open_count(void *fgp_storage, uint32_t count, const char *extension)
+{
+	struct fgp_storage *storage = fgp_storage;
+	uint32_t cur_count = storage->count;
+	FuriString *fs_tmp;
+	bool ret = false;
+
+	storage->count = count;
+	fs_tmp = fgp_storage_path_alloc(storage, extension);
+	storage->count = cur_count;
+
+	ret = storage_file_open(storage->file,
+				furi_string_get_cstr(fs_tmp),
+				FSAM_WRITE,
+				FSOM_CREATE_ALWAYS);
+
+	furi_string_free(fs_tmp);
+
+	return ret;
+}
+
+/* True if file opened successfully */
+bool fgp_storage_open_count_read(void *fgp_storage, File *file, uint32_t count, const char *extension)
+{
+	struct fgp_storage *storage = fgp_storage;
+	uint32_t cur_count = storage->count;
+	FuriString *fs_tmp;
+	bool ret = false;
+
+	storage->count = count;
+	fs_tmp = fgp_storage_path_alloc(storage, extension);
+	storage->count = cur_count;
+
+	ret = storage_file_open(file,
+				furi_string_get_cstr(fs_tmp),
+				FSAM_READ,
+				FSOM_OPEN_EXISTING);
+
+	furi_string_free(fs_tmp);
+
+	return ret;
+}
+
+/* True if file opened successfully */
+bool fgp_storage_open_folder(void *fgp_storage, const char *name)
+{
+	struct fgp_storage *storage = fgp_storage;
+	FuriString *fs_tmp;
+	bool ret = false;
+
+	fs_tmp = furi_string_alloc_printf("%s/%s", furi_string_get_cstr(storage->base_path), name);
+	ret = storage_file_open(storage->file,
+				furi_string_get_cstr(fs_tmp),
+				FSAM_WRITE,
+				FSOM_OPEN_APPEND);
+	furi_string_free(fs_tmp);
+
+	return ret;
+}
+
+/* True if file opened successfully */
+bool fgp_storage_open_session(void *fgp_storage, const char *extension, bool create)
+{
+	struct fgp_storage *storage = fgp_storage;
+	FuriString *fs_tmp;
+	bool ret = false;
+
+	/* Every session file is named after whichever file was current the
+	 * first time any of them was opened.
+	 */
+	if (furi_string_empty(storage->session_path)) {
+		fs_tmp = fgp_storage_path_alloc(storage, "");
+		furi_string_set(storage->session_path, fs_tmp);
+		furi_string_free(fs_tmp);
+	}
+
+	fs_tmp = furi_string_alloc_printf("%s%s", furi_string_get_cstr(storage->session_path), extension);
+	ret = storage_file_open(storage->file,
+				furi_string_get_cstr(fs_tmp),
+				FSAM_WRITE,
+				create ? FSOM_CREATE_ALWAYS : FSOM_OPEN_APPEND);
+	furi_string_free(fs_tmp);
+
+	return ret;
+}
+
+/* True if copied successfully */
+bool fgp_storage_copy(void *fgp_storage, const char *src_extension, const char *dst_extension)
+{
+	struct fgp_storage *storage = fgp_storage;
+	FuriString *src = fgp_storage_path_alloc(storage, src_extension);
+	FuriString *dst = fgp_storage_path_alloc(storage, dst_extension);
+	bool ret = false;
+
+	/* Copy refuses to overwrite an existing file */
+	storage_simply_remove(storage->storage, furi_string_get_cstr(dst));
+	ret = (storage_common_copy(storage->storage,
+				   furi_string_get_cstr(src),
+				   furi_string_get_cstr(dst)) == FSE_OK);
+
+	furi_string_free(src);
+	furi_string_free(dst);
+
+	return ret;
+}
+
 size_t fgp_storage_write(void *fgp_storage, const void *buf, size_t len)
 {
 	struct fgp_storage *storage = fgp_storage;
@@ -162,10 +292,83 @@ void fgp_storage_free(void *fgp_storage)
 	furi_string_free(storage->base_path);
 	furi_string_free(storage->file_name);
 	furi_string_free(storage->date);
+	furi_string_free(storage->session_path);
 
 	free(storage);
 }
 
+void fgp_storage_today_get(char *name)
+{
+	DateTime date;
+
+	furi_hal_rtc_get_datetime(&date);
+	snprintf(name, FGP_FOLDER_LEN, "%04d-%02d-%02d", date.year, date.month, date.day);
+}
+
+void fgp_storage_folder_get(void *fgp_storage, char *name)
+{
+	struct fgp_storage *storage = fgp_storage;
+
+	snprintf(name, FGP_FOLDER_LEN, "%s", furi_string_get_cstr(storage->date));
+}
+
+static bool fgp_storage_folder_name_check(const char *name)
+{
+	unsigned int i;
+
+	if (strlen(name) != FGP_FOLDER_LEN - 1)
+		return false;
+
+	for (i = 0; i < FGP_FOLDER_LEN - 1; i++) {
+		if (i == 4 || i == 7) {
+			if (name[i] != '-')
+				return false;
+		} else if (name[i] < '0' || name[i] > '9') {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static int fgp_storage_folder_cmp(const void *a, const void *b)
+{
+	return strcmp(a, b);
+}
+
+size_t fgp_storage_folders_get(Storage *storage, const char *path, const char *after, char (**folders)[FGP_FOLDER_LEN])
+{
+	File *dir = storage_file_alloc(storage);
+	FileInfo info;
+	char name[FGP_FOLDER_LEN + 1];
+	size_t cnt = 0;
+
+	*folders = NULL;
+
+	/* Names too long to fit in name come back cut short, and the extra
+	 * length is what keeps them from passing the check.
+	 */
+	if (storage_dir_open(dir, path)) {
+		while (storage_dir_read(dir, &info, name, sizeof(name))) {
+			if (!file_info_is_dir(&info) || !fgp_storage_folder_name_check(name) ||
+			    strcmp(name, after) <= 0)
+				continue;
+
+			if (!(cnt % 16))
+				*folders = realloc(*folders, (cnt + 16) * FGP_FOLDER_LEN);
+			strcpy((*folders)[cnt++], name);
+		}
+	}
+	storage_dir_close(dir);
+	storage_file_free(dir);
+
+	/* Dated names sort oldest first */
+	if (cnt)
+		qsort(*folders, cnt, FGP_FOLDER_LEN, fgp_storage_folder_cmp);
+
+	return cnt;
+}
+
 /* Extension is used for making a full file */
 void *fgp_storage_alloc(char *file_prefix, char *extension)
 {
@@ -180,6 +383,7 @@ void *fgp_storage_alloc(char *file_prefix, char *extension)
 	storage->file_name = furi_string_alloc_set(file_prefix);
 	storage->base_path = furi_string_alloc();
 	storage->date = furi_string_alloc();
+	storage->session_path = furi_string_alloc();
 
 	/* Get settings */
 	furi_string_set(fs_tmp, APP_DATA_PATH(""));
@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/gif.h>
+
+/* Every px is one of 4 shades, so LZW starts from 2 bit codes. Clear and end
+ * of information are the first two codes after those, new strings are added
+ * from there up to the 12 bit limit of GIF.
+ */
+#define LZW_MIN_SIZE	2
+#define LZW_CLEAR	(1 << LZW_MIN_SIZE)
+#define LZW_EOI		(LZW_CLEAR + 1)
+#define LZW_FIRST	(LZW_CLEAR + 2)
+#define LZW_MAX_CODE	4096
+
+/* Strings are looked up by their prefix code and the px that follows it, in
+ * a fixed size, open addressed, hash table. A prime larger than the number of
+ * codes keeps probes short even right before the table is cleared. Prefix and
+ * px together are 14 bits, the key is stored +1 so 0 can mark an empty slot.
+ */
+#define LZW_HSIZE	5003
+
+struct __attribute__((__packed__)) gif_head {
+	uint8_t magic[6]; // GIF89a
+	uint16_t width;
+	uint16_t height;
+	uint8_t flags; // Global color table of 4 colors
+	uint8_t bg_color;
+	uint8_t aspect;
+};
+
+struct __attribute__((__packed__)) gif_image {
+	uint8_t separator; // Always 0x2c
+	uint16_t left;
+	uint16_t top;
+	uint16_t width;
+	uint16_t height;
+	uint8_t flags; // No local color table, not interlaced
+	uint8_t lzw_min_size;
+};
+
+struct gif {
+	struct gif_head head;
+	uint8_t gct[4][3];
+
+	/* Output sink, and whether any write to it came up short */
+	png_write_cb write;
+	void *write_ctx;
+	bool error;
+	size_t written;
+
+	size_t width_px; // Width of the source rows
+	size_t height_px; // Total height of the whole, scaled, image
+	unsigned int scale;
+
+	/* LZW state, the string matched so far and the next code to add */
+	int prefix;
+	unsigned int code_size;
+	unsigned int next_code;
+
+	/* Bits not yet making up a whole byte, LSB first as GIF wants */
+	uint32_t bit_buf;
+	unsigned int bit_cnt;
+
+	/* One sub-block being filled, its length byte first */
+	uint8_t block[256];
+
+	uint16_t keys[LZW_HSIZE];
+	uint16_t codes[LZW_HSIZE];
+};
+
+static const struct gif_head gif_head_data = {
+	.magic = { 'G', 'I', 'F', '8', '9', 'a' },
+	.flags = 0xf1, // Global color table, 8 bit color resolution, 4 colors
+	.bg_color = 0,
+	.aspect = 0,
+};
+
+static void gif_write(struct gif *gif, const void *buf, size_t len)
+{
+	if (gif->write(gif->write_ctx, buf, len) != len)
+		gif->error = true;
+	gif->written += len;
+}
+
+static void gif_block_flush(struct gif *gif)
+{
+	if (!gif->block[0])
+		return;
+
+	gif_write(gif, gif->block, gif->block[0] + 1);
+	gif->block[0] = 0;
+}
+
+static void gif_byte(struct gif *gif, uint8_t byte)
+{
+	gif->block[++gif->block[0]] = byte;
+	if (gif->block[0] == 255)
+		gif_block_flush(gif);
+}
+
+static void gif_code(struct gif *gif, unsigned int code)
+{
+	gif->bit_buf |= code << gif->bit_cnt;
+	gif->bit_cnt += gif->code_size;
+
+	while (gif->bit_cnt >= 8) {
+		gif_byte(gif, gif->bit_buf);
+		gif->bit_buf >>= 8;
+		gif->bit_cnt -= 8;
+	}
+}
+
+static void gif_lzw_clear(struct gif *gif)
+{
+	memset(gif->keys, 0, sizeof(gif->keys));
+	gif->code_size = LZW_MIN_SIZE + 1;
+	gif->next_code = LZW_FIRST;
+}
+
+/* The decoder adds a string for every code it reads but the first, so it
+ * widens codes one code later than the encoder adds strings. Both agree on
+ * when that happens as long as the width here is checked as if a string was
+ * added after every code sent.
+ */
+static void gif_lzw_widen(struct gif *gif, unsigned int next_code)
+{
+	if (next_code > (1U << gif->code_size) && gif->code_size < 12)
+		gif->code_size++;
+}
+
+static void gif_lzw_px(struct gif *gif, unsigned int px)
+{
+	unsigned int key;
+	size_t slot;
+
+	if (gif->prefix < 0) {
+		gif->prefix = px;
+		return;
+	}
+
+	key = ((gif->prefix << 2) | px) + 1;
+	slot = ((key * 2654435761UL) >> 8) % LZW_HSIZE;
+	while (gif->keys[slot]) {
+		if (gif->keys[slot] == key) {
+			gif->prefix = gif->codes[slot];
+			return;
+		}
+		if (++slot == LZW_HSIZE)
+			slot = 0;
+	}
+
+	gif_code(gif, gif->prefix);
+	gif->prefix = px;
+
+	gif->keys[slot] = key;
+	gif->codes[slot] = gif->next_code++;
+	gif_lzw_widen(gif, gif->next_code);
+
+	/* Out of codes, start over from single px */
+	if (gif->next_code == LZW_MAX_CODE) {
+		gif_code(gif, LZW_CLEAR);
+		gif_lzw_clear(gif);
+	}
+}
+
+void gif_reset(void *gif_handle, size_t px_w, unsigned int scale)
+{
+	struct gif *gif = gif_handle;
+
+	gif->width_px = px_w;
+	gif->scale = scale;
+	gif->height_px = 0;
+
+	memcpy(&gif->head, &gif_head_data, sizeof(struct gif_head));
+	gif->head.width = px_w * scale;
+	gif->head.height = 0;
+}
+
+void gif_palette_set(void *gif_handle, const uint8_t (*rgb)[3])
+{
+	struct gif *gif = gif_handle;
+
+	memcpy(gif->gct, rgb, sizeof(gif->gct));
+}
+
+void gif_start(void *gif_handle, size_t px_h, png_write_cb write, void *write_ctx, bool resume)
+{
+	struct gif *gif = gif_handle;
+	struct gif_image image = {
+		.separator = 0x2c,
+		.left = 0,
+		.top = gif->height_px,
+		.width = gif->width_px * gif->scale,
+		.height = px_h * gif->scale,
+		.flags = 0,
+		.lzw_min_size = LZW_MIN_SIZE,
+	};
+
+	gif->write = write;
+	gif->write_ctx = write_ctx;
+	gif->error = false;
+	gif->written = 0;
+
+	if (!resume) {
+		gif_write(gif, &gif->head, sizeof(struct gif_head));
+		gif_write(gif, gif->gct, sizeof(gif->gct));
+	}
+	gif_write(gif, &image, sizeof(struct gif_image));
+
+	gif->bit_buf = 0;
+	gif->bit_cnt = 0;
+	gif->block[0] = 0;
+	gif->prefix = -1;
+	gif_lzw_clear(gif);
+	gif_code(gif, LZW_CLEAR);
+}
+
+void gif_row(void *gif_handle, const uint8_t *row)
+{
+	struct gif *gif = gif_handle;
+	size_t px;
+	unsigned int shade;
+	unsigned int x;
+	unsigned int y;
+
+	/* Unlike PNG, there is no filter to make a repeated row free, but
+	 * LZW picks up on it fast as the same strings come by again.
+	 */
+	for (y = 0; y < gif->scale; y++) {
+		for (px = 0; px < gif->width_px; px++) {
+			shade = (row[px / 4] >> (6 - ((px % 4) * 2))) & 0x03;
+			for (x = 0; x < gif->scale; x++)
+				gif_lzw_px(gif, shade);
+		}
+	}
+
+	gif->height_px += gif->scale;
+}
+
+bool gif_finish(void *gif_handle)
+{
+	struct gif *gif = gif_handle;
+	const uint8_t trailer[2] = { 0x00, 0x3b }; // Block terminator, trailer
+
+	if (gif->prefix >= 0) {
+		gif_code(gif, gif->prefix);
+		gif_lzw_widen(gif, gif->next_code + 1);
+	}
+	gif_code(gif, LZW_EOI);
+	if (gif->bit_cnt)
+		gif_byte(gif, gif->bit_buf);
+	gif_block_flush(gif);
+	gif_write(gif, trailer, sizeof(trailer));
+
+	gif->head.height = gif->height_px;
+
+	return !gif->error;
+}
+
+size_t gif_written_get(void *gif_handle)
+{
+	struct gif *gif = gif_handle;
+
+	return gif->written;
+}
+
+uint8_t *gif_buf_get(void *gif_handle, enum gif_parts part)
+{
+	struct gif *gif = gif_handle;
+
+	switch (part) {
+	case GIF_HEAD:
+		return (uint8_t *)&gif->head;
+	case GIF_GCT:
+		return (uint8_t *)gif->gct;
+	default:
+		return NULL;
+	}
+}
+
+size_t gif_len_get(void *gif_handle, enum gif_parts part)
+{
+	UNUSED(gif_handle);
+
+	switch (part) {
+	case GIF_HEAD:
+		return sizeof(struct gif_head);
+	case GIF_GCT:
+		return GIF_GCT_LEN;
+	case GIF_TRAILER:
+		return 1; // Just the trailer, the block terminator stays
+	default:
+		return 0;
+	}
+}
+
+void *gif_alloc(void)
+{
+	struct gif *gif = malloc(sizeof(struct gif));
+
+	gif_reset(gif, 160, 1);
+
+	return gif;
+}
+
+void gif_free(void *gif_handle)
+{
+	free(gif_handle);
+}
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#pragma once
+
+#include <stdint.h>
+
+/* A fast capture, GCIM_YYYY-MM-DD_XXXX-cap.bin, is CAPTURE_MAGIC followed by
+ * one record per print of the image, each a header then tiles_w * tiles_h
+ * tiles of gb tile data exactly as received. Prints stacked without margins
+ * are records of the same file. Every field is little endian.
+ */
+#define CAPTURE_MAGIC	"GB-CAP01"
+#define CAPTURE_EXT	"-cap.bin"
+
+/* A record of type 'R' is the same, but each row of tiles is stored as a
+ * uint16_t length then the row in the Game Boy Printer RLE format. A length
+ * with CAPTURE_ROW_RAW set is a row stored as is, it didn't get any smaller.
+ * Records are only ever 'R' if that makes them smaller than a 'P'.
+ */
+#define CAPTURE_ROW_RAW	0x8000
+
+struct __attribute__((__packed__)) capture_rec {
+	uint8_t type; // 'P' or 'R'
+	uint8_t margins; // Print command margins byte
+	uint8_t palette; // Print command palette byte
+	uint8_t exposure; // Print command exposure byte
+	uint16_t tiles_w;
+	uint16_t tiles_h;
+};
+
+struct convert_stats {
+	unsigned int done; // Captures converted to PNG
+	unsigned int errors; // Captures that couldn't be read or saved
+};
+
+/* Find every dated folder that may still have captures without a PNG. Folders
+ * already fully converted by an earlier run, as noted in the state file, are
+ * not looked at again. PNGs are saved in palette idx.
+ */
+void *convert_alloc(unsigned int idx);
+
+/* Save the state file and free everything. A later convert_alloc() picks up
+ * where this left off.
+ */
+void convert_free(void *convert_handle);
+
+/* Convert up to max captures that don't have a PNG yet, then save the state
+ * file. Returns false once there are no captures left to convert.
+ */
+bool convert_batch(void *convert_handle, unsigned int max);
+
+/* Totals of this run */
+void convert_stats_get(void *convert_handle, struct convert_stats *stats);
+
+#endif // CONVERT_H
@@ -9,4 +9,9 @@
 /* Return the CRC of the bytes buf[0..len-1]. */
 uint32_t crc(uint8_t *buf, size_t len);
 
+/* Return the CRC of everything crc was the CRC of, followed by the bytes
+ * buf[0..len-1]. The CRC of nothing is 0.
+ */
+uint32_t crc_update(uint32_t crc, const uint8_t *buf, size_t len);
+
 #endif // CRC_H
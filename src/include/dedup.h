@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#pragma once
+
+#include <stdint.h>
+
+/* Every dated folder has a hash index, with a record for each image saved to
+ * it, in the order they were saved. A print with the same hash, size and
+ * palette byte as one in the index is the same image printed again.
+ */
+#define DEDUP_FILE	".hashes"
+
+/* Newest records of the index kept in RAM, older images aren't matched */
+#define DEDUP_MAX	256
+
+struct __attribute__((__packed__)) dedup_rec {
+	uint64_t hash; // FNV-1a of the tile data
+	uint32_t len; // Bytes of tile data
+	uint16_t count; // Number of the file the image was saved to
+	uint8_t tiles_w;
+	uint8_t palette; // Print command palette byte
+};
+
+/* Copy len bytes of tile data from src to dst, returns their hash */
+uint64_t dedup_copy(uint8_t *dst, const uint8_t *src, size_t len);
+
+void *dedup_alloc(void);
+
+void dedup_free(void *dedup);
+
+/* Load the newest DEDUP_MAX records of the index of folder, named YYYY-MM-DD,
+ * in one read. Nothing is done if folder is already the one loaded.
+ */
+void dedup_folder_set(void *dedup, const char *folder);
+
+/* The record of the image rec is a reprint of, or NULL if it isn't one */
+const struct dedup_rec *dedup_find(void *dedup, const struct dedup_rec *rec);
+
+/* Remember rec, the oldest record is forgotten if there are DEDUP_MAX already.
+ * Only the copy in RAM is changed, appending rec to the index is up to the
+ * caller.
+ */
+void dedup_add(void *dedup, const struct dedup_rec *rec);
+
+#endif // DEDUP_H
@@ -21,7 +21,41 @@
 #define OPT_SAVE_BIN		(1 << 0)
 #define OPT_SAVE_BIN_HDR	(1 << 1)
 #define OPT_SAVE_PNG		(1 << 2)
-#define RECV_OPTS		(OPT_SAVE_BIN | OPT_SAVE_BIN_HDR | OPT_SAVE_PNG)
+#define OPT_SAVE_TILES		(1 << 3)
+#define OPT_SAVE_APNG		(1 << 4)
+#define OPT_SAVE_GIF		(1 << 5)
+#define SAVE_OPTS		(OPT_SAVE_BIN | OPT_SAVE_BIN_HDR | OPT_SAVE_PNG | OPT_SAVE_TILES | OPT_SAVE_APNG | OPT_SAVE_GIF)
+/* Only save the raw tiles of each print, everything else is done later */
+#define OPT_FAST_CAPTURE	(1 << 6)
+/* Send each print to a PC over USB serial as it comes in */
+#define OPT_STREAM_USB		(1 << 7)
+#define RECV_OPTS		(SAVE_OPTS | OPT_FAST_CAPTURE | OPT_STREAM_USB)
+
+/* Transforms that can be done to a print before saving it as a PNG */
+enum fgp_xform {
+	XFORM_NONE,
+	XFORM_PHOTO, // Just the 128x112 photo of a GB Camera print, no frame
+	XFORM_TRIM, // Drop blank rows of tiles at the top and bottom
+	XFORM_MIRROR,
+	XFORM_ROTATE, // 90 degrees clockwise
+	XFORM_COUNT,
+};
+
+/* What to do with a print that is the same as one already saved today */
+enum fgp_dup {
+	DUP_SAVE, // Save it again like any other print
+	DUP_LINK, // Only save a small file naming the earlier one
+	DUP_SKIP, // Save nothing, only count it
+	DUP_COUNT,
+};
+
+/* Layout of the contact sheet made of each session's images */
+enum fgp_sheet {
+	SHEET_NONE,
+	SHEET_GRID, // As close to square as the images fit
+	SHEET_POSTER, // All in one row, side by side
+	SHEET_LAYOUT_COUNT,
+};
 
 struct fgp_app {
 	ViewDispatcher *view_dispatcher;
@@ -31,6 +65,7 @@ struct fgp_app {
 	Submenu *submenu;
 	VariableItemList *variable_item_list;
 	void *receive_view;
+	void *gallery_view;
 
 	Storage *storage;
 
@@ -38,12 +73,26 @@ struct fgp_app {
 
 	unsigned int options;
 	unsigned int palette_idx;
+	unsigned int palette_set_idx; // Extra palettes to also save PNGs in
+	unsigned int png_scale; // Each PNG px is png_scale x png_scale px
+	enum fgp_xform png_xform; // Transform done to each print saved as PNG
+	enum fgp_dup dup_mode;
+	enum fgp_sheet sheet;
+	unsigned int sheet_gap; // Tiles of shade 0 around each image of the sheet
+	unsigned int repalette_idx; // Palette to recolor a folder of PNGs to
+	unsigned int convert_idx; // Palette to convert fast captures to
+	void *convert; // Fast captures being converted, NULL if not running
+	void *thumb_build; // Thumbnails of a folder being rebuilt, NULL if not running
+	void *sheet_out; // Contact sheet left to write by the receive view, or NULL
+	void *sheet_storage; // Files of the session sheet_out is of
+	void *recompress; // Background recompression of saved PNGs
 };
 
 typedef enum {
 	fgpViewSubmenu,
 	fgpViewVariableItemList,
 	fgpViewReceive,
+	fgpViewGallery,
 } fgpView;
 
 #endif // FGP_APP_H
@@ -7,12 +7,34 @@
 
 #pragma once
 
+/* Add any palettes from the SD card to the built-in ones. Should be called
+ * once at startup, before any palette is used.
+ */
+void palette_load(void);
+
+void palette_unload(void);
+
 size_t palette_count_get(void);
 
 char *palette_name_get(unsigned int idx);
 
 char *palette_shortname_get(unsigned int idx);
 
+/* Index of the palette with shortname, or -1 if there is none */
+int palette_idx_get(const char *shortname);
+
 void *palette_rgb16_get(unsigned int idx);
 
+/* The complete PLTE chunk of the palette, PNG_PLTE_LEN bytes with CRC */
+const uint8_t *palette_plte_get(unsigned int idx);
+
+/* A palette set is a named group of palettes, as a mask with bit n set for
+ * each palette idx n in the group.
+ */
+size_t palette_set_count_get(void);
+
+char *palette_set_name_get(unsigned int idx);
+
+uint32_t palette_set_mask_get(unsigned int idx);
+
 #endif // FGP_PALETTE_H
@@ -4,12 +4,58 @@
 #pragma once
 
 #include <stdint.h>
+#include <storage/storage.h>
+
+/* Files are saved to a folder per day, named YYYY-MM-DD */
+#define FGP_FOLDER_LEN	11 // YYYY-MM-DD and the NUL
 
 void fgp_storage_next_count(void *fgp_storage);
 
+/* Number of the current file, as used in its name */
+uint32_t fgp_storage_count_get(void *fgp_storage);
+
+/* Move the current file to the folder of today if the day changed since it was
+ * named. Only between images, never while the current file may still be added
+ * to.
+ */
+void fgp_storage_date_refresh(void *fgp_storage);
+
 /* True if file opened successfully */
 bool fgp_storage_open(void *fgp_storage, const char *extension);
 
+/* Create, or empty, the file of an earlier count with extension, in the folder
+ * of the current file.
+ * True if file opened successfully.
+ */
+bool fgp_storage_open_count(void *fgp_storage, uint32_t count, const char *extension);
+
+/* Open the file of an earlier count with extension, in the folder of the
+ * current file, for reading with file, a File of the caller's own. This
+ * leaves the file of fgp_storage free to be written at the same time.
+ * True if file opened successfully.
+ */
+bool fgp_storage_open_count_read(void *fgp_storage, File *file, uint32_t count, const char *extension);
+
+/* Open name in the folder of the current file, for append. Any seek and write
+ * after that works as usual.
+ * True if file opened successfully.
+ */
+bool fgp_storage_open_folder(void *fgp_storage, const char *name);
+
+/* Open a file shared by everything saved in this session, i.e. since
+ * fgp_storage_alloc(). All session files are named after the current file the
+ * first time any of them is opened. If create, the file is created empty,
+ * otherwise it is opened for append.
+ * True if file opened successfully.
+ */
+bool fgp_storage_open_session(void *fgp_storage, const char *extension, bool create);
+
+/* Copy the current file with src_extension over the current file with
+ * dst_extension. Must not be called while a file is open.
+ * True if copied successfully.
+ */
+bool fgp_storage_copy(void *fgp_storage, const char *src_extension, const char *dst_extension);
+
 size_t fgp_storage_write(void *fgp_storage, const void *buf, size_t len);
 
 bool fgp_storage_close(void *fgp_storage);
@@ -18,6 +64,20 @@ bool fgp_storage_seek(void *fgp_storage, off_t offs, bool from_start);
 
 void fgp_storage_free(void *fgp_storage);
 
+/* Name of the folder files saved right now go to */
+void fgp_storage_today_get(char *name);
+
+/* Name of the folder of the current file. This only moves on to a new day
+ * once the count does, or on fgp_storage_date_refresh().
+ */
+void fgp_storage_folder_get(void *fgp_storage, char *name);
+
+/* List the dated folders in path, which ends in a /, that sort after the
+ * folder named after, oldest first. Returns the number found, folders is set
+ * to a list that must be free()d either way.
+ */
+size_t fgp_storage_folders_get(Storage *storage, const char *path, const char *after, char (**folders)[FGP_FOLDER_LEN]);
+
 /* Extension is used for making a full file */
 void *fgp_storage_alloc(char *file_prefix, char *extension);
 
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef GIF_H
+#define GIF_H
+
+#pragma once
+
+#include <stdint.h>
+
+#include <src/include/png.h>
+
+/* Streaming GIF89a output
+ *
+ * Works the same way as png_stream, rows of 2bpp scanline data are scaled,
+ * LZW compressed, and written out to the sink in sub-blocks as they are
+ * passed in. The sink is the same png_write_cb.
+ *
+ * Each segment is its own image block, placed below the segments before it,
+ * so an image can be extended just like a PNG. Seek back over TRAILER from the
+ * end of the file, start the new segment with resume, then rewrite HEAD at the
+ * start of the file with the new height.
+ */
+
+/* The color table of 4 colors, 12 bytes, is always at a fixed offset right
+ * after the header. Changing the palette of a GIF on disk is a single write.
+ */
+#define GIF_GCT_OFFS	13
+#define GIF_GCT_LEN	12
+
+enum gif_parts {
+	GIF_HEAD, // Header and logical screen descriptor
+	GIF_GCT, // Global color table
+	GIF_TRAILER, // Special, length of the end of the file
+};
+
+/* No row is ever buffered, so any width can be output */
+void *gif_alloc(void);
+
+void gif_free(void *gif);
+
+/* Start a new, empty image of width px_w source px, each px output as a scale
+ * by scale square.
+ */
+void gif_reset(void *gif, size_t px_w, unsigned int scale);
+
+/* rgb is the 4 colors of a palette, from palette_rgb16_get() */
+void gif_palette_set(void *gif, const uint8_t (*rgb)[3]);
+
+/* Start writing a segment of px_h source px rows to the sink. For a new file,
+ * resume is false and the header and color table are written first.
+ */
+void gif_start(void *gif, size_t px_h, png_write_cb write, void *write_ctx, bool resume);
+
+/* Compress and write one row of 2bpp scanline data, px_w px wide */
+void gif_row(void *gif, const uint8_t *row);
+
+/* End the segment and write the trailer. Afterwards HEAD has the new height
+ * and must be rewritten at the start of the file. Returns false if any write
+ * to the sink came up short.
+ */
+bool gif_finish(void *gif);
+
+/* Bytes written to the sink since the last gif_start() */
+size_t gif_written_get(void *gif);
+
+/* TRAILER has no buffer */
+uint8_t *gif_buf_get(void *gif, enum gif_parts part);
+
+size_t gif_len_get(void *gif, enum gif_parts part);
+
+#endif // GIF_H
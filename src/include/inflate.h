@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#pragma once
+
+#include <stdint.h>
+
+/* Source of compressed data. Returns the number of bytes put in buf, 0 once
+ * there is no more.
+ */
+typedef size_t (*inflate_read_cb)(void *ctx, uint8_t *buf, size_t len);
+
+/* Sink of inflated data. Returning false stops inflating. */
+typedef bool (*inflate_write_cb)(void *ctx, const uint8_t *buf, size_t len);
+
+/* window is the furthest back, in bytes, a match can reach, and must be a power
+ * of 2. A stream made with a larger window can still be inflated as long as
+ * none of its matches actually reach back further than this.
+ */
+void *inflate_alloc(size_t window);
+
+void inflate_free(void *inflate);
+
+/* Inflate one whole zlib stream from read to write, and check its adler32.
+ * Stored, fixed, and dynamic Huffman blocks are all supported. Returns false
+ * if the stream is bad, ends early, reaches back past the window, or write
+ * stopped it.
+ */
+bool inflate_zlib(void *inflate, inflate_read_cb read, void *read_ctx, inflate_write_cb write, void *write_ctx);
+
+#endif // INFLATE_H
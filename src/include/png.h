@@ -6,25 +6,67 @@
 
 #pragma once
 
-/* Max width/height of a single image. Images can be smaller, but never
- * larger as this allocates the full amount of data.
+/* Max width/height of a single image segment. Segments can be smaller, but
+ * never larger as this allocates the full amount of data. Any number of
+ * segments can be stacked in to one image.
  */
 void *png_alloc(uint32_t width, uint32_t height);
 
-void png_reset(void *png_handle, size_t px_w, size_t px_h);
+/* Start a new, empty image of width px_w. Image data already written to the
+ * current segment is kept, so a segment can be converted before it is known
+ * whether it starts a new image or continues the last one.
+ */
+void png_reset(void *png_handle, size_t px_w);
+
+/* Discard the current segment and start a new, empty one of width px_w. The
+ * segment must be the same width as the image it is appended to.
+ */
+void png_seg_reset(void *png_handle, size_t px_w);
 
-void png_add_height(void *png_handle, size_t px_h);
+/* Append px_h rows of 2bpp scanlines from image_buf to the current segment */
+void png_dat_write(void *png_handle, uint8_t *image_buf, size_t px_h);
 
-/* Modifies the current IDAT chunk to unset BFINAL bit of deflate, and then
- * recalculates the whole CRC for that chunk. When done, the last IDAT chunk
- * can then be rewritten in preparation to append another IDAT chunk with more
- * image data.
+/* Append tiles_h rows of gb tile data to the current segment. The scanlines
+ * and their filter bytes are written straight in to the IDAT chunks and
+ * tile_buf is left untouched. This can be called as often as needed as tile
+ * data arrives, every band of rows that is completed is fully encoded then.
+ * If lut, from tile_palette_lut(), is not NULL, shades are remapped with it.
+ */
+void png_dat_write_tiles(void *png_handle, const uint8_t *tile_buf, size_t tiles_h, const uint8_t *lut);
+
+/* Build the next band, 8 rows, of the segment out of several images side by
+ * side. png_dat_band_start() clears the band to shade 0, each
+ * png_dat_band_tiles() converts one band of tiles_w wide gb tile data straight
+ * in to it starting x tiles across, remapped with lut if not NULL, and
+ * png_dat_band_add() then adds the band to the segment. The segment height
+ * must be a multiple of 8 px before png_dat_band_start().
+ */
+void png_dat_band_start(void *png_handle);
+void png_dat_band_tiles(void *png_handle, const uint8_t *tile_buf, size_t tiles_w, size_t x, const uint8_t *lut);
+void png_dat_band_add(void *png_handle);
+
+size_t png_seg_height_get(void *png_handle);
+
+/* The 2bpp scanline of row of the current segment, as already converted,
+ * after its filter byte.
+ */
+const uint8_t *png_seg_row_get(void *png_handle, size_t row);
+
+/* Add the current segment to the bottom of the image. Updates the height in
+ * IHDR and the adler32 in IDAT_CHECK. The segment is then available as IDAT
+ * until the next png_seg_reset().
  *
- * Must be run before png_add_height() as that will clobber current IDAT sections
+ * To write a new image, write every chunk from CHUNK_START to CHUNK_COUNT.
+ * To extend an image already on disk, seek back by TRAILER from the end of
+ * the file, then write IDAT, IDAT_CHECK, and IEND, and rewrite IHDR at the
+ * start of the file.
  */
-void png_deflate_unfinal(void *png_handle);
+void png_seg_append(void *png_handle);
 
-void png_palette_set(void *png_handle, uint8_t rgb[4][3]);
+/* plte is a complete PLTE chunk, from palette_plte_get(). It is written out
+ * as is and must remain valid as long as png_handle uses it.
+ */
+void png_palette_set(void *png_handle, const uint8_t *plte);
 
 void png_free(void *png_handle);
 
@@ -33,18 +75,120 @@ enum png_chunks {
 	IHDR = 0, // Start of file through IHDR end
 	PLTE,
 	IDAT_ZLIB,
-	IDAT, // Current whole IDAT
-	IDAT_CHECK, // The final IDAT with zlib adler32
+	IDAT, // Every IDAT chunk of the current segment
+	IDAT_CHECK, // The final IDAT with the end of DEFLATE and zlib adler32
 	IEND,
 	CHUNK_COUNT, // Special, sentry of normal sections that can be looped
-	LAST_IDAT, // Special, length of current whole IDAT, IDAT_check, and IEND.
-		   // Used to be able to overwrite a previous IDAT chunk, e.g.
-		   // to unmark the BFINAL bit.
+	TRAILER, // Special, length of IDAT_CHECK and IEND. Used to be able to
+		 // seek back over the end of a file in order to append another
+		 // segment of IDAT chunks.
+	ACTL, // Special, APNG animation control, only from png_stream
 };
 
 uint8_t *png_buf_get(void *png_handle, enum png_chunks chunk);
 size_t png_len_get(void *png_handle, enum png_chunks chunk);
 
-void png_dat_write(void *png_handle, uint8_t *image_buf);
+/* Every PNG written starts with the magic and IHDR, followed directly by a
+ * PLTE chunk of PNG_PLTE_LEN bytes. Changing the palette of a PNG already on
+ * disk is only a matter of writing over PLTE.
+ */
+#define PNG_PLTE_OFFS	33
+#define PNG_PLTE_LEN	24
+#define PNG_PLTE_SMALL_LEN	18 // PLTE of a 1 bit per px PNG, 2 colors
+#define PNG_HEAD_LEN	(PNG_PLTE_OFFS + 8) // Through PLTE length and type
+#define PNG_ACTL_OFFS	(PNG_PLTE_OFFS + PNG_PLTE_LEN) // acTL of an APNG
+
+/* Check that the first PNG_HEAD_LEN bytes of a file, head, are a PNG as
+ * written here; indexed with a valid IHDR and PLTE right after. Returns the
+ * length of the whole PLTE chunk, PNG_PLTE_LEN for 2bpp or PNG_PLTE_SMALL_LEN
+ * for 1bpp, or 0 if head is not one of ours.
+ */
+size_t png_head_check(const uint8_t *head);
+
+/* Build the PNG_PLTE_SMALL_LEN byte PLTE chunk of a 1bpp PNG in chunk. Each
+ * PNG index n is given the color of GB shade shades[n] from plte_chunk, a
+ * complete palette from palette_plte_get().
+ */
+void png_plte_small_build(uint8_t *chunk, const uint8_t *plte_chunk, const uint8_t shades[2]);
+
+/* Build the PNG_PLTE_LEN byte PLTE chunk of a 2bpp PNG in chunk. Each PNG index
+ * n is given the color of GB shade (order >> (n * 2)) & 0x03 from plte_chunk,
+ * so the palette byte of a print command can be taken as is as the order.
+ */
+void png_plte_order_build(uint8_t *chunk, const uint8_t *plte_chunk, uint8_t order);
+
+/* Streaming, compressed, PNG output
+ *
+ * Rather than building the whole segment in memory, rows are compressed and
+ * written out to the sink as they are passed in. This allows integer scaled
+ * output of any size with only a single row of buffer. The sink has the same
+ * shape as fgp_storage_write() and must return the number of bytes written.
+ */
+typedef size_t (*png_write_cb)(void *ctx, const void *buf, size_t len);
+
+/* width is the widest row, after scaling, that will ever be output */
+void *png_stream_alloc(uint32_t width);
+
+void png_stream_free(void *png_stream);
+
+/* Start a new, empty image of width px_w source px, each px output as a
+ * scale by scale square.
+ */
+void png_stream_reset(void *png_stream, size_t px_w, unsigned int scale);
+
+/* Same as png_palette_set() */
+void png_stream_palette_set(void *png_stream, const uint8_t *plte);
+
+/* shades is a mask of the GB shades used by the image, with bit n set if shade
+ * n is used, e.g. from tile_histogram(). If no more than 2 are used, the image
+ * is written at 1 bit per px with a 2 color PLTE of just those shades. Only
+ * valid for an image that will never be extended by another segment. Must be
+ * called after png_stream_reset() and before png_stream_start().
+ */
+void png_stream_shades_set(void *png_stream, unsigned int shades);
+
+/* Start writing a segment to the sink. For a new file, resume is false and
+ * IHDR, PLTE, and the zlib header are written first. To extend a file already
+ * on disk, seek back by TRAILER from the end of the file and resume.
+ */
+void png_stream_start(void *png_stream, png_write_cb write, void *write_ctx, bool resume);
+
+/* Compress and write one row of 2bpp scanline data, px_w px wide */
+void png_stream_row(void *png_stream, const uint8_t *row);
+
+/* End the segment and write the trailer. Afterwards, IHDR from
+ * png_stream_buf_get() has the new height and must be rewritten at the start
+ * of the file. Returns false if any write to the sink came up short.
+ */
+bool png_stream_finish(void *png_stream);
+
+/* Animated PNG output
+ *
+ * After png_stream_reset() to the width of the whole animation, and setting
+ * the palette, png_stream_apng_start() writes IHDR, px_h source px tall, PLTE,
+ * and acTL. Each frame is
+ * then png_stream_frame_start(), a row for each of its px_h rows, and
+ * png_stream_frame_finish(), which also writes IEND. The first frame must be
+ * the whole image. Any later frame is a px_w x px_h rect at x, y, in source
+ * px, that replaces what was there; only the part that changed is needed.
+ *
+ * To add a frame to a file already on disk, seek back over IEND, add the
+ * frame, then rewrite ACTL at PNG_ACTL_OFFS with the new frame count. Only
+ * 2bpp output is supported, png_stream_shades_set() must not be used.
+ */
+/* Returns false if any write to the sink came up short */
+bool png_stream_apng_start(void *png_stream, size_t px_h, png_write_cb write, void *write_ctx);
+
+void png_stream_frame_start(void *png_stream, png_write_cb write, void *write_ctx,
+			    size_t x, size_t y, size_t px_w, size_t px_h, uint16_t delay_ms);
+
+/* Returns false if any write to the sink came up short */
+bool png_stream_frame_finish(void *png_stream);
+
+/* Only IHDR, PLTE, and ACTL are valid */
+uint8_t *png_stream_buf_get(void *png_stream, enum png_chunks chunk);
+
+/* Only IHDR, PLTE, TRAILER, IEND, and ACTL are valid */
+size_t png_stream_len_get(void *png_stream, enum png_chunks chunk);
 
 #endif // PNG_H
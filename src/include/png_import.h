@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef PNG_IMPORT_H
+#define PNG_IMPORT_H
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <storage/storage.h>
+
+/* Turns a PNG of a print back in to gb tile data, a band, one row of tiles, at
+ * a time. PNGs as png_handle writes them, stored blocks of rows that aren't
+ * filtered, are read straight in to rows with no inflate at all. Any other
+ * indexed PNG of 1 or 2 bits per px, e.g. one recompressed, or one edited on a
+ * computer, is inflated and unfiltered with png_read instead. Its inflate
+ * window is only as large as the zlib header and size of the image data call
+ * for, 8 KiB for a 160x144 print, up to 32 KiB for a tall one. It is kept
+ * until png_import_free() for the PNGs after.
+ */
+
+/* Widest PNG that can be imported, the widest a print can be */
+#define PNG_IMPORT_W_MAX	160
+
+/* Called with each band in order, tiles_w * 16 bytes of gb tile data. The
+ * image is tiles_w x tiles_h tiles, the last band is padded with shade 0 if
+ * the PNG isn't a multiple of 8 px tall. Returning false stops the import.
+ */
+typedef bool (*png_import_cb)(void *ctx, const uint8_t *tiles, size_t tiles_w, size_t tiles_h, size_t band);
+
+void *png_import_alloc(void);
+
+void png_import_free(void *png_import);
+
+/* Import the PNG open in file, from its start. plte is the complete PLTE chunk,
+ * from palette_plte_get(), of the palette the PNG was saved in. Each color of
+ * the PNG is the shade of the same color in plte, or if plte is NULL or doesn't
+ * have it, the shade nearest its brightness. The width must be a multiple of
+ * 8 px. Returns false if the PNG can't be imported, or cb stopped it.
+ */
+bool png_import(void *png_import, File *file, const uint8_t *plte, png_import_cb cb, void *ctx);
+
+#endif // PNG_IMPORT_H
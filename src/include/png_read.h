@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef PNG_READ_H
+#define PNG_READ_H
+
+#pragma once
+
+#include <stdint.h>
+
+/* Reads PNGs back in, a row at a time, with only a row or two of image data
+ * held at once. Interlaced PNGs are not supported.
+ */
+
+/* Largest window a zlib stream can be made with */
+#define PNG_WINDOW_MAX	32768
+
+/* Same shape as storage_file_read(), returns the number of bytes read */
+typedef size_t (*png_read_cb)(void *ctx, void *buf, size_t len);
+
+/* Called with each row, already unfiltered, len bytes long. Returning false
+ * stops reading.
+ */
+typedef bool (*png_row_cb)(void *ctx, const uint8_t *row, size_t len);
+
+struct png_info {
+	uint32_t width;
+	uint32_t height;
+	uint8_t bit_depth;
+	uint8_t color_type;
+	uint8_t plte[256][3];
+	unsigned int plte_cnt; // 0 if there is no PLTE
+	size_t window; // Inflate window the image data needs, at most PNG_WINDOW_MAX
+};
+
+/* window is passed on to inflate_alloc(), see png_read_window_set() */
+void *png_read_alloc(size_t window);
+
+void png_read_free(void *png_read);
+
+/* Read the signature and every chunk up to the image data, from read, which
+ * must be at the start of the file. Returns false if it isn't a PNG that can
+ * be read.
+ */
+bool png_read_head(void *png_read, png_read_cb read, void *read_ctx);
+
+/* Valid after png_read_head() */
+const struct png_info *png_read_info_get(void *png_read);
+
+/* Grow the inflate window to window bytes, e.g. to the window of the PNG from
+ * png_read_info_get(). A window already that large is kept. Not while reading
+ * rows.
+ */
+void png_read_window_set(void *png_read, size_t window);
+
+/* Inflate and unfilter the image data, right after png_read_head(), passing
+ * each row to row_cb. Returns false if the image data is bad, doesn't have
+ * every row, or row_cb stopped it.
+ */
+bool png_read_rows(void *png_read, png_row_cb row_cb, void *row_ctx);
+
+#endif // PNG_READ_H
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef PRINT_CACHE_H
+#define PRINT_CACHE_H
+
+#pragma once
+
+#include <stdint.h>
+
+/* Most images held at once, no matter how small */
+#define PRINT_CACHE_IMAGES	4
+
+/* The last few images received, kept in RAM as 2bpp scanline data with the
+ * shades of the print command palette byte already applied. Stacked prints
+ * are joined in to one image, just like the saved files. Anything can be
+ * exported again from here without reading it back from the SD card.
+ */
+struct print_cache_img {
+	uint32_t count; // Number of the file the image was saved to
+	size_t px_w;
+	size_t px_h;
+	uint8_t *data; // px_w / 4 bytes per row, px_h rows
+};
+
+/* Holds no more than max_len bytes of image data */
+void *print_cache_alloc(size_t max_len);
+
+void print_cache_free(void *print_cache);
+
+/* Add tiles_w x tiles_h tiles of gb tile data, remapped with lut if not NULL.
+ * If same_image, the rows are added to the bottom of the image added last.
+ * The least recently used images are dropped to make room. Returns false if
+ * the image can't fit at all, it is then dropped too.
+ */
+bool print_cache_add(void *print_cache, const uint8_t *tiles, size_t tiles_w, size_t tiles_h, const uint8_t *lut, uint32_t count, bool same_image);
+
+size_t print_cache_count_get(void *print_cache);
+
+/* Image idx, 0 the most recently used. NULL if there is no such image. */
+const struct print_cache_img *print_cache_get(void *print_cache, size_t idx);
+
+/* The image added to last, NULL if it was dropped */
+const struct print_cache_img *print_cache_last_get(void *print_cache);
+
+/* Mark image idx as used, it becomes image 0 */
+void print_cache_touch(void *print_cache, size_t idx);
+
+#endif // PRINT_CACHE_H
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef RECOMPRESS_H
+#define RECOMPRESS_H
+
+#pragma once
+
+#include <stdint.h>
+
+/* PNGs converted as prints arrive are written uncompressed, as stored DEFLATE
+ * blocks, with an IDAT chunk per band of rows. A low priority thread finds
+ * those in the dated folders and rewrites them compressed, one file at a time.
+ * Each rewrite is checked by reading it back before it replaces the original.
+ *
+ * The thread starts out paused.
+ */
+void *recompress_alloc(void);
+
+/* Stops the thread, any file in progress is left as it was */
+void recompress_free(void *recompress);
+
+/* Let the thread run. If skip_today, PNGs in the folder of today are left
+ * alone, as the receive view may still add to them.
+ */
+void recompress_resume(void *recompress, bool skip_today);
+
+/* Stop working on the SD card as soon as possible, only returns once the
+ * thread has. The file in progress, if any, is dropped and started over on the
+ * next resume.
+ */
+void recompress_pause(void *recompress);
+
+#endif // RECOMPRESS_H
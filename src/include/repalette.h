@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef REPALETTE_H
+#define REPALETTE_H
+
+#pragma once
+
+#include <stdint.h>
+
+struct repalette_stats {
+	unsigned int done; // Files recolored and renamed
+	unsigned int skipped; // Not one of our PNGs, already in the palette, etc.
+	unsigned int errors; // Failed part way through
+};
+
+/* Recolor every PNG in the folder at path to palette idx, and rename each from
+ * its -<shortname> suffix to that of the new palette. Only PLTE of each file
+ * is rewritten, the image data itself is never touched. The thumbnail index
+ * of the folder is updated to the new names.
+ */
+void repalette_folder(const char *path, unsigned int idx, struct repalette_stats *stats);
+
+#endif // REPALETTE_H
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef RLE_H
+#define RLE_H
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The compression the Game Boy uses for print data over the link cable. Data
+ * is a series of chunks, each a control byte then its data. A control byte
+ * with bit 7 set is a run, the one byte after it repeated (ctrl & 0x7f) + 2
+ * times. Otherwise it is a literal, the ctrl + 1 bytes after it.
+ */
+#define RLE_RUN		0x80
+#define RLE_RUN_MIN	2
+#define RLE_RUN_MAX	(0x7f + RLE_RUN_MIN)
+#define RLE_LIT_MAX	0x80
+
+/* Most bytes len bytes can be encoded in to, nothing but literals */
+#define RLE_LEN_MAX(len)	((len) + (((len) + RLE_LIT_MAX - 1) / RLE_LIT_MAX))
+
+/* Encode len bytes of src to dst, which must fit RLE_LEN_MAX(len) bytes.
+ * Returns the length of the encoded data.
+ */
+size_t rle_encode(uint8_t *dst, const uint8_t *src, size_t len);
+
+/* Most bytes rows of tiles, len bytes in all, can be encoded in to by
+ * rle_rows_encode(), even one tile wide with every row stored as is. The last
+ * row is encoded in full before it is known if it gets any smaller.
+ */
+#define RLE_ROWS_LEN_MAX(len)	(RLE_LEN_MAX(len) + (((len) / 16) * sizeof(uint16_t)))
+
+/* Encode rows rows of row_sz bytes of src to dst, each row on its own, as the
+ * rows of an 'R' capture record. dst must fit RLE_ROWS_LEN_MAX(rows * row_sz)
+ * bytes. Returns the length of the record data.
+ */
+size_t rle_rows_encode(uint8_t *dst, const uint8_t *src, size_t row_sz, size_t rows);
+
+/* Decode all src_len bytes of src to exactly len bytes of dst. Returns false
+ * if src doesn't decode to exactly that many bytes.
+ */
+bool rle_decode(uint8_t *dst, size_t len, const uint8_t *src, size_t src_len);
+
+#endif // RLE_H
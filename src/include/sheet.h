@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef SHEET_H
+#define SHEET_H
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A contact sheet is one PNG of every image of a session, laid out in a grid,
+ * or all in one row for the parts of a poster. It is put together a band at a
+ * time from the raw tile data saved for each image, so no more than one band
+ * of one image, and one band of the sheet, is ever in memory.
+ */
+
+/* Images of a session that make it on to the sheet, any after are left off */
+#define SHEET_MAX	64
+
+/* Runs of prints with a palette byte of their own, over all images. Once out,
+ * an image stacked from more prints keeps the palette byte of the last run.
+ */
+#define SHEET_PRINTS_MAX	128
+
+/* Widest a sheet gets, a poster of more images than this wraps */
+#define SHEET_COLS_MAX	16
+
+void *sheet_alloc(void);
+
+void sheet_free(void *sheet);
+
+/* Add a print of tiles_w x tiles_h tiles, saved as file count, with print
+ * command palette byte palette. If same_image, the rows are added to the
+ * bottom of the image added last instead, each print remapped with its own
+ * palette byte the same as the PNG of the image. Returns false if the sheet is
+ * full.
+ */
+bool sheet_add(void *sheet, uint32_t count, size_t tiles_w, size_t tiles_h, uint8_t palette, bool same_image);
+
+size_t sheet_count_get(void *sheet);
+
+/* Start writing the sheet as GCIM_..._XXXX-sheet-zzz.png, XXXX the count of
+ * the first image and zzz the shortname of palette_idx. The tile data of each
+ * image is read from its file with src_ext, starting src_offs bytes in, e.g.
+ * -hdr.bin and 8. Images are in a grid as close to square as fits, or in one
+ * row if poster, with gap tiles of shade 0 around each. fgp_storage is used
+ * until sheet_write_finish(). There must be at least one image.
+ */
+void sheet_write_start(void *sheet, void *fgp_storage, const char *src_ext, size_t src_offs,
+		       bool poster, size_t gap, unsigned int palette_idx);
+
+/* Write up to max more bands, rows of tiles, of the sheet. Returns false once
+ * the whole sheet is written.
+ */
+bool sheet_write_next(void *sheet, size_t max);
+
+/* Bands of the sheet written so far, out of total */
+void sheet_progress_get(void *sheet, size_t *done, size_t *total);
+
+/* Finish the PNG, even if stopped early. Returns false if any image couldn't
+ * be read or the sheet couldn't be written.
+ */
+bool sheet_write_finish(void *sheet);
+
+#endif // SHEET_H
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef THUMB_H
+#define THUMB_H
+
+#pragma once
+
+#include <stdint.h>
+
+/* Every dated folder has a thumbnail index, with a record for each image saved
+ * to it, in the order they were saved. Records are all the same size, record
+ * n is at n * sizeof(struct thumb_rec), so any one of them is a single read.
+ */
+#define THUMB_FILE	".thumbs"
+
+/* Largest thumbnail, fits the screen top to bottom */
+#define THUMB_MAX_W	64
+#define THUMB_MAX_H	64
+
+#define THUMB_EXT_LEN	24
+
+struct __attribute__((__packed__)) thumb_rec {
+	uint16_t count; // Number of the file the image was saved to
+	uint16_t px_w; // Size of the image itself
+	uint16_t px_h;
+	uint8_t palette; // Palette the image was saved in
+	uint8_t thumb_w;
+	uint8_t thumb_h;
+	char ext[THUMB_EXT_LEN]; // Name of the PNG after the count, empty if none
+	uint8_t data[(THUMB_MAX_W / 8) * THUMB_MAX_H]; // XBM, 1bpp, LSB is leftmost px
+};
+
+void *thumb_alloc(void);
+
+void thumb_free(void *thumb);
+
+/* Start a thumbnail of a px_w x px_h image. Every field of the record other
+ * than the thumbnail itself is left to the caller.
+ */
+void thumb_start(void *thumb, size_t px_w, size_t px_h);
+
+/* Add the next row of the image, 2bpp scanline data px_w px wide. Each px of
+ * the thumbnail is the average shade of the px it covers, dithered.
+ */
+void thumb_row(void *thumb, const uint8_t *row);
+
+/* The record being built. The thumbnail is complete after every row of the
+ * image was added.
+ */
+struct thumb_rec *thumb_rec_get(void *thumb);
+
+#endif // THUMB_H
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef THUMB_BUILD_H
+#define THUMB_BUILD_H
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Builds the thumbnail index of a dated folder that has none, e.g. one saved
+ * before thumbnails were kept, from the PNGs in it. Each PNG is read back with
+ * png_import, so nothing but the PNG itself is needed. Records are in order of
+ * count, one for each image, the same as if they were made as it was saved.
+ */
+
+struct thumb_build_stats {
+	unsigned int total; // Images found to make a thumbnail of
+	unsigned int done;
+	unsigned int errors; // PNGs that couldn't be read back
+};
+
+/* List the images of folder, a dated folder in the app data folder. For each
+ * count the PNG at 1x is used, with no transform if there is one. Exports,
+ * sheets, APNGs, and scaled PNGs are passed over. Returns NULL if the folder
+ * already has THUMB_FILE, or has no PNG to make one from.
+ */
+void *thumb_build_alloc(const char *folder);
+
+/* Make the thumbnails of up to max more images. Returns false once every image
+ * has one.
+ */
+bool thumb_build_next(void *thumb_build, unsigned int max);
+
+void thumb_build_stats_get(void *thumb_build, struct thumb_build_stats *stats);
+
+/* If thumb_build_next() got through every image, the new index becomes the
+ * THUMB_FILE of the folder, otherwise it is thrown away and the next build
+ * starts over.
+ */
+void thumb_build_free(void *thumb_build);
+
+#endif // THUMB_BUILD_H
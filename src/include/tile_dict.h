@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef TILE_DICT_H
+#define TILE_DICT_H
+
+#pragma once
+
+#include <stdint.h>
+
+/* Index of a tile that didn't fit in a full dictionary, its data is stored
+ * with the print every time it shows up.
+ */
+#define TILE_DICT_LITERAL	0xffff
+
+/* A dictionary of every distinct 16 byte gb tile seen, in the order they were
+ * first seen, holding at most max_tiles. Each tile is looked up by a hash of
+ * its data, and compared in full on a hit, so two tiles never share an index.
+ */
+void *tile_dict_alloc(size_t max_tiles);
+
+void tile_dict_free(void *tile_dict);
+
+/* Forget every tile, the next tile added is index 0 again */
+void tile_dict_reset(void *tile_dict);
+
+/* Index of tile, adding it if it isn't in the dictionary yet. added is set if
+ * the tile was added, or is TILE_DICT_LITERAL, i.e. its data wasn't already
+ * stored and needs to be.
+ */
+uint16_t tile_dict_get(void *tile_dict, const uint8_t *tile, bool *added);
+
+#endif // TILE_DICT_H
@@ -6,8 +6,74 @@
 
 #pragma once
 
-void tile_to_scanline(uint8_t *src, size_t tiles_w, size_t tiles_h);
+/* Checks each conversion kernel against the reference implementation, times
+ * the ones that pass, and selects the fastest for all later conversions.
+ * Should be called once at startup, before any conversion is done.
+ */
+void tile_tools_init(void);
 
+/* Build lut, 256 bytes, to remap the shades of 2bpp scanline data as set by
+ * the palette byte of a print command. Returns false, and leaves lut alone, if
+ * palette doesn't change any shade and no remap is needed.
+ */
+bool tile_palette_lut(uint8_t *lut, uint8_t palette);
+
+/* Converts tiles_w x tiles_h tiles of gb tile data in src to 2bpp scanlines
+ * written to dst, leaving src untouched. Each scanline starts dst_stride bytes
+ * after the last, dst_stride must be at least tiles_w * 2. If lut is not NULL,
+ * the shades of each scanline are remapped with it as it is written.
+ */
+void tile_to_scanline_copy(uint8_t *dst, size_t dst_stride, const uint8_t *src, size_t tiles_w, size_t tiles_h, const uint8_t *lut);
+
+/* Converts the single px row, row, of tiles_w wide gb tile data in src to one
+ * 2bpp scanline in dst, remapped with lut if not NULL. src is left untouched.
+ */
+void tile_row_get(uint8_t *dst, const uint8_t *src, size_t tiles_w, size_t row, const uint8_t *lut);
+
+/* Count the px of each shade, 0 the lightest through 3 the darkest, in len
+ * bytes of gb tile data in src. Tile layout doesn't matter for this, so any
+ * number of whole tiles, rows, or lines can be counted at once.
+ */
+void tile_histogram(const uint8_t *src, size_t len, uint32_t hist[4]);
+
+/* Mask of the shades used in hist, bit n set if shade n has any px after the
+ * print command palette byte, palette, is applied.
+ */
+unsigned int tile_shades_get(const uint32_t hist[4], uint8_t palette);
+
+/* A transform of an image, done entirely on its tiles. The rect of x, y, w, h,
+ * in tiles, is cut out of the image, then turned 90 degrees clockwise if
+ * rotate is set, then mirrored left to right if mirror is set.
+ */
+struct tile_xform {
+	size_t x;
+	size_t y;
+	size_t w;
+	size_t h;
+	bool mirror;
+	bool rotate;
+};
+
+/* Size, in tiles, of the image that xf results in */
+void tile_xform_size_get(const struct tile_xform *xf, size_t *tiles_w, size_t *tiles_h);
+
+/* Get band, a row of tiles, of the result of xf on src_tiles_w wide gb tile
+ * data in src. dst needs room for one band of the result, 16 bytes per tile.
+ * The return is where the band is, either dst or, if src already has it as is,
+ * straight in to src. Either way it can be handed to tile_row_get(), so the
+ * result is never held as anything bigger than one band.
+ */
+const uint8_t *tile_xform_band(uint8_t *dst, const uint8_t *src, size_t src_tiles_w, const struct tile_xform *xf, size_t band);
+
+/* Shrink the rect of xf to drop rows of tiles at its top and bottom that are
+ * blank, all px shade 0, in src. Returns false, and leaves xf alone, if the
+ * whole rect is blank.
+ */
+bool tile_xform_trim(struct tile_xform *xf, const uint8_t *src, size_t src_tiles_w);
+
+/* Converts 2bpp scanlines in src to gb tile data in dst, dst and src must not
+ * overlap.
+ */
 void scanline_to_tile(uint8_t *dst, uint8_t *src, size_t tiles_w, size_t tiles_h);
 
 #endif // TILE_TOOLS_H
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef USB_STREAM_H
+#define USB_STREAM_H
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <protocols/printer/include/printer_proto.h>
+
+#define USB_STREAM_MAGIC	"GBPF"
+#define USB_STREAM_VERSION	1
+
+#define USB_STREAM_SAME_IMAGE	(1 << 0) // Continues the image of the last frame
+
+/* Each print goes out as one frame, this header, then the payload, then a
+ * uint32_t CRC of both. The payload is exactly what Save hdr+bin appends to
+ * the -hdr.bin of the image, GB-BIN01 then the tile data, or only the tile
+ * data when the print continues the last image. Every field is little endian.
+ */
+struct __attribute__((__packed__)) usb_stream_hdr {
+	char magic[4];
+	uint8_t version;
+	uint8_t flags;
+	uint16_t count; // Number of the file the print was saved to
+	uint8_t margins;
+	uint8_t palette;
+	uint8_t exposure;
+	uint8_t tiles_w;
+	uint16_t tiles_h;
+	uint32_t len; // Of the payload
+};
+
+/* Switch the USB port to two CDC channels, the second of which prints are
+ * streamed over. The first stays the CLI. Returns NULL if the USB config
+ * couldn't be changed.
+ */
+void *usb_stream_alloc(void);
+
+/* Puts back the USB config that was there before usb_stream_alloc() */
+void usb_stream_free(void *usb_stream);
+
+/* Send one print as a frame. Nothing is sent if no host has the port open.
+ * Returns false if the host stopped taking data partway through the frame.
+ */
+bool usb_stream_print(void *usb_stream, struct gb_image *image, uint16_t count,
+		      size_t tiles_w, size_t tiles_h, bool same_image);
+
+#endif // USB_STREAM_H
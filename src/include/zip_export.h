@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef ZIP_EXPORT_H
+#define ZIP_EXPORT_H
+
+#pragma once
+
+#include <stdint.h>
+
+struct zip_stats {
+	unsigned int files; // Files added to the ZIP
+	unsigned int errors; // Files that couldn't be read in full, left out
+	uint32_t bytes; // Size of the ZIP
+};
+
+/* Bundle every file in the dated folder, named YYYY-MM-DD, in to one ZIP of
+ * the same name next to it in the app data folder, e.g. 2024-05-01.zip. Files
+ * are stored as is, without compression, most of them are PNGs that wouldn't
+ * get any smaller. Files starting with a '.' are left out.
+ * Returns false if the ZIP couldn't be written, it is then removed.
+ */
+bool zip_export_day(const char *folder, struct zip_stats *stats);
+
+#endif // ZIP_EXPORT_H
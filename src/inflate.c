@@ -0,0 +1,407 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* Based on the approach of puff.c, the reference inflate by Mark Adler that
+ * ships with zlib. Huffman codes are decoded a bit at a time from canonical
+ * code counts, which is slow but needs no large tables.
+ */
+#include <furi.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/inflate.h>
+
+#define INFLATE_MAX_BITS	15
+#define INFLATE_LEN_CODES	288
+#define INFLATE_DIST_CODES	30
+#define INFLATE_CL_CODES	19 // Code length codes of a dynamic block
+
+/* Bytes of input and output held at a time between callbacks */
+#define INFLATE_BUF	64
+
+struct huffman {
+	uint16_t count[INFLATE_MAX_BITS + 1]; // Codes of each length
+	uint16_t symbol[INFLATE_LEN_CODES]; // Symbols in canonical code order
+};
+
+struct inflate {
+	inflate_read_cb read;
+	void *read_ctx;
+	inflate_write_cb write;
+	void *write_ctx;
+	bool error;
+
+	uint8_t in[INFLATE_BUF];
+	size_t in_len;
+	size_t in_pos;
+	uint32_t bit_buf;
+	unsigned int bit_cnt;
+
+	uint8_t out[INFLATE_BUF];
+	size_t out_len;
+	size_t total; // Bytes output so far, matches can't reach back past 0
+	uint32_t adler_a;
+	uint32_t adler_b;
+
+	struct huffman fixed_len;
+	struct huffman fixed_dist;
+	struct huffman dyn_len;
+	struct huffman dyn_dist;
+
+	size_t window_mask;
+	uint8_t window[];
+};
+
+/* Lengths that the length codes 257 through 285 start at, and how many extra
+ * bits follow each.
+ */
+static const uint16_t len_base[] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t len_extra[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+
+/* Order the code length code lengths of a dynamic block are sent in */
+static const uint8_t cl_order[INFLATE_CL_CODES] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15,
+};
+
+/* Same for the distance codes 0 through 29 */
+static const uint16_t dist_base[] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577,
+};
+static const uint8_t dist_extra[] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+	12, 12, 13, 13,
+};
+
+static unsigned int inflate_byte(struct inflate *inf)
+{
+	if (inf->in_pos == inf->in_len) {
+		inf->in_pos = 0;
+		inf->in_len = inf->error ? 0 : inf->read(inf->read_ctx, inf->in, sizeof(inf->in));
+		if (!inf->in_len) {
+			inf->error = true;
+			return 0;
+		}
+	}
+
+	return inf->in[inf->in_pos++];
+}
+
+/* Take cnt bits, LSB first, up to 24 at once */
+static uint32_t inflate_bits(struct inflate *inf, unsigned int cnt)
+{
+	uint32_t bits;
+
+	while (inf->bit_cnt < cnt) {
+		inf->bit_buf |= (uint32_t)inflate_byte(inf) << inf->bit_cnt;
+		inf->bit_cnt += 8;
+	}
+
+	bits = inf->bit_buf & ((1UL << cnt) - 1);
+	inf->bit_buf >>= cnt;
+	inf->bit_cnt -= cnt;
+
+	return bits;
+}
+
+/* Once there is an error, output is thrown away, but still has to make room */
+static void inflate_flush(struct inflate *inf)
+{
+	if (inf->out_len && !inf->error && !inf->write(inf->write_ctx, inf->out, inf->out_len))
+		inf->error = true;
+	inf->out_len = 0;
+}
+
+static void inflate_out(struct inflate *inf, uint8_t byte)
+{
+	inf->window[inf->total & inf->window_mask] = byte;
+	inf->total++;
+
+	/* A modulo every byte is slow, but can never overflow */
+	inf->adler_a = (inf->adler_a + byte) % 65521;
+	inf->adler_b = (inf->adler_b + inf->adler_a) % 65521;
+
+	inf->out[inf->out_len++] = byte;
+	if (inf->out_len == sizeof(inf->out))
+		inflate_flush(inf);
+}
+
+/* Build the canonical code of n symbols from the code length of each. Returns
+ * false if the lengths describe more codes than fit, an incomplete code is
+ * fine, like the fixed distance code.
+ */
+static bool inflate_huffman_build(struct huffman *h, const uint8_t *length, size_t n)
+{
+	uint16_t offs[INFLATE_MAX_BITS + 1];
+	int left = 1;
+	size_t sym;
+	unsigned int len;
+
+	memset(h->count, 0, sizeof(h->count));
+	for (sym = 0; sym < n; sym++)
+		h->count[length[sym]]++;
+
+	for (len = 1; len <= INFLATE_MAX_BITS; len++) {
+		left <<= 1;
+		left -= h->count[len];
+		if (left < 0)
+			return false;
+	}
+
+	offs[1] = 0;
+	for (len = 1; len < INFLATE_MAX_BITS; len++)
+		offs[len + 1] = offs[len] + h->count[len];
+
+	for (sym = 0; sym < n; sym++) {
+		if (length[sym])
+			h->symbol[offs[length[sym]]++] = sym;
+	}
+
+	return true;
+}
+
+/* Decode one symbol, -1 if the bits aren't a code */
+static int inflate_decode(struct inflate *inf, const struct huffman *h)
+{
+	int code = 0; // Bits read so far
+	int first = 0; // First code of the current length
+	int index = 0; // Symbol index of first
+	int count;
+	unsigned int len;
+
+	for (len = 1; len <= INFLATE_MAX_BITS; len++) {
+		code |= inflate_bits(inf, 1);
+		count = h->count[len];
+		if (code - count < first)
+			return h->symbol[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+
+	return -1;
+}
+
+static bool inflate_stored(struct inflate *inf)
+{
+	uint16_t len;
+	uint16_t nlen;
+
+	/* Stored blocks start on a byte boundary */
+	inf->bit_buf = 0;
+	inf->bit_cnt = 0;
+
+	len = inflate_bits(inf, 16);
+	nlen = inflate_bits(inf, 16);
+	if ((len ^ nlen) != 0xffff)
+		return false;
+
+	while (len-- && !inf->error)
+		inflate_out(inf, inflate_byte(inf));
+
+	return !inf->error;
+}
+
+static bool inflate_codes(struct inflate *inf, const struct huffman *lencode, const struct huffman *distcode)
+{
+	int sym;
+	size_t len;
+	size_t dist;
+
+	while (!inf->error) {
+		sym = inflate_decode(inf, lencode);
+		if (sym < 0)
+			return false;
+		if (sym < 256) {
+			inflate_out(inf, sym);
+			continue;
+		}
+		if (sym == 256)
+			return true;
+
+		sym -= 257;
+		if (sym >= (int)COUNT_OF(len_base))
+			return false;
+		len = len_base[sym] + inflate_bits(inf, len_extra[sym]);
+
+		sym = inflate_decode(inf, distcode);
+		if (sym < 0 || sym >= (int)COUNT_OF(dist_base))
+			return false;
+		dist = dist_base[sym] + inflate_bits(inf, dist_extra[sym]);
+		if (dist > inf->total || dist > (inf->window_mask + 1))
+			return false;
+
+		while (len--)
+			inflate_out(inf, inf->window[(inf->total - dist) & inf->window_mask]);
+	}
+
+	return false;
+}
+
+/* A block that carries its own codes, as code lengths that are themselves
+ * Huffman coded. The code length code is built in dyn_dist while it is needed.
+ */
+static bool inflate_dynamic(struct inflate *inf)
+{
+	uint8_t length[INFLATE_LEN_CODES + INFLATE_DIST_CODES];
+	size_t nlen;
+	size_t ndist;
+	size_t ncode;
+	size_t index;
+	size_t rep;
+	int sym;
+
+	nlen = inflate_bits(inf, 5) + 257;
+	ndist = inflate_bits(inf, 5) + 1;
+	ncode = inflate_bits(inf, 4) + 4;
+	if (nlen > 286 || ndist > INFLATE_DIST_CODES)
+		return false;
+
+	memset(length, 0, INFLATE_CL_CODES);
+	for (index = 0; index < ncode; index++)
+		length[cl_order[index]] = inflate_bits(inf, 3);
+	if (!inflate_huffman_build(&inf->dyn_dist, length, INFLATE_CL_CODES))
+		return false;
+
+	index = 0;
+	while (index < nlen + ndist) {
+		sym = inflate_decode(inf, &inf->dyn_dist);
+		if (sym < 0 || inf->error)
+			return false;
+		if (sym < 16) {
+			length[index++] = sym;
+			continue;
+		}
+
+		/* 16 repeats the last length 3 to 6 times, 17 and 18 repeat 0 */
+		if (sym == 16) {
+			if (!index)
+				return false;
+			sym = length[index - 1];
+			rep = 3 + inflate_bits(inf, 2);
+		} else if (sym == 17) {
+			sym = 0;
+			rep = 3 + inflate_bits(inf, 3);
+		} else {
+			sym = 0;
+			rep = 11 + inflate_bits(inf, 7);
+		}
+		if (index + rep > nlen + ndist)
+			return false;
+		while (rep--)
+			length[index++] = sym;
+	}
+
+	/* Without an end of block code the block could never end */
+	if (!length[256])
+		return false;
+
+	if (!inflate_huffman_build(&inf->dyn_len, length, nlen) ||
+	    !inflate_huffman_build(&inf->dyn_dist, length + nlen, ndist))
+		return false;
+
+	return inflate_codes(inf, &inf->dyn_len, &inf->dyn_dist);
+}
+
+bool inflate_zlib(void *inflate, inflate_read_cb read, void *read_ctx, inflate_write_cb write, void *write_ctx)
+{
+	struct inflate *inf = inflate;
+	unsigned int cmf;
+	unsigned int flg;
+	unsigned int last;
+	unsigned int type;
+	uint32_t check;
+	bool ok = true;
+
+	inf->read = read;
+	inf->read_ctx = read_ctx;
+	inf->write = write;
+	inf->write_ctx = write_ctx;
+	inf->error = false;
+	inf->in_len = 0;
+	inf->in_pos = 0;
+	inf->bit_buf = 0;
+	inf->bit_cnt = 0;
+	inf->out_len = 0;
+	inf->total = 0;
+	inf->adler_a = 1;
+	inf->adler_b = 0;
+
+	/* DEFLATE, no preset dictionary */
+	cmf = inflate_byte(inf);
+	flg = inflate_byte(inf);
+	if ((cmf & 0x0f) != 8 || (flg & 0x20) || ((cmf << 8) | flg) % 31)
+		return false;
+
+	do {
+		last = inflate_bits(inf, 1);
+		type = inflate_bits(inf, 2);
+		if (type == 0)
+			ok = inflate_stored(inf);
+		else if (type == 1)
+			ok = inflate_codes(inf, &inf->fixed_len, &inf->fixed_dist);
+		else if (type == 2)
+			ok = inflate_dynamic(inf);
+		else
+			ok = false;
+	} while (ok && !last && !inf->error);
+
+	inflate_flush(inf);
+	if (!ok || inf->error)
+		return false;
+
+	/* adler32 follows the last block, on a byte boundary, MSB first */
+	inf->bit_buf = 0;
+	inf->bit_cnt = 0;
+	check = inflate_byte(inf) << 24;
+	check |= inflate_byte(inf) << 16;
+	check |= inflate_byte(inf) << 8;
+	check |= inflate_byte(inf);
+
+	return !inf->error && (check == ((inf->adler_b << 16) | inf->adler_a));
+}
+
+void *inflate_alloc(size_t window)
+{
+	struct inflate *inf = NULL;
+	uint8_t length[INFLATE_LEN_CODES];
+	unsigned int sym;
+
+	furi_check(window && !(window & (window - 1)));
+
+	inf = malloc(sizeof(struct inflate) + window);
+	inf->window_mask = window - 1;
+
+	/* The fixed codes, as set out in RFC 1951 */
+	for (sym = 0; sym < 144; sym++)
+		length[sym] = 8;
+	for (; sym < 256; sym++)
+		length[sym] = 9;
+	for (; sym < 280; sym++)
+		length[sym] = 7;
+	for (; sym < INFLATE_LEN_CODES; sym++)
+		length[sym] = 8;
+	inflate_huffman_build(&inf->fixed_len, length, INFLATE_LEN_CODES);
+
+	for (sym = 0; sym < INFLATE_DIST_CODES; sym++)
+		length[sym] = 5;
+	inflate_huffman_build(&inf->fixed_dist, length, INFLATE_DIST_CODES);
+
+	return inf;
+}
+
+void inflate_free(void *inflate)
+{
+	free(inflate);
+}
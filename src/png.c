@@ -12,6 +12,7 @@
 #include <src/include/fgp_palette.h>
 
 #include <src/include/png.h>
+#include <src/include/tile_tools.h>
 
 /* XXX TODO NOTE:
  * the use of bswap32 is fine, but, should port some form of htonl and ntohl to
@@ -54,7 +55,7 @@ struct __attribute__((__packed__)) idat_zlib {
 struct __attribute__((__packed__)) idat_image {
 	uint32_t data_len; // len is just the data itself
 	uint8_t type[4]; // Usually represented in ASCII
-	uint8_t deflate_btype; // Should always be 0x01, I think this says no compression?
+	uint8_t deflate_btype; // Always 0x00, stored (no compression) and not BFINAL
 	uint16_t len; // Len of image data, includes filter type
 	uint16_t nlen; // 1s compliment of len
 	uint8_t image[]; // Finally, the actual image data!
@@ -65,6 +66,9 @@ struct __attribute__((__packed__)) idat_image {
 struct __attribute__((__packed__)) idat_check {
 	uint32_t data_len; // len is just the data itself
 	uint8_t type[4]; // Usually represented in ASCII
+	uint8_t deflate_btype; // Always 0x01, stored and BFINAL
+	uint16_t len; // Always 0, this block is empty and only ends the stream
+	uint16_t nlen; // Always 0xffff
 	uint32_t check_data; // zlib adler32 check
 	uint32_t crc;
 };
@@ -76,43 +80,48 @@ struct __attribute__((__packed__)) iend {
 	uint32_t crc;
 };
 
+/* Image data is kept as a run of IDAT chunks, one per band of PNG_BAND_PX
+ * rows. Each chunk is a complete stored DEFLATE block with its own CRC, so a
+ * band can be finished as soon as its rows are converted, long before the
+ * height of the whole segment is known.
+ *
+ * None of the image data blocks are BFINAL. The stream is instead ended by an
+ * empty BFINAL block in IDAT_CHECK, in front of the adler32. Appending more
+ * image data to a file is then just a matter of writing over IDAT_CHECK and
+ * IEND, without touching any image data already on disk.
+ */
+#define PNG_BAND_PX	16
+
 struct png_handle {
 	/* Structures to represent the actual PNG file data directly */
 	struct ihdr ihdr;
-	struct plte plte;
+	const uint8_t *plte; // Complete PLTE chunk, from palette_plte_get()
 	struct idat_zlib idat_zlib;
-	//struct idat idat;
 	struct idat_check idat_check;
 	struct iend iend;
 
 	/* Variables to track certain data that we need */
 	size_t height_px; // Total height of the whole image
 	size_t width_px; // Total width of the whole image
-	size_t image_len; // IDAT Image data in bytes
-	size_t image_height_px; // IDAT image height
+	size_t band_len_max; // Length of a whole band IDAT chunk at max width
+	size_t seg_height_max_px; // Max height of a single segment
 
-	/* The max length a single IDAT chunk can be.
-	 * Note that this includes the CRC for IDAT.
-	 *
-	 * In other words, the IDAT chunk will be the length of
-	 * sizeof(struct idat) + image_len_max
-	 */
-	size_t image_len_max; // The max length a single IDAT chunk can be
+	/* The segment is the image data not yet added to the whole image */
+	size_t seg_width_px;
+	size_t row_len; // Bytes per row of the segment, including the filter byte
+	size_t band_len; // Length of a whole band IDAT chunk, including CRC
+	size_t seg_height_px;
+	uint32_t seg_adler_a;
+	uint32_t seg_adler_b;
 
-	/* Tracking the adler32 steps. */
+	/* Tracking the adler32 steps of the whole image. */
 	uint32_t adler_a;
 	uint32_t adler_b;
 
-	/* The IDAT chunk is at the very end since it has variable length
-	 * data. Just easier to do it this way than to deal with a pointer
-	 * off to somewhere else in the middle of the struct. That is luckily
-	 * the only variable data.
-	 *
-	 * The CRC of the idat chunk is considered to be included in that.
-	 * That is, whatever the actual data length of IDAT is, add 4 to also
-	 * hold the CRC.
+	/* The band IDAT chunks are at the very end since they are variable
+	 * length. The CRC of each chunk is stored right after its data.
 	 */
-	struct idat_image idat_image;
+	uint8_t idat[];
 };
 
 static const struct ihdr ihdr_data = {
@@ -144,14 +153,17 @@ static const struct idat_zlib idat_zlib_data = {
 static const struct idat_image idat_data = {
 	.data_len = 0, // len is just the data itself
 	.type = { 'I', 'D', 'A', 'T' }, // Usually represented in ASCII
-	.deflate_btype = 0x01, // This should be 0x01, no compression?
+	.deflate_btype = 0x00, // Stored, more blocks follow
 	.len = 0, // Len of image data, includes filter type
 	.nlen = 0, // 1s compliment of len
 };
 
 static const struct idat_check idat_check_data = {
-	.data_len = 67108864, // (uint32_t)__builtin_bswap32(4)
+	.data_len = 150994944, // (uint32_t)__builtin_bswap32(9)
 	.type = { 'I', 'D', 'A', 'T' }, // Usually represented in ASCII
+	.deflate_btype = 0x01, // Stored, BFINAL
+	.len = 0x0000,
+	.nlen = 0xffff,
 };
 
 static const struct iend iend_data = {
@@ -160,131 +172,248 @@ static const struct iend iend_data = {
 	.crc = 0x826042ae,
 };
 
-/* Both updates ihdr as well as sets image_len used in idat*/
-void png_add_height(void *png_handle, size_t px_h)
+/* Running zlib adler32. The modulo is only needed every 5552 bytes, the most
+ * that can be summed before b could overflow 32 bits.
+ */
+static void png_adler_update(uint32_t *adler_a, uint32_t *adler_b, const uint8_t *buf, size_t len)
 {
-	struct png_handle *png = png_handle;
-
-	/* Since image data is 4 px per bit, the image length is (height*width/4),
-	 * and, PNG has a byte starting each "scanline" (each row), so add in
-	 * one more lump of height.
-	 */
-	png->image_len = (px_h * png->width_px/4) + px_h;
-	png->height_px += px_h;
-	png->image_height_px = px_h;
-	png->ihdr.height = __builtin_bswap32(png->height_px);
+	uint32_t a = *adler_a;
+	uint32_t b = *adler_b;
+	size_t n;
 
-	png->idat_image.len = png->image_len;
-	png->idat_image.nlen = ~(png->image_len);
-	png->idat_image.data_len = __builtin_bswap32(png->image_len + 5); // 5 is zlib header size
+	while (len) {
+		n = (len < 5552) ? len : 5552;
+		len -= n;
+		while (n--) {
+			a += *buf++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
 
-	/* Set this DEFLATE stream to the FINAL */
-	png->idat_image.deflate_btype = 1;
+	*adler_a = a;
+	*adler_b = b;
+}
 
-	/* Calculate CRCs */
-	/* +4 is because LEN doesn't include type bytes, but CRC does */
-	png->ihdr.crc = __builtin_bswap32(crc(png->ihdr.type, __builtin_bswap32(png->ihdr.data_len) + 4));
-	/* IDAT not calculated here, since it would need to be recalculated again
-	 * after the chunk is written later.
-	 */
+/* Start of a row in the segment, which is the filter byte of that row */
+static uint8_t *png_row_get(struct png_handle *png, size_t row)
+{
+	return png->idat +
+	       ((row / PNG_BAND_PX) * png->band_len) +
+	       sizeof(struct idat_image) +
+	       ((row % PNG_BAND_PX) * png->row_len);
 }
 
-void png_deflate_unfinal(void *png_handle)
+/* Fill in the header and CRC of the band that row px_h - 1 of the segment
+ * falls in, once its last row has been written.
+ */
+static void png_band_close(struct png_handle *png, size_t px_h)
 {
-	struct png_handle *png = png_handle;
+	struct idat_image *idat;
+	size_t rows = ((px_h - 1) % PNG_BAND_PX) + 1;
+	size_t len = rows * png->row_len;
 	uint32_t i;
 
-	png->idat_image.deflate_btype = 0;
+	idat = (struct idat_image *)(png->idat + (((px_h - 1) / PNG_BAND_PX) * png->band_len));
+	memcpy(idat, &idat_data, sizeof(struct idat_image));
+	idat->len = len;
+	idat->nlen = ~len;
+	idat->data_len = __builtin_bswap32(len + 5); // 5 is DEFLATE block header size
 
 	/* Calculate CRCs */
 	/* +4 is because LEN doesn't include type bytes, but CRC does */
 	/* The crc is stored as part of the image data since its a variable
 	 * length argument.
 	 */
-	i = __builtin_bswap32(crc(png->idat_image.type, __builtin_bswap32(png->idat_image.data_len) + 4));
-	memcpy(&png->idat_image.image[png->image_len], &i, sizeof(uint32_t));
+	i = __builtin_bswap32(crc(idat->type, len + 5 + 4));
+	memcpy(&idat->image[len], &i, sizeof(uint32_t));
 }
 
-void png_palette_set(void *png_handle, uint8_t rgb[4][3])
+/* Account for rows just written to the segment starting at row. */
+static void png_seg_rows_added(struct png_handle *png, size_t row, size_t px_h)
 {
-	struct png_handle *png = png_handle;
-	memcpy(&png->plte.color, rgb, 12); // This is a constant size
-	/* Calculate CRCs */
-	/* +4 is because LEN doesn't include type bytes, but CRC does */
-	png->plte.crc = __builtin_bswap32(crc(png->plte.type, __builtin_bswap32(png->plte.data_len) + 4));
+	size_t i;
+
+	/* Rows of a band are contiguous, but bands have a header and CRC
+	 * between them.
+	 */
+	for (i = row; i < (row + px_h); i++) {
+		png_adler_update(&png->seg_adler_a, &png->seg_adler_b, png_row_get(png, i), png->row_len);
+		if (((i + 1) % PNG_BAND_PX) == 0)
+			png_band_close(png, i + 1);
+	}
+
+	png->seg_height_px = row + px_h;
 }
 
-void png_dat_write(void *png_handle, uint8_t *image_buf)
+void png_dat_write(void *png_handle, uint8_t *image_buf, size_t px_h)
 {
 	struct png_handle *png = png_handle;
-	uint8_t *image_ptr = png->idat_image.image;
+	size_t row = png->seg_height_px;
+	uint8_t *image_ptr;
 	uint32_t i;
 
-	for (i = 0; i < png->image_height_px; i++) {
+	furi_check((row + px_h) <= png->seg_height_max_px);
+
+	for (i = 0; i < px_h; i++) {
 		/* Each row needs to begin with a 0 byte to indicate no filter
 		 * for that row.
 		 */
+		image_ptr = png_row_get(png, row + i);
 		*image_ptr = 0x00;
-		image_ptr++;
-		memcpy(image_ptr, image_buf, 40); // The magic number is that each row is 40 bytes long
-		image_ptr += 40;
-		image_buf += 40;
+		memcpy(image_ptr + 1, image_buf, png->row_len - 1);
+		image_buf += png->row_len - 1;
 	}
 
-	/* Calculate zlib adler32 */
-	image_ptr = png->idat_image.image;
-	for (i = 0; i < png->image_len; i++) {
-		png->adler_a = (png->adler_a + image_ptr[i]) % 65521;
-		png->adler_b = (png->adler_b + png->adler_a) % 65521;
+	png_seg_rows_added(png, row, px_h);
+}
+
+void png_dat_write_tiles(void *png_handle, const uint8_t *tile_buf, size_t tiles_h, const uint8_t *lut)
+{
+	struct png_handle *png = png_handle;
+	size_t tiles_w = png->seg_width_px / 8;
+	size_t row = png->seg_height_px;
+	uint8_t *image_ptr;
+	size_t i;
+	int j;
+
+	furi_check((row + (tiles_h * 8)) <= png->seg_height_max_px);
+
+	for (i = 0; i < tiles_h; i++) {
+		/* The 8 rows of a tile never straddle two bands */
+		image_ptr = png_row_get(png, row + (i * 8));
+
+		/* Each row needs to begin with a 0 byte to indicate no filter */
+		for (j = 0; j < 8; j++)
+			image_ptr[j * png->row_len] = 0x00;
+
+		/* And the scanlines land right after each filter byte */
+		tile_to_scanline_copy(image_ptr + 1, png->row_len, tile_buf, tiles_w, 1, lut);
+		tile_buf += tiles_w * 16;
 	}
+
+	png_seg_rows_added(png, row, tiles_h * 8);
+}
+
+void png_dat_band_start(void *png_handle)
+{
+	struct png_handle *png = png_handle;
+	size_t row = png->seg_height_px;
+	int j;
+
+	furi_check((row + 8) <= png->seg_height_max_px);
+
+	/* Filter bytes, and every px not drawn over, are all 0 */
+	for (j = 0; j < 8; j++)
+		memset(png_row_get(png, row + j), 0x00, png->row_len);
+}
+
+void png_dat_band_tiles(void *png_handle, const uint8_t *tile_buf, size_t tiles_w, size_t x, const uint8_t *lut)
+{
+	struct png_handle *png = png_handle;
+
+	furi_check(((x + tiles_w) * 2) <= (png->row_len - 1));
+
+	/* Each tile is 2 bytes of each scanline */
+	tile_to_scanline_copy(png_row_get(png, png->seg_height_px) + 1 + (x * 2), png->row_len, tile_buf, tiles_w, 1, lut);
+}
+
+void png_dat_band_add(void *png_handle)
+{
+	struct png_handle *png = png_handle;
+
+	png_seg_rows_added(png, png->seg_height_px, 8);
+}
+
+const uint8_t *png_seg_row_get(void *png_handle, size_t row)
+{
+	struct png_handle *png = png_handle;
+
+	furi_check(row < png->seg_height_px);
+
+	return png_row_get(png, row) + 1;
+}
+
+size_t png_seg_height_get(void *png_handle)
+{
+	struct png_handle *png = png_handle;
+	return png->seg_height_px;
+}
+
+void png_seg_reset(void *png_handle, size_t px_w)
+{
+	struct png_handle *png = png_handle;
+
+	/* The row length, and with it where each row lands in the IDAT chunks,
+	 * is worked out once here for the whole segment. Since image data is
+	 * 2 bits per px, each row is (width/4) bytes rounded up, and, PNG has
+	 * a byte starting each "scanline" (each row).
+	 */
+	png->seg_width_px = px_w;
+	png->row_len = (((px_w * 2) + 7) / 8) + 1;
+	png->band_len = sizeof(struct idat_image) + (PNG_BAND_PX * png->row_len) + sizeof(uint32_t);
+	furi_check(png->band_len <= png->band_len_max);
+
+	png->seg_height_px = 0;
+	png->seg_adler_a = 1;
+	png->seg_adler_b = 0;
+}
+
+void png_seg_append(void *png_handle)
+{
+	struct png_handle *png = png_handle;
+	size_t seg_len = png->seg_height_px * png->row_len;
+	uint32_t rem = seg_len % 65521;
+
+	/* Stacking needs every segment to be the same width as the image */
+	furi_check(png->seg_width_px == png->width_px);
+
+	/* Finish off a partial last band */
+	if (png->seg_height_px % PNG_BAND_PX)
+		png_band_close(png, png->seg_height_px);
+
+	/* Fold the segment's adler32 in to the whole image's. This is the same
+	 * as zlib's adler32_combine(), the segment started from a = 1, b = 0.
+	 */
+	png->adler_b = (png->adler_b + png->seg_adler_b + ((rem * ((png->adler_a + 65521 - 1) % 65521)) % 65521)) % 65521;
+	png->adler_a = (png->adler_a + png->seg_adler_a + 65521 - 1) % 65521;
 	png->idat_check.check_data = (__builtin_bswap32((png->adler_b << 16) | png->adler_a));
 
+	png->height_px += png->seg_height_px;
+	png->ihdr.height = __builtin_bswap32(png->height_px);
+
 	/* Calculate CRCs */
 	/* +4 is because LEN doesn't include type bytes, but CRC does */
-	i = __builtin_bswap32(crc(png->idat_image.type, __builtin_bswap32(png->idat_image.data_len) + 4));
-	memcpy(&png->idat_image.image[png->image_len], &i, sizeof(uint32_t));
+	png->ihdr.crc = __builtin_bswap32(crc(png->ihdr.type, __builtin_bswap32(png->ihdr.data_len) + 4));
 	png->idat_check.crc = __builtin_bswap32(crc(png->idat_check.type, __builtin_bswap32(png->idat_check.data_len) + 4));
 }
 
-void png_reset(void *png_handle, size_t px_w, size_t px_h)
+void png_palette_set(void *png_handle, const uint8_t *plte)
 {
 	struct png_handle *png = png_handle;
 
-	/* Clear each PNG chunk */
-	memset(&png->ihdr, '\0', sizeof(struct ihdr));
-	memset(&png->plte, '\0', sizeof(struct plte));
-	memset(&png->idat_zlib, '\0', sizeof(struct idat_zlib));
-	memset(&png->idat_check, '\0', sizeof(struct idat_check));
-	memset(&png->iend, '\0', sizeof(struct iend));
-	memset(&png->idat_image, '\0', (sizeof(struct idat_image) + png->image_len_max));
+	png->plte = plte;
+}
+
+void png_reset(void *png_handle, size_t px_w)
+{
+	struct png_handle *png = png_handle;
 
 	/* Recalculate sizes, must be smaller than max allocated */
-	png->height_px = px_h;
-	png->image_height_px = px_h;
+	png->height_px = 0;
 	png->width_px = px_w;
-	/* Since image data is 4 px per bit, the image length is (height*width/4),
-	 * and, PNG has a byte starting each "scanline" (each row), so add in
-	 * one more lump of height.
-	 */
-	png->image_len = (px_h*px_w/4) + px_h;
-	furi_check((png->image_len + sizeof(uint32_t)) <= png->image_len_max);
 
 	/* Copy in static data bits */
 	memcpy(&png->ihdr, &ihdr_data, sizeof(struct ihdr));
-	memcpy(&png->plte, &plte_data, sizeof(struct plte));
-	png_palette_set(png_handle, palette_rgb16_get(0));
+	png->plte = palette_plte_get(0);
 	memcpy(&png->idat_zlib, &idat_zlib_data, sizeof(struct idat_zlib));
 	memcpy(&png->idat_check, &idat_check_data, sizeof(struct idat_check));
 	memcpy(&png->iend, &iend_data, sizeof(struct iend));
-	memcpy(&png->idat_image, &idat_data, sizeof(struct idat_image));
 
 	/* Start adding in dynamic data */
 	png->ihdr.width = __builtin_bswap32(png->width_px);
 	png->ihdr.height = __builtin_bswap32(png->height_px);
-	/* len and nlen are components of the deflate stream inside zlib */
-	png->idat_image.len = png->image_len;
-	png->idat_image.nlen = ~(png->image_len);
-	png->idat_image.data_len = __builtin_bswap32(png->image_len + 5); // 5 is zlib header size
 
 	/* Reset adler32 running */
 	png->adler_a = 1;
@@ -299,27 +428,29 @@ void png_reset(void *png_handle, size_t px_w, size_t px_h)
 void *png_alloc(uint32_t width, uint32_t height)
 {
 	struct png_handle *png = NULL;
-	uint32_t image_len;
+	size_t band_len;
+	size_t bands;
 
-	/* The IDAT chunk has variable length data, and we calculate that
+	/* The IDAT chunks have variable length data, and we calculate that
 	 * amount based on width and height.
 	 *
-	 * Since image data is 4 px per bit, the image length is (height*width/4),
-	 * and, PNG has a byte starting each "scanline" (each row), so add in
-	 * one more lump of height.
+	 * Since image data is 4 px per byte, the row length is (width/4), and,
+	 * PNG has a byte starting each "scanline" (each row), so add in one more
+	 * byte per row. Each band is a chunk of its own with a header and CRC.
 	 */
-	image_len = (height*width/4) + height;
+	band_len = sizeof(struct idat_image) + (PNG_BAND_PX * ((width / 4) + 1)) + sizeof(uint32_t);
+	bands = (height + PNG_BAND_PX - 1) / PNG_BAND_PX;
 
 	/* Allocate the data we will need. The whole png_handle, plus the length
-	 * of the image data, plus the image data's crc32 which is considered a
-	 * part of the data stream for our purposes.
+	 * of all of the bands.
 	 */
-	png = malloc(sizeof(struct png_handle) + image_len + sizeof(uint32_t));
+	png = malloc(sizeof(struct png_handle) + (bands * band_len));
 
-	png->image_len = image_len;
-	png->image_len_max = (image_len + sizeof(uint32_t));
+	png->band_len_max = band_len;
+	png->seg_height_max_px = height;
 
-	png_reset(png, width, height);
+	png_seg_reset(png, width);
+	png_reset(png, width);
 
 	return png;
 }
@@ -333,6 +464,7 @@ void png_free(void *png_handle)
 size_t png_len_get(void *png_handle, enum png_chunks chunk)
 {
 	struct png_handle *png = png_handle;
+	size_t rem;
 
 	switch (chunk) {
 	case IHDR:
@@ -342,13 +474,16 @@ size_t png_len_get(void *png_handle, enum png_chunks chunk)
 	case IDAT_ZLIB:
 		return sizeof(struct idat_zlib);
 	case IDAT:
-		return sizeof(struct idat_image) + png->image_len + 4; // +4 is for the CRC appended to the end.
+		/* All of the whole bands, plus what is left over */
+		rem = png->seg_height_px % PNG_BAND_PX;
+		return ((png->seg_height_px / PNG_BAND_PX) * png->band_len) +
+		       (rem ? (sizeof(struct idat_image) + (rem * png->row_len) + 4) : 0); // +4 is for the CRC appended to the end.
 	case IDAT_CHECK:
 		return sizeof(struct idat_check);
 	case IEND:
 		return 12; // Always 12 bytes
-	case LAST_IDAT:
-		return (12 + sizeof(struct idat_check) + sizeof(struct idat_image) + png->image_len + 4); // 12 is IEND, 4 is CRC to IDAT
+	case TRAILER:
+		return (12 + sizeof(struct idat_check)); // 12 is IEND
 	default:
 		return 0;
 	}
@@ -362,17 +497,624 @@ uint8_t *png_buf_get(void *png_handle, enum png_chunks chunk)
 	case IHDR:
 		return (uint8_t *)&png->ihdr;
 	case PLTE:
-		return (uint8_t *)&png->plte;
+		return (uint8_t *)png->plte;
 	case IDAT_ZLIB:
 		return (uint8_t *)&png->idat_zlib;
 	case IDAT:
-		return (uint8_t *)&png->idat_image;
+		return png->idat;
 	case IDAT_CHECK:
 		return (uint8_t *)&png->idat_check;
 	case IEND:
 		return (uint8_t *)&png->iend;
-	// LAST_IDAT doesn't have any meaning as a buffer
+	// TRAILER doesn't have any meaning as a buffer
+	default:
+		return NULL;
+	}
+}
+
+size_t png_head_check(const uint8_t *head)
+{
+	const struct ihdr *ihdr = (const struct ihdr *)head;
+	const struct plte *plte = (const struct plte *)(head + sizeof(struct ihdr));
+
+	/* Magic, and IHDR, must match what we write, other than image size */
+	if (memcmp(ihdr->magic, ihdr_data.magic, sizeof(ihdr->magic)) ||
+	    ihdr->data_len != ihdr_data.data_len ||
+	    memcmp(ihdr->type, ihdr_data.type, sizeof(ihdr->type)) ||
+	    ihdr->color_type != ihdr_data.color_type ||
+	    ihdr->crc != __builtin_bswap32(crc((uint8_t *)ihdr->type, __builtin_bswap32(ihdr->data_len) + 4)))
+		return 0;
+
+	/* And PLTE must follow it directly, with a color per possible index */
+	if (memcmp(plte->type, plte_data.type, sizeof(plte->type)))
+		return 0;
+	if (ihdr->bit_depth == 2 && plte->data_len == plte_data.data_len)
+		return PNG_PLTE_LEN;
+	if (ihdr->bit_depth == 1 && plte->data_len == __builtin_bswap32(6))
+		return PNG_PLTE_SMALL_LEN;
+
+	return 0;
+}
+
+void png_plte_small_build(uint8_t *chunk, const uint8_t *plte_chunk, const uint8_t shades[2])
+{
+	const struct plte *plte = (const struct plte *)plte_chunk;
+	uint32_t i;
+
+	i = __builtin_bswap32(6);
+	memcpy(chunk, &i, sizeof(uint32_t));
+	memcpy(chunk + 4, plte->type, sizeof(plte->type));
+	memcpy(chunk + 8, plte->color[shades[0]], 3);
+	memcpy(chunk + 11, plte->color[shades[1]], 3);
+	/* +4 is because LEN doesn't include type bytes, but CRC does */
+	i = __builtin_bswap32(crc(chunk + 4, 6 + 4));
+	memcpy(chunk + 14, &i, sizeof(uint32_t));
+}
+
+void png_plte_order_build(uint8_t *chunk, const uint8_t *plte_chunk, uint8_t order)
+{
+	const struct plte *plte = (const struct plte *)plte_chunk;
+	struct plte *out = (struct plte *)chunk;
+	unsigned int idx;
+
+	out->data_len = plte->data_len;
+	memcpy(out->type, plte->type, sizeof(out->type));
+	for (idx = 0; idx < 4; idx++)
+		memcpy(out->color[idx], plte->color[(order >> (idx * 2)) & 0x03], 3);
+	out->crc = __builtin_bswap32(crc(out->type, sizeof(out->type) + sizeof(out->color)));
+}
+
+/* Streaming encoder
+ *
+ * Where the above keeps a whole segment of stored (uncompressed) image data
+ * in memory, the stream only ever holds one row and one chunk worth of output.
+ * Rows are compressed as they come in with fixed Huffman codes and the only
+ * match DEFLATE is ever asked for is "repeat the previous byte", distance 1.
+ * That is plenty for runs of a single shade, and it makes a row that is an
+ * exact copy of the one above nearly free: with the PNG "Up" filter, that row
+ * is a filter byte and a run of 0.
+ *
+ * The file layout mirrors the one above. IHDR and PLTE, the zlib header, then
+ * IDAT chunks of compressed data each segment ending byte aligned and not
+ * BFINAL, then the same IDAT_CHECK and IEND trailer. Streams can be extended
+ * with more segments in exactly the same way.
+ */
+#define PNG_STREAM_CHUNK	1024
+
+/* Animated PNG control chunks, see the APNG spec. acTL goes right after PLTE
+ * so that PLTE is still at PNG_PLTE_OFFS, and fcTL in front of each frame.
+ */
+struct __attribute__((__packed__)) actl {
+	uint32_t data_len;
+	uint8_t type[4];
+	uint32_t num_frames;
+	uint32_t num_plays; // 0 loops forever
+	uint32_t crc;
+};
+
+struct __attribute__((__packed__)) fctl {
+	uint32_t data_len;
+	uint8_t type[4];
+	uint32_t seq;
+	uint32_t width;
+	uint32_t height;
+	uint32_t x_offset;
+	uint32_t y_offset;
+	uint16_t delay_num;
+	uint16_t delay_den;
+	uint8_t dispose_op;
+	uint8_t blend_op;
+	uint32_t crc;
+};
+
+struct png_stream {
+	struct ihdr ihdr;
+	const uint8_t *plte; // Complete PLTE chunk, from palette_plte_get()
+	struct idat_zlib idat_zlib;
+	struct idat_check idat_check;
+	struct iend iend;
+
+	/* At 1 bit per px, PLTE only has the 2 shades used */
+	unsigned int depth;
+	uint8_t shade_map[4]; // PNG index of each GB shade
+	uint8_t plte_shade[2]; // GB shade of each PNG index
+	uint8_t plte_small[PNG_PLTE_SMALL_LEN];
+
+	/* Output sink, and whether any write to it came up short */
+	png_write_cb write;
+	void *write_ctx;
+	bool error;
+
+	size_t width_px; // Width of the source rows
+	size_t height_px; // Total height of the whole, scaled, image
+	unsigned int scale;
+	size_t row_len; // Bytes per scaled row, not including the filter byte
+	size_t row_len_max;
+
+	uint32_t adler_a;
+	uint32_t adler_b;
+
+	/* Bits not yet making up a whole byte, LSB first as DEFLATE wants */
+	uint32_t bit_buf;
+	unsigned int bit_cnt;
+	/* The last byte fed to DEFLATE, the one a distance 1 match repeats */
+	int last;
+
+	/* Animated PNG. Every frame after the first goes in fdAT chunks, which
+	 * are IDAT with a sequence number in front of the data.
+	 */
+	struct actl actl;
+	uint32_t frames;
+	uint32_t seq; // Next sequence number, fcTL and fdAT share them
+	size_t chunk_start; // Bytes of chunk data before any image data
+
+	/* One IDAT chunk being filled; length, type, data, and room for CRC */
+	size_t chunk_len;
+	uint8_t chunk[8 + PNG_STREAM_CHUNK + 4];
+
+	uint8_t row[]; // One scaled row
+};
+
+static const struct idat_zlib idat_zlib_stream_data = {
+	.data_len = 33554432, // (uint32_t)__builtin_bswap32(2)
+	.type = { 'I', 'D', 'A', 'T' },
+	.zlib_flags = 0x58, // 8k window size, DEFLATE
+	.zlib_addl_flags = 0x47, // Compressed with the fastest algorithm, no dictionary, check bits for flags
+	.crc = 0xd5be21e6,
+};
+
+static const struct actl actl_data = {
+	.data_len = 134217728, // (uint32_t)__builtin_bswap32(8)
+	.type = { 'a', 'c', 'T', 'L' },
+	.num_frames = 0,
+	.num_plays = 0,
+};
+
+static const struct fctl fctl_data = {
+	.data_len = 436207616, // (uint32_t)__builtin_bswap32(26)
+	.type = { 'f', 'c', 'T', 'L' },
+	.dispose_op = 0, // APNG_DISPOSE_OP_NONE, leave the frame as is
+	.blend_op = 0, // APNG_BLEND_OP_SOURCE, replace what was there
+};
+
+/* Lengths that the DEFLATE length codes 257 through 285 start at, and how
+ * many extra bits follow each.
+ */
+static const uint16_t len_base[] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t len_extra[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+
+/* Fill in the length and CRC of a chunk of data_len bytes and write it out */
+static void png_stream_chunk_write(struct png_stream *stream, uint8_t *chunk, size_t data_len)
+{
+	uint32_t i;
+
+	i = __builtin_bswap32(data_len);
+	memcpy(chunk, &i, sizeof(uint32_t));
+	/* +4 is because LEN doesn't include type bytes, but CRC does */
+	i = __builtin_bswap32(crc(chunk + 4, data_len + 4));
+	memcpy(chunk + 8 + data_len, &i, sizeof(uint32_t));
+
+	if (stream->write(stream->write_ctx, chunk, data_len + 12) != (data_len + 12))
+		stream->error = true;
+}
+
+static void png_stream_flush(struct png_stream *stream)
+{
+	uint32_t i;
+
+	if (stream->chunk_len == stream->chunk_start)
+		return;
+
+	/* Numbered as they are written, so no number is ever skipped */
+	if (stream->chunk_start) {
+		i = __builtin_bswap32(stream->seq++);
+		memcpy(stream->chunk + 8, &i, sizeof(uint32_t));
+	}
+
+	png_stream_chunk_write(stream, stream->chunk, stream->chunk_len);
+	stream->chunk_len = stream->chunk_start;
+}
+
+static void png_stream_bits(struct png_stream *stream, uint32_t bits, unsigned int cnt)
+{
+	stream->bit_buf |= bits << stream->bit_cnt;
+	stream->bit_cnt += cnt;
+
+	while (stream->bit_cnt >= 8) {
+		stream->chunk[8 + stream->chunk_len++] = stream->bit_buf;
+		stream->bit_buf >>= 8;
+		stream->bit_cnt -= 8;
+		if (stream->chunk_len == PNG_STREAM_CHUNK)
+			png_stream_flush(stream);
+	}
+}
+
+/* Huffman codes are sent MSB first, unlike everything else */
+static void png_stream_code(struct png_stream *stream, uint32_t code, unsigned int cnt)
+{
+	uint32_t rev = 0;
+	unsigned int i;
+
+	for (i = 0; i < cnt; i++) {
+		rev = (rev << 1) | (code & 1);
+		code >>= 1;
+	}
+
+	png_stream_bits(stream, rev, cnt);
+}
+
+/* Send a literal/length symbol with the fixed Huffman code for it */
+static void png_stream_sym(struct png_stream *stream, unsigned int sym)
+{
+	if (sym < 144)
+		png_stream_code(stream, 0x30 + sym, 8);
+	else if (sym < 256)
+		png_stream_code(stream, 0x190 + (sym - 144), 9);
+	else if (sym < 280)
+		png_stream_code(stream, sym - 256, 7);
+	else
+		png_stream_code(stream, 0xc0 + (sym - 280), 8);
+}
+
+/* Repeat the last byte len more times, len must be 3 to 258 */
+static void png_stream_run(struct png_stream *stream, unsigned int len)
+{
+	int i;
+
+	for (i = COUNT_OF(len_base) - 1; len_base[i] > len; i--);
+
+	png_stream_sym(stream, 257 + i);
+	png_stream_bits(stream, len - len_base[i], len_extra[i]);
+	/* Distance code 0, distance 1, no extra bits */
+	png_stream_code(stream, 0, 5);
+}
+
+static void png_stream_deflate(struct png_stream *stream, const uint8_t *buf, size_t len)
+{
+	size_t i = 0;
+	size_t run;
+
+	png_adler_update(&stream->adler_a, &stream->adler_b, buf, len);
+
+	while (i < len) {
+		for (run = 0; (i + run) < len && run < 258 && buf[i + run] == stream->last; run++);
+
+		if (run >= 3) {
+			png_stream_run(stream, run);
+			i += run;
+		} else {
+			png_stream_sym(stream, buf[i]);
+			stream->last = buf[i];
+			i++;
+		}
+	}
+}
+
+/* Start a fixed Huffman block, not BFINAL */
+static void png_stream_block_start(struct png_stream *stream)
+{
+	png_stream_bits(stream, 0, 1); // BFINAL
+	png_stream_bits(stream, 1, 2); // BTYPE fixed Huffman
+	/* Nothing before this point in the stream can be matched against */
+	stream->last = -1;
+}
+
+static void png_stream_plte_small(struct png_stream *stream)
+{
+	if (stream->depth == 1)
+		png_plte_small_build(stream->plte_small, stream->plte, stream->plte_shade);
+}
+
+void png_stream_reset(void *png_stream, size_t px_w, unsigned int scale)
+{
+	struct png_stream *stream = png_stream;
+
+	stream->width_px = px_w;
+	stream->scale = scale;
+	stream->height_px = 0;
+	stream->depth = 2;
+	stream->row_len = (((px_w * scale * 2) + 7) / 8);
+	furi_check(stream->row_len <= stream->row_len_max);
+
+	memcpy(&stream->ihdr, &ihdr_data, sizeof(struct ihdr));
+	stream->plte = palette_plte_get(0);
+	memcpy(&stream->idat_zlib, &idat_zlib_stream_data, sizeof(struct idat_zlib));
+	memcpy(&stream->idat_check, &idat_check_data, sizeof(struct idat_check));
+	memcpy(&stream->iend, &iend_data, sizeof(struct iend));
+
+	stream->ihdr.width = __builtin_bswap32(px_w * scale);
+	stream->ihdr.height = 0;
+	stream->ihdr.crc = __builtin_bswap32(crc(stream->ihdr.type, __builtin_bswap32(stream->ihdr.data_len) + 4));
+
+	stream->adler_a = 1;
+	stream->adler_b = 0;
+
+	memcpy(&stream->actl, &actl_data, sizeof(struct actl));
+	stream->frames = 0;
+	stream->seq = 0;
+}
+
+void png_stream_shades_set(void *png_stream, unsigned int shades)
+{
+	struct png_stream *stream = png_stream;
+	unsigned int shade;
+	unsigned int idx = 0;
+
+	if (__builtin_popcount(shades & 0x0f) > 2)
+		return;
+
+	/* A single shade still needs a 2 entry PLTE, pad it with whichever
+	 * of white or black isn't used.
+	 */
+	if (__builtin_popcount(shades & 0x0f) < 2)
+		shades |= (shades & 0x01) ? 0x08 : 0x01;
+
+	for (shade = 0; shade < 4; shade++) {
+		stream->shade_map[shade] = 0;
+		if (shades & (1 << shade)) {
+			stream->shade_map[shade] = idx;
+			stream->plte_shade[idx++] = shade;
+		}
+	}
+
+	stream->depth = 1;
+	stream->row_len = (((stream->width_px * stream->scale) + 7) / 8);
+	stream->ihdr.bit_depth = 1;
+	stream->ihdr.crc = __builtin_bswap32(crc(stream->ihdr.type, __builtin_bswap32(stream->ihdr.data_len) + 4));
+	png_stream_plte_small(stream);
+}
+
+void png_stream_palette_set(void *png_stream, const uint8_t *plte)
+{
+	struct png_stream *stream = png_stream;
+
+	stream->plte = plte;
+	png_stream_plte_small(stream);
+}
+
+void png_stream_start(void *png_stream, png_write_cb write, void *write_ctx, bool resume)
+{
+	struct png_stream *stream = png_stream;
+
+	stream->write = write;
+	stream->write_ctx = write_ctx;
+	stream->error = false;
+	stream->bit_buf = 0;
+	stream->bit_cnt = 0;
+	stream->chunk_start = 0;
+	stream->chunk_len = 0;
+	memcpy(stream->chunk + 4, "IDAT", 4);
+
+	if (!resume) {
+		stream->error |= (write(write_ctx, &stream->ihdr, sizeof(struct ihdr)) != sizeof(struct ihdr));
+		stream->error |= (write(write_ctx, png_stream_buf_get(stream, PLTE), png_stream_len_get(stream, PLTE)) != png_stream_len_get(stream, PLTE));
+		stream->error |= (write(write_ctx, &stream->idat_zlib, sizeof(struct idat_zlib)) != sizeof(struct idat_zlib));
+	}
+
+	png_stream_block_start(stream);
+}
+
+void png_stream_row(void *png_stream, const uint8_t *row)
+{
+	struct png_stream *stream = png_stream;
+	uint8_t filter;
+	size_t px;
+	unsigned int n;
+	unsigned int shade;
+	unsigned int bit = 0;
+
+	/* Expand each 2 bit px to scale px, nearest neighbour, and to the PNG
+	 * index of its shade at 1 bit per px.
+	 */
+	if (stream->scale == 1 && stream->depth == 2) {
+		memcpy(stream->row, row, stream->row_len);
+	} else {
+		memset(stream->row, 0, stream->row_len);
+		for (px = 0; px < stream->width_px; px++) {
+			shade = (row[px / 4] >> (6 - ((px % 4) * 2))) & 0x03;
+			if (stream->depth == 1)
+				shade = stream->shade_map[shade];
+			for (n = 0; n < stream->scale; n++) {
+				stream->row[bit / 8] |= shade << (8 - stream->depth - (bit % 8));
+				bit += stream->depth;
+			}
+		}
+	}
+
+	/* The first copy of the row is sent as is, no filter */
+	filter = 0x00;
+	png_stream_deflate(stream, &filter, 1);
+	png_stream_deflate(stream, stream->row, stream->row_len);
+
+	/* Every copy after that is the Up filter, the difference from the row
+	 * above, which is all 0.
+	 */
+	if (stream->scale > 1)
+		memset(stream->row, 0, stream->row_len);
+	for (n = 1; n < stream->scale; n++) {
+		filter = 0x02;
+		png_stream_deflate(stream, &filter, 1);
+		png_stream_deflate(stream, stream->row, stream->row_len);
+	}
+
+	stream->height_px += stream->scale;
+}
+
+bool png_stream_finish(void *png_stream)
+{
+	struct png_stream *stream = png_stream;
+
+	/* End of block, then an empty stored block to get back to a byte
+	 * boundary. The next segment, if any, starts a new block right here.
+	 */
+	png_stream_sym(stream, 256);
+	png_stream_bits(stream, 0, 3); // Not BFINAL, BTYPE stored
+	if (stream->bit_cnt)
+		png_stream_bits(stream, 0, 8 - stream->bit_cnt);
+	png_stream_bits(stream, 0x0000, 16); // LEN
+	png_stream_bits(stream, 0xffff, 16); // NLEN
+	png_stream_flush(stream);
+
+	stream->idat_check.check_data = (__builtin_bswap32((stream->adler_b << 16) | stream->adler_a));
+	stream->idat_check.crc = __builtin_bswap32(crc(stream->idat_check.type, __builtin_bswap32(stream->idat_check.data_len) + 4));
+	stream->error |= (stream->write(stream->write_ctx, &stream->idat_check, sizeof(struct idat_check)) != sizeof(struct idat_check));
+	stream->error |= (stream->write(stream->write_ctx, &stream->iend, sizeof(struct iend)) != sizeof(struct iend));
+
+	/* IHDR needs to be rewritten by the caller with the new height */
+	stream->ihdr.height = __builtin_bswap32(stream->height_px);
+	stream->ihdr.crc = __builtin_bswap32(crc(stream->ihdr.type, __builtin_bswap32(stream->ihdr.data_len) + 4));
+
+	return !stream->error;
+}
+
+bool png_stream_apng_start(void *png_stream, size_t px_h, png_write_cb write, void *write_ctx)
+{
+	struct png_stream *stream = png_stream;
+
+	stream->write = write;
+	stream->write_ctx = write_ctx;
+	stream->error = false;
+
+	stream->ihdr.height = __builtin_bswap32(px_h * stream->scale);
+	stream->ihdr.crc = __builtin_bswap32(crc(stream->ihdr.type, __builtin_bswap32(stream->ihdr.data_len) + 4));
+	stream->actl.crc = __builtin_bswap32(crc(stream->actl.type, __builtin_bswap32(stream->actl.data_len) + 4));
+
+	stream->error |= (write(write_ctx, &stream->ihdr, sizeof(struct ihdr)) != sizeof(struct ihdr));
+	stream->error |= (write(write_ctx, stream->plte, sizeof(struct plte)) != sizeof(struct plte));
+	stream->error |= (write(write_ctx, &stream->actl, sizeof(struct actl)) != sizeof(struct actl));
+
+	return !stream->error;
+}
+
+void png_stream_frame_start(void *png_stream, png_write_cb write, void *write_ctx,
+			    size_t x, size_t y, size_t px_w, size_t px_h, uint16_t delay_ms)
+{
+	struct png_stream *stream = png_stream;
+	struct fctl fctl;
+
+	stream->write = write;
+	stream->write_ctx = write_ctx;
+	stream->error = false;
+
+	/* Every frame is its own, complete, zlib stream of px_w wide rows */
+	stream->width_px = px_w;
+	stream->row_len = (((px_w * stream->scale * 2) + 7) / 8);
+	furi_check(stream->row_len <= stream->row_len_max);
+	stream->adler_a = 1;
+	stream->adler_b = 0;
+
+	memcpy(&fctl, &fctl_data, sizeof(struct fctl));
+	fctl.seq = __builtin_bswap32(stream->seq++);
+	fctl.width = __builtin_bswap32(px_w * stream->scale);
+	fctl.height = __builtin_bswap32(px_h * stream->scale);
+	fctl.x_offset = __builtin_bswap32(x * stream->scale);
+	fctl.y_offset = __builtin_bswap32(y * stream->scale);
+	fctl.delay_num = __builtin_bswap16(delay_ms);
+	fctl.delay_den = __builtin_bswap16(1000);
+	fctl.crc = __builtin_bswap32(crc(fctl.type, __builtin_bswap32(fctl.data_len) + 4));
+	stream->error |= (write(write_ctx, &fctl, sizeof(struct fctl)) != sizeof(struct fctl));
+
+	/* The first frame is also the image seen by anything that doesn't
+	 * know APNG, so it has to be normal IDAT.
+	 */
+	stream->bit_buf = 0;
+	stream->bit_cnt = 0;
+	stream->chunk_start = stream->frames ? 4 : 0;
+	stream->chunk_len = stream->chunk_start;
+	memcpy(stream->chunk + 4, stream->frames ? "fdAT" : "IDAT", 4);
+
+	stream->frames++;
+	stream->actl.num_frames = __builtin_bswap32(stream->frames);
+	stream->actl.crc = __builtin_bswap32(crc(stream->actl.type, __builtin_bswap32(stream->actl.data_len) + 4));
+
+	png_stream_bits(stream, idat_zlib_stream_data.zlib_flags, 8);
+	png_stream_bits(stream, idat_zlib_stream_data.zlib_addl_flags, 8);
+	png_stream_block_start(stream);
+}
+
+bool png_stream_frame_finish(void *png_stream)
+{
+	struct png_stream *stream = png_stream;
+	uint32_t adler = (stream->adler_b << 16) | stream->adler_a;
+	int i;
+
+	/* End of block, then an empty stored block, this time BFINAL, and the
+	 * adler32 of the frame, MSB first.
+	 */
+	png_stream_sym(stream, 256);
+	png_stream_bits(stream, 1, 3); // BFINAL, BTYPE stored
+	if (stream->bit_cnt)
+		png_stream_bits(stream, 0, 8 - stream->bit_cnt);
+	png_stream_bits(stream, 0x0000, 16); // LEN
+	png_stream_bits(stream, 0xffff, 16); // NLEN
+	for (i = 24; i >= 0; i -= 8)
+		png_stream_bits(stream, (adler >> i) & 0xff, 8);
+	png_stream_flush(stream);
+
+	stream->error |= (stream->write(stream->write_ctx, &stream->iend, sizeof(struct iend)) != sizeof(struct iend));
+
+	return !stream->error;
+}
+
+uint8_t *png_stream_buf_get(void *png_stream, enum png_chunks chunk)
+{
+	struct png_stream *stream = png_stream;
+
+	switch (chunk) {
+	case IHDR:
+		return (uint8_t *)&stream->ihdr;
+	case PLTE:
+		if (stream->depth == 1)
+			return stream->plte_small;
+		return (uint8_t *)stream->plte;
+	case ACTL:
+		return (uint8_t *)&stream->actl;
 	default:
 		return NULL;
 	}
 }
+
+size_t png_stream_len_get(void *png_stream, enum png_chunks chunk)
+{
+	struct png_stream *stream = png_stream;
+
+	switch (chunk) {
+	case IHDR:
+		return sizeof(struct ihdr);
+	case PLTE:
+		if (stream->depth == 1)
+			return PNG_PLTE_SMALL_LEN;
+		return sizeof(struct plte);
+	case TRAILER:
+		return sizeof(struct idat_check) + sizeof(struct iend);
+	case IEND:
+		return sizeof(struct iend);
+	case ACTL:
+		return sizeof(struct actl);
+	default:
+		return 0;
+	}
+}
+
+void *png_stream_alloc(uint32_t width)
+{
+	struct png_stream *stream = NULL;
+	size_t row_len = ((width * 2) + 7) / 8;
+
+	stream = malloc(sizeof(struct png_stream) + row_len);
+	stream->row_len_max = row_len;
+	png_stream_reset(stream, width, 1);
+
+	return stream;
+}
+
+void png_stream_free(void *png_stream)
+{
+	free(png_stream);
+}
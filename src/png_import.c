@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/png_import.h>
+#include <src/include/png_read.h>
+#include <src/include/tile_tools.h>
+
+/* Window png_read starts out with, grown to what each PNG needs */
+#define PNG_IMPORT_WINDOW	256
+
+#define PNG_IMPORT_ROW_MAX	(PNG_IMPORT_W_MAX / 4) // 2bpp scanline bytes
+
+struct png_import {
+	void *png_read; // Only allocated once a PNG needs it
+
+	File *file;
+	const uint8_t *plte; // Colors of the palette the PNG was saved in, or NULL
+	png_import_cb cb;
+	void *cb_ctx;
+
+	uint32_t height;
+	uint8_t bit_depth;
+	size_t row_len; // Bytes per row of the PNG, not including the filter byte
+	size_t tiles_w;
+	size_t tiles_h;
+	uint32_t rows; // Rows taken so far
+	size_t bands; // Bands passed to cb so far
+	size_t row_pos; // Bytes of the current row so far, with its filter byte
+
+	uint8_t shade[4]; // Shade of each index of the PNG
+	bool remap; // shade isn't just the index
+	uint8_t lut[256]; // Whole bytes of 2bpp rows remapped with shade
+
+	uint8_t row[PNG_IMPORT_ROW_MAX + 1]; // Filter byte, then the row
+	uint8_t scan[PNG_IMPORT_ROW_MAX * 8]; // One band of 2bpp scanlines
+	uint8_t tiles[PNG_IMPORT_ROW_MAX * 8];
+};
+
+static const uint8_t png_magic[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+static uint32_t png_import_be32(const uint8_t *buf)
+{
+	return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3];
+}
+
+static bool png_import_read(struct png_import *imp, void *buf, size_t len)
+{
+	return (storage_file_read(imp->file, buf, len) == len);
+}
+
+static bool png_import_skip(struct png_import *imp, size_t len)
+{
+	return storage_file_seek(imp->file, storage_file_tell(imp->file) + len, true);
+}
+
+/* Same shape as storage_file_read(), for png_read */
+static size_t png_import_read_cb(void *ctx, void *buf, size_t len)
+{
+	return storage_file_read(ctx, buf, len);
+}
+
+/* Shade of a color of the PNG, idx is the index it has in the PNG */
+static uint8_t png_import_shade_get(struct png_import *imp, const uint8_t *rgb, unsigned int idx)
+{
+	unsigned int i;
+	unsigned int luma;
+
+	/* A 2bpp PNG of ours has shade n at index n, even if a custom palette
+	 * has the same color more than once.
+	 */
+	if (imp->plte) {
+		if (imp->bit_depth == 2 && !memcmp(rgb, imp->plte + (idx * 3), 3))
+			return idx;
+		for (i = 0; i < 4; i++) {
+			if (!memcmp(rgb, imp->plte + (i * 3), 3))
+				return i;
+		}
+	}
+
+	luma = ((rgb[0] * 77) + (rgb[1] * 150) + (rgb[2] * 29)) >> 8;
+
+	return ((255 - luma) * 4) / 256;
+}
+
+/* Check the PNG is one that can be imported, and set up for its rows */
+static bool png_import_start(struct png_import *imp, uint32_t width, uint32_t height, uint8_t bit_depth,
+			     uint8_t color_type, const uint8_t (*plte)[3], size_t plte_cnt)
+{
+	unsigned int idx;
+	unsigned int byte;
+	unsigned int px;
+
+	if (color_type != 3 || (bit_depth != 1 && bit_depth != 2) || !width ||
+	    width % 8 || width > PNG_IMPORT_W_MAX || !height)
+		return false;
+
+	imp->height = height;
+	imp->bit_depth = bit_depth;
+	imp->row_len = (width * bit_depth) / 8;
+	imp->tiles_w = width / 8;
+	imp->tiles_h = (height + 7) / 8;
+
+	/* Indexes past the end of PLTE aren't valid, shade 0 is as good as any */
+	imp->remap = false;
+	for (idx = 0; idx < 4; idx++) {
+		imp->shade[idx] = 0;
+		if (idx < plte_cnt && idx < (1U << bit_depth))
+			imp->shade[idx] = png_import_shade_get(imp, plte[idx], idx);
+		if (imp->shade[idx] != idx)
+			imp->remap = true;
+	}
+
+	if (bit_depth == 2 && imp->remap) {
+		for (byte = 0; byte < 256; byte++) {
+			imp->lut[byte] = 0;
+			for (px = 0; px < 8; px += 2)
+				imp->lut[byte] |= imp->shade[(byte >> px) & 0x03] << px;
+		}
+	}
+
+	return true;
+}
+
+static bool png_import_band(struct png_import *imp)
+{
+	scanline_to_tile(imp->tiles, imp->scan, imp->tiles_w, 1);
+
+	return imp->cb(imp->cb_ctx, imp->tiles, imp->tiles_w, imp->tiles_h, imp->bands++);
+}
+
+/* Take one row of the PNG, unfiltered */
+static bool png_import_row(struct png_import *imp, const uint8_t *row)
+{
+	size_t scan_len = imp->tiles_w * 2;
+	uint8_t *dst = imp->scan + ((imp->rows % 8) * scan_len);
+	unsigned int px;
+	size_t i;
+
+	/* More rows than IHDR said there would be */
+	if (imp->rows == imp->height)
+		return false;
+
+	if (imp->bit_depth == 2) {
+		if (imp->remap) {
+			for (i = 0; i < scan_len; i++)
+				dst[i] = imp->lut[row[i]];
+		} else {
+			memcpy(dst, row, scan_len);
+		}
+	} else {
+		/* Each px of 1bpp, MSB first, becomes 2 bits of 2bpp */
+		for (i = 0; i < imp->row_len; i++) {
+			dst[i * 2] = 0;
+			dst[(i * 2) + 1] = 0;
+			for (px = 0; px < 8; px++)
+				dst[(i * 2) + (px / 4)] |= imp->shade[(row[i] >> (7 - px)) & 0x01] << (6 - ((px % 4) * 2));
+		}
+	}
+
+	imp->rows++;
+	if (!(imp->rows % 8))
+		return png_import_band(imp);
+
+	return true;
+}
+
+static bool png_import_row_cb(void *ctx, const uint8_t *row, size_t len)
+{
+	UNUSED(len);
+
+	return png_import_row(ctx, row);
+}
+
+/* Every row is in, pad out the last band if it is short */
+static bool png_import_end(struct png_import *imp)
+{
+	size_t rem = imp->rows % 8;
+
+	if (imp->rows != imp->height)
+		return false;
+	if (!rem)
+		return true;
+
+	memset(imp->scan + (rem * imp->tiles_w * 2), 0, (8 - rem) * imp->tiles_w * 2);
+	return png_import_band(imp);
+}
+
+/* The layout png_handle writes; IHDR, PLTE, an IDAT of only the zlib header,
+ * then IDATs of exactly one stored block each, the last of them an empty
+ * BFINAL block and the adler32. Rows are read straight out of the file.
+ * The adler32 isn't checked, that would cost as much as a stored inflate.
+ */
+static bool png_import_fast(struct png_import *imp)
+{
+	uint8_t buf[13];
+	uint8_t plte[4][3];
+	size_t plte_cnt = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint8_t bit_depth = 0;
+	uint8_t color_type = 0;
+	bool zlib = false;
+	bool last = false;
+	uint32_t len;
+	size_t left;
+	size_t cnt;
+
+	if (!png_import_read(imp, buf, sizeof(png_magic)) || memcmp(buf, png_magic, sizeof(png_magic)))
+		return false;
+
+	while (!last) {
+		if (!png_import_read(imp, buf, 8))
+			return false;
+		len = png_import_be32(buf);
+
+		if (!memcmp(buf + 4, "IHDR", 4)) {
+			if (len != 13 || !png_import_read(imp, buf, 13) || !png_import_skip(imp, 4))
+				return false;
+			/* Compression, filter, and interlace methods */
+			if (buf[10] || buf[11] || buf[12])
+				return false;
+			width = png_import_be32(buf);
+			height = png_import_be32(buf + 4);
+			bit_depth = buf[8];
+			color_type = buf[9];
+		} else if (!memcmp(buf + 4, "PLTE", 4)) {
+			if (zlib || len % 3 || len > sizeof(plte) || !png_import_read(imp, plte, len) ||
+			    !png_import_skip(imp, 4))
+				return false;
+			plte_cnt = len / 3;
+		} else if (memcmp(buf + 4, "IDAT", 4)) {
+			/* Ancillary chunks, e.g. acTL, don't change the image */
+			if (!(buf[4] & 0x20) || !png_import_skip(imp, len + 4))
+				return false;
+		} else if (!zlib) {
+			if (len != 2 || !png_import_read(imp, buf, 2) || !png_import_skip(imp, 4) ||
+			    (buf[0] & 0x0f) != 8 || (buf[1] & 0x20) || ((buf[0] << 8) | buf[1]) % 31)
+				return false;
+			if (!png_import_start(imp, width, height, bit_depth, color_type, plte, plte_cnt))
+				return false;
+			zlib = true;
+		} else {
+			if (len < 5 || !png_import_read(imp, buf, 5) || (buf[0] & ~0x01))
+				return false;
+			last = buf[0];
+			left = buf[1] | (buf[2] << 8);
+			if ((left ^ (buf[3] | (buf[4] << 8))) != 0xffff || len != 5 + left + (last ? 4 : 0))
+				return false;
+
+			while (left) {
+				cnt = (imp->row_len + 1) - imp->row_pos;
+				if (cnt > left)
+					cnt = left;
+				if (!png_import_read(imp, imp->row + imp->row_pos, cnt))
+					return false;
+				imp->row_pos += cnt;
+				left -= cnt;
+
+				if (imp->row_pos < (imp->row_len + 1))
+					continue;
+				/* Only rows that aren't filtered can go straight through */
+				if (imp->row[0] || !png_import_row(imp, imp->row + 1))
+					return false;
+				imp->row_pos = 0;
+			}
+
+			/* adler32 after the last block, and the chunk CRC */
+			if (!png_import_skip(imp, (last ? 4 : 0) + 4))
+				return false;
+		}
+	}
+
+	return (!imp->row_pos && png_import_end(imp));
+}
+
+bool png_import(void *png_import, File *file, const uint8_t *plte, png_import_cb cb, void *ctx)
+{
+	struct png_import *imp = png_import;
+	const struct png_info *info;
+
+	imp->file = file;
+	imp->plte = plte ? plte + 8 : NULL; // Past PLTE length and type
+	imp->cb = cb;
+	imp->cb_ctx = ctx;
+	imp->rows = 0;
+	imp->bands = 0;
+	imp->row_pos = 0;
+
+	if (storage_file_seek(file, 0, true) && png_import_fast(imp)) {
+		FURI_LOG_D("import", "%ux%lu stored", imp->tiles_w * 8, imp->height);
+		return true;
+	}
+
+	/* A band already passed on can't be taken back, so it is too late to
+	 * start the PNG over.
+	 */
+	if (imp->bands)
+		return false;
+	imp->rows = 0;
+
+	if (!imp->png_read)
+		imp->png_read = png_read_alloc(PNG_IMPORT_WINDOW);
+
+	if (!storage_file_seek(file, 0, true) || !png_read_head(imp->png_read, png_import_read_cb, file))
+		return false;
+	info = png_read_info_get(imp->png_read);
+	png_read_window_set(imp->png_read, info->window);
+	if (!png_import_start(imp, info->width, info->height, info->bit_depth, info->color_type,
+			      info->plte, info->plte_cnt))
+		return false;
+	if (!png_read_rows(imp->png_read, png_import_row_cb, imp) || !png_import_end(imp))
+		return false;
+
+	FURI_LOG_D("import", "%ux%lu inflated", imp->tiles_w * 8, imp->height);
+	return true;
+}
+
+void *png_import_alloc(void)
+{
+	struct png_import *imp = malloc(sizeof(struct png_import));
+
+	memset(imp, 0, sizeof(struct png_import));
+
+	return imp;
+}
+
+void png_import_free(void *png_import)
+{
+	struct png_import *imp = png_import;
+
+	if (imp->png_read)
+		png_read_free(imp->png_read);
+	free(imp);
+}
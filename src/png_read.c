@@ -0,0 +1,346 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/inflate.h>
+#include <src/include/png_read.h>
+
+/* Longest row, in bytes, that will be read. Far more than any print needs, but
+ * keeps a bad IHDR from asking for more memory than there is.
+ */
+#define PNG_ROW_MAX	4096
+
+struct png_read {
+	void *inflate;
+
+	/* Source, positioned in the middle of an IDAT chunk while reading rows */
+	png_read_cb read;
+	void *read_ctx;
+	uint32_t chunk_left; // Image data left in the current IDAT chunk
+	bool idat_end; // Ran in to a chunk that isn't IDAT
+	bool cmf_held; // cmf was read by png_read_head(), inflate still needs it
+	uint8_t cmf; // First byte of the zlib stream
+	size_t window; // Size of the inflate window
+
+	struct png_info info;
+	size_t row_len; // Bytes per row, not including the filter byte
+	size_t bpp; // Bytes per complete px, at least 1, as filters see it
+	size_t row_pos; // Bytes of the current row so far, with its filter byte
+	uint32_t rows; // Rows passed to row_cb so far
+
+	png_row_cb row_cb;
+	void *row_ctx;
+
+	uint8_t *row; // Filter byte, then the row
+	uint8_t *prev; // Row above, unfiltered
+};
+
+static const uint8_t png_magic[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+static uint32_t png_read_be32(const uint8_t *buf)
+{
+	return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3];
+}
+
+static bool png_read_full(struct png_read *pr, void *buf, size_t len)
+{
+	return (pr->read(pr->read_ctx, buf, len) == len);
+}
+
+static bool png_read_skip(struct png_read *pr, size_t len)
+{
+	uint8_t buf[32];
+	size_t cnt;
+
+	while (len) {
+		cnt = len < sizeof(buf) ? len : sizeof(buf);
+		if (!png_read_full(pr, buf, cnt))
+			return false;
+		len -= cnt;
+	}
+
+	return true;
+}
+
+/* Image data for inflate, chunk by chunk. Chunk CRCs aren't checked, adler32
+ * already covers the image data itself.
+ */
+static size_t png_read_idat(void *ctx, uint8_t *buf, size_t len)
+{
+	struct png_read *pr = ctx;
+	uint8_t head[8];
+	size_t cnt;
+
+	if (pr->cmf_held && len) {
+		pr->cmf_held = false;
+		buf[0] = pr->cmf;
+		return 1;
+	}
+
+	while (!pr->chunk_left) {
+		if (pr->idat_end)
+			return 0;
+
+		/* CRC of the last chunk, then the head of the next */
+		if (!png_read_skip(pr, 4) || !png_read_full(pr, head, sizeof(head)) ||
+		    memcmp(head + 4, "IDAT", 4)) {
+			pr->idat_end = true;
+			return 0;
+		}
+		pr->chunk_left = png_read_be32(head);
+	}
+
+	if (len > pr->chunk_left)
+		len = pr->chunk_left;
+	cnt = pr->read(pr->read_ctx, buf, len);
+	pr->chunk_left -= cnt;
+	if (!cnt)
+		pr->idat_end = true;
+
+	return cnt;
+}
+
+static int png_read_paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+
+	if (pa <= pb && pa <= pc)
+		return a;
+	if (pb <= pc)
+		return b;
+	return c;
+}
+
+static bool png_read_unfilter(struct png_read *pr)
+{
+	uint8_t *x = pr->row + 1;
+	const uint8_t *up = pr->prev;
+	size_t bpp = pr->bpp;
+	size_t i;
+
+	switch (pr->row[0]) {
+	case 0: // None
+		break;
+	case 1: // Sub
+		for (i = bpp; i < pr->row_len; i++)
+			x[i] += x[i - bpp];
+		break;
+	case 2: // Up
+		for (i = 0; i < pr->row_len; i++)
+			x[i] += up[i];
+		break;
+	case 3: // Average
+		for (i = 0; i < pr->row_len; i++)
+			x[i] += ((i >= bpp ? x[i - bpp] : 0) + up[i]) / 2;
+		break;
+	case 4: // Paeth
+		for (i = 0; i < pr->row_len; i++)
+			x[i] += png_read_paeth(i >= bpp ? x[i - bpp] : 0, up[i], i >= bpp ? up[i - bpp] : 0);
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/* Inflated data, put back together in to rows */
+static bool png_read_out(void *ctx, const uint8_t *buf, size_t len)
+{
+	struct png_read *pr = ctx;
+	size_t cnt;
+
+	while (len) {
+		cnt = (pr->row_len + 1) - pr->row_pos;
+		if (cnt > len)
+			cnt = len;
+		memcpy(pr->row + pr->row_pos, buf, cnt);
+		pr->row_pos += cnt;
+		buf += cnt;
+		len -= cnt;
+
+		if (pr->row_pos < (pr->row_len + 1))
+			break;
+
+		/* More rows than IHDR said there would be */
+		if (pr->rows == pr->info.height || !png_read_unfilter(pr))
+			return false;
+		if (!pr->row_cb(pr->row_ctx, pr->row + 1, pr->row_len))
+			return false;
+
+		memcpy(pr->prev, pr->row + 1, pr->row_len);
+		pr->rows++;
+		pr->row_pos = 0;
+	}
+
+	return true;
+}
+
+bool png_read_head(void *png_read, png_read_cb read, void *read_ctx)
+{
+	struct png_read *pr = png_read;
+	struct png_info *info = &pr->info;
+	uint8_t buf[13];
+	uint32_t len;
+	unsigned int channels;
+	uint64_t raw;
+	bool ihdr = false;
+
+	pr->read = read;
+	pr->read_ctx = read_ctx;
+	pr->idat_end = false;
+	pr->cmf_held = false;
+	memset(info, 0, sizeof(struct png_info));
+
+	if (!png_read_full(pr, buf, sizeof(png_magic)) || memcmp(buf, png_magic, sizeof(png_magic)))
+		return false;
+
+	while (1) {
+		if (!png_read_full(pr, buf, 8))
+			return false;
+		len = png_read_be32(buf);
+
+		if (!memcmp(buf + 4, "IHDR", 4)) {
+			if (ihdr || len != 13 || !png_read_full(pr, buf, 13) || !png_read_skip(pr, 4))
+				return false;
+			info->width = png_read_be32(buf);
+			info->height = png_read_be32(buf + 4);
+			info->bit_depth = buf[8];
+			info->color_type = buf[9];
+			/* Compression, filter, and interlace methods */
+			if (buf[10] || buf[11] || buf[12])
+				return false;
+			ihdr = true;
+		} else if (!memcmp(buf + 4, "PLTE", 4)) {
+			if (len % 3 || len > sizeof(info->plte) || !png_read_full(pr, info->plte, len) ||
+			    !png_read_skip(pr, 4))
+				return false;
+			info->plte_cnt = len / 3;
+		} else if (!memcmp(buf + 4, "IDAT", 4)) {
+			/* CINFO, the window size the stream was made with */
+			if (len && !png_read_full(pr, &pr->cmf, 1))
+				return false;
+			pr->cmf_held = !!len;
+			pr->chunk_left = len - pr->cmf_held;
+			break;
+		} else if (!(buf[4] & 0x20)) {
+			/* Any other critical chunk, e.g. IEND before any IDAT */
+			return false;
+		} else if (!png_read_skip(pr, len + 4)) {
+			return false;
+		}
+	}
+
+	if (!ihdr || !info->width || !info->height)
+		return false;
+
+	switch (info->color_type) {
+	case 0: // Grayscale
+	case 3: // Indexed
+		channels = 1;
+		break;
+	case 4: // Grayscale and alpha
+		channels = 2;
+		break;
+	case 2: // RGB
+		channels = 3;
+		break;
+	case 6: // RGB and alpha
+		channels = 4;
+		break;
+	default:
+		return false;
+	}
+	if (info->bit_depth != 1 && info->bit_depth != 2 && info->bit_depth != 4 &&
+	    info->bit_depth != 8 && info->bit_depth != 16)
+		return false;
+
+	if (info->width > ((PNG_ROW_MAX * 8) / (info->bit_depth * channels)))
+		return false;
+	pr->row_len = ((info->width * info->bit_depth * channels) + 7) / 8;
+	pr->bpp = (info->bit_depth * channels) / 8;
+	if (!pr->bpp)
+		pr->bpp = 1;
+
+	/* No match reaches back further than the window of the zlib header
+	 * says, nor past the start of the image data.
+	 */
+	info->window = PNG_WINDOW_MAX;
+	if (pr->cmf_held && (pr->cmf >> 4) <= 7)
+		info->window = 256 << (pr->cmf >> 4);
+	raw = (uint64_t)(pr->row_len + 1) * info->height;
+	while (info->window > 256 && (info->window / 2) >= raw)
+		info->window /= 2;
+
+	free(pr->row);
+	free(pr->prev);
+	pr->row = malloc(pr->row_len + 1);
+	pr->prev = malloc(pr->row_len);
+
+	return true;
+}
+
+const struct png_info *png_read_info_get(void *png_read)
+{
+	struct png_read *pr = png_read;
+
+	return &pr->info;
+}
+
+bool png_read_rows(void *png_read, png_row_cb row_cb, void *row_ctx)
+{
+	struct png_read *pr = png_read;
+
+	pr->row_cb = row_cb;
+	pr->row_ctx = row_ctx;
+	pr->row_pos = 0;
+	pr->rows = 0;
+	/* The row above the first is all 0 as far as filters go */
+	memset(pr->prev, 0, pr->row_len);
+
+	if (!inflate_zlib(pr->inflate, png_read_idat, pr, png_read_out, pr))
+		return false;
+
+	return (pr->rows == pr->info.height && !pr->row_pos);
+}
+
+void *png_read_alloc(size_t window)
+{
+	struct png_read *pr = malloc(sizeof(struct png_read));
+
+	memset(pr, 0, sizeof(struct png_read));
+	pr->inflate = inflate_alloc(window);
+	pr->window = window;
+
+	return pr;
+}
+
+void png_read_window_set(void *png_read, size_t window)
+{
+	struct png_read *pr = png_read;
+
+	if (window <= pr->window)
+		return;
+
+	inflate_free(pr->inflate);
+	pr->inflate = inflate_alloc(window);
+	pr->window = window;
+}
+
+void png_read_free(void *png_read)
+{
+	struct png_read *pr = png_read;
+
+	inflate_free(pr->inflate);
+	free(pr->row);
+	free(pr->prev);
+	free(pr);
+}
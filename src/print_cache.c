@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/print_cache.h>
+#include <src/include/tile_tools.h>
+
+struct print_cache {
+	/* Most recently used first, only the first cnt are valid */
+	struct print_cache_img *img[PRINT_CACHE_IMAGES];
+	size_t cnt;
+	struct print_cache_img *last; // Added last, may be extended, NULL if dropped
+	size_t len; // Bytes of image data held
+	size_t max_len;
+};
+
+static size_t print_cache_img_len(const struct print_cache_img *img)
+{
+	return (img->px_w / 4) * img->px_h;
+}
+
+static void print_cache_drop(struct print_cache *pc, size_t idx)
+{
+	struct print_cache_img *img = pc->img[idx];
+
+	pc->len -= print_cache_img_len(img);
+	if (img == pc->last)
+		pc->last = NULL;
+	free(img->data);
+	free(img);
+
+	pc->cnt--;
+	memmove(&pc->img[idx], &pc->img[idx + 1], (pc->cnt - idx) * sizeof(pc->img[0]));
+}
+
+/* Drop the least recently used images, other than keep, until len more bytes
+ * fit. keep itself must leave room for len.
+ */
+static void print_cache_room(struct print_cache *pc, size_t len, const struct print_cache_img *keep)
+{
+	size_t idx = pc->cnt;
+
+	while ((pc->len + len) > pc->max_len) {
+		idx--;
+		if (pc->img[idx] != keep)
+			print_cache_drop(pc, idx);
+	}
+}
+
+void *print_cache_alloc(size_t max_len)
+{
+	struct print_cache *pc = malloc(sizeof(struct print_cache));
+
+	memset(pc, 0, sizeof(struct print_cache));
+	pc->max_len = max_len;
+
+	return pc;
+}
+
+void print_cache_free(void *print_cache)
+{
+	struct print_cache *pc = print_cache;
+
+	while (pc->cnt)
+		print_cache_drop(pc, pc->cnt - 1);
+	free(pc);
+}
+
+bool print_cache_add(void *print_cache, const uint8_t *tiles, size_t tiles_w, size_t tiles_h, const uint8_t *lut, uint32_t count, bool same_image)
+{
+	struct print_cache *pc = print_cache;
+	struct print_cache_img *img = same_image ? pc->last : NULL;
+	size_t stride = tiles_w * 2;
+	size_t len = stride * tiles_h * 8;
+	size_t idx;
+
+	if (!tiles_h)
+		return false;
+
+	/* The start of a stacked image that was already dropped, the rest of
+	 * it can't be kept either.
+	 */
+	if (same_image && !img)
+		return false;
+
+	/* Too big to ever fit, no need to drop anything else for it */
+	if (((img ? print_cache_img_len(img) : 0) + len) > pc->max_len) {
+		for (idx = 0; img && pc->img[idx] != img; idx++);
+		if (img)
+			print_cache_drop(pc, idx);
+		return false;
+	}
+
+	if (!img) {
+		if (pc->cnt == PRINT_CACHE_IMAGES)
+			print_cache_drop(pc, pc->cnt - 1);
+
+		img = malloc(sizeof(struct print_cache_img));
+		img->count = count;
+		img->px_w = tiles_w * 8;
+		img->px_h = 0;
+		img->data = NULL;
+
+		memmove(&pc->img[1], &pc->img[0], pc->cnt * sizeof(pc->img[0]));
+		pc->img[0] = img;
+		pc->cnt++;
+		pc->last = img;
+	}
+
+	print_cache_room(pc, len, img);
+
+	img->data = realloc(img->data, print_cache_img_len(img) + len);
+	tile_to_scanline_copy(img->data + print_cache_img_len(img), stride, tiles, tiles_w, tiles_h, lut);
+	img->px_h += tiles_h * 8;
+	pc->len += len;
+
+	return true;
+}
+
+size_t print_cache_count_get(void *print_cache)
+{
+	struct print_cache *pc = print_cache;
+
+	return pc->cnt;
+}
+
+const struct print_cache_img *print_cache_get(void *print_cache, size_t idx)
+{
+	struct print_cache *pc = print_cache;
+
+	if (idx >= pc->cnt)
+		return NULL;
+
+	return pc->img[idx];
+}
+
+const struct print_cache_img *print_cache_last_get(void *print_cache)
+{
+	struct print_cache *pc = print_cache;
+
+	return pc->last;
+}
+
+void print_cache_touch(void *print_cache, size_t idx)
+{
+	struct print_cache *pc = print_cache;
+	struct print_cache_img *img;
+
+	if (idx >= pc->cnt)
+		return;
+
+	img = pc->img[idx];
+	memmove(&pc->img[1], &pc->img[0], idx * sizeof(pc->img[0]));
+	pc->img[0] = img;
+}
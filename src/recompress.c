@@ -0,0 +1,457 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/crc.h>
+#include <src/include/file_handling.h>
+#include <src/include/png.h>
+#include <src/include/png_read.h>
+#include <src/include/recompress.h>
+
+#define NAME_LEN	128
+
+#define RECOMP_STACK	(3 * 1024)
+
+/* Only files written by png.c are ever read, none of those match further
+ * back than the byte before.
+ */
+#define RECOMP_WINDOW	256
+
+/* Widest image png_stream is set up for */
+#define RECOMP_WIDTH_MAX	160
+
+/* Thread flags */
+#define RECOMP_RESUME	(1 << 0)
+#define RECOMP_STOP	(1 << 1)
+
+/* Every uncompressed PNG has an IDAT of only the zlib header right after PLTE,
+ * 14 bytes with its length, type, and CRC. The first byte of data of the next
+ * IDAT is the head of the first DEFLATE block, BTYPE of 0 is stored.
+ */
+#define RECOMP_ZLIB_OFFS	(PNG_PLTE_OFFS + PNG_PLTE_LEN)
+#define RECOMP_BTYPE_OFFS	(RECOMP_ZLIB_OFFS + 14 + 8)
+#define RECOMP_HEAD_LEN		(RECOMP_BTYPE_OFFS + 1)
+
+/* Part way through a rewrite, the original is kept as .bak until the new file
+ * has taken its place. .rz is the new file as it is being written.
+ */
+#define RECOMP_EXT_BAK	".bak"
+#define RECOMP_EXT_TMP	".rz"
+
+enum recomp_result {
+	RECOMP_DONE,
+	RECOMP_SKIP, // Already compressed, or not one of ours
+	RECOMP_ERROR,
+	RECOMP_PAUSED,
+};
+
+struct recompress {
+	FuriThread *thread;
+	FuriMutex *working; // Held by the thread for each step of the walk
+	volatile bool paused;
+	volatile bool skip_today;
+
+	Storage *storage;
+	File *dir;
+	File *in;
+	File *out;
+	bool dir_open;
+
+	FuriString *base_path; // App data folder, with the trailing /
+	FuriString *done; // Newest folder with nothing left to do, and all before it
+	FuriString *path;
+	FuriString *tmp_path;
+	FuriString *bak_path;
+	char today[FGP_FOLDER_LEN];
+	char *name;
+
+	/* Folders of the current walk, oldest first */
+	bool walking;
+	char (*folders)[FGP_FOLDER_LEN];
+	size_t folder_cnt;
+	size_t folder;
+	unsigned int folder_errors;
+	bool retry; // name was dropped by a pause, do it over
+
+	void *png_read;
+	void *png_stream;
+	uint8_t head[RECOMP_HEAD_LEN];
+	uint32_t crc; // Of every row read so far
+};
+
+static size_t recompress_read(void *ctx, void *buf, size_t len)
+{
+	return storage_file_read(ctx, buf, len);
+}
+
+static size_t recompress_write(void *ctx, const void *buf, size_t len)
+{
+	return storage_file_write(ctx, buf, len);
+}
+
+/* Rows of the original, straight to the new file */
+static bool recompress_row_write(void *ctx, const uint8_t *row, size_t len)
+{
+	struct recompress *rc = ctx;
+
+	if (rc->paused)
+		return false;
+
+	rc->crc = crc_update(rc->crc, row, len);
+	png_stream_row(rc->png_stream, row);
+
+	return true;
+}
+
+/* Rows of the new file, as read back */
+static bool recompress_row_check(void *ctx, const uint8_t *row, size_t len)
+{
+	struct recompress *rc = ctx;
+
+	if (rc->paused)
+		return false;
+
+	rc->crc = crc_update(rc->crc, row, len);
+
+	return true;
+}
+
+/* Only PNGs with their image data stored are worth the time */
+static bool recompress_head_check(struct recompress *rc)
+{
+	if (storage_file_read(rc->in, rc->head, RECOMP_HEAD_LEN) != RECOMP_HEAD_LEN)
+		return false;
+	if (png_head_check(rc->head) != PNG_PLTE_LEN)
+		return false;
+	if (memcmp(rc->head + RECOMP_ZLIB_OFFS, "\x00\x00\x00\x02IDAT", 8))
+		return false;
+
+	return !(rc->head[RECOMP_BTYPE_OFFS] & 0x06);
+}
+
+static enum recomp_result recompress_file(struct recompress *rc)
+{
+	const struct png_info *info;
+	uint32_t width;
+	uint32_t height;
+	uint32_t crc_orig;
+	uint64_t size_orig;
+	uint64_t size_new = 0;
+	bool ok = true;
+
+	furi_string_printf(rc->tmp_path, "%s%s", furi_string_get_cstr(rc->path), RECOMP_EXT_TMP);
+	furi_string_printf(rc->bak_path, "%s%s", furi_string_get_cstr(rc->path), RECOMP_EXT_BAK);
+
+	if (!storage_file_open(rc->in, furi_string_get_cstr(rc->path), FSAM_READ, FSOM_OPEN_EXISTING) ||
+	    !recompress_head_check(rc)) {
+		storage_file_close(rc->in);
+		return RECOMP_SKIP;
+	}
+	size_orig = storage_file_size(rc->in);
+
+	ok &= storage_file_seek(rc->in, 0, true);
+	ok &= png_read_head(rc->png_read, recompress_read, rc->in);
+	info = png_read_info_get(rc->png_read);
+	if (ok && (info->bit_depth != 2 || info->color_type != 3 || info->width > RECOMP_WIDTH_MAX)) {
+		storage_file_close(rc->in);
+		return RECOMP_SKIP;
+	}
+	width = info->width;
+	height = info->height;
+
+	if (!storage_file_open(rc->out, furi_string_get_cstr(rc->tmp_path), FSAM_WRITE, FSOM_CREATE_ALWAYS))
+		ok = false;
+
+	/* The PLTE chunk is carried over as is */
+	if (ok) {
+		png_stream_reset(rc->png_stream, width, 1);
+		png_stream_palette_set(rc->png_stream, rc->head + PNG_PLTE_OFFS);
+		png_stream_start(rc->png_stream, recompress_write, rc->out, false);
+
+		rc->crc = 0;
+		ok &= png_read_rows(rc->png_read, recompress_row_write, rc);
+	}
+	/* Paused part way, nothing more is written to a file that is dropped */
+	if (ok) {
+		ok &= png_stream_finish(rc->png_stream);
+		ok &= storage_file_seek(rc->out, 0, true);
+		ok &= (storage_file_write(rc->out,
+					  png_stream_buf_get(rc->png_stream, IHDR),
+					  png_stream_len_get(rc->png_stream, IHDR)) ==
+		       png_stream_len_get(rc->png_stream, IHDR));
+		size_new = storage_file_size(rc->out);
+	}
+	storage_file_close(rc->in);
+	ok &= storage_file_close(rc->out);
+	crc_orig = rc->crc;
+
+	/* Read the new file back in full, it only replaces the original if
+	 * every row comes out the same.
+	 */
+	if (ok) {
+		ok &= storage_file_open(rc->in, furi_string_get_cstr(rc->tmp_path), FSAM_READ, FSOM_OPEN_EXISTING);
+		ok &= png_read_head(rc->png_read, recompress_read, rc->in);
+		info = png_read_info_get(rc->png_read);
+		ok &= (info->width == width && info->height == height);
+
+		rc->crc = 0;
+		ok &= png_read_rows(rc->png_read, recompress_row_check, rc);
+		ok &= (rc->crc == crc_orig);
+		storage_file_close(rc->in);
+	}
+
+	if (!ok || size_new >= size_orig) {
+		storage_simply_remove(rc->storage, furi_string_get_cstr(rc->tmp_path));
+		if (rc->paused)
+			return RECOMP_PAUSED;
+		return ok ? RECOMP_SKIP : RECOMP_ERROR;
+	}
+
+	/* FAT can't rename over a file, so the original is moved aside first.
+	 * If that is as far as it gets, the next walk puts it back.
+	 */
+	if (storage_common_rename(rc->storage, furi_string_get_cstr(rc->path),
+				  furi_string_get_cstr(rc->bak_path)) != FSE_OK) {
+		storage_simply_remove(rc->storage, furi_string_get_cstr(rc->tmp_path));
+		return RECOMP_ERROR;
+	}
+	if (storage_common_rename(rc->storage, furi_string_get_cstr(rc->tmp_path),
+				  furi_string_get_cstr(rc->path)) != FSE_OK) {
+		storage_common_rename(rc->storage, furi_string_get_cstr(rc->bak_path),
+				      furi_string_get_cstr(rc->path));
+		storage_simply_remove(rc->storage, furi_string_get_cstr(rc->tmp_path));
+		return RECOMP_ERROR;
+	}
+	storage_simply_remove(rc->storage, furi_string_get_cstr(rc->bak_path));
+
+	FURI_LOG_I("recomp", "%s: %lu to %lu bytes", rc->name, (uint32_t)size_orig, (uint32_t)size_new);
+
+	return RECOMP_DONE;
+}
+
+static bool recompress_ext(const char *name, const char *ext)
+{
+	size_t len = strlen(name);
+	size_t ext_len = strlen(ext);
+
+	return (len > ext_len && !strcmp(name + len - ext_len, ext));
+}
+
+/* Whatever an earlier run left behind when it was stopped part way */
+static void recompress_cleanup(struct recompress *rc)
+{
+	if (recompress_ext(rc->name, ".png" RECOMP_EXT_TMP)) {
+		storage_simply_remove(rc->storage, furi_string_get_cstr(rc->path));
+	} else if (recompress_ext(rc->name, ".png" RECOMP_EXT_BAK)) {
+		furi_string_set(rc->bak_path, rc->path);
+		furi_string_left(rc->path, furi_string_size(rc->path) - strlen(RECOMP_EXT_BAK));
+		if (storage_file_exists(rc->storage, furi_string_get_cstr(rc->path))) {
+			storage_simply_remove(rc->storage, furi_string_get_cstr(rc->bak_path));
+		} else {
+			storage_common_rename(rc->storage, furi_string_get_cstr(rc->bak_path),
+					      furi_string_get_cstr(rc->path));
+			/* May already be past it in the listing, the folder is
+			 * gone through again on the next walk.
+			 */
+			rc->folder_errors++;
+		}
+	}
+}
+
+static void recompress_walk_end(struct recompress *rc)
+{
+	if (rc->dir_open)
+		storage_dir_close(rc->dir);
+	rc->dir_open = false;
+	rc->walking = false;
+	rc->retry = false;
+}
+
+/* Do the next step of the walk, one file or one folder. Returns false once
+ * the walk is over.
+ */
+static bool recompress_next(struct recompress *rc)
+{
+	const char *folder;
+	FileInfo info;
+
+	if (!rc->walking) {
+		fgp_storage_today_get(rc->today);
+		free(rc->folders);
+		rc->folder_cnt = fgp_storage_folders_get(rc->storage, furi_string_get_cstr(rc->base_path),
+							 furi_string_get_cstr(rc->done), &rc->folders);
+		rc->folder = 0;
+		rc->walking = true;
+	}
+
+	if (rc->folder == rc->folder_cnt) {
+		recompress_walk_end(rc);
+		return false;
+	}
+	folder = rc->folders[rc->folder];
+
+	/* Today is always the last folder */
+	if (rc->skip_today && !strcmp(folder, rc->today)) {
+		recompress_walk_end(rc);
+		return false;
+	}
+
+	if (!rc->dir_open) {
+		furi_string_printf(rc->path, "%s%s", furi_string_get_cstr(rc->base_path), folder);
+		rc->dir_open = storage_dir_open(rc->dir, furi_string_get_cstr(rc->path));
+		rc->folder_errors = 0;
+		if (!rc->dir_open) {
+			storage_dir_close(rc->dir);
+			rc->folder++;
+		}
+		return true;
+	}
+
+	if (!rc->retry) {
+		if (!storage_dir_read(rc->dir, &info, rc->name, NAME_LEN)) {
+			storage_dir_close(rc->dir);
+			rc->dir_open = false;
+			if (!rc->folder_errors && strcmp(folder, rc->today) < 0)
+				furi_string_set(rc->done, folder);
+			rc->folder++;
+			return true;
+		}
+		if (file_info_is_dir(&info))
+			return true;
+	}
+	rc->retry = false;
+
+	furi_string_printf(rc->path, "%s%s/%s", furi_string_get_cstr(rc->base_path), folder, rc->name);
+
+	/* Files renamed in to place can come up again later in the listing,
+	 * they are skipped as already compressed.
+	 */
+	if (recompress_ext(rc->name, ".png")) {
+		switch (recompress_file(rc)) {
+		case RECOMP_PAUSED:
+			rc->retry = true;
+			break;
+		case RECOMP_ERROR:
+			FURI_LOG_E("recomp", "failed on %s", rc->name);
+			rc->folder_errors++;
+			break;
+		default:
+			break;
+		}
+	} else {
+		recompress_cleanup(rc);
+	}
+
+	return true;
+}
+
+static int32_t recompress_thread(void *context)
+{
+	struct recompress *rc = context;
+	uint32_t flags;
+	bool more;
+
+	while (1) {
+		flags = furi_thread_flags_wait(RECOMP_RESUME | RECOMP_STOP, FuriFlagWaitAny, FuriWaitForever);
+		if (flags & FuriFlagError)
+			continue;
+		if (flags & RECOMP_STOP)
+			break;
+
+		/* A pause waits on the mutex, so it only returns between
+		 * steps, never with a file still open.
+		 */
+		while (!rc->paused) {
+			furi_mutex_acquire(rc->working, FuriWaitForever);
+			more = !rc->paused && recompress_next(rc);
+			furi_mutex_release(rc->working);
+			if (!more)
+				break;
+		}
+	}
+
+	recompress_walk_end(rc);
+
+	return 0;
+}
+
+void recompress_resume(void *recompress, bool skip_today)
+{
+	struct recompress *rc = recompress;
+
+	rc->skip_today = skip_today;
+	rc->paused = false;
+	furi_thread_flags_set(furi_thread_get_id(rc->thread), RECOMP_RESUME);
+}
+
+void recompress_pause(void *recompress)
+{
+	struct recompress *rc = recompress;
+
+	/* The thread drops the file it is on at the next row, then lets go */
+	rc->paused = true;
+	furi_mutex_acquire(rc->working, FuriWaitForever);
+	furi_mutex_release(rc->working);
+}
+
+void *recompress_alloc(void)
+{
+	struct recompress *rc = malloc(sizeof(struct recompress));
+
+	memset(rc, 0, sizeof(struct recompress));
+	rc->paused = true;
+	rc->working = furi_mutex_alloc(FuriMutexTypeNormal);
+
+	rc->storage = furi_record_open(RECORD_STORAGE);
+	rc->dir = storage_file_alloc(rc->storage);
+	rc->in = storage_file_alloc(rc->storage);
+	rc->out = storage_file_alloc(rc->storage);
+	rc->base_path = furi_string_alloc_set(APP_DATA_PATH(""));
+	rc->done = furi_string_alloc();
+	rc->path = furi_string_alloc();
+	rc->tmp_path = furi_string_alloc();
+	rc->bak_path = furi_string_alloc();
+	rc->name = malloc(NAME_LEN);
+	rc->png_read = png_read_alloc(RECOMP_WINDOW);
+	rc->png_stream = png_stream_alloc(RECOMP_WIDTH_MAX);
+
+	storage_common_resolve_path_and_ensure_app_directory(rc->storage, rc->base_path);
+
+	rc->thread = furi_thread_alloc_ex("FgpRecompress", RECOMP_STACK, recompress_thread, rc);
+	furi_thread_set_priority(rc->thread, FuriThreadPriorityLowest);
+	furi_thread_start(rc->thread);
+
+	return rc;
+}
+
+void recompress_free(void *recompress)
+{
+	struct recompress *rc = recompress;
+
+	rc->paused = true;
+	furi_thread_flags_set(furi_thread_get_id(rc->thread), RECOMP_STOP);
+	furi_thread_join(rc->thread);
+	furi_thread_free(rc->thread);
+	furi_mutex_free(rc->working);
+
+	free(rc->folders);
+	png_stream_free(rc->png_stream);
+	png_read_free(rc->png_read);
+	free(rc->name);
+	furi_string_free(rc->bak_path);
+	furi_string_free(rc->tmp_path);
+	furi_string_free(rc->path);
+	furi_string_free(rc->done);
+	furi_string_free(rc->base_path);
+	storage_file_free(rc->out);
+	storage_file_free(rc->in);
+	storage_file_free(rc->dir);
+	furi_record_close(RECORD_STORAGE);
+
+	free(rc);
+}
@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <src/include/fgp_palette.h>
+#include <src/include/png.h>
+#include <src/include/repalette.h>
+#include <src/include/thumb.h>
+
+#define NAME_LEN	128
+
+/* Work out the new name of a PNG, saved as one of:
+ *   <name>-<shortname>.png
+ *   <name>-<shortname>-<N>x.png
+ * by swapping out <shortname> for that of palette idx. Returns false if name
+ * doesn't follow the pattern, or is already in palette idx. Otherwise, old_idx
+ * is set to the palette the file is in now.
+ */
+static bool repalette_name(FuriString *new_name, const char *name, unsigned int idx, int *old_idx)
+{
+	const char *end = name + strlen(name);
+	const char *tail;
+	const char *dash;
+	char shortname[16];
+	int cur;
+
+	if ((end - name) < 4 || strcmp(end - 4, ".png"))
+		return false;
+	end -= 4;
+
+	/* Scaled PNGs have a -<N>x after the palette */
+	if ((end - name) >= 3 && end[-3] == '-' && end[-2] >= '1' && end[-2] <= '9' && end[-1] == 'x')
+		end -= 3;
+	tail = end;
+
+	for (dash = end - 1; dash > name && *dash != '-'; dash--);
+	if (*dash != '-' || (size_t)(end - dash - 1) >= sizeof(shortname))
+		return false;
+
+	memcpy(shortname, dash + 1, end - dash - 1);
+	shortname[end - dash - 1] = '\0';
+	cur = palette_idx_get(shortname);
+	if (cur < 0 || cur == (int)idx)
+		return false;
+	*old_idx = cur;
+
+	furi_string_set(new_name, name);
+	furi_string_left(new_name, dash + 1 - name);
+	furi_string_cat_printf(new_name, "%s%s", palette_shortname_get(idx), tail);
+
+	return true;
+}
+
+/* Build the PLTE, plte_len bytes, in new palette idx from the colors, rgb, of
+ * the PLTE of the same length in palette old_idx. The shade of each color in
+ * the old palette gets the color of that shade in the new one, so a 1bpp PLTE
+ * keeps its 2 shades, and a 2bpp PLTE in the order of a palette byte keeps
+ * that order. False if the colors aren't in the old palette.
+ */
+static bool repalette_plte(uint8_t *plte, size_t plte_len, const uint8_t *rgb, int old_idx, unsigned int idx)
+{
+	const uint8_t (*old_rgb)[3] = palette_rgb16_get(old_idx);
+	uint8_t shades[4];
+	uint8_t order = 0;
+	unsigned int cnt = (plte_len == PNG_PLTE_SMALL_LEN) ? 2 : 4;
+	unsigned int i;
+
+	for (i = 0; i < cnt; i++) {
+		/* Shade n at index n, even if a palette has a color twice */
+		shades[i] = i;
+		if (cnt == 4 && !memcmp(old_rgb[i], rgb + (i * 3), 3))
+			continue;
+		for (shades[i] = 0; shades[i] < 4; shades[i]++) {
+			if (!memcmp(old_rgb[shades[i]], rgb + (i * 3), 3))
+				break;
+		}
+		if (shades[i] == 4)
+			return false;
+	}
+
+	if (cnt == 2) {
+		png_plte_small_build(plte, palette_plte_get(idx), shades);
+		return true;
+	}
+
+	for (i = 0; i < 4; i++)
+		order |= shades[i] << (i * 2);
+	png_plte_order_build(plte, palette_plte_get(idx), order);
+
+	return true;
+}
+
+/* Point each record of the thumbnail index of the folder at path at the new
+ * name of its PNG. Only a record whose PNG is now under the new name, and no
+ * longer under the old, is rewritten, along with the palette it is in.
+ */
+static bool repalette_thumbs(Storage *storage, File *file, const char *path, unsigned int idx)
+{
+	const char *folder = strrchr(path, '/');
+	struct thumb_rec *rec = malloc(sizeof(struct thumb_rec));
+	FuriString *name_path = furi_string_alloc();
+	FuriString *new_ext = furi_string_alloc();
+	size_t head_len = offsetof(struct thumb_rec, data);
+	size_t recs;
+	size_t i;
+	int old_idx;
+	bool error = false;
+
+	folder = folder ? folder + 1 : path;
+
+	furi_string_printf(name_path, "%s/%s", path, THUMB_FILE);
+	if (!storage_file_open(file, furi_string_get_cstr(name_path), FSAM_READ_WRITE, FSOM_OPEN_EXISTING))
+		goto out;
+
+	recs = storage_file_size(file) / sizeof(struct thumb_rec);
+	for (i = 0; i < recs && !error; i++) {
+		error |= !storage_file_seek(file, i * sizeof(struct thumb_rec), true);
+		error |= (storage_file_read(file, rec, head_len) != head_len);
+		if (error)
+			break;
+		rec->ext[THUMB_EXT_LEN - 1] = '\0';
+
+		if (!repalette_name(new_ext, rec->ext, idx, &old_idx) ||
+		    furi_string_size(new_ext) >= THUMB_EXT_LEN)
+			continue;
+
+		furi_string_printf(name_path, "%s/GCIM_%s_%04u%s", path, folder, rec->count,
+				   furi_string_get_cstr(new_ext));
+		if (!storage_file_exists(storage, furi_string_get_cstr(name_path)))
+			continue;
+		furi_string_printf(name_path, "%s/GCIM_%s_%04u%s", path, folder, rec->count, rec->ext);
+		if (storage_file_exists(storage, furi_string_get_cstr(name_path)))
+			continue;
+
+		rec->palette = idx;
+		memset(rec->ext, 0, sizeof(rec->ext));
+		memcpy(rec->ext, furi_string_get_cstr(new_ext), furi_string_size(new_ext));
+		error |= !storage_file_seek(file, i * sizeof(struct thumb_rec), true);
+		error |= (storage_file_write(file, rec, head_len) != head_len);
+	}
+	error |= !storage_file_close(file);
+
+out:
+	furi_string_free(new_ext);
+	furi_string_free(name_path);
+	free(rec);
+
+	return !error;
+}
+
+void repalette_folder(const char *path, unsigned int idx, struct repalette_stats *stats)
+{
+	Storage *storage = furi_record_open(RECORD_STORAGE);
+	File *dir = storage_file_alloc(storage);
+	File *file = storage_file_alloc(storage);
+	FuriString *old_path = furi_string_alloc();
+	FuriString *new_path = furi_string_alloc();
+	FuriString *new_name = furi_string_alloc();
+	FileInfo info;
+	uint8_t *head = malloc(PNG_HEAD_LEN + 12);
+	uint8_t plte[PNG_PLTE_LEN];
+	char *name = malloc(NAME_LEN);
+	size_t plte_len;
+	int old_idx;
+	bool error;
+
+	memset(stats, 0, sizeof(struct repalette_stats));
+
+	if (!storage_dir_open(dir, path)) {
+		FURI_LOG_E("repal", "failed to open %s", path);
+		stats->errors++;
+		goto out;
+	}
+
+	while (storage_dir_read(dir, &info, name, NAME_LEN)) {
+		if (file_info_is_dir(&info))
+			continue;
+
+		/* Files already renamed to the new palette can show up again
+		 * later in the listing, those are skipped here too.
+		 */
+		if (!repalette_name(new_name, name, idx, &old_idx)) {
+			stats->skipped++;
+			continue;
+		}
+
+		furi_string_printf(old_path, "%s/%s", path, name);
+		furi_string_printf(new_path, "%s/%s", path, furi_string_get_cstr(new_name));
+
+		/* Don't clobber a file already saved in the new palette */
+		if (storage_file_exists(storage, furi_string_get_cstr(new_path))) {
+			stats->skipped++;
+			continue;
+		}
+
+		if (!storage_file_open(file, furi_string_get_cstr(old_path), FSAM_READ_WRITE, FSOM_OPEN_EXISTING)) {
+			stats->errors++;
+			continue;
+		}
+
+		/* 1bpp PNGs only have the 2 shades used in PLTE, and a 2bpp
+		 * PNG can have its shades in any order. Find which shades
+		 * those are in the old palette to pick the same ones from the
+		 * new palette. Every PNG of ours is longer than a whole PLTE.
+		 */
+		plte_len = 0;
+		if (storage_file_read(file, head, PNG_HEAD_LEN + 12) == (PNG_HEAD_LEN + 12))
+			plte_len = png_head_check(head);
+		if (plte_len && !repalette_plte(plte, plte_len, head + PNG_HEAD_LEN, old_idx, idx))
+			plte_len = 0;
+
+		if (!plte_len) {
+			storage_file_close(file);
+			stats->skipped++;
+			continue;
+		}
+
+		error = false;
+		error |= !storage_file_seek(file, PNG_PLTE_OFFS, true);
+		error |= (storage_file_write(file, plte, plte_len) != plte_len);
+		error |= !storage_file_close(file);
+		if (!error)
+			error |= (storage_common_rename(storage,
+							furi_string_get_cstr(old_path),
+							furi_string_get_cstr(new_path)) != FSE_OK);
+
+		if (error)
+			stats->errors++;
+		else
+			stats->done++;
+	}
+
+	storage_dir_close(dir);
+
+	/* The Gallery shows the name and palette from the thumbnail index */
+	if (stats->done && !repalette_thumbs(storage, file, path, idx)) {
+		FURI_LOG_E("repal", "%s: thumbnails not updated", path);
+		stats->errors++;
+	}
+
+out:
+	FURI_LOG_I("repal", "%s: %u done, %u skipped, %u errors",
+		   path, stats->done, stats->skipped, stats->errors);
+
+	free(name);
+	free(head);
+	furi_string_free(new_name);
+	furi_string_free(new_path);
+	furi_string_free(old_path);
+	storage_file_free(file);
+	storage_file_free(dir);
+	furi_record_close(RECORD_STORAGE);
+}
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <src/include/convert.h>
+#include <src/include/rle.h>
+
+/* A run only pays off from 3 bytes on. A run of 2 is the same size as the 2
+ * bytes as part of a literal, and would split the literal up.
+ */
+#define RLE_RUN_USE	3
+
+size_t rle_encode(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	const uint8_t *end = src + len;
+	const uint8_t *lit = src; // Start of the literal not yet written
+	uint8_t *out = dst;
+	size_t run;
+
+	while (src < end) {
+		for (run = 1; (src + run) < end && run < RLE_RUN_MAX && src[run] == *src; run++)
+			;
+
+		if (run < RLE_RUN_USE && (src + run) < end) {
+			src += run;
+			continue;
+		}
+		if (run < RLE_RUN_USE)
+			src += run;
+
+		/* Everything before the run, or up to the end, is literal */
+		while (lit < src) {
+			len = src - lit;
+			if (len > RLE_LIT_MAX)
+				len = RLE_LIT_MAX;
+			*out++ = len - 1;
+			memcpy(out, lit, len);
+			out += len;
+			lit += len;
+		}
+
+		if (run >= RLE_RUN_USE) {
+			*out++ = RLE_RUN | (run - RLE_RUN_MIN);
+			*out++ = *src;
+			src += run;
+			lit = src;
+		}
+	}
+
+	return out - dst;
+}
+
+size_t rle_rows_encode(uint8_t *dst, const uint8_t *src, size_t row_sz, size_t rows)
+{
+	uint8_t *out = dst;
+	uint16_t len;
+	size_t row;
+
+	for (row = 0; row < rows; row++, src += row_sz) {
+		len = rle_encode(out + sizeof(len), src, row_sz);
+		if (len >= row_sz) {
+			memcpy(out + sizeof(len), src, row_sz);
+			len = row_sz | CAPTURE_ROW_RAW;
+		}
+		memcpy(out, &len, sizeof(len));
+		out += sizeof(len) + (len & ~CAPTURE_ROW_RAW);
+	}
+
+	return out - dst;
+}
+
+bool rle_decode(uint8_t *dst, size_t len, const uint8_t *src, size_t src_len)
+{
+	const uint8_t *end = src + src_len;
+	uint8_t *dst_end = dst + len;
+	size_t cnt;
+	uint8_t ctrl;
+
+	while (src < end) {
+		ctrl = *src++;
+		if (ctrl & RLE_RUN) {
+			cnt = (ctrl & ~RLE_RUN) + RLE_RUN_MIN;
+			if (src == end || cnt > (size_t)(dst_end - dst))
+				return false;
+			memset(dst, *src++, cnt);
+		} else {
+			cnt = ctrl + 1;
+			if (cnt > (size_t)(end - src) || cnt > (size_t)(dst_end - dst))
+				return false;
+			memcpy(dst, src, cnt);
+			src += cnt;
+		}
+		dst += cnt;
+	}
+
+	return (dst == dst_end);
+}
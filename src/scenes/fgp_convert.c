@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <gui/modules/variable_item_list.h>
+#include <dialogs/dialogs.h>
+#include <src/include/fgp_app.h>
+#include <src/scenes/include/fgp_scene.h>
+
+#include <src/include/fgp_palette.h>
+#include <src/include/convert.h>
+
+/* Captures converted per event. Between batches, the GUI gets to redraw and
+ * Back gets a chance to stop the run.
+ */
+#define CONVERT_BATCH	4
+
+enum convert_events {
+	CONVERT_START,
+	CONVERT_NEXT,
+};
+
+static const char * const list_text[] = {
+	"Palette:",
+	"Convert Pending",
+};
+
+static void set_palette(VariableItem* item)
+{
+	struct fgp_app * fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, palette_name_get(index));
+	fgp->convert_idx = index;
+}
+
+static void enter_callback(void* context, uint32_t index)
+{
+	struct fgp_app *fgp = context;
+
+	if (index == COUNT_OF(list_text) - 1)
+		view_dispatcher_send_custom_event(fgp->view_dispatcher, CONVERT_START);
+}
+
+/* Show how the run went and end it */
+static void fgp_scene_convert_done(struct fgp_app *fgp)
+{
+	DialogsApp *dialogs = furi_record_open(RECORD_DIALOGS);
+	DialogMessage *message;
+	struct convert_stats stats;
+	FuriString *fs_tmp;
+
+	convert_stats_get(fgp->convert, &stats);
+	convert_free(fgp->convert);
+	fgp->convert = NULL;
+
+	fs_tmp = furi_string_alloc_printf("Converted: %u\nErrors: %u", stats.done, stats.errors);
+	message = dialog_message_alloc();
+	dialog_message_set_header(message, "Convert Pending", 64, 2, AlignCenter, AlignTop);
+	dialog_message_set_text(message, furi_string_get_cstr(fs_tmp), 64, 32, AlignCenter, AlignCenter);
+	dialog_message_set_buttons(message, NULL, "OK", NULL);
+	dialog_message_show(dialogs, message);
+	dialog_message_free(message);
+
+	variable_item_set_current_value_text(variable_item_list_get(fgp->variable_item_list, 1), "");
+
+	furi_string_free(fs_tmp);
+	furi_record_close(RECORD_DIALOGS);
+}
+
+/* Convert one batch, and queue up the next if there are captures left */
+static void fgp_scene_convert_next(struct fgp_app *fgp)
+{
+	struct convert_stats stats;
+	char string[16];
+	bool more;
+
+	/* Stopped with Back while this event was queued */
+	if (!fgp->convert)
+		return;
+
+	more = convert_batch(fgp->convert, CONVERT_BATCH);
+
+	convert_stats_get(fgp->convert, &stats);
+	snprintf(string, sizeof(string), "%u done", stats.done);
+	variable_item_set_current_value_text(variable_item_list_get(fgp->variable_item_list, 1), string);
+
+	if (more)
+		view_dispatcher_send_custom_event(fgp->view_dispatcher, CONVERT_NEXT);
+	else
+		fgp_scene_convert_done(fgp);
+}
+
+void fgp_scene_convert_on_enter(void* context)
+{
+	struct fgp_app *fgp = context;
+	VariableItem *item;
+
+	variable_item_list_reset(fgp->variable_item_list);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[0],
+				      palette_count_get(),
+				      set_palette,
+				      fgp);
+	variable_item_set_current_value_index(item, fgp->convert_idx);
+	variable_item_set_current_value_text(item, palette_name_get(fgp->convert_idx));
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[1],
+				      0,
+				      NULL,
+				      fgp);
+
+	variable_item_list_set_enter_callback(fgp->variable_item_list,
+					      enter_callback,
+					      fgp);
+
+	view_dispatcher_switch_to_view(fgp->view_dispatcher, fgpViewVariableItemList);
+}
+
+bool fgp_scene_convert_on_event(void* context, SceneManagerEvent event)
+{
+	struct fgp_app *fgp = context;
+	bool consumed = false;
+
+	if (event.type == SceneManagerEventTypeCustom) {
+		if (event.event == CONVERT_START && !fgp->convert) {
+			fgp->convert = convert_alloc(fgp->convert_idx);
+			fgp_scene_convert_next(fgp);
+		} else if (event.event == CONVERT_NEXT) {
+			fgp_scene_convert_next(fgp);
+		}
+		consumed = true;
+	} else if (event.type == SceneManagerEventTypeBack && fgp->convert) {
+		/* Stop after the batch in progress, the state file lets the
+		 * next run carry on from there. The scene is only left on the
+		 * next Back, once no more batches are queued to it.
+		 */
+		fgp_scene_convert_done(fgp);
+		consumed = true;
+	}
+	return consumed;
+}
+
+void fgp_scene_convert_on_exit(void* context)
+{
+	struct fgp_app *fgp = context;
+
+	if (fgp->convert) {
+		convert_free(fgp->convert);
+		fgp->convert = NULL;
+	}
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <gui/modules/submenu.h>
+#include <dialogs/dialogs.h>
+#include <storage/storage.h>
+#include <src/include/fgp_app.h>
+#include <src/scenes/include/fgp_scene.h>
+
+#include <src/include/file_handling.h>
+#include <src/include/zip_export.h>
+
+static void folder_callback(void* context, uint32_t index)
+{
+	struct fgp_app *fgp = context;
+
+	view_dispatcher_send_custom_event(fgp->view_dispatcher, index);
+}
+
+/* Dated folders, oldest first, must be free()d */
+static size_t fgp_scene_export_folders_get(char (**folders)[FGP_FOLDER_LEN])
+{
+	Storage *storage = furi_record_open(RECORD_STORAGE);
+	FuriString *path = furi_string_alloc_set(APP_DATA_PATH(""));
+	size_t cnt;
+
+	storage_common_resolve_path_and_ensure_app_directory(storage, path);
+	cnt = fgp_storage_folders_get(storage, furi_string_get_cstr(path), "", folders);
+
+	furi_string_free(path);
+	furi_record_close(RECORD_STORAGE);
+
+	return cnt;
+}
+
+/* Bundle the folder and show how it went */
+static void fgp_scene_export_run(const char *folder)
+{
+	DialogsApp *dialogs = furi_record_open(RECORD_DIALOGS);
+	DialogMessage *message;
+	FuriString *text = furi_string_alloc();
+	struct zip_stats stats;
+
+	if (zip_export_day(folder, &stats))
+		furi_string_printf(text, "%s.zip\nFiles: %u\nSize: %lu KiB\nErrors: %u",
+				   folder, stats.files, (stats.bytes + 1023) / 1024, stats.errors);
+	else
+		furi_string_printf(text, "%s.zip\nFailed to write", folder);
+
+	message = dialog_message_alloc();
+	dialog_message_set_header(message, "Export Day", 64, 2, AlignCenter, AlignTop);
+	dialog_message_set_text(message, furi_string_get_cstr(text), 64, 36, AlignCenter, AlignCenter);
+	dialog_message_set_buttons(message, NULL, "OK", NULL);
+	dialog_message_show(dialogs, message);
+	dialog_message_free(message);
+
+	furi_string_free(text);
+	furi_record_close(RECORD_DIALOGS);
+}
+
+void fgp_scene_export_on_enter(void* context)
+{
+	struct fgp_app *fgp = context;
+	char (*folders)[FGP_FOLDER_LEN];
+	size_t cnt;
+	size_t idx;
+
+	submenu_reset(fgp->submenu);
+	submenu_set_header(fgp->submenu, "Export Day");
+
+	/* Newest folder at the top */
+	cnt = fgp_scene_export_folders_get(&folders);
+	for (idx = 0; idx < cnt; idx++)
+		submenu_add_item(fgp->submenu, folders[cnt - 1 - idx], idx, folder_callback, fgp);
+	free(folders);
+
+	view_dispatcher_switch_to_view(fgp->view_dispatcher, fgpViewSubmenu);
+}
+
+bool fgp_scene_export_on_event(void* context, SceneManagerEvent event)
+{
+	struct fgp_app *fgp = context;
+	char (*folders)[FGP_FOLDER_LEN];
+	size_t cnt;
+	bool consumed = false;
+
+	if (event.type == SceneManagerEventTypeCustom) {
+		/* Listed again, nothing else adds folders while in here */
+		cnt = fgp_scene_export_folders_get(&folders);
+		if (event.event < cnt)
+			fgp_scene_export_run(folders[cnt - 1 - event.event]);
+		free(folders);
+		submenu_set_selected_item(fgp->submenu, event.event);
+		consumed = true;
+	}
+
+	return consumed;
+}
+
+void fgp_scene_export_on_exit(void* context) {
+	struct fgp_app *fgp = context;
+
+	submenu_reset(fgp->submenu);
+}
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <gui/modules/submenu.h>
+#include <src/include/fgp_app.h>
+#include <src/scenes/include/fgp_scene.h>
+#include <src/views/include/gallery_view.h>
+
+#include <src/include/thumb_build.h>
+
+/* Thumbnails rebuilt per event. Between batches, the GUI gets to redraw and
+ * Back gets a chance to stop the rebuild.
+ */
+#define GALLERY_BUILD_BATCH	4
+
+/* Folders picked are sent as their index, this is past any of them */
+#define GALLERY_BUILD_NEXT	(1 << 16)
+
+/* Scene state, which view is up */
+enum gallery_state {
+	GALLERY_FOLDERS,
+	GALLERY_IMAGES,
+};
+
+static void folder_callback(void* context, uint32_t index)
+{
+	struct fgp_app *fgp = context;
+
+	view_dispatcher_send_custom_event(fgp->view_dispatcher, index);
+}
+
+static void fgp_scene_gallery_show(struct fgp_app *fgp)
+{
+	scene_manager_set_scene_state(fgp->scene_manager, fgpSceneGallery, GALLERY_IMAGES);
+	view_dispatcher_switch_to_view(fgp->view_dispatcher, fgpViewGallery);
+}
+
+/* Stop the rebuild, the index is only kept if it got through every image */
+static void fgp_scene_gallery_build_done(struct fgp_app *fgp)
+{
+	thumb_build_free(fgp->thumb_build);
+	fgp->thumb_build = NULL;
+	submenu_set_header(fgp->submenu, "Gallery");
+}
+
+/* Rebuild one batch, and queue up the next, or show the folder once done */
+static void fgp_scene_gallery_build_next(struct fgp_app *fgp)
+{
+	struct thumb_build_stats stats;
+	char string[32];
+	bool more;
+
+	/* Stopped with Back while this event was queued */
+	if (!fgp->thumb_build)
+		return;
+
+	more = thumb_build_next(fgp->thumb_build, GALLERY_BUILD_BATCH);
+
+	thumb_build_stats_get(fgp->thumb_build, &stats);
+	snprintf(string, sizeof(string), "Thumbnails %u/%u", stats.done + stats.errors, stats.total);
+	submenu_set_header(fgp->submenu, string);
+
+	if (more) {
+		view_dispatcher_send_custom_event(fgp->view_dispatcher, GALLERY_BUILD_NEXT);
+	} else {
+		fgp_scene_gallery_build_done(fgp);
+		fgp_scene_gallery_show(fgp);
+	}
+}
+
+void fgp_scene_gallery_on_enter(void* context)
+{
+	struct fgp_app *fgp = context;
+	size_t cnt;
+	size_t idx;
+
+	submenu_reset(fgp->submenu);
+	submenu_set_header(fgp->submenu, "Gallery");
+
+	/* Newest folder at the top */
+	cnt = fgp_gallery_view_folders_load(fgp->gallery_view);
+	for (idx = 0; idx < cnt; idx++)
+		submenu_add_item(fgp->submenu, fgp_gallery_view_folder_get(fgp->gallery_view, idx),
+				 idx, folder_callback, fgp);
+
+	scene_manager_set_scene_state(fgp->scene_manager, fgpSceneGallery, GALLERY_FOLDERS);
+	view_dispatcher_switch_to_view(fgp->view_dispatcher, fgpViewSubmenu);
+}
+
+bool fgp_scene_gallery_on_event(void* context, SceneManagerEvent event)
+{
+	struct fgp_app *fgp = context;
+	bool consumed = false;
+
+	if (event.type == SceneManagerEventTypeCustom && event.event == GALLERY_BUILD_NEXT) {
+		fgp_scene_gallery_build_next(fgp);
+		consumed = true;
+	} else if (event.type == SceneManagerEventTypeCustom && !fgp->thumb_build) {
+		fgp_gallery_view_folder_select(fgp->gallery_view, event.event);
+		submenu_set_selected_item(fgp->submenu, event.event);
+
+		/* A folder with no thumbnails, e.g. saved before they were
+		 * kept, gets them from its PNGs first.
+		 */
+		fgp->thumb_build = thumb_build_alloc(fgp_gallery_view_folder_get(fgp->gallery_view, event.event));
+		if (fgp->thumb_build)
+			fgp_scene_gallery_build_next(fgp);
+		else
+			fgp_scene_gallery_show(fgp);
+		consumed = true;
+	}
+
+	/* Back while rebuilding stops it and stays on the list of folders */
+	if (event.type == SceneManagerEventTypeBack && fgp->thumb_build) {
+		fgp_scene_gallery_build_done(fgp);
+		return true;
+	}
+
+	/* Back from a folder goes back to the list of folders */
+	if (event.type == SceneManagerEventTypeBack &&
+	    scene_manager_get_scene_state(fgp->scene_manager, fgpSceneGallery) == GALLERY_IMAGES) {
+		scene_manager_set_scene_state(fgp->scene_manager, fgpSceneGallery, GALLERY_FOLDERS);
+		view_dispatcher_switch_to_view(fgp->view_dispatcher, fgpViewSubmenu);
+		consumed = true;
+	}
+
+	return consumed;
+}
+
+void fgp_scene_gallery_on_exit(void* context) {
+	struct fgp_app *fgp = context;
+
+	if (fgp->thumb_build)
+		fgp_scene_gallery_build_done(fgp);
+	submenu_reset(fgp->submenu);
+}
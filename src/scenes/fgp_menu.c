@@ -3,6 +3,7 @@
 
 #include <gui/modules/submenu.h>
 #include <src/include/fgp_app.h>
+#include <src/include/recompress.h>
 #include <src/scenes/include/fgp_scene.h>
 
 
@@ -26,6 +27,15 @@ void fgp_scene_menu_on_enter(void* context)
 
 	/* Init config variables here */
 	fgp->palette_idx = 0;
+	fgp->palette_set_idx = 0;
+	fgp->png_scale = 1;
+	fgp->png_xform = XFORM_NONE;
+	fgp->dup_mode = DUP_SAVE;
+	fgp->sheet = SHEET_NONE;
+	fgp->sheet_gap = 1;
+	fgp->repalette_idx = 0;
+	fgp->convert_idx = 0;
+	fgp->convert = NULL;
 
 	submenu_add_item(
 	fgp->submenu,
@@ -41,11 +51,42 @@ void fgp_scene_menu_on_enter(void* context)
 	scene_change_from_main_cb,
 	fgp);
 
+	submenu_add_item(
+	fgp->submenu,
+	"Re-palette Folder",
+	fgpSceneRepalette,
+	scene_change_from_main_cb,
+	fgp);
+
+	submenu_add_item(
+	fgp->submenu,
+	"Convert Pending",
+	fgpSceneConvert,
+	scene_change_from_main_cb,
+	fgp);
+
+	submenu_add_item(
+	fgp->submenu,
+	"Gallery",
+	fgpSceneGallery,
+	scene_change_from_main_cb,
+	fgp);
+
+	submenu_add_item(
+	fgp->submenu,
+	"Export Day",
+	fgpSceneExport,
+	scene_change_from_main_cb,
+	fgp);
+
 	submenu_set_selected_item(
 	fgp->submenu,
 	scene_manager_get_scene_state(fgp->scene_manager, fgpSceneMenu));
 
 	view_dispatcher_switch_to_view(fgp->view_dispatcher, fgpViewSubmenu);
+
+	/* Nothing else is using the SD card while sitting in the menu */
+	recompress_resume(fgp->recompress, false);
 }
 
 bool fgp_scene_menu_on_event(void* context, SceneManagerEvent event)
@@ -62,5 +103,7 @@ bool fgp_scene_menu_on_event(void* context, SceneManagerEvent event)
 }
 
 void fgp_scene_menu_on_exit(void* context) {
-	UNUSED(context);
+	struct fgp_app *fgp = context;
+
+	recompress_pause(fgp->recompress);
 }
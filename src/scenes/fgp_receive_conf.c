@@ -6,21 +6,83 @@
 #include <src/scenes/include/fgp_scene.h>
 
 #include <src/include/fgp_palette.h>
+#include <src/views/include/receive_view.h>
 
 static const char * const list_text[] = {
 	"Save bin:",
 	"Save hdr+bin:",
 	"Save PNG:",
+	"Save tiles:",
+	"Save APNG:",
+	"Save GIF:",
+	"Fast Capture:",
+	"Stream USB:",
+	"Duplicates:",
+	"Contact Sheet:",
+	"Sheet Gap:",
 	"PNG Palette:",
+	"Extra Palettes:",
+	"PNG Scale:",
+	"PNG Transform:",
 	"Receive!",
 };
 
+/* Options of list_text that a Fast Capture doesn't use, only the tiles are
+ * saved and everything else is up to Convert Pending
+ */
+static const uint8_t fast_capture_unused[] = {
+	0, // Save bin
+	1, // Save hdr+bin
+	2, // Save PNG
+	3, // Save tiles
+	4, // Save APNG
+	5, // Save GIF
+	9, // Contact Sheet
+	10, // Sheet Gap
+	11, // PNG Palette
+	12, // Extra Palettes
+	13, // PNG Scale
+	14, // PNG Transform
+};
 
 static const char * const yes_no_text[] = {
 	"No",
 	"Yes",
 };
 
+static const char * const dup_text[DUP_COUNT] = {
+	"Save",
+	"Link",
+	"Skip",
+};
+
+static const char * const sheet_text[SHEET_LAYOUT_COUNT] = {
+	"None",
+	"Grid",
+	"Poster",
+};
+
+static const char * const gap_text[] = {
+	"0 px",
+	"8 px",
+	"16 px",
+};
+
+static const char * const scale_text[] = {
+	"1x",
+	"2x",
+	"3x",
+	"4x",
+};
+
+static const char * const xform_text[XFORM_COUNT] = {
+	"None",
+	"Photo Only",
+	"Trim",
+	"Mirror",
+	"Rotate",
+};
+
 static void save_binary(VariableItem *item)
 {
 	struct fgp_app *fgp = variable_item_get_context(item);
@@ -54,6 +116,100 @@ static void save_png(VariableItem *item)
 		fgp->options |= OPT_SAVE_PNG;
 }
 
+static void save_tiles(VariableItem *item)
+{
+	struct fgp_app *fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, yes_no_text[index]);
+	fgp->options &= ~OPT_SAVE_TILES;
+	if (index)
+		fgp->options |= OPT_SAVE_TILES;
+}
+
+static void save_apng(VariableItem *item)
+{
+	struct fgp_app *fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, yes_no_text[index]);
+	fgp->options &= ~OPT_SAVE_APNG;
+	if (index)
+		fgp->options |= OPT_SAVE_APNG;
+}
+
+static void save_gif(VariableItem *item)
+{
+	struct fgp_app *fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, yes_no_text[index]);
+	fgp->options &= ~OPT_SAVE_GIF;
+	if (index)
+		fgp->options |= OPT_SAVE_GIF;
+}
+
+/* Lock the options Fast Capture leaves alone while it is on */
+static void fast_capture_lock(struct fgp_app *fgp)
+{
+	bool locked = !!(fgp->options & OPT_FAST_CAPTURE);
+	unsigned int i;
+
+	for (i = 0; i < COUNT_OF(fast_capture_unused); i++)
+		variable_item_set_locked(variable_item_list_get(fgp->variable_item_list, fast_capture_unused[i]),
+					 locked, "Not used with\nFast Capture");
+}
+
+static void fast_capture(VariableItem *item)
+{
+	struct fgp_app *fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, yes_no_text[index]);
+	fgp->options &= ~OPT_FAST_CAPTURE;
+	if (index)
+		fgp->options |= OPT_FAST_CAPTURE;
+	fast_capture_lock(fgp);
+}
+
+static void stream_usb(VariableItem *item)
+{
+	struct fgp_app *fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, yes_no_text[index]);
+	fgp->options &= ~OPT_STREAM_USB;
+	if (index)
+		fgp->options |= OPT_STREAM_USB;
+}
+
+static void set_dup(VariableItem* item)
+{
+	struct fgp_app * fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, dup_text[index]);
+	fgp->dup_mode = index;
+}
+
+static void set_sheet(VariableItem* item)
+{
+	struct fgp_app * fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, sheet_text[index]);
+	fgp->sheet = index;
+}
+
+static void set_sheet_gap(VariableItem* item)
+{
+	struct fgp_app * fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, gap_text[index]);
+	fgp->sheet_gap = index;
+}
+
 static void set_palette(VariableItem* item)
 {
 	struct fgp_app * fgp = variable_item_get_context(item);
@@ -63,6 +219,33 @@ static void set_palette(VariableItem* item)
 	fgp->palette_idx = index;
 }
 
+static void set_palette_set(VariableItem* item)
+{
+	struct fgp_app * fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, palette_set_name_get(index));
+	fgp->palette_set_idx = index;
+}
+
+static void set_scale(VariableItem* item)
+{
+	struct fgp_app * fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, scale_text[index]);
+	fgp->png_scale = index + 1;
+}
+
+static void set_xform(VariableItem* item)
+{
+	struct fgp_app * fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, xform_text[index]);
+	fgp->png_xform = index;
+}
+
 static void enter_callback(void* context, uint32_t index)
 {
 	struct fgp_app *fgp = context;
@@ -118,6 +301,70 @@ void fgp_scene_receive_conf_on_enter(void* context)
 
 	item = variable_item_list_add(fgp->variable_item_list,
 				      list_text[3],
+				      COUNT_OF(yes_no_text),
+				      save_tiles,
+				      fgp);
+	variable_item_set_current_value_index(item, !!(fgp->options & OPT_SAVE_TILES));
+	variable_item_set_current_value_text(item, yes_no_text[(!!(fgp->options & OPT_SAVE_TILES))]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[4],
+				      COUNT_OF(yes_no_text),
+				      save_apng,
+				      fgp);
+	variable_item_set_current_value_index(item, !!(fgp->options & OPT_SAVE_APNG));
+	variable_item_set_current_value_text(item, yes_no_text[(!!(fgp->options & OPT_SAVE_APNG))]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[5],
+				      COUNT_OF(yes_no_text),
+				      save_gif,
+				      fgp);
+	variable_item_set_current_value_index(item, !!(fgp->options & OPT_SAVE_GIF));
+	variable_item_set_current_value_text(item, yes_no_text[(!!(fgp->options & OPT_SAVE_GIF))]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[6],
+				      COUNT_OF(yes_no_text),
+				      fast_capture,
+				      fgp);
+	variable_item_set_current_value_index(item, !!(fgp->options & OPT_FAST_CAPTURE));
+	variable_item_set_current_value_text(item, yes_no_text[(!!(fgp->options & OPT_FAST_CAPTURE))]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[7],
+				      COUNT_OF(yes_no_text),
+				      stream_usb,
+				      fgp);
+	variable_item_set_current_value_index(item, !!(fgp->options & OPT_STREAM_USB));
+	variable_item_set_current_value_text(item, yes_no_text[(!!(fgp->options & OPT_STREAM_USB))]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[8],
+				      COUNT_OF(dup_text),
+				      set_dup,
+				      fgp);
+	variable_item_set_current_value_index(item, fgp->dup_mode);
+	variable_item_set_current_value_text(item, dup_text[fgp->dup_mode]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[9],
+				      COUNT_OF(sheet_text),
+				      set_sheet,
+				      fgp);
+	variable_item_set_current_value_index(item, fgp->sheet);
+	variable_item_set_current_value_text(item, sheet_text[fgp->sheet]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[10],
+				      COUNT_OF(gap_text),
+				      set_sheet_gap,
+				      fgp);
+	variable_item_set_current_value_index(item, fgp->sheet_gap);
+	variable_item_set_current_value_text(item, gap_text[fgp->sheet_gap]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[11],
 				      palette_count_get(),
 				      set_palette,
 				      fgp);
@@ -125,11 +372,37 @@ void fgp_scene_receive_conf_on_enter(void* context)
 	variable_item_set_current_value_text(item, palette_name_get(fgp->palette_idx));
 
 	item = variable_item_list_add(fgp->variable_item_list,
-				      list_text[4],
+				      list_text[12],
+				      palette_set_count_get(),
+				      set_palette_set,
+				      fgp);
+	variable_item_set_current_value_index(item, fgp->palette_set_idx);
+	variable_item_set_current_value_text(item, palette_set_name_get(fgp->palette_set_idx));
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[13],
+				      COUNT_OF(scale_text),
+				      set_scale,
+				      fgp);
+	variable_item_set_current_value_index(item, fgp->png_scale - 1);
+	variable_item_set_current_value_text(item, scale_text[fgp->png_scale - 1]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[14],
+				      COUNT_OF(xform_text),
+				      set_xform,
+				      fgp);
+	variable_item_set_current_value_index(item, fgp->png_xform);
+	variable_item_set_current_value_text(item, xform_text[fgp->png_xform]);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[15],
 				      0,
 				      NULL,
 				      fgp);
 
+	fast_capture_lock(fgp);
+
 	variable_item_list_set_enter_callback(fgp->variable_item_list,
 					      enter_callback,
 					      fgp);
@@ -146,6 +419,11 @@ bool fgp_scene_receive_conf_on_event(void* context, SceneManagerEvent event)
 		if (event.event == 0)
 			view_dispatcher_switch_to_view(fgp->view_dispatcher, fgpViewReceive);
 		consumed = true;
+	} else if (event.type == SceneManagerEventTypeBack &&
+		   fgp_receive_view_sheet_pending(fgp->receive_view)) {
+		/* The contact sheet of the session is written on the way out */
+		scene_manager_next_scene(fgp->scene_manager, fgpSceneSheet);
+		consumed = true;
 	}
 	return consumed;
 }
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <gui/modules/variable_item_list.h>
+#include <dialogs/dialogs.h>
+#include <storage/storage.h>
+#include <src/include/fgp_app.h>
+#include <src/scenes/include/fgp_scene.h>
+
+#include <src/include/fgp_palette.h>
+#include <src/include/repalette.h>
+
+static const char * const list_text[] = {
+	"Palette:",
+	"Pick Folder",
+};
+
+static void set_palette(VariableItem* item)
+{
+	struct fgp_app * fgp = variable_item_get_context(item);
+	uint8_t index = variable_item_get_current_value_index(item);
+
+	variable_item_set_current_value_text(item, palette_name_get(index));
+	fgp->repalette_idx = index;
+}
+
+static void enter_callback(void* context, uint32_t index)
+{
+	struct fgp_app *fgp = context;
+
+	if (index == COUNT_OF(list_text) - 1)
+		view_dispatcher_send_custom_event(fgp->view_dispatcher, 0);
+}
+
+/* Have the user pick any PNG in the folder to recolor, then do the whole
+ * folder and show how it went.
+ */
+static void fgp_scene_repalette_run(struct fgp_app *fgp)
+{
+	DialogsApp *dialogs = furi_record_open(RECORD_DIALOGS);
+	Storage *storage = furi_record_open(RECORD_STORAGE);
+	DialogsFileBrowserOptions browser_options;
+	DialogMessage *message;
+	FuriString *path = furi_string_alloc_set(APP_DATA_PATH(""));
+	struct repalette_stats stats;
+	size_t slash;
+
+	storage_common_resolve_path_and_ensure_app_directory(storage, path);
+	furi_record_close(RECORD_STORAGE);
+
+	dialog_file_browser_set_basic_options(&browser_options, ".png", NULL);
+	browser_options.base_path = furi_string_get_cstr(path);
+	browser_options.hide_ext = false;
+
+	if (!dialog_file_browser_show(dialogs, path, path, &browser_options))
+		goto out;
+
+	slash = furi_string_search_rchar(path, '/', 0);
+	if (slash == FURI_STRING_FAILURE)
+		goto out;
+	furi_string_left(path, slash);
+
+	repalette_folder(furi_string_get_cstr(path), fgp->repalette_idx, &stats);
+
+	furi_string_printf(path, "Recolored: %u\nSkipped: %u\nErrors: %u",
+			   stats.done, stats.skipped, stats.errors);
+	message = dialog_message_alloc();
+	dialog_message_set_header(message, "Re-palette", 64, 2, AlignCenter, AlignTop);
+	dialog_message_set_text(message, furi_string_get_cstr(path), 64, 36, AlignCenter, AlignCenter);
+	dialog_message_set_buttons(message, NULL, "OK", NULL);
+	dialog_message_show(dialogs, message);
+	dialog_message_free(message);
+
+out:
+	furi_string_free(path);
+	furi_record_close(RECORD_DIALOGS);
+}
+
+void fgp_scene_repalette_on_enter(void* context)
+{
+	struct fgp_app *fgp = context;
+	VariableItem *item;
+
+	variable_item_list_reset(fgp->variable_item_list);
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[0],
+				      palette_count_get(),
+				      set_palette,
+				      fgp);
+	variable_item_set_current_value_index(item, fgp->repalette_idx);
+	variable_item_set_current_value_text(item, palette_name_get(fgp->repalette_idx));
+
+	item = variable_item_list_add(fgp->variable_item_list,
+				      list_text[1],
+				      0,
+				      NULL,
+				      fgp);
+
+	variable_item_list_set_enter_callback(fgp->variable_item_list,
+					      enter_callback,
+					      fgp);
+
+	view_dispatcher_switch_to_view(fgp->view_dispatcher, fgpViewVariableItemList);
+}
+
+bool fgp_scene_repalette_on_event(void* context, SceneManagerEvent event)
+{
+	struct fgp_app *fgp = context;
+	bool consumed = false;
+
+	if (event.type == SceneManagerEventTypeCustom) {
+		if (event.event == 0)
+			fgp_scene_repalette_run(fgp);
+		consumed = true;
+	}
+	return consumed;
+}
+
+void fgp_scene_repalette_on_exit(void* context)
+{
+	UNUSED(context);
+}
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <gui/modules/submenu.h>
+#include <dialogs/dialogs.h>
+#include <src/include/fgp_app.h>
+#include <src/scenes/include/fgp_scene.h>
+
+#include <src/include/file_handling.h>
+#include <src/include/sheet.h>
+
+/* Bands of the sheet written per event, between them the GUI gets to redraw */
+#define SHEET_BATCH	8
+
+enum sheet_events {
+	SHEET_NEXT,
+};
+
+/* Finish the sheet, and say so if any of it is missing */
+static void fgp_scene_sheet_done(struct fgp_app *fgp)
+{
+	DialogsApp *dialogs;
+	DialogMessage *message;
+	bool ok;
+
+	ok = sheet_write_finish(fgp->sheet_out);
+	sheet_free(fgp->sheet_out);
+	fgp_storage_free(fgp->sheet_storage);
+	fgp->sheet_out = NULL;
+	fgp->sheet_storage = NULL;
+
+	if (ok)
+		return;
+
+	dialogs = furi_record_open(RECORD_DIALOGS);
+	message = dialog_message_alloc();
+	dialog_message_set_header(message, "Contact Sheet", 64, 2, AlignCenter, AlignTop);
+	dialog_message_set_text(message, "Some images couldn't\nbe read, or the sheet\ncouldn't be saved",
+				64, 36, AlignCenter, AlignCenter);
+	dialog_message_set_buttons(message, NULL, "OK", NULL);
+	dialog_message_show(dialogs, message);
+	dialog_message_free(message);
+	furi_record_close(RECORD_DIALOGS);
+}
+
+void fgp_scene_sheet_on_enter(void* context)
+{
+	struct fgp_app *fgp = context;
+
+	submenu_reset(fgp->submenu);
+	submenu_set_header(fgp->submenu, "Contact Sheet");
+
+	/* Leaving the receive screen hands over the sheet of the session */
+	view_dispatcher_switch_to_view(fgp->view_dispatcher, fgpViewSubmenu);
+	view_dispatcher_send_custom_event(fgp->view_dispatcher, SHEET_NEXT);
+}
+
+bool fgp_scene_sheet_on_event(void* context, SceneManagerEvent event)
+{
+	struct fgp_app *fgp = context;
+	size_t done;
+	size_t total;
+	char string[24];
+	bool more = false;
+
+	/* The sheet is always finished, Back waits for it */
+	if (event.type == SceneManagerEventTypeBack)
+		return true;
+
+	if (event.type != SceneManagerEventTypeCustom || event.event != SHEET_NEXT)
+		return false;
+
+	if (fgp->sheet_out) {
+		more = sheet_write_next(fgp->sheet_out, SHEET_BATCH);
+		sheet_progress_get(fgp->sheet_out, &done, &total);
+		snprintf(string, sizeof(string), "Contact Sheet %u%%", (done * 100) / total);
+		submenu_set_header(fgp->submenu, string);
+	}
+
+	if (more) {
+		view_dispatcher_send_custom_event(fgp->view_dispatcher, SHEET_NEXT);
+	} else {
+		if (fgp->sheet_out)
+			fgp_scene_sheet_done(fgp);
+		scene_manager_search_and_switch_to_previous_scene(fgp->scene_manager, fgpSceneMenu);
+	}
+
+	return true;
+}
+
+void fgp_scene_sheet_on_exit(void* context)
+{
+	struct fgp_app *fgp = context;
+
+	if (fgp->sheet_out)
+		fgp_scene_sheet_done(fgp);
+	submenu_reset(fgp->submenu);
+}
@@ -4,3 +4,8 @@
 ADD_SCENE(fgp,	menu,		Menu)
 ADD_SCENE(fgp,	receive_conf,	ReceiveConf)
 ADD_SCENE(fgp,	select_pins,	SelectPins)
+ADD_SCENE(fgp,	repalette,	Repalette)
+ADD_SCENE(fgp,	convert,	Convert)
+ADD_SCENE(fgp,	gallery,	Gallery)
+ADD_SCENE(fgp,	export,		Export)
+ADD_SCENE(fgp,	sheet,		Sheet)
@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/fgp_palette.h>
+#include <src/include/file_handling.h>
+#include <src/include/png.h>
+#include <src/include/sheet.h>
+#include <src/include/tile_tools.h>
+
+/* Rows of the sheet held before they are written out, one IDAT chunk */
+#define SHEET_SEG_PX	16
+
+/* A run of prints of an image with the same palette byte, most images are
+ * just the one
+ */
+struct sheet_print {
+	uint16_t tiles_h;
+	uint8_t palette; // Print command palette byte
+};
+
+struct sheet_img {
+	uint32_t count; // Number of the file the image was saved to
+	uint16_t tiles_w;
+	uint16_t tiles_h;
+	uint16_t print; // First of its prints
+	uint16_t print_cnt;
+};
+
+/* The PNG of the sheet as it is being written */
+struct sheet_out {
+	void *png;
+	void *fgp_storage;
+	size_t px_w;
+	size_t bands; // Bands of the sheet added so far
+	bool first; // Nothing written yet, IHDR, PLTE, and zlib header go first
+	bool error;
+};
+
+struct sheet {
+	size_t cnt;
+	struct sheet_img img[SHEET_MAX];
+	size_t print_cnt;
+	struct sheet_print print[SHEET_PRINTS_MAX];
+
+	/* From sheet_write_start() until sheet_write_finish() */
+	struct sheet_out out;
+	Storage *storage;
+	File *src[SHEET_COLS_MAX]; // Images of the row being written
+	char src_ext[16];
+	size_t src_offs;
+	size_t gap;
+	size_t cols;
+	size_t rows;
+	size_t cell_w;
+	size_t bands; // Bands of the whole sheet
+	size_t row; // Row of images being written
+	size_t row_h;
+	size_t band; // Band of the row to write next
+	uint8_t *band_buf;
+	uint8_t lut[256];
+	bool error; // An image couldn't be read
+};
+
+void *sheet_alloc(void)
+{
+	struct sheet *sh = malloc(sizeof(struct sheet));
+
+	memset(sh, 0, sizeof(struct sheet));
+
+	return sh;
+}
+
+void sheet_free(void *sheet)
+{
+	free(sheet);
+}
+
+bool sheet_add(void *sheet, uint32_t count, size_t tiles_w, size_t tiles_h, uint8_t palette, bool same_image)
+{
+	struct sheet *sh = sheet;
+	struct sheet_img *img;
+	struct sheet_print *print;
+
+	if (same_image && sh->cnt && sh->img[sh->cnt - 1].count == count) {
+		img = &sh->img[sh->cnt - 1];
+		img->tiles_h += tiles_h;
+
+		/* With no room for another, the last palette carries on */
+		print = &sh->print[sh->print_cnt - 1];
+		if (print->palette != palette && sh->print_cnt < SHEET_PRINTS_MAX) {
+			print++;
+			print->tiles_h = 0;
+			print->palette = palette;
+			sh->print_cnt++;
+			img->print_cnt++;
+		}
+		print->tiles_h += tiles_h;
+		return true;
+	}
+
+	if (sh->cnt == SHEET_MAX || sh->print_cnt == SHEET_PRINTS_MAX)
+		return false;
+
+	img = &sh->img[sh->cnt++];
+	img->count = count;
+	img->tiles_w = tiles_w;
+	img->tiles_h = tiles_h;
+	img->print = sh->print_cnt;
+	img->print_cnt = 1;
+
+	print = &sh->print[sh->print_cnt++];
+	print->tiles_h = tiles_h;
+	print->palette = palette;
+
+	return true;
+}
+
+size_t sheet_count_get(void *sheet)
+{
+	struct sheet *sh = sheet;
+
+	return sh->cnt;
+}
+
+/* Add the segment to the image and write its IDAT chunks out */
+static void sheet_seg_write(struct sheet_out *out)
+{
+	enum png_chunks chunk;
+
+	png_seg_append(out->png);
+	if (out->first) {
+		for (chunk = CHUNK_START; chunk < IDAT; chunk++)
+			out->error |= !fgp_storage_write(out->fgp_storage, png_buf_get(out->png, chunk),
+							 png_len_get(out->png, chunk));
+		out->first = false;
+	}
+	out->error |= !fgp_storage_write(out->fgp_storage, png_buf_get(out->png, IDAT),
+					 png_len_get(out->png, IDAT));
+	png_seg_reset(out->png, out->px_w);
+}
+
+/* The band built with png_dat_band_*() is done */
+static void sheet_band_add(struct sheet_out *out)
+{
+	png_dat_band_add(out->png);
+	out->bands++;
+	if (png_seg_height_get(out->png) == SHEET_SEG_PX)
+		sheet_seg_write(out);
+}
+
+static void sheet_gap_write(struct sheet_out *out, size_t gap)
+{
+	while (gap--) {
+		png_dat_band_start(out->png);
+		sheet_band_add(out);
+	}
+}
+
+/* Open each image of the next row, to be read a band at a time as the bands
+ * of the row go by
+ */
+static void sheet_row_open(struct sheet *sh)
+{
+	const struct sheet_img *img;
+	size_t col;
+
+	sh->row_h = 0;
+	sh->band = 0;
+	for (col = 0; col < sh->cols && ((sh->row * sh->cols) + col) < sh->cnt; col++) {
+		img = &sh->img[(sh->row * sh->cols) + col];
+		if (img->tiles_h > sh->row_h)
+			sh->row_h = img->tiles_h;
+		if (!fgp_storage_open_count_read(sh->out.fgp_storage, sh->src[col], img->count, sh->src_ext) ||
+		    !storage_file_seek(sh->src[col], sh->src_offs, true)) {
+			FURI_LOG_E("sheet", "can't read %04lu%s", img->count, sh->src_ext);
+			storage_file_close(sh->src[col]);
+			sh->error = true;
+		}
+	}
+}
+
+/* Remap of band b of img, as set by the palette byte of the print it is from */
+static const uint8_t *sheet_lut_get(struct sheet *sh, const struct sheet_img *img, size_t b)
+{
+	const struct sheet_print *print = &sh->print[img->print];
+	size_t i;
+
+	for (i = 1; i < img->print_cnt && b >= print->tiles_h; i++) {
+		b -= print->tiles_h;
+		print++;
+	}
+
+	return tile_palette_lut(sh->lut, print->palette) ? sh->lut : NULL;
+}
+
+static void sheet_band_write(struct sheet *sh)
+{
+	const struct sheet_img *img;
+	size_t col;
+
+	png_dat_band_start(sh->out.png);
+	for (col = 0; col < sh->cols && ((sh->row * sh->cols) + col) < sh->cnt; col++) {
+		img = &sh->img[(sh->row * sh->cols) + col];
+		if (sh->band >= img->tiles_h || !storage_file_is_open(sh->src[col]))
+			continue;
+
+		/* Anything missing from the end of a file is left blank */
+		if (storage_file_read(sh->src[col], sh->band_buf, img->tiles_w * 16) != (size_t)(img->tiles_w * 16)) {
+			storage_file_close(sh->src[col]);
+			sh->error = true;
+			continue;
+		}
+		png_dat_band_tiles(sh->out.png, sh->band_buf, img->tiles_w, sh->gap + (col * (sh->cell_w + sh->gap)),
+				   sheet_lut_get(sh, img, sh->band));
+	}
+	sheet_band_add(&sh->out);
+	sh->band++;
+}
+
+void sheet_write_start(void *sheet, void *fgp_storage, const char *src_ext, size_t src_offs,
+		       bool poster, size_t gap, unsigned int palette_idx)
+{
+	struct sheet *sh = sheet;
+	FuriString *fs_tmp;
+	size_t idx;
+	size_t col;
+
+	/* As close to square as the images fit, or one row for a poster */
+	sh->cols = 1;
+	if (poster)
+		sh->cols = sh->cnt;
+	while ((sh->cols * sh->cols) < sh->cnt)
+		sh->cols++;
+	if (sh->cols > SHEET_COLS_MAX)
+		sh->cols = SHEET_COLS_MAX;
+	sh->rows = (sh->cnt + sh->cols - 1) / sh->cols;
+
+	/* Every column is as wide as the widest image, every row as tall as
+	 * the tallest image in it
+	 */
+	sh->cell_w = 0;
+	sh->bands = gap;
+	for (idx = 0; idx < sh->cnt; idx++) {
+		if (sh->img[idx].tiles_w > sh->cell_w)
+			sh->cell_w = sh->img[idx].tiles_w;
+	}
+	for (sh->row = 0; sh->row < sh->rows; sh->row++) {
+		sh->row_h = 0;
+		for (col = 0; col < sh->cols && ((sh->row * sh->cols) + col) < sh->cnt; col++) {
+			if (sh->img[(sh->row * sh->cols) + col].tiles_h > sh->row_h)
+				sh->row_h = sh->img[(sh->row * sh->cols) + col].tiles_h;
+		}
+		sh->bands += sh->row_h + gap;
+	}
+
+	snprintf(sh->src_ext, sizeof(sh->src_ext), "%s", src_ext);
+	sh->src_offs = src_offs;
+	sh->gap = gap;
+	sh->error = false;
+
+	sh->out.fgp_storage = fgp_storage;
+	sh->out.px_w = ((sh->cols * sh->cell_w) + ((sh->cols + 1) * gap)) * 8;
+	sh->out.bands = 0;
+	sh->out.first = true;
+	sh->out.error = false;
+	sh->out.png = png_alloc(sh->out.px_w, SHEET_SEG_PX);
+	png_reset(sh->out.png, sh->out.px_w);
+	png_palette_set(sh->out.png, palette_plte_get(palette_idx));
+	sh->band_buf = malloc(sh->cell_w * 16);
+
+	fs_tmp = furi_string_alloc_printf("-sheet-%s.png", palette_shortname_get(palette_idx));
+	sh->out.error |= !fgp_storage_open_count(fgp_storage, sh->img[0].count, furi_string_get_cstr(fs_tmp));
+	furi_string_free(fs_tmp);
+
+	sh->storage = furi_record_open(RECORD_STORAGE);
+	for (col = 0; col < sh->cols; col++)
+		sh->src[col] = storage_file_alloc(sh->storage);
+
+	sheet_gap_write(&sh->out, gap);
+	sh->row = 0;
+	sheet_row_open(sh);
+}
+
+bool sheet_write_next(void *sheet, size_t max)
+{
+	struct sheet *sh = sheet;
+	size_t col;
+
+	while (max && sh->row < sh->rows) {
+		if (sh->band < sh->row_h) {
+			sheet_band_write(sh);
+			max--;
+			continue;
+		}
+
+		for (col = 0; col < sh->cols; col++)
+			storage_file_close(sh->src[col]);
+		sheet_gap_write(&sh->out, sh->gap);
+		sh->row++;
+		if (sh->row < sh->rows)
+			sheet_row_open(sh);
+	}
+
+	return (sh->row < sh->rows);
+}
+
+void sheet_progress_get(void *sheet, size_t *done, size_t *total)
+{
+	struct sheet *sh = sheet;
+
+	*done = sh->out.bands;
+	*total = sh->bands;
+}
+
+bool sheet_write_finish(void *sheet)
+{
+	struct sheet *sh = sheet;
+	void *fgp_storage = sh->out.fgp_storage;
+	size_t col;
+
+	if (png_seg_height_get(sh->out.png))
+		sheet_seg_write(&sh->out);
+
+	/* End the stream, then IHDR again with the height of the whole sheet */
+	sh->out.error |= !fgp_storage_write(fgp_storage, png_buf_get(sh->out.png, IDAT_CHECK),
+					    png_len_get(sh->out.png, IDAT_CHECK));
+	sh->out.error |= !fgp_storage_write(fgp_storage, png_buf_get(sh->out.png, IEND),
+					    png_len_get(sh->out.png, IEND));
+	sh->out.error |= !fgp_storage_seek(fgp_storage, 0, true);
+	sh->out.error |= !fgp_storage_write(fgp_storage, png_buf_get(sh->out.png, IHDR),
+					    png_len_get(sh->out.png, IHDR));
+	sh->out.error |= !fgp_storage_close(fgp_storage);
+
+	for (col = 0; col < sh->cols; col++) {
+		storage_file_close(sh->src[col]);
+		storage_file_free(sh->src[col]);
+	}
+	furi_record_close(RECORD_STORAGE);
+	free(sh->band_buf);
+	png_free(sh->out.png);
+
+	FURI_LOG_I("sheet", "%u images, %ux%u grid, %u px wide", sh->cnt, sh->cols, sh->rows, sh->out.px_w);
+
+	return !(sh->error || sh->out.error);
+}
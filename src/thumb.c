@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <src/include/thumb.h>
+
+struct thumb {
+	struct thumb_rec rec;
+	size_t px_w;
+	size_t px_h;
+	size_t y; // Rows of the image so far
+	uint32_t sum[THUMB_MAX_W]; // Shades of the current row of the thumbnail
+	uint32_t cnt[THUMB_MAX_W]; // px of the image that went in to each sum
+};
+
+/* 4x4 ordered dither thresholds, 0 through 15 */
+static const uint8_t bayer[4][4] = {
+	{ 0, 8, 2, 10 },
+	{ 12, 4, 14, 6 },
+	{ 3, 11, 1, 9 },
+	{ 15, 7, 13, 5 },
+};
+
+void *thumb_alloc(void)
+{
+	struct thumb *th = malloc(sizeof(struct thumb));
+
+	memset(th, 0, sizeof(struct thumb));
+
+	return th;
+}
+
+void thumb_free(void *thumb)
+{
+	free(thumb);
+}
+
+void thumb_start(void *thumb, size_t px_w, size_t px_h)
+{
+	struct thumb *th = thumb;
+	size_t longest = (px_w > px_h) ? px_w : px_h;
+
+	/* Keep the shape of the image, only ever scaling it down */
+	th->rec.thumb_w = (longest > THUMB_MAX_W) ? (px_w * THUMB_MAX_W) / longest : px_w;
+	th->rec.thumb_h = (longest > THUMB_MAX_H) ? (px_h * THUMB_MAX_H) / longest : px_h;
+	if (!th->rec.thumb_w)
+		th->rec.thumb_w = 1;
+	if (!th->rec.thumb_h)
+		th->rec.thumb_h = 1;
+
+	th->px_w = px_w;
+	th->px_h = px_h;
+	th->y = 0;
+	memset(th->rec.data, 0, sizeof(th->rec.data));
+	memset(th->sum, 0, sizeof(th->sum));
+	memset(th->cnt, 0, sizeof(th->cnt));
+}
+
+void thumb_row(void *thumb, const uint8_t *row)
+{
+	struct thumb *th = thumb;
+	size_t tw = th->rec.thumb_w;
+	size_t ty;
+	size_t tx;
+	size_t x;
+	uint8_t *dst;
+
+	if (th->y >= th->px_h)
+		return;
+
+	for (x = 0; x < th->px_w; x++) {
+		tx = (x * tw) / th->px_w;
+		th->sum[tx] += (row[x / 4] >> (6 - ((x & 3) * 2))) & 0x03;
+		th->cnt[tx]++;
+	}
+
+	ty = (th->y * th->rec.thumb_h) / th->px_h;
+	th->y++;
+
+	/* More rows of the image still go in to this row of the thumbnail */
+	if (th->y < th->px_h && ((th->y * th->rec.thumb_h) / th->px_h) == ty)
+		return;
+
+	/* The average shade, 0 to 3, against a threshold spread out over the
+	 * same range. Shade 3, the darkest, is a set bit.
+	 */
+	dst = th->rec.data + (ty * (THUMB_MAX_W / 8));
+	for (tx = 0; tx < tw; tx++) {
+		if ((th->sum[tx] * 32) > ((bayer[ty & 3][tx & 3] * 2) + 1) * 3 * th->cnt[tx])
+			dst[tx / 8] |= (1 << (tx & 7));
+	}
+
+	memset(th->sum, 0, sizeof(th->sum));
+	memset(th->cnt, 0, sizeof(th->cnt));
+}
+
+struct thumb_rec *thumb_rec_get(void *thumb)
+{
+	struct thumb *th = thumb;
+
+	return &th->rec;
+}
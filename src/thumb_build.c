@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/file_handling.h>
+#include <src/include/fgp_palette.h>
+#include <src/include/png_import.h>
+#include <src/include/thumb.h>
+#include <src/include/thumb_build.h>
+#include <src/include/tile_tools.h>
+
+#define NAME_LEN	128
+
+/* The new index is only named THUMB_FILE once it has every image */
+#define THUMB_TMP	THUMB_FILE ".tmp"
+
+/* Images listed at a time, the list grows by this many */
+#define THUMB_BUILD_GROW	16
+
+/* Names between the count and the palette that aren't an image of their own */
+static const char * const thumb_build_skip[] = {
+	"exp",
+	"sheet",
+	"anim",
+};
+
+struct thumb_build_png {
+	uint16_t count;
+	uint8_t palette;
+	char ext[THUMB_EXT_LEN];
+};
+
+struct thumb_build {
+	Storage *storage;
+	File *in;
+	File *out;
+
+	FuriString *path; // The folder, with the trailing /
+	FuriString *tmp_path;
+	char folder[FGP_FOLDER_LEN];
+
+	struct thumb_build_png *pngs; // In order of count
+	size_t cnt;
+	size_t next; // Next of pngs to make a thumbnail of
+
+	void *png_import;
+	void *thumb;
+	size_t px_w; // Of the PNG being imported
+	uint32_t px_h; // From its IHDR, bands only have whole tiles
+	uint8_t scan_row[PNG_IMPORT_W_MAX / 4];
+
+	struct thumb_build_stats stats;
+};
+
+/* Take the name apart if it is one of our PNGs of an image of folder,
+ * GCIM_<folder>_XXXX-[<xform>[N]-]<shortname>.png
+ */
+static bool thumb_build_name(const char *folder, const char *name, struct thumb_build_png *png)
+{
+	size_t len = strlen(name);
+	const char *ext = name + 20; // Past GCIM_YYYY-MM-DD_XXXX
+	const char *dash;
+	char shortname[16];
+	unsigned int count = 0;
+	unsigned int i;
+	int idx;
+
+	if (len < 25 || strncmp(name, "GCIM_", 5) || strncmp(name + 5, folder, FGP_FOLDER_LEN - 1) ||
+	    name[15] != '_' || ext[0] != '-' || strcmp(name + len - 4, ".png") ||
+	    strlen(ext) >= THUMB_EXT_LEN)
+		return false;
+
+	for (i = 16; i < 20; i++) {
+		if (name[i] < '0' || name[i] > '9')
+			return false;
+		count = (count * 10) + (name[i] - '0');
+	}
+
+	/* ext starts with a dash, so there always is one */
+	for (dash = name + len - 5; *dash != '-'; dash--);
+	if ((size_t)(name + len - 4 - dash - 1) >= sizeof(shortname))
+		return false;
+	memcpy(shortname, dash + 1, name + len - 4 - dash - 1);
+	shortname[name + len - 4 - dash - 1] = '\0';
+	idx = palette_idx_get(shortname);
+	if (idx < 0)
+		return false;
+
+	for (i = 0; i < COUNT_OF(thumb_build_skip); i++) {
+		if (!strncmp(ext + 1, thumb_build_skip[i], strlen(thumb_build_skip[i])))
+			return false;
+	}
+
+	png->count = count;
+	png->palette = idx;
+	snprintf(png->ext, sizeof(png->ext), "%s", ext);
+
+	return true;
+}
+
+/* By count, then the shortest name, the one with no transform, first */
+static int thumb_build_cmp(const void *a, const void *b)
+{
+	const struct thumb_build_png *pa = a;
+	const struct thumb_build_png *pb = b;
+
+	if (pa->count != pb->count)
+		return (int)pa->count - (int)pb->count;
+
+	return (int)strlen(pa->ext) - (int)strlen(pb->ext);
+}
+
+static void thumb_build_list(struct thumb_build *tb, File *dir)
+{
+	FileInfo info;
+	char *name = malloc(NAME_LEN);
+	size_t cap = 0;
+	size_t cnt = 0;
+	size_t i;
+
+	while (storage_dir_read(dir, &info, name, NAME_LEN)) {
+		if (file_info_is_dir(&info))
+			continue;
+
+		if (tb->cnt == cap) {
+			cap += THUMB_BUILD_GROW;
+			tb->pngs = realloc(tb->pngs, cap * sizeof(struct thumb_build_png));
+		}
+		if (thumb_build_name(tb->folder, name, &tb->pngs[tb->cnt]))
+			tb->cnt++;
+	}
+	free(name);
+
+	if (!tb->cnt)
+		return;
+
+	/* Only the first PNG of each count is kept */
+	qsort(tb->pngs, tb->cnt, sizeof(struct thumb_build_png), thumb_build_cmp);
+	for (i = 0; i < tb->cnt; i++) {
+		if (!cnt || tb->pngs[i].count != tb->pngs[cnt - 1].count)
+			tb->pngs[cnt++] = tb->pngs[i];
+	}
+	tb->cnt = cnt;
+}
+
+/* Each band of the PNG, back to rows for the thumbnail */
+static bool thumb_build_band(void *ctx, const uint8_t *tiles, size_t tiles_w, size_t tiles_h, size_t band)
+{
+	struct thumb_build *tb = ctx;
+	size_t row;
+
+	UNUSED(tiles_h);
+
+	if (!band) {
+		tb->px_w = tiles_w * 8;
+		thumb_start(tb->thumb, tb->px_w, tb->px_h);
+	}
+
+	/* Rows past px_h of the last band are padding, the thumbnail is
+	 * already complete by then.
+	 */
+	for (row = 0; row < 8; row++) {
+		tile_row_get(tb->scan_row, tiles, tiles_w, row, NULL);
+		thumb_row(tb->thumb, tb->scan_row);
+	}
+
+	return true;
+}
+
+static bool thumb_build_one(struct thumb_build *tb, const struct thumb_build_png *png)
+{
+	struct thumb_rec *rec = thumb_rec_get(tb->thumb);
+	FuriString *fs_tmp;
+	uint8_t head[24]; // Signature, then IHDR up to the height
+	bool error = false;
+
+	fs_tmp = furi_string_alloc_printf("%sGCIM_%s_%04u%s", furi_string_get_cstr(tb->path), tb->folder,
+					  png->count, png->ext);
+	if (!storage_file_open(tb->in, furi_string_get_cstr(fs_tmp), FSAM_READ, FSOM_OPEN_EXISTING)) {
+		furi_string_free(fs_tmp);
+		return false;
+	}
+	furi_string_free(fs_tmp);
+
+	error |= (storage_file_read(tb->in, head, sizeof(head)) != sizeof(head));
+	tb->px_h = ((uint32_t)head[20] << 24) | ((uint32_t)head[21] << 16) | ((uint32_t)head[22] << 8) | head[23];
+	error |= (tb->px_h > UINT16_MAX);
+	if (!error)
+		error |= !png_import(tb->png_import, tb->in, palette_plte_get(png->palette), thumb_build_band, tb);
+	storage_file_close(tb->in);
+	if (error)
+		return false;
+
+	rec->count = png->count;
+	rec->px_w = tb->px_w;
+	rec->px_h = tb->px_h;
+	rec->palette = png->palette;
+	memcpy(rec->ext, png->ext, sizeof(rec->ext));
+
+	return (storage_file_write(tb->out, rec, sizeof(struct thumb_rec)) == sizeof(struct thumb_rec));
+}
+
+void *thumb_build_alloc(const char *folder)
+{
+	struct thumb_build *tb = malloc(sizeof(struct thumb_build));
+	FuriString *fs_tmp;
+	File *dir;
+
+	memset(tb, 0, sizeof(struct thumb_build));
+
+	tb->storage = furi_record_open(RECORD_STORAGE);
+	tb->in = storage_file_alloc(tb->storage);
+	tb->out = storage_file_alloc(tb->storage);
+	tb->path = furi_string_alloc_set(APP_DATA_PATH(""));
+	tb->tmp_path = furi_string_alloc();
+	snprintf(tb->folder, sizeof(tb->folder), "%s", folder);
+
+	storage_common_resolve_path_and_ensure_app_directory(tb->storage, tb->path);
+	furi_string_cat_printf(tb->path, "%s/", folder);
+
+	fs_tmp = furi_string_alloc_printf("%s%s", furi_string_get_cstr(tb->path), THUMB_FILE);
+	if (!storage_file_exists(tb->storage, furi_string_get_cstr(fs_tmp))) {
+		dir = storage_file_alloc(tb->storage);
+		if (storage_dir_open(dir, furi_string_get_cstr(tb->path)))
+			thumb_build_list(tb, dir);
+		storage_dir_close(dir);
+		storage_file_free(dir);
+	}
+	furi_string_free(fs_tmp);
+
+	furi_string_printf(tb->tmp_path, "%s%s", furi_string_get_cstr(tb->path), THUMB_TMP);
+	if (!tb->cnt || !storage_file_open(tb->out, furi_string_get_cstr(tb->tmp_path), FSAM_WRITE,
+					   FSOM_CREATE_ALWAYS)) {
+		tb->cnt = 0;
+		thumb_build_free(tb);
+		return NULL;
+	}
+
+	tb->png_import = png_import_alloc();
+	tb->thumb = thumb_alloc();
+	tb->stats.total = tb->cnt;
+
+	FURI_LOG_I("thumb", "%s: %u images to rebuild", folder, tb->cnt);
+
+	return tb;
+}
+
+bool thumb_build_next(void *thumb_build, unsigned int max)
+{
+	struct thumb_build *tb = thumb_build;
+
+	while (max-- && tb->next < tb->cnt) {
+		if (thumb_build_one(tb, &tb->pngs[tb->next]))
+			tb->stats.done++;
+		else
+			tb->stats.errors++;
+		tb->next++;
+	}
+
+	return (tb->next < tb->cnt);
+}
+
+void thumb_build_stats_get(void *thumb_build, struct thumb_build_stats *stats)
+{
+	struct thumb_build *tb = thumb_build;
+
+	*stats = tb->stats;
+}
+
+void thumb_build_free(void *thumb_build)
+{
+	struct thumb_build *tb = thumb_build;
+	FuriString *fs_tmp;
+	bool ok;
+
+	if (tb->cnt) {
+		ok = storage_file_close(tb->out);
+		fs_tmp = furi_string_alloc_printf("%s%s", furi_string_get_cstr(tb->path), THUMB_FILE);
+		if (!ok || tb->next < tb->cnt ||
+		    storage_common_rename(tb->storage, furi_string_get_cstr(tb->tmp_path),
+					  furi_string_get_cstr(fs_tmp)) != FSE_OK)
+			storage_simply_remove(tb->storage, furi_string_get_cstr(tb->tmp_path));
+		furi_string_free(fs_tmp);
+
+		FURI_LOG_I("thumb", "%s: %u of %u done, %u errors", tb->folder, tb->stats.done,
+			   tb->stats.total, tb->stats.errors);
+	}
+
+	if (tb->png_import)
+		png_import_free(tb->png_import);
+	if (tb->thumb)
+		thumb_free(tb->thumb);
+	free(tb->pngs);
+	furi_string_free(tb->tmp_path);
+	furi_string_free(tb->path);
+	storage_file_free(tb->out);
+	storage_file_free(tb->in);
+	furi_record_close(RECORD_STORAGE);
+	free(tb);
+}
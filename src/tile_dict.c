@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <src/include/tile_dict.h>
+
+#define SLOT_EMPTY	0xffff
+
+/* Open addressed hash table of indexes in to tiles. There are always at least
+ * twice as many slots as tiles, so probes stay short even when full.
+ */
+struct tile_dict {
+	uint8_t *tiles; // 16 bytes per tile, in index order
+	uint16_t *slots;
+	size_t slot_mask;
+	size_t max_tiles;
+	size_t count;
+};
+
+void *tile_dict_alloc(size_t max_tiles)
+{
+	struct tile_dict *dict = malloc(sizeof(struct tile_dict));
+	size_t slots = 1;
+
+	/* Indexes are 16 bit, and one of those is the literal marker */
+	if (max_tiles >= TILE_DICT_LITERAL)
+		max_tiles = TILE_DICT_LITERAL - 1;
+
+	while (slots < (max_tiles * 2))
+		slots <<= 1;
+
+	dict->tiles = malloc(max_tiles * 16);
+	dict->slots = malloc(slots * sizeof(uint16_t));
+	dict->slot_mask = slots - 1;
+	dict->max_tiles = max_tiles;
+	tile_dict_reset(dict);
+
+	return dict;
+}
+
+void tile_dict_free(void *tile_dict)
+{
+	struct tile_dict *dict = tile_dict;
+
+	free(dict->tiles);
+	free(dict->slots);
+	free(dict);
+}
+
+void tile_dict_reset(void *tile_dict)
+{
+	struct tile_dict *dict = tile_dict;
+
+	memset(dict->slots, 0xff, (dict->slot_mask + 1) * sizeof(uint16_t));
+	dict->count = 0;
+}
+
+/* Mix the 4 words of a tile, multiply and xor-shift so the high bits, which
+ * don't make it in to the slot index, still count.
+ */
+static size_t tile_dict_hash(const uint8_t *tile)
+{
+	uint32_t word;
+	uint32_t h = 0;
+	size_t i;
+
+	for (i = 0; i < 16; i += 4) {
+		memcpy(&word, tile + i, sizeof(uint32_t));
+		h = (h ^ word) * 0x9e3779b1;
+		h ^= h >> 15;
+	}
+
+	return h;
+}
+
+uint16_t tile_dict_get(void *tile_dict, const uint8_t *tile, bool *added)
+{
+	struct tile_dict *dict = tile_dict;
+	size_t slot = tile_dict_hash(tile) & dict->slot_mask;
+	uint16_t idx;
+
+	while ((idx = dict->slots[slot]) != SLOT_EMPTY) {
+		if (!memcmp(dict->tiles + (idx * 16), tile, 16)) {
+			*added = false;
+			return idx;
+		}
+		slot = (slot + 1) & dict->slot_mask;
+	}
+
+	*added = true;
+	if (dict->count == dict->max_tiles)
+		return TILE_DICT_LITERAL;
+
+	idx = dict->count++;
+	memcpy(dict->tiles + (idx * 16), tile, 16);
+	dict->slots[slot] = idx;
+
+	return idx;
+}
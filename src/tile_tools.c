@@ -1,95 +1,669 @@
 // SPDX-License-Identifier: BSD-2-Clause
 // Copyright (c) 2024 KBEmbedded
 
+#include <furi.h>
+#include <furi_hal.h>
+
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
-/* Copy src to dst converting from gb tile format to scanline format for
- * standard image data.
+#include <src/include/tile_tools.h>
+
+/* Each 8 px line of a GB tile is two bytes, the low bitplane followed by the
+ * high bitplane. The same 8 px in a 2bpp scanline are also two bytes, but with
+ * the bits of both planes interleaved, high plane bit first, MSB first:
+ *
+ *   tile: 0 1 2 3 4 5 6 7  8 9 a b c d e f
+ *   scan: 8 0 9 1 a 2 b 3  c 4 d 5 e 6 f 7
+ *
+ * A kernel converts `count` of those lines in one direction or the other. The
+ * tile side of the conversion is strided, since consecutive lines of a scanline
+ * live in consecutive tiles, while the scanline side is always contiguous.
  */
-/* TODO: Make this able to run against a single buffer rather than copying from
- * one buffer to another.
+struct tile_kernel {
+	const char *name;
+	/* src is tile data, stepped by src_stride per line, dst is scanline */
+	void (*interleave)(uint8_t *dst, const uint8_t *src, size_t count, size_t src_stride);
+	/* src is scanline, dst is tile data, stepped by dst_stride per line */
+	void (*deinterleave)(uint8_t *dst, const uint8_t *src, size_t count, size_t dst_stride);
+};
+
+/* Reference implementation, moves a single bit at a time. Every other kernel
+ * is checked against this one before it is allowed to be used.
  */
-void tile_to_scanline(uint8_t *src, size_t tiles_w, size_t tiles_h)
+static void interleave_scalar(uint8_t *dst, const uint8_t *src, size_t count, size_t src_stride)
+{
+	uint8_t lo;
+	uint8_t hi;
+	int i;
+
+	while (count--) {
+		lo = src[0];
+		hi = src[1];
+		dst[0] = 0;
+		for (i = 0; i < 8; i++) {
+			dst[0] <<= 1;
+			dst[0] |= !!(hi & (0x80 >> i));
+			dst[0] <<= 1;
+			dst[0] |= !!(lo & (0x80 >> i));
+			if (i == 3) {
+				dst++;
+				dst[0] = 0;
+			}
+		}
+		dst++;
+		src += src_stride;
+	}
+}
+
+static void deinterleave_scalar(uint8_t *dst, const uint8_t *src, size_t count, size_t dst_stride)
 {
-	//size_t tile_w = 2; // 2 byte wide
-	size_t tile_h = 8; // 8 byte tall
-	size_t tile_x_max = tiles_w;
-	size_t tile_y_max = tiles_h;
-	size_t tile_x = 0;
-	size_t tile_y = 0;
-	size_t tile_suby = 0;
-	size_t tmp;
 	int i;
-	/* One row of tiles is 160 px (per line) / 4 (px per byte) * 8 lines */
-	/* TODO: Should this be on the heap? */
-	uint8_t line_buf[320];
-	uint8_t *line_buf_ptr;
 
+	while (count--) {
+		dst[0] = 0;
+		dst[1] = 0;
+		for (i = 0; i < 8; i++) {
+			dst[1] <<= 1;
+			dst[0] <<= 1;
+			dst[1] |= !!(src[i / 4] & (0x80 >> ((i*2) % 8)));
+			dst[0] |= !!(src[i / 4] & (0x40 >> ((i*2) % 8)));
+		}
+		src += 2;
+		dst += dst_stride;
+	}
+}
+
+/* SWAR (SIMD within a register) kernels. Each 8 bit plane byte sits in its own
+ * 16 bit lane of the register, and the standard Morton "spread" moves bit n of
+ * every lane to bit 2n in three shift/mask steps. "Compact" is the inverse.
+ *
+ * The 32 bit version handles 2 lines per step and maps directly on to the
+ * registers of the Cortex-M4. The 64 bit version handles 4 lines per step but
+ * the compiler has to split every operation in to register pairs.
+ */
+static inline uint32_t spread32(uint32_t x)
+{
+	x = (x | (x << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
+static inline uint32_t compact32(uint32_t x)
+{
+	x &= 0x55555555;
+	x = (x | (x >> 1)) & 0x33333333;
+	x = (x | (x >> 2)) & 0x0f0f0f0f;
+	x = (x | (x >> 4)) & 0x00ff00ff;
+	return x;
+}
+
+static inline uint64_t spread64(uint64_t x)
+{
+	x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	x = (x | (x << 2)) & 0x3333333333333333ULL;
+	x = (x | (x << 1)) & 0x5555555555555555ULL;
+	return x;
+}
+
+static inline uint64_t compact64(uint64_t x)
+{
+	x &= 0x5555555555555555ULL;
+	x = (x | (x >> 1)) & 0x3333333333333333ULL;
+	x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+	x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+	return x;
+}
+
+static void interleave_swar32(uint8_t *dst, const uint8_t *src, size_t count, size_t src_stride)
+{
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t w;
+
+	for (; count >= 2; count -= 2) {
+		lo = src[0] | ((uint32_t)src[src_stride] << 16);
+		hi = src[1] | ((uint32_t)src[src_stride + 1] << 16);
+		w = spread32(lo) | (spread32(hi) << 1);
+		dst[0] = w >> 8;
+		dst[1] = w;
+		dst[2] = w >> 24;
+		dst[3] = w >> 16;
+		dst += 4;
+		src += src_stride * 2;
+	}
+
+	if (count) {
+		w = spread32(src[0]) | (spread32(src[1]) << 1);
+		dst[0] = w >> 8;
+		dst[1] = w;
+	}
+}
+
+static void deinterleave_swar32(uint8_t *dst, const uint8_t *src, size_t count, size_t dst_stride)
+{
+	uint32_t w;
+
+	for (; count >= 2; count -= 2) {
+		w = ((uint32_t)src[0] << 8) | src[1] |
+		    ((uint32_t)src[2] << 24) | ((uint32_t)src[3] << 16);
+		dst[0] = compact32(w);
+		dst[1] = compact32(w >> 1);
+		dst[dst_stride] = compact32(w) >> 16;
+		dst[dst_stride + 1] = compact32(w >> 1) >> 16;
+		src += 4;
+		dst += dst_stride * 2;
+	}
+
+	if (count) {
+		w = ((uint32_t)src[0] << 8) | src[1];
+		dst[0] = compact32(w);
+		dst[1] = compact32(w >> 1);
+	}
+}
+
+static void interleave_swar64(uint8_t *dst, const uint8_t *src, size_t count, size_t src_stride)
+{
+	uint64_t lo;
+	uint64_t hi;
+	uint64_t w;
+	int i;
+
+	for (; count >= 4; count -= 4) {
+		lo = 0;
+		hi = 0;
+		for (i = 0; i < 4; i++) {
+			lo |= (uint64_t)src[0] << (i * 16);
+			hi |= (uint64_t)src[1] << (i * 16);
+			src += src_stride;
+		}
+		w = spread64(lo) | (spread64(hi) << 1);
+		for (i = 0; i < 4; i++) {
+			dst[0] = w >> 8;
+			dst[1] = w;
+			dst += 2;
+			w >>= 16;
+		}
+	}
+
+	interleave_swar32(dst, src, count, src_stride);
+}
+
+static void deinterleave_swar64(uint8_t *dst, const uint8_t *src, size_t count, size_t dst_stride)
+{
+	uint64_t w;
+	uint64_t lo;
+	uint64_t hi;
+	int i;
+
+	for (; count >= 4; count -= 4) {
+		w = 0;
+		for (i = 0; i < 4; i++) {
+			w |= (uint64_t)((src[0] << 8) | src[1]) << (i * 16);
+			src += 2;
+		}
+		lo = compact64(w);
+		hi = compact64(w >> 1);
+		for (i = 0; i < 4; i++) {
+			dst[0] = lo;
+			dst[1] = hi;
+			dst += dst_stride;
+			lo >>= 16;
+			hi >>= 16;
+		}
+	}
+
+	deinterleave_swar32(dst, src, count, dst_stride);
+}
+
+/* Lookup table kernels, a byte at a time rather than a bit at a time.
+ *
+ * spread_lut[] moves bit n of a bitplane byte to bit 2n, so one line of a
+ * scanline is spread_lut[lo] | (spread_lut[hi] << 1).
+ *
+ * unzip_lut[] goes the other way for one scanline byte (4 px). The low
+ * nibble collects the even (low plane) bits, the high nibble the odd (high
+ * plane) bits.
+ */
+static const uint16_t spread_lut[256] = {
+	0x0000, 0x0001, 0x0004, 0x0005, 0x0010, 0x0011, 0x0014, 0x0015,
+	0x0040, 0x0041, 0x0044, 0x0045, 0x0050, 0x0051, 0x0054, 0x0055,
+	0x0100, 0x0101, 0x0104, 0x0105, 0x0110, 0x0111, 0x0114, 0x0115,
+	0x0140, 0x0141, 0x0144, 0x0145, 0x0150, 0x0151, 0x0154, 0x0155,
+	0x0400, 0x0401, 0x0404, 0x0405, 0x0410, 0x0411, 0x0414, 0x0415,
+	0x0440, 0x0441, 0x0444, 0x0445, 0x0450, 0x0451, 0x0454, 0x0455,
+	0x0500, 0x0501, 0x0504, 0x0505, 0x0510, 0x0511, 0x0514, 0x0515,
+	0x0540, 0x0541, 0x0544, 0x0545, 0x0550, 0x0551, 0x0554, 0x0555,
+	0x1000, 0x1001, 0x1004, 0x1005, 0x1010, 0x1011, 0x1014, 0x1015,
+	0x1040, 0x1041, 0x1044, 0x1045, 0x1050, 0x1051, 0x1054, 0x1055,
+	0x1100, 0x1101, 0x1104, 0x1105, 0x1110, 0x1111, 0x1114, 0x1115,
+	0x1140, 0x1141, 0x1144, 0x1145, 0x1150, 0x1151, 0x1154, 0x1155,
+	0x1400, 0x1401, 0x1404, 0x1405, 0x1410, 0x1411, 0x1414, 0x1415,
+	0x1440, 0x1441, 0x1444, 0x1445, 0x1450, 0x1451, 0x1454, 0x1455,
+	0x1500, 0x1501, 0x1504, 0x1505, 0x1510, 0x1511, 0x1514, 0x1515,
+	0x1540, 0x1541, 0x1544, 0x1545, 0x1550, 0x1551, 0x1554, 0x1555,
+	0x4000, 0x4001, 0x4004, 0x4005, 0x4010, 0x4011, 0x4014, 0x4015,
+	0x4040, 0x4041, 0x4044, 0x4045, 0x4050, 0x4051, 0x4054, 0x4055,
+	0x4100, 0x4101, 0x4104, 0x4105, 0x4110, 0x4111, 0x4114, 0x4115,
+	0x4140, 0x4141, 0x4144, 0x4145, 0x4150, 0x4151, 0x4154, 0x4155,
+	0x4400, 0x4401, 0x4404, 0x4405, 0x4410, 0x4411, 0x4414, 0x4415,
+	0x4440, 0x4441, 0x4444, 0x4445, 0x4450, 0x4451, 0x4454, 0x4455,
+	0x4500, 0x4501, 0x4504, 0x4505, 0x4510, 0x4511, 0x4514, 0x4515,
+	0x4540, 0x4541, 0x4544, 0x4545, 0x4550, 0x4551, 0x4554, 0x4555,
+	0x5000, 0x5001, 0x5004, 0x5005, 0x5010, 0x5011, 0x5014, 0x5015,
+	0x5040, 0x5041, 0x5044, 0x5045, 0x5050, 0x5051, 0x5054, 0x5055,
+	0x5100, 0x5101, 0x5104, 0x5105, 0x5110, 0x5111, 0x5114, 0x5115,
+	0x5140, 0x5141, 0x5144, 0x5145, 0x5150, 0x5151, 0x5154, 0x5155,
+	0x5400, 0x5401, 0x5404, 0x5405, 0x5410, 0x5411, 0x5414, 0x5415,
+	0x5440, 0x5441, 0x5444, 0x5445, 0x5450, 0x5451, 0x5454, 0x5455,
+	0x5500, 0x5501, 0x5504, 0x5505, 0x5510, 0x5511, 0x5514, 0x5515,
+	0x5540, 0x5541, 0x5544, 0x5545, 0x5550, 0x5551, 0x5554, 0x5555,
+};
+
+static const uint8_t unzip_lut[256] = {
+	0x00, 0x01, 0x10, 0x11, 0x02, 0x03, 0x12, 0x13, 0x20, 0x21, 0x30, 0x31, 0x22, 0x23, 0x32, 0x33,
+	0x04, 0x05, 0x14, 0x15, 0x06, 0x07, 0x16, 0x17, 0x24, 0x25, 0x34, 0x35, 0x26, 0x27, 0x36, 0x37,
+	0x40, 0x41, 0x50, 0x51, 0x42, 0x43, 0x52, 0x53, 0x60, 0x61, 0x70, 0x71, 0x62, 0x63, 0x72, 0x73,
+	0x44, 0x45, 0x54, 0x55, 0x46, 0x47, 0x56, 0x57, 0x64, 0x65, 0x74, 0x75, 0x66, 0x67, 0x76, 0x77,
+	0x08, 0x09, 0x18, 0x19, 0x0a, 0x0b, 0x1a, 0x1b, 0x28, 0x29, 0x38, 0x39, 0x2a, 0x2b, 0x3a, 0x3b,
+	0x0c, 0x0d, 0x1c, 0x1d, 0x0e, 0x0f, 0x1e, 0x1f, 0x2c, 0x2d, 0x3c, 0x3d, 0x2e, 0x2f, 0x3e, 0x3f,
+	0x48, 0x49, 0x58, 0x59, 0x4a, 0x4b, 0x5a, 0x5b, 0x68, 0x69, 0x78, 0x79, 0x6a, 0x6b, 0x7a, 0x7b,
+	0x4c, 0x4d, 0x5c, 0x5d, 0x4e, 0x4f, 0x5e, 0x5f, 0x6c, 0x6d, 0x7c, 0x7d, 0x6e, 0x6f, 0x7e, 0x7f,
+	0x80, 0x81, 0x90, 0x91, 0x82, 0x83, 0x92, 0x93, 0xa0, 0xa1, 0xb0, 0xb1, 0xa2, 0xa3, 0xb2, 0xb3,
+	0x84, 0x85, 0x94, 0x95, 0x86, 0x87, 0x96, 0x97, 0xa4, 0xa5, 0xb4, 0xb5, 0xa6, 0xa7, 0xb6, 0xb7,
+	0xc0, 0xc1, 0xd0, 0xd1, 0xc2, 0xc3, 0xd2, 0xd3, 0xe0, 0xe1, 0xf0, 0xf1, 0xe2, 0xe3, 0xf2, 0xf3,
+	0xc4, 0xc5, 0xd4, 0xd5, 0xc6, 0xc7, 0xd6, 0xd7, 0xe4, 0xe5, 0xf4, 0xf5, 0xe6, 0xe7, 0xf6, 0xf7,
+	0x88, 0x89, 0x98, 0x99, 0x8a, 0x8b, 0x9a, 0x9b, 0xa8, 0xa9, 0xb8, 0xb9, 0xaa, 0xab, 0xba, 0xbb,
+	0x8c, 0x8d, 0x9c, 0x9d, 0x8e, 0x8f, 0x9e, 0x9f, 0xac, 0xad, 0xbc, 0xbd, 0xae, 0xaf, 0xbe, 0xbf,
+	0xc8, 0xc9, 0xd8, 0xd9, 0xca, 0xcb, 0xda, 0xdb, 0xe8, 0xe9, 0xf8, 0xf9, 0xea, 0xeb, 0xfa, 0xfb,
+	0xcc, 0xcd, 0xdc, 0xdd, 0xce, 0xcf, 0xde, 0xdf, 0xec, 0xed, 0xfc, 0xfd, 0xee, 0xef, 0xfe, 0xff,
+};
+
+static void interleave_lut(uint8_t *dst, const uint8_t *src, size_t count, size_t src_stride)
+{
+	uint16_t w;
+
+	while (count--) {
+		w = spread_lut[src[0]] | (spread_lut[src[1]] << 1);
+		dst[0] = w >> 8;
+		dst[1] = w;
+		dst += 2;
+		src += src_stride;
+	}
+}
+
+static void deinterleave_lut(uint8_t *dst, const uint8_t *src, size_t count, size_t dst_stride)
+{
+	uint8_t a;
+	uint8_t b;
+
+	while (count--) {
+		a = unzip_lut[src[0]];
+		b = unzip_lut[src[1]];
+		dst[0] = (a << 4) | (b & 0x0f);
+		dst[1] = (a & 0xf0) | (b >> 4);
+		src += 2;
+		dst += dst_stride;
+	}
+}
+
+static const struct tile_kernel kernels[] = {
+	{ "scalar",	interleave_scalar,	deinterleave_scalar },
+	{ "swar32",	interleave_swar32,	deinterleave_swar32 },
+	{ "swar64",	interleave_swar64,	deinterleave_swar64 },
+	{ "lut",	interleave_lut,		deinterleave_lut },
+};
+
+/* Used until tile_tools_init() picks something better */
+static const struct tile_kernel *kernel = &kernels[0];
+
+/* Compare a kernel against the reference with an odd count, so the tail
+ * handling of the wide kernels is exercised as well.
+ */
+static bool tile_kernel_check(const struct tile_kernel *k, uint8_t *buf)
+{
+	const size_t count = 61;
+	const size_t stride = 16;
+	uint8_t *tiles = buf;
+	uint8_t *ref = tiles + (count * stride);
+	uint8_t *out = ref + (count * 2);
+	uint32_t x = 0x2545f491;
+	size_t i;
+
+	for (i = 0; i < count * stride; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		tiles[i] = x;
+	}
+
+	interleave_scalar(ref, tiles, count, stride);
+	k->interleave(out, tiles, count, stride);
+	if (memcmp(ref, out, count * 2))
+		return false;
+
+	/* Go back the other way and make sure the lines land where they came from */
+	memset(out, 0, count * stride);
+	k->deinterleave(out, ref, count, stride);
+	for (i = 0; i < count; i++) {
+		if (memcmp(&out[i * stride], &tiles[i * stride], 2))
+			return false;
+	}
+
+	return true;
+}
+
+void tile_tools_init(void)
+{
+	/* Scratch for two full 160x144 images, one to convert from and one to
+	 * convert to, also large enough for the check
+	 */
+	const size_t tiles_w = 20;
+	const size_t tiles_h = 18;
+	const size_t len = tiles_w * tiles_h * 16;
+	uint8_t *buf = malloc(len * 2);
+	const struct tile_kernel *fastest = &kernels[0];
+	uint32_t cycles;
+	uint32_t best = UINT32_MAX;
+	size_t i;
+
+	for (i = 0; i < COUNT_OF(kernels); i++) {
+		if (!tile_kernel_check(&kernels[i], buf)) {
+			FURI_LOG_E("tile", "%s kernel failed check, skipping", kernels[i].name);
+			continue;
+		}
+
+		/* Time a full image in each direction, between separate
+		 * buffers, the same as saving a PNG and importing one do. The
+		 * data is garbage at this point, only the timing matters.
+		 */
+		kernel = &kernels[i];
+		cycles = DWT->CYCCNT;
+		tile_to_scanline_copy(buf + len, tiles_w * 2, buf, tiles_w, tiles_h, NULL);
+		scanline_to_tile(buf, buf + len, tiles_w, tiles_h);
+		cycles = DWT->CYCCNT - cycles;
+		FURI_LOG_I("tile", "%s: %lu cycles per 160x144 image", kernel->name, cycles);
+
+		if (cycles < best) {
+			best = cycles;
+			fastest = kernel;
+		}
+	}
+
+	kernel = fastest;
+	FURI_LOG_I("tile", "using %s kernel", kernel->name);
+
+	free(buf);
+}
+
+bool tile_palette_lut(uint8_t *lut, uint8_t palette)
+{
+	unsigned int i;
+	unsigned int px;
+
+	/* Most games send 0x00 when they mean the default */
+	if (palette == 0x00 || palette == 0xe4)
+		return false;
+
+	/* Shade n of a px becomes bits 2n+1:2n of the palette. Scanline bytes
+	 * are 4 px each, remap all 4 at once.
+	 */
+	for (i = 0; i < 256; i++) {
+		lut[i] = 0;
+		for (px = 0; px < 8; px += 2)
+			lut[i] |= ((palette >> (((i >> px) & 0x03) * 2)) & 0x03) << px;
+	}
+
+	return true;
+}
+
+/* Remap a converted line while it is still in cache */
+static inline void tile_line_remap(uint8_t *line, size_t len, const uint8_t *lut)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		line[i] = lut[line[i]];
+}
 
+/* Each scanline starts dst_stride bytes after the previous one. This lets the
+ * caller leave room around each line, e.g. for a PNG filter byte.
+ */
+void tile_to_scanline_copy(uint8_t *dst, size_t dst_stride, const uint8_t *src, size_t tiles_w, size_t tiles_h, const uint8_t *lut)
+{
+	size_t tile_h = 8; // 8 byte tall
+	size_t band_len = tiles_w * 16;
+	size_t tile_y;
+	size_t tile_suby;
 
-	for (tile_y = 0; tile_y < tile_y_max; tile_y++) {
-		line_buf_ptr = line_buf;
+	for (tile_y = 0; tile_y < tiles_h; tile_y++) {
 		for (tile_suby = 0; tile_suby < tile_h; tile_suby++) {
-			for (tile_x = 0; tile_x < tile_x_max; tile_x++) {
-				/* need to shuffle bits */
-				/* from: 0 1 2 3 4 5 6 7  8 9 a b c d e f
-				 *   to: 8 0 9 1 a 2 b 3  c 4 d 5 e 6 f 7
-				 */
-				tmp = (tile_x*16)+(tile_y*320)+(tile_suby*2);
-				*line_buf_ptr = 0;
-				for (i = 0; i < 8; i++) {
-					*line_buf_ptr <<= 1;
-					*line_buf_ptr |= !!(src[tmp+1] & (0x80 >> i));
-					*line_buf_ptr <<= 1;
-					*line_buf_ptr |= !!(src[tmp] & (0x80 >> i));
-					if (i == 3) {
-						line_buf_ptr++;
-						*line_buf_ptr = 0;
-					}
-				}
-				line_buf_ptr++;
+			kernel->interleave(dst, src + (tile_suby*2), tiles_w, 16);
+			if (lut)
+				tile_line_remap(dst, tiles_w * 2, lut);
+			dst += dst_stride;
+		}
+		src += band_len;
+	}
+}
 
-			}
+void tile_row_get(uint8_t *dst, const uint8_t *src, size_t tiles_w, size_t row, const uint8_t *lut)
+{
+	size_t band_len = tiles_w * 16;
+
+	kernel->interleave(dst, src + ((row / 8) * band_len) + ((row % 8) * 2), tiles_w, 16);
+	if (lut)
+		tile_line_remap(dst, tiles_w * 2, lut);
+}
+
+/* Each line of a tile is a byte of the low bit of each px followed by a byte of
+ * the high bit, so a word holds 2 lines. The low and high planes are split out
+ * and a popcount of the right combination of them counts each shade, 16 px at
+ * a time.
+ */
+void tile_histogram(const uint8_t *src, size_t len, uint32_t hist[4])
+{
+	uint32_t word;
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t cnt[4] = { 0 };
+	size_t i;
+
+	for (i = 0; (i + 4) <= len; i += 4) {
+		memcpy(&word, src + i, sizeof(uint32_t));
+		lo = word & 0x00ff00ff;
+		hi = (word >> 8) & 0x00ff00ff;
+		cnt[1] += __builtin_popcount(lo & ~hi);
+		cnt[2] += __builtin_popcount(~lo & hi);
+		cnt[3] += __builtin_popcount(lo & hi);
+	}
+
+	/* Tile data is always whole lines, there can be at most one left */
+	if ((i + 2) <= len) {
+		lo = src[i];
+		hi = src[i + 1];
+		cnt[1] += __builtin_popcount(lo & ~hi);
+		cnt[2] += __builtin_popcount(~lo & hi & 0xff);
+		cnt[3] += __builtin_popcount(lo & hi);
+		i += 2;
+	}
+
+	cnt[0] = (i * 4) - cnt[1] - cnt[2] - cnt[3];
+	memcpy(hist, cnt, sizeof(cnt));
+}
+
+unsigned int tile_shades_get(const uint32_t hist[4], uint8_t palette)
+{
+	unsigned int shades = 0;
+	unsigned int shade;
+
+	if (palette == 0x00)
+		palette = 0xe4;
+
+	for (shade = 0; shade < 4; shade++) {
+		if (hist[shade])
+			shades |= (1 << ((palette >> (shade * 2)) & 0x03));
+	}
+
+	return shades;
+}
+
+/* Every byte of tile data is 8 px of one bitplane, MSB leftmost. Reversing the
+ * bits of each byte mirrors the tile, no need to touch the other plane.
+ */
+#define R2(n)	n, n + (2 * 64), n + (1 * 64), n + (3 * 64)
+#define R4(n)	R2(n), R2(n + (2 * 16)), R2(n + (1 * 16)), R2(n + (3 * 16))
+#define R6(n)	R4(n), R4(n + (2 * 4)), R4(n + (1 * 4)), R4(n + (3 * 4))
+static const uint8_t bitrev_lut[256] = { R6(0), R6(2), R6(1), R6(3) };
+#undef R6
+#undef R4
+#undef R2
+
+/* Transpose the 8x8 bit matrix of one bitplane of a tile, 8 bytes read from
+ * src every src_step bytes, written to dst every 2 bytes. Bit 7 - x of line y
+ * ends up as bit 7 - y of line x. Both halves of the matrix are held in a 32
+ * bit word and swapped in 3 rounds of 1, 2, and 4 bit blocks, as in Hacker's
+ * Delight.
+ */
+static void tile_plane_transpose(uint8_t *dst, const uint8_t *src, ptrdiff_t src_step)
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t t;
+
+	x = ((uint32_t)src[0] << 24) | (src[src_step] << 16) | (src[2 * src_step] << 8) | src[3 * src_step];
+	y = ((uint32_t)src[4 * src_step] << 24) | (src[5 * src_step] << 16) | (src[6 * src_step] << 8) | src[7 * src_step];
+
+	t = (x ^ (x >> 7)) & 0x00aa00aa;
+	x = x ^ t ^ (t << 7);
+	t = (y ^ (y >> 7)) & 0x00aa00aa;
+	y = y ^ t ^ (t << 7);
+
+	t = (x ^ (x >> 14)) & 0x0000cccc;
+	x = x ^ t ^ (t << 14);
+	t = (y ^ (y >> 14)) & 0x0000cccc;
+	y = y ^ t ^ (t << 14);
+
+	t = (x & 0xf0f0f0f0) | ((y >> 4) & 0x0f0f0f0f);
+	y = ((x << 4) & 0xf0f0f0f0) | (y & 0x0f0f0f0f);
+	x = t;
+
+	dst[0] = x >> 24;
+	dst[2] = x >> 16;
+	dst[4] = x >> 8;
+	dst[6] = x;
+	dst[8] = y >> 24;
+	dst[10] = y >> 16;
+	dst[12] = y >> 8;
+	dst[14] = y;
+}
+
+void tile_xform_size_get(const struct tile_xform *xf, size_t *tiles_w, size_t *tiles_h)
+{
+	*tiles_w = xf->rotate ? xf->h : xf->w;
+	*tiles_h = xf->rotate ? xf->w : xf->h;
+}
+
+const uint8_t *tile_xform_band(uint8_t *dst, const uint8_t *src, size_t src_tiles_w, const struct tile_xform *xf, size_t band)
+{
+	size_t band_len = src_tiles_w * 16;
+	size_t tiles_w;
+	size_t tiles_h;
+	size_t col;
+	size_t from;
+	size_t i;
+	const uint8_t *tile;
+	uint8_t *out;
+
+	/* A whole band straight from src needs no work at all */
+	if (!xf->mirror && !xf->rotate && !xf->x && xf->w == src_tiles_w)
+		return src + ((xf->y + band) * band_len);
+
+	tile_xform_size_get(xf, &tiles_w, &tiles_h);
+
+	for (col = 0; col < tiles_w; col++) {
+		/* Work out each tile as if not mirrored, mirroring then only
+		 * swaps which column it lands in and reverses its bits.
+		 */
+		from = xf->mirror ? (tiles_w - 1 - col) : col;
+		out = dst + (col * 16);
+
+		if (!xf->rotate) {
+			tile = src + ((xf->y + band) * band_len) + ((xf->x + from) * 16);
+			memcpy(out, tile, 16);
+		} else {
+			/* Turned 90 degrees clockwise, band n of the output is
+			 * tile column n of the rect, read from the bottom up.
+			 * Inside each tile, line y is column y of the source
+			 * tile, also bottom up, so the source lines are read
+			 * last to first going in to the transpose.
+			 */
+			tile = src + ((xf->y + xf->h - 1 - from) * band_len) + ((xf->x + band) * 16);
+			tile_plane_transpose(out, tile + 14, -2);
+			tile_plane_transpose(out + 1, tile + 15, -2);
+		}
+
+		if (xf->mirror) {
+			for (i = 0; i < 16; i++)
+				out[i] = bitrev_lut[out[i]];
 		}
-		memcpy(src+(tile_y*320), line_buf, 320);
 	}
 
+	return dst;
+}
 
+/* Blank is every px shade 0, i.e. every byte of both planes 0 */
+static bool tile_row_blank(const uint8_t *src, size_t len)
+{
+	uint8_t acc = 0;
+
+	while (len--)
+		acc |= *src++;
+
+	return !acc;
+}
+
+bool tile_xform_trim(struct tile_xform *xf, const uint8_t *src, size_t src_tiles_w)
+{
+	size_t band_len = src_tiles_w * 16;
+	size_t first;
+	size_t last;
+
+	for (first = xf->y; first < (xf->y + xf->h); first++) {
+		if (!tile_row_blank(src + (first * band_len) + (xf->x * 16), xf->w * 16))
+			break;
+	}
+
+	if (first == (xf->y + xf->h))
+		return false;
+
+	for (last = xf->y + xf->h - 1; last > first; last--) {
+		if (!tile_row_blank(src + (last * band_len) + (xf->x * 16), xf->w * 16))
+			break;
+	}
+
+	xf->y = first;
+	xf->h = last - first + 1;
+
+	return true;
 }
 
 void scanline_to_tile(uint8_t *dst, uint8_t *src, size_t tiles_w, size_t tiles_h)
 {
-	//size_t tile_w = 2; // 2 byte wide
 	size_t tile_h = 8; // 8 byte tall
-	size_t tile_x_max = tiles_w;
-	size_t tile_y_max = tiles_h;
-	size_t tile_x = 0;
+	size_t line_len = tiles_w * 2; // 4 px per byte, 8 px per tile
+	size_t band_len = tiles_w * 16;
 	size_t tile_y = 0;
 	size_t tile_suby = 0;
-	size_t tmp;
-	int i;
 
-	for (tile_y = 0; tile_y < tile_y_max; tile_y++) {
-		for (tile_x = 0; tile_x < tile_x_max; tile_x++) {
-			for (tile_suby = 0; tile_suby < tile_h; tile_suby++) {
-				/* need to shuffle bits */
-				/* from: 8 0 9 1 a 2 b 3  c 4 d 5 e 6 f 7
-				 *   to: 0 1 2 3 4 5 6 7  8 9 a b c d e f
-				 */
-				tmp = (tile_x*2)+(tile_y*320)+(tile_suby*40);
-				*dst = 0;
-				for (i = 0; i < 8; i++) {
-					dst[1] <<= 1;
-					dst[0] <<= 1;
-					dst[1] |= !!(src[tmp] & (0x80 >> ((i*2) % 8)));
-					dst[0] |= !!(src[tmp] & (0x40 >> ((i*2) % 8)));
-					if (i == 3)
-						tmp++;
-				}
-				dst += 2;
-			}
+	for (tile_y = 0; tile_y < tiles_h; tile_y++) {
+		for (tile_suby = 0; tile_suby < tile_h; tile_suby++) {
+			kernel->deinterleave(dst + (tile_y*band_len) + (tile_suby*2),
+					     src + (tile_y*band_len) + (tile_suby*line_len),
+					     tiles_w,
+					     16);
 		}
 	}
 }
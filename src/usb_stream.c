@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <furi_hal_usb.h>
+#include <furi_hal_usb_cdc.h>
+
+#include <string.h>
+
+#include <src/include/crc.h>
+#include <src/include/usb_stream.h>
+
+/* Channel 0 of usb_cdc_dual is the CLI */
+#define USB_STREAM_IF		1
+
+/* How long the host gets to take each packet before the frame is given up */
+#define USB_STREAM_TIMEOUT_MS	100
+
+struct usb_stream {
+	FuriHalUsbInterface *usb_prev; // USB config to put back when done
+	FuriSemaphore *tx_done;
+	bool ok; // False once a packet of the current frame timed out
+	size_t pkt_len;
+	uint8_t pkt[CDC_DATA_SZ]; // Bytes of the frame not yet sent
+	uint32_t crc;
+};
+
+static void usb_stream_tx_callback(void *context)
+{
+	struct usb_stream *usb = context;
+
+	furi_semaphore_release(usb->tx_done);
+}
+
+static CdcCallbacks usb_stream_callbacks = {
+	.tx_ep_callback = usb_stream_tx_callback,
+};
+
+static void usb_stream_send(struct usb_stream *usb, size_t len)
+{
+	if (!usb->ok)
+		return;
+
+	furi_hal_cdc_send(USB_STREAM_IF, usb->pkt, len);
+	if (furi_semaphore_acquire(usb->tx_done, furi_ms_to_ticks(USB_STREAM_TIMEOUT_MS)) != FuriStatusOk)
+		usb->ok = false;
+}
+
+/* Frames are sent a full packet at a time, whatever part of them is in */
+static void usb_stream_write(struct usb_stream *usb, const void *buf, size_t len)
+{
+	const uint8_t *src = buf;
+	size_t cnt;
+
+	usb->crc = crc_update(usb->crc, src, len);
+
+	while (len) {
+		cnt = CDC_DATA_SZ - usb->pkt_len;
+		if (cnt > len)
+			cnt = len;
+		memcpy(usb->pkt + usb->pkt_len, src, cnt);
+		usb->pkt_len += cnt;
+		src += cnt;
+		len -= cnt;
+
+		if (usb->pkt_len == CDC_DATA_SZ) {
+			usb_stream_send(usb, CDC_DATA_SZ);
+			usb->pkt_len = 0;
+		}
+	}
+}
+
+/* The last packet of a frame is always short, if the frame is a multiple of
+ * the packet size that is an empty one, so the host doesn't wait for more.
+ */
+static void usb_stream_flush(struct usb_stream *usb)
+{
+	usb_stream_send(usb, usb->pkt_len);
+	usb->pkt_len = 0;
+}
+
+void *usb_stream_alloc(void)
+{
+	struct usb_stream *usb = malloc(sizeof(struct usb_stream));
+
+	usb->usb_prev = furi_hal_usb_get_config();
+	furi_hal_usb_unlock();
+	if (!furi_hal_usb_set_config(&usb_cdc_dual, NULL)) {
+		FURI_LOG_E("usb", "can't switch to dual CDC");
+		free(usb);
+		return NULL;
+	}
+
+	usb->tx_done = furi_semaphore_alloc(1, 0);
+	usb->pkt_len = 0;
+	furi_hal_cdc_set_callbacks(USB_STREAM_IF, &usb_stream_callbacks, usb);
+
+	return usb;
+}
+
+void usb_stream_free(void *usb_stream)
+{
+	struct usb_stream *usb = usb_stream;
+
+	furi_hal_cdc_set_callbacks(USB_STREAM_IF, NULL, NULL);
+	furi_hal_usb_set_config(usb->usb_prev, NULL);
+	furi_semaphore_free(usb->tx_done);
+	free(usb);
+}
+
+bool usb_stream_print(void *usb_stream, struct gb_image *image, uint16_t count,
+		      size_t tiles_w, size_t tiles_h, bool same_image)
+{
+	struct usb_stream *usb = usb_stream;
+	struct usb_stream_hdr hdr;
+	size_t len = tiles_w * tiles_h * 16;
+	uint32_t crc;
+
+	/* Nobody to send it to */
+	if (!(furi_hal_cdc_get_ctrl_line_state(USB_STREAM_IF) & CdcCtrlLineDTR))
+		return true;
+
+	memcpy(hdr.magic, USB_STREAM_MAGIC, sizeof(hdr.magic));
+	hdr.version = USB_STREAM_VERSION;
+	hdr.flags = same_image ? USB_STREAM_SAME_IMAGE : 0;
+	hdr.count = count;
+	hdr.margins = image->margins;
+	hdr.palette = image->palette;
+	hdr.exposure = image->exposure;
+	hdr.tiles_w = tiles_w;
+	hdr.tiles_h = tiles_h;
+	hdr.len = len + (same_image ? 0 : 8);
+
+	/* A packet from a frame that timed out may be done by now */
+	furi_semaphore_acquire(usb->tx_done, 0);
+	usb->ok = true;
+	usb->crc = 0;
+	usb->pkt_len = 0;
+
+	usb_stream_write(usb, &hdr, sizeof(hdr));
+	if (!same_image)
+		usb_stream_write(usb, "GB-BIN01", 8);
+	usb_stream_write(usb, image->data, len);
+	crc = usb->crc;
+	usb_stream_write(usb, &crc, sizeof(crc));
+	usb_stream_flush(usb);
+
+	if (!usb->ok)
+		FURI_LOG_E("usb", "host stopped reading, frame %u dropped", count);
+
+	return usb->ok;
+}
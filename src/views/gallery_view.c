@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <gui/view.h>
+#include <storage/storage.h>
+#include <src/include/fgp_app.h>
+
+#include <src/include/fgp_palette.h>
+#include <src/include/file_handling.h>
+#include <src/include/thumb.h>
+#include <src/views/include/gallery_view.h>
+
+/* Up and Down skip this many images at once */
+#define GALLERY_JUMP	10
+
+struct gallery_model {
+	size_t idx; // Image shown, 0 the oldest
+	size_t cnt; // Images in the folder
+	bool loaded; // rec holds image idx
+	struct thumb_rec rec;
+};
+
+struct gallery_ctx {
+	View *view;
+	struct fgp_app *fgp;
+
+	Storage *storage;
+	File *file; // Thumbnail index of the folder shown, open while shown
+
+	char (*folders)[FGP_FOLDER_LEN]; // Oldest first
+	size_t folder_cnt;
+	size_t folder; // Folder to show
+};
+
+/* Only the record of the image to show is ever read */
+static void fgp_gallery_view_load(struct gallery_ctx *ctx, struct gallery_model *model)
+{
+	model->loaded = (model->cnt &&
+			 storage_file_seek(ctx->file, model->idx * sizeof(struct thumb_rec), true) &&
+			 (storage_file_read(ctx->file, &model->rec, sizeof(struct thumb_rec)) ==
+			  sizeof(struct thumb_rec)));
+
+	/* Don't trust a record that came in from the SD card */
+	if (model->rec.thumb_w > THUMB_MAX_W || model->rec.thumb_h > THUMB_MAX_H)
+		model->loaded = false;
+	model->rec.ext[THUMB_EXT_LEN - 1] = '\0';
+}
+
+static void fgp_gallery_view_enter(void *context)
+{
+	struct gallery_ctx *ctx = context;
+	FuriString *path;
+	uint64_t size = 0;
+
+	path = furi_string_alloc_set(APP_DATA_PATH(""));
+	storage_common_resolve_path_and_ensure_app_directory(ctx->storage, path);
+	if (ctx->folder < ctx->folder_cnt) {
+		furi_string_cat_printf(path, "%s/%s", ctx->folders[ctx->folder], THUMB_FILE);
+		if (storage_file_open(ctx->file, furi_string_get_cstr(path), FSAM_READ, FSOM_OPEN_EXISTING))
+			size = storage_file_size(ctx->file);
+	}
+	furi_string_free(path);
+
+	/* Start out on the newest image */
+	with_view_model(ctx->view,
+			struct gallery_model * model,
+			{
+				model->cnt = size / sizeof(struct thumb_rec);
+				model->idx = model->cnt ? model->cnt - 1 : 0;
+				fgp_gallery_view_load(ctx, model);
+			},
+			true);
+}
+
+static void fgp_gallery_view_exit(void *context)
+{
+	struct gallery_ctx *ctx = context;
+
+	storage_file_close(ctx->file);
+}
+
+/* Left and Right step through the images, Up and Down skip ahead */
+static bool fgp_gallery_view_input(InputEvent *event, void *context)
+{
+	struct gallery_ctx *ctx = context;
+	bool ret = false;
+
+	if (event->type != InputTypeShort && event->type != InputTypeRepeat)
+		return false;
+
+	with_view_model(ctx->view,
+			struct gallery_model * model,
+			{
+				size_t idx = model->idx;
+
+				ret = true;
+				switch (event->key) {
+				case InputKeyLeft:
+					if (idx)
+						idx--;
+					break;
+				case InputKeyRight:
+					if ((idx + 1) < model->cnt)
+						idx++;
+					break;
+				case InputKeyUp:
+					idx = (idx > GALLERY_JUMP) ? idx - GALLERY_JUMP : 0;
+					break;
+				case InputKeyDown:
+					idx += GALLERY_JUMP;
+					if (idx >= model->cnt)
+						idx = model->cnt ? model->cnt - 1 : 0;
+					break;
+				default:
+					ret = false;
+					break;
+				}
+
+				if (idx != model->idx) {
+					model->idx = idx;
+					fgp_gallery_view_load(ctx, model);
+				}
+			},
+			true);
+
+	return ret;
+}
+
+static void fgp_gallery_view_draw(Canvas *canvas, void *view_model)
+{
+	struct gallery_model *model = view_model;
+	struct thumb_rec *rec = &model->rec;
+	char string[26];
+
+	canvas_set_font(canvas, FontSecondary);
+
+	if (!model->cnt) {
+		canvas_draw_str_aligned(canvas, 64, 32, AlignCenter, AlignCenter, "No thumbnails");
+		return;
+	}
+
+	snprintf(string, sizeof(string), "%u/%u", model->idx + 1, model->cnt);
+	canvas_draw_str(canvas, 68, 62, string);
+
+	if (!model->loaded) {
+		canvas_draw_str(canvas, 68, 10, "Bad record");
+		return;
+	}
+
+	/* Rows of the thumbnail are always THUMB_MAX_W px apart */
+	canvas_draw_xbm(canvas, (THUMB_MAX_W - rec->thumb_w) / 2, (THUMB_MAX_H - rec->thumb_h) / 2,
+			THUMB_MAX_W, rec->thumb_h, rec->data);
+
+	snprintf(string, sizeof(string), "#%04u", rec->count);
+	canvas_draw_str(canvas, 68, 10, string);
+
+	snprintf(string, sizeof(string), "%ux%u", rec->px_w, rec->px_h);
+	canvas_draw_str(canvas, 68, 20, string);
+
+	if (rec->palette < palette_count_get())
+		canvas_draw_str(canvas, 68, 30, palette_name_get(rec->palette));
+
+	canvas_draw_str(canvas, 68, 40, rec->ext[0] == '-' ? rec->ext + 1 : rec->ext);
+}
+
+size_t fgp_gallery_view_folders_load(void *gallery_ctx)
+{
+	struct gallery_ctx *ctx = gallery_ctx;
+	FuriString *path = furi_string_alloc_set(APP_DATA_PATH(""));
+
+	storage_common_resolve_path_and_ensure_app_directory(ctx->storage, path);
+
+	free(ctx->folders);
+	ctx->folder_cnt = fgp_storage_folders_get(ctx->storage, furi_string_get_cstr(path), "", &ctx->folders);
+	furi_string_free(path);
+
+	return ctx->folder_cnt;
+}
+
+const char *fgp_gallery_view_folder_get(void *gallery_ctx, size_t idx)
+{
+	struct gallery_ctx *ctx = gallery_ctx;
+
+	return ctx->folders[ctx->folder_cnt - 1 - idx];
+}
+
+void fgp_gallery_view_folder_select(void *gallery_ctx, size_t idx)
+{
+	struct gallery_ctx *ctx = gallery_ctx;
+
+	ctx->folder = ctx->folder_cnt - 1 - idx;
+}
+
+View *fgp_gallery_view_get_view(void *gallery_ctx)
+{
+	struct gallery_ctx *ctx = gallery_ctx;
+
+	return ctx->view;
+}
+
+void *fgp_gallery_view_alloc(struct fgp_app *fgp)
+{
+	struct gallery_ctx *ctx = malloc(sizeof(struct gallery_ctx));
+
+	ctx->fgp = fgp;
+	ctx->storage = furi_record_open(RECORD_STORAGE);
+	ctx->file = storage_file_alloc(ctx->storage);
+	ctx->folders = NULL;
+	ctx->folder_cnt = 0;
+	ctx->folder = 0;
+
+	ctx->view = view_alloc();
+	view_set_context(ctx->view, ctx);
+	view_allocate_model(ctx->view, ViewModelTypeLockFree, sizeof(struct gallery_model));
+
+	view_set_input_callback(ctx->view, fgp_gallery_view_input);
+	view_set_draw_callback(ctx->view, fgp_gallery_view_draw);
+	view_set_enter_callback(ctx->view, fgp_gallery_view_enter);
+	view_set_exit_callback(ctx->view, fgp_gallery_view_exit);
+
+	return ctx;
+}
+
+void fgp_gallery_view_free(void *gallery_ctx)
+{
+	struct gallery_ctx *ctx = gallery_ctx;
+
+	view_free_model(ctx->view);
+	view_free(ctx->view);
+	free(ctx->folders);
+	storage_file_free(ctx->file);
+	furi_record_close(RECORD_STORAGE);
+	free(ctx);
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef GALLERY_VIEW_H
+#define GALLERY_VIEW_H
+
+#pragma once
+
+#include <furi.h>
+#include <src/include/fgp_app.h>
+
+void *fgp_gallery_view_alloc(struct fgp_app *fgp);
+
+void fgp_gallery_view_free(void *gallery_ctx);
+
+View *fgp_gallery_view_get_view(void *gallery_ctx);
+
+/* List the dated folders, newest first. Returns the number found. */
+size_t fgp_gallery_view_folders_load(void *gallery_ctx);
+
+/* Name of folder idx, as listed by fgp_gallery_view_folders_load() */
+const char *fgp_gallery_view_folder_get(void *gallery_ctx, size_t idx);
+
+/* Folder idx is shown the next time the view is switched to */
+void fgp_gallery_view_folder_select(void *gallery_ctx, size_t idx);
+
+#endif //GALLERY_VIEW_H
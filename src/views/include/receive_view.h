@@ -15,4 +15,9 @@ void fgp_receive_view_free(void *recv_ctx);
 
 View *fgp_receive_view_get_view(void *recv_ctx);
 
+/* True if leaving the receive screen now leaves a contact sheet to write, in
+ * sheet_out of the app
+ */
+bool fgp_receive_view_sheet_pending(void *recv_ctx);
+
 #endif //RECEIVE_VIEW_H
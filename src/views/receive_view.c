@@ -2,6 +2,7 @@
 // Copyright (c) 2024 KBEmbedded
 
 #include <furi.h>
+#include <furi_hal.h>
 #include <gui/modules/submenu.h>
 #include <storage/storage.h>
 #include <src/include/fgp_app.h>
@@ -13,21 +14,49 @@
 #include <protocols/printer/include/printer_proto.h>
 #include <protocols/printer/include/printer_receive.h>
 
+#include <src/include/convert.h>
+#include <src/include/dedup.h>
 #include <src/include/file_handling.h>
 #include <src/include/png.h>
+#include <src/include/gif.h>
+#include <src/include/print_cache.h>
+#include <src/include/thumb.h>
+#include <src/include/recompress.h>
+#include <src/include/rle.h>
+#include <src/include/sheet.h>
 #include <src/include/tile_tools.h>
+#include <src/include/tile_dict.h>
+#include <src/include/usb_stream.h>
 
 /* XXX: TODO turn this in to an enum */
 #define LINE_XFER		0x80000000
 #define PRINT		0x40000000
 #define COMPLETE	0x20000000
+#define EXPORT		0x10000000
+#define EXPORT_GIF	0x08000000
+#define IDLE		0x04000000
+
+/* Widest a row of tiles gets after a transform, band and scan_row are this
+ * wide. A rotated print 144 px tall is 18 tiles wide.
+ */
+#define XFORM_TILES_MAX	(160 / 8)
+
+/* How long after the last packet before saved PNGs are recompressed */
+#define RECOMP_IDLE_MS	3000
 
 struct recv_model {
 	int count;
 	int converted;
 	int errors;
+	int cache_cnt; // Images in the print cache
+	int cache_sel; // Image to export, 0 the most recently used
+	int export_pal; // Palette to export in
+	int dups; // Reprints linked or skipped instead of saved
 };
 
+/* Enough for 3 GB Camera prints */
+#define PRINT_CACHE_LEN	(18 * 1024)
+
 struct recv_ctx {
 	View *view;
 	struct recv_model *model;
@@ -42,23 +71,127 @@ struct recv_ctx {
 	struct gb_image *image;
 	int packet_cnt;
 
+	// Image geometry, worked out once per image
+	size_t px_w; // Width of the image being received, 0 if not yet known
+	size_t tile_row_sz; // Bytes in one row of tiles of the image
+	size_t last_px_w; // Width of the last image saved
+
 	// PNG handling
 	void *png_handle;
+	size_t conv_sz; // Bytes of the current image already given to png_handle
+	uint8_t lut[256]; // Shade remap from the print command palette byte
+	uint8_t png_lut[256]; // Shade remap of the PNG, to the order of its PLTE
+	const uint8_t *remap; // png_lut if the current image needs remapping, or NULL
+	uint8_t plte_pal; // Palette byte the PLTE of the current PNG is in the order of
+	uint8_t plte[PNG_PLTE_LEN]; // PLTE in that order, if it isn't 0xe4
+	void *png_stream; // Scaled PNG output, written row by row at print time
+	uint8_t *scan_row; // One unscaled row of scanline data for png_stream
+	uint8_t *band; // One row of transformed tiles for png_stream
+	unsigned int seg; // Segment of the current image, when transformed
+
+	// Tile archive handling
+	void *tile_dict; // Every tile saved this session, NULL until the first
+
+	// Animated PNG handling
+	void *apng; // Every print this session as a frame, NULL until the first
+	uint8_t *apng_prev; // Tile data of the last frame
+	size_t apng_len; // Bytes of tile data in every frame
+	uint8_t apng_palette; // Print command palette byte of the last frame
+	unsigned int apng_num; // Animations before this one, one per print size
+
+	// GIF handling
+	void *gif; // NULL until the first GIF is saved
+
+	// Extra palettes, copied from the file in the selected palette once the
+	// image can't be extended any more
+	uint32_t png_copies; // Of the png_stream PNG, mask of palettes
+	uint32_t gif_copies;
+
+	// Recent images, for export again in another palette or format
+	void *print_cache;
+
+	// Gallery thumbnail of the image saved last
+	void *thumb;
+
+	// Background recompression, only while no print is on its way. Only
+	// started or paused from the event handler, the timer just reads them
+	// to know when to send IDLE.
+	volatile uint32_t idle_tick; // Tick of the last packet or finished print
+	volatile bool busy; // A print is waiting to be saved
+	volatile bool recomp_running;
+
+	// Fast capture records, RLE compressed, NULL if not capturing
+	uint8_t *rle_buf;
+
+	// Prints streamed to a PC, NULL if not enabled
+	void *usb_stream;
+
+	// Hashes of the images saved today, NULL if reprints are saved anyway
+	void *dedup;
+	struct dedup_rec dedup_rec; // Of the print being saved
+
+	// Images of the session for the contact sheet, NULL if not made
+	void *sheet;
 
 	// File operations
 	void *file_handle;
 };
 
+/* Enough for every distinct tile of a handful of GB Camera photos, plus the
+ * frames they share.
+ */
+#define TILE_DICT_MAX	1024
+
+/* A tile archive is GB-TDA01 followed by one record per print, each a header,
+ * then a uint16_t index per tile, then the data of each tile that wasn't
+ * already in the archive, in the order they show up. Every field is little
+ * endian. An index one past the last tile stored adds the next tile of data
+ * to the dictionary, TILE_DICT_LITERAL is a tile that didn't fit and only
+ * applies to the one spot.
+ */
+struct __attribute__((__packed__)) tile_archive_rec {
+	uint8_t type; // Always 'P'
+	uint8_t same_image; // Continues the image of the last record
+	uint16_t count; // Number of the file the print was saved to
+	uint16_t tiles_w;
+	uint16_t tiles;
+	uint16_t new_tiles;
+};
+
+static bool fgp_receive_view_idle(struct recv_ctx *ctx)
+{
+	return (!ctx->recomp_running && !ctx->busy &&
+		(furi_get_tick() - ctx->idle_tick) > furi_ms_to_ticks(RECOMP_IDLE_MS));
+}
+
 static void fgp_receive_view_timer(void *context)
 {
 	struct recv_ctx *ctx = context;
 
+	/* Checked again when the event is handled, a packet may have come in
+	 * since.
+	 */
+	if (fgp_receive_view_idle(ctx))
+		view_dispatcher_send_custom_event(ctx->view_dispatcher, IDLE);
+
 	with_view_model(ctx->view,
 			struct recv_model * model,
 			{ UNUSED(model); },
 			true);
 }
 
+/* Leave the SD card to the receive path the moment anything shows up. Returns
+ * once the recompress thread is off of the SD card.
+ */
+static void fgp_receive_view_recomp_pause(struct recv_ctx *ctx)
+{
+	ctx->idle_tick = furi_get_tick();
+	if (ctx->recomp_running) {
+		recompress_pause(ctx->fgp->recompress);
+		ctx->recomp_running = false;
+	}
+}
+
 static void printer_callback(void *context, struct gb_image *image, enum cb_reason reason)
 {
 	struct recv_ctx *ctx = context;
@@ -67,7 +200,13 @@ static void printer_callback(void *context, struct gb_image *image, enum cb_reas
 
 	switch (reason) {
 	case reason_line_xfer:
+		/* Holds off IDLE until the event handler pauses recompression */
+		ctx->idle_tick = furi_get_tick();
 		ctx->packet_cnt++;
+		/* Rows of tiles already received can be converted while the
+		 * rest of the image is still on its way.
+		 */
+		ctx->volatile_image = image;
 		view_dispatcher_send_custom_event(ctx->view_dispatcher, LINE_XFER);
 		break;
 	case reason_print:
@@ -82,6 +221,7 @@ static void printer_callback(void *context, struct gb_image *image, enum cb_reas
 		 * queue but that image will not have been marked as printed so
 		 * the receive proto will tell the GB that it is still printing.
 		 */
+		ctx->busy = true;
 		ctx->volatile_image = image;
 		view_dispatcher_send_custom_event(ctx->view_dispatcher, PRINT);
 		break;
@@ -93,6 +233,798 @@ static void printer_callback(void *context, struct gb_image *image, enum cb_reas
 }
 
 
+/* Work out the width of a new image, and everything that follows from it.
+ * The printer protocol itself has no notion of width, every print from a GB
+ * is 160 px wide.
+ */
+static void fgp_receive_view_geometry(struct recv_ctx *ctx, struct gb_image *image)
+{
+	UNUSED(image);
+
+	if (ctx->px_w)
+		return;
+
+	ctx->px_w = 160; // TODO: Photo! transfer will be less than this
+	ctx->tile_row_sz = (ctx->px_w / 8) * 16; // 16 bytes per tile
+}
+
+/* True if palette takes every shade to a different one, so which shade the
+ * tile data had can always be told from the result.
+ */
+static bool fgp_receive_view_pal_is_order(uint8_t palette)
+{
+	unsigned int shades = 0;
+	unsigned int shade;
+
+	for (shade = 0; shade < 4; shade++)
+		shades |= (1 << ((palette >> (shade * 2)) & 0x03));
+
+	return (shades == 0x0f);
+}
+
+/* The palette byte that takes each shade of a segment sent with palette byte
+ * palette to the PNG index of a PLTE in the order of palette byte order that
+ * has the same shade, index shade itself if it does. A shade order doesn't
+ * have goes to the nearest one.
+ */
+static uint8_t fgp_receive_view_pal_rebase(uint8_t order, uint8_t palette)
+{
+	unsigned int shade;
+	unsigned int want;
+	unsigned int idx;
+	unsigned int best;
+	uint8_t out = 0;
+
+	if (palette == 0x00)
+		palette = 0xe4;
+
+	for (shade = 0; shade < 4; shade++) {
+		want = (palette >> (shade * 2)) & 0x03;
+		best = shade;
+		for (idx = 0; idx < 4; idx++) {
+			if (abs((int)((order >> (idx * 2)) & 0x03) - (int)want) <
+			    abs((int)((order >> (best * 2)) & 0x03) - (int)want))
+				best = idx;
+		}
+		out |= best << (shade * 2);
+	}
+
+	return out;
+}
+
+/* The PLTE of palette idx for the PNG of the current image, in the order of
+ * plte_pal. Only good until the next call.
+ */
+static const uint8_t *fgp_receive_view_plte_get(struct recv_ctx *ctx, unsigned int idx)
+{
+	if (ctx->plte_pal == 0xe4)
+		return palette_plte_get(idx);
+
+	png_plte_order_build(ctx->plte, palette_plte_get(idx), ctx->plte_pal);
+
+	return ctx->plte;
+}
+
+/* Hand any whole rows of tiles received since the last call over to the PNG
+ * encoder. Called for every packet as it arrives, so by the time the print
+ * command shows up, the bulk of the image is already converted.
+ */
+static void fgp_receive_view_convert(struct recv_ctx *ctx, struct gb_image *image)
+{
+	size_t rows;
+
+	/* Scaled or transformed PNGs are streamed out straight from the tiles
+	 * at print time.
+	 */
+	if (!(ctx->fgp->options & OPT_SAVE_PNG) || ctx->fgp->png_scale != 1 ||
+	    ctx->fgp->png_xform != XFORM_NONE || (ctx->fgp->options & OPT_FAST_CAPTURE))
+		return;
+
+	fgp_receive_view_geometry(ctx, image);
+
+	/* The image shrank out from under us, the GB must have started over */
+	if (image->data_sz < ctx->conv_sz)
+		ctx->conv_sz = 0;
+
+	rows = (image->data_sz - ctx->conv_sz) / ctx->tile_row_sz;
+	if (!rows)
+		return;
+
+	/* First rows of a new image, lay out a segment at its width */
+	if (!ctx->conv_sz)
+		png_seg_reset(ctx->png_handle, ctx->px_w);
+
+	png_dat_write_tiles(ctx->png_handle, image->data + ctx->conv_sz, rows, ctx->remap);
+	ctx->conv_sz += rows * ctx->tile_row_sz;
+}
+
+/* Save the raw tile data of the image, only whole rows of tiles at the width
+ * of this image are written out.
+ */
+static bool fgp_receive_view_save_bin(struct recv_ctx *ctx, struct gb_image *image, bool same_image)
+{
+	size_t len = (image->data_sz / ctx->tile_row_sz) * ctx->tile_row_sz;
+	bool error = false;
+
+	/* Save binary version always */
+	/* We don't care if this was previously opened or not, we just
+	 * need to blindly append data to it and its fine.
+	 */
+	if (ctx->fgp->options & OPT_SAVE_BIN) {
+		error |= !fgp_storage_open(ctx->file_handle, ".bin");
+		error |= !fgp_storage_write(ctx->file_handle, image->data, len);
+		error |= !fgp_storage_close(ctx->file_handle);
+	}
+
+	/* Similar above, we want to just append to this file, but, if
+	 * this is the same image, we don't want to re-add the header.
+	 */
+	if (ctx->fgp->options & OPT_SAVE_BIN_HDR) {
+		error |= !fgp_storage_open(ctx->file_handle, "-hdr.bin");
+		if (!same_image)
+			error |= !fgp_storage_write(ctx->file_handle, "GB-BIN01", 8);
+		error |= !fgp_storage_write(ctx->file_handle, image->data, len);
+		error |= !fgp_storage_close(ctx->file_handle);
+	}
+
+	return error;
+}
+
+/* Fast capture, only the tiles and the print command bytes needed to convert
+ * them later are saved. Nothing is converted, cached, or thumbnailed here, so
+ * the next print can be taken in as soon as possible. Prints that compress,
+ * blank areas, text, etc., are saved RLE compressed, the same as they came over
+ * the link cable, for less to write to the SD card. The reprint hash is worked
+ * out as the packets are copied in, it costs nothing extra here.
+ */
+static bool fgp_receive_view_save_capture(struct recv_ctx *ctx, struct gb_image *image, bool same_image)
+{
+	struct capture_rec rec;
+	const uint8_t *data = image->data;
+	size_t len;
+	size_t rle_len;
+	bool error = false;
+
+	rec.type = 'P';
+	rec.margins = image->margins;
+	rec.palette = image->palette;
+	rec.exposure = image->exposure;
+	rec.tiles_w = ctx->px_w / 8;
+	rec.tiles_h = image->data_sz / ctx->tile_row_sz;
+
+	len = rec.tiles_h * ctx->tile_row_sz;
+	rle_len = rle_rows_encode(ctx->rle_buf, image->data, ctx->tile_row_sz, rec.tiles_h);
+	if (rle_len < len) {
+		rec.type = 'R';
+		data = ctx->rle_buf;
+		len = rle_len;
+	}
+
+	error |= !fgp_storage_open(ctx->file_handle, CAPTURE_EXT);
+	if (!same_image)
+		error |= !fgp_storage_write(ctx->file_handle, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1);
+	error |= !fgp_storage_write(ctx->file_handle, &rec, sizeof(rec));
+	error |= !fgp_storage_write(ctx->file_handle, data, len);
+	error |= !fgp_storage_close(ctx->file_handle);
+
+	return error;
+}
+
+/* Named in files as -<name>[<seg>] before the palette. Each segment of a
+ * transformed image is its own file, later segments are numbered from 2.
+ */
+static const char * const xform_name[XFORM_COUNT] = {
+	NULL,
+	"photo",
+	"trim",
+	"mirror",
+	"rot",
+};
+
+/* Add the print to the tile archive of the session. Only tiles never seen
+ * before this session are written, everything else is an index in to those.
+ */
+static bool fgp_receive_view_save_tiles(struct recv_ctx *ctx, struct gb_image *image, bool same_image)
+{
+	struct tile_archive_rec rec;
+	size_t tiles = (image->data_sz / ctx->tile_row_sz) * (ctx->px_w / 8);
+	uint16_t *map = malloc(tiles * sizeof(uint16_t));
+	bool *added = malloc(tiles * sizeof(bool));
+	size_t i;
+	size_t run;
+	bool error = false;
+
+	error |= !fgp_storage_open_session(ctx->file_handle, "-tiles.tda", !ctx->tile_dict);
+	if (!ctx->tile_dict) {
+		ctx->tile_dict = tile_dict_alloc(TILE_DICT_MAX);
+		error |= !fgp_storage_write(ctx->file_handle, "GB-TDA01", 8);
+	}
+
+	rec.type = 'P';
+	rec.same_image = same_image;
+	rec.count = fgp_storage_count_get(ctx->file_handle);
+	rec.tiles_w = ctx->px_w / 8;
+	rec.tiles = tiles;
+	rec.new_tiles = 0;
+
+	for (i = 0; i < tiles; i++) {
+		map[i] = tile_dict_get(ctx->tile_dict, image->data + (i * 16), &added[i]);
+		rec.new_tiles += added[i];
+	}
+
+	error |= !fgp_storage_write(ctx->file_handle, &rec, sizeof(rec));
+	if (tiles)
+		error |= !fgp_storage_write(ctx->file_handle, map, tiles * sizeof(uint16_t));
+
+	/* Write new tiles in runs, a new photo is mostly one long run */
+	for (i = 0; i < tiles; i += run) {
+		for (run = 0; (i + run) < tiles && added[i + run]; run++);
+		if (run)
+			error |= !fgp_storage_write(ctx->file_handle, image->data + (i * 16), run * 16);
+		else
+			run = 1;
+	}
+
+	error |= !fgp_storage_close(ctx->file_handle);
+	free(added);
+	free(map);
+
+	return error;
+}
+
+/* Time each frame of the animation is shown for */
+#define APNG_DELAY_MS	500
+
+/* Add the print as the next frame of the animation of the session. Only the
+ * rect of tiles that changed since the last frame is encoded, the rest of the
+ * last frame is left showing.
+ */
+static bool fgp_receive_view_save_apng(struct recv_ctx *ctx, struct gb_image *image, const uint8_t *lut)
+{
+	size_t tiles_w = ctx->px_w / 8;
+	size_t len = (image->data_sz / ctx->tile_row_sz) * ctx->tile_row_sz;
+	size_t tiles_h = len / ctx->tile_row_sz;
+	size_t x0 = tiles_w;
+	size_t y0 = tiles_h;
+	size_t x1 = 0;
+	size_t y1 = 0;
+	size_t i;
+	size_t tile_y;
+	size_t row;
+	struct tile_xform xf = { 0 };
+	const uint8_t *band;
+	FuriString *fs_tmp;
+	bool first = !ctx->apng;
+	bool error = false;
+
+	if (!len)
+		return false;
+
+	/* Every frame is drawn on the canvas the first one set up, a print of
+	 * any other size starts an animation of its own.
+	 */
+	if (!first && len != ctx->apng_len) {
+		FURI_LOG_I("recv", "%u byte print starts a new animation", len);
+		ctx->apng_num++;
+		first = true;
+	}
+
+	if (first) {
+		if (!ctx->apng)
+			ctx->apng = png_stream_alloc(160 * 4);
+		free(ctx->apng_prev);
+		ctx->apng_prev = malloc(len);
+		ctx->apng_len = len;
+		png_stream_reset(ctx->apng, ctx->px_w, ctx->fgp->png_scale);
+		png_stream_palette_set(ctx->apng, palette_plte_get(ctx->fgp->palette_idx));
+	}
+
+	xf.w = tiles_w;
+	xf.h = tiles_h;
+	if (!first && image->palette == ctx->apng_palette) {
+		for (i = 0; i < (len / 16); i++) {
+			if (!memcmp(image->data + (i * 16), ctx->apng_prev + (i * 16), 16))
+				continue;
+			x0 = MIN(x0, i % tiles_w);
+			x1 = MAX(x1, i % tiles_w);
+			y0 = MIN(y0, i / tiles_w);
+			y1 = MAX(y1, i / tiles_w);
+		}
+
+		/* A frame can't be empty, a repeat is the first tile again */
+		if (x0 > x1) {
+			x0 = x1 = 0;
+			y0 = y1 = 0;
+		}
+
+		xf.x = x0;
+		xf.y = y0;
+		xf.w = x1 - x0 + 1;
+		xf.h = y1 - y0 + 1;
+	}
+
+	fs_tmp = furi_string_alloc_set("-anim");
+	if (ctx->apng_num)
+		furi_string_cat_printf(fs_tmp, "%u", ctx->apng_num + 1);
+	furi_string_cat_printf(fs_tmp, "-%s", palette_shortname_get(ctx->fgp->palette_idx));
+	if (ctx->fgp->png_scale != 1)
+		furi_string_cat_printf(fs_tmp, "-%ux", ctx->fgp->png_scale);
+	furi_string_cat_str(fs_tmp, ".png");
+	error |= !fgp_storage_open_session(ctx->file_handle, furi_string_get_cstr(fs_tmp), first);
+	furi_string_free(fs_tmp);
+
+	/* Frames go where IEND was, then the frame count in acTL is updated */
+	if (first)
+		error |= !png_stream_apng_start(ctx->apng, tiles_h * 8, fgp_storage_write, ctx->file_handle);
+	else
+		error |= !fgp_storage_seek(ctx->file_handle, -(png_stream_len_get(ctx->apng, IEND)), false);
+
+	png_stream_frame_start(ctx->apng, fgp_storage_write, ctx->file_handle,
+			       xf.x * 8, xf.y * 8, xf.w * 8, xf.h * 8, APNG_DELAY_MS);
+	for (tile_y = 0; tile_y < xf.h; tile_y++) {
+		band = tile_xform_band(ctx->band, image->data, tiles_w, &xf, tile_y);
+		for (row = 0; row < 8; row++) {
+			tile_row_get(ctx->scan_row, band, xf.w, row, lut);
+			png_stream_row(ctx->apng, ctx->scan_row);
+		}
+	}
+	error |= !png_stream_frame_finish(ctx->apng);
+
+	error |= !fgp_storage_seek(ctx->file_handle, PNG_ACTL_OFFS, true);
+	error |= !fgp_storage_write(ctx->file_handle, png_stream_buf_get(ctx->apng, ACTL), png_stream_len_get(ctx->apng, ACTL));
+	error |= !fgp_storage_close(ctx->file_handle);
+
+	memcpy(ctx->apng_prev, image->data, len);
+	ctx->apng_palette = image->palette;
+
+	return error;
+}
+
+static void fgp_receive_view_gif_name(struct recv_ctx *ctx, FuriString *fs, unsigned int idx)
+{
+	furi_string_printf(fs, "-%s", palette_shortname_get(idx));
+	if (ctx->fgp->png_scale != 1)
+		furi_string_cat_printf(fs, "-%ux", ctx->fgp->png_scale);
+	furi_string_cat_str(fs, ".gif");
+}
+
+/* Copy the finished GIF in to each palette in gif_copies, writing over just
+ * the color table at its fixed offset.
+ */
+static bool fgp_receive_view_gif_copy(struct recv_ctx *ctx)
+{
+	unsigned int idx;
+	bool error = false;
+	FuriString *fs_tmp;
+	FuriString *fs_copy;
+
+	if (!ctx->gif_copies)
+		return false;
+
+	fs_tmp = furi_string_alloc();
+	fs_copy = furi_string_alloc();
+	fgp_receive_view_gif_name(ctx, fs_tmp, ctx->fgp->palette_idx);
+
+	for (idx = 0; idx < palette_count_get(); idx++) {
+		if (!(ctx->gif_copies & (1UL << idx)))
+			continue;
+
+		fgp_receive_view_gif_name(ctx, fs_copy, idx);
+		error |= !fgp_storage_copy(ctx->file_handle, furi_string_get_cstr(fs_tmp), furi_string_get_cstr(fs_copy));
+		error |= !fgp_storage_open(ctx->file_handle, furi_string_get_cstr(fs_copy));
+		error |= !fgp_storage_seek(ctx->file_handle, GIF_GCT_OFFS, true);
+		error |= !fgp_storage_write(ctx->file_handle, palette_rgb16_get(idx), GIF_GCT_LEN);
+		error |= !fgp_storage_close(ctx->file_handle);
+	}
+	ctx->gif_copies = 0;
+
+	furi_string_free(fs_copy);
+	furi_string_free(fs_tmp);
+
+	return error;
+}
+
+/* Save the image as a GIF, scaled up by png_scale, in the selected palette
+ * and any extra ones. Stacked images are extended just like PNGs are.
+ */
+static bool fgp_receive_view_save_gif(struct recv_ctx *ctx, struct gb_image *image, bool same_image, const uint8_t *lut)
+{
+	size_t rows = (image->data_sz / ctx->tile_row_sz) * 8;
+	uint32_t palettes = palette_set_mask_get(ctx->fgp->palette_set_idx) | (1UL << ctx->fgp->palette_idx);
+	size_t row;
+	bool error = false;
+	FuriString *fs_tmp;
+
+	if (!ctx->gif)
+		ctx->gif = gif_alloc();
+
+	fs_tmp = furi_string_alloc();
+	fgp_receive_view_gif_name(ctx, fs_tmp, ctx->fgp->palette_idx);
+
+	error |= !fgp_storage_open(ctx->file_handle, furi_string_get_cstr(fs_tmp));
+	if (!same_image) {
+		gif_reset(ctx->gif, ctx->px_w, ctx->fgp->png_scale);
+		gif_palette_set(ctx->gif, palette_rgb16_get(ctx->fgp->palette_idx));
+	} else {
+		error |= !fgp_storage_seek(ctx->file_handle, -(gif_len_get(ctx->gif, GIF_TRAILER)), false);
+	}
+
+	gif_start(ctx->gif, rows, fgp_storage_write, ctx->file_handle, same_image);
+	for (row = 0; row < rows; row++) {
+		tile_row_get(ctx->scan_row, image->data, ctx->px_w / 8, row, lut);
+		gif_row(ctx->gif, ctx->scan_row);
+	}
+	error |= !gif_finish(ctx->gif);
+
+	error |= !fgp_storage_seek(ctx->file_handle, 0, true);
+	error |= !fgp_storage_write(ctx->file_handle, gif_buf_get(ctx->gif, GIF_HEAD), gif_len_get(ctx->gif, GIF_HEAD));
+	error |= !fgp_storage_close(ctx->file_handle);
+
+	furi_string_free(fs_tmp);
+
+	/* Other palettes only differ in the color table, they are copies of
+	 * this file made once the image is finished.
+	 */
+	ctx->gif_copies = palettes & ~(1UL << ctx->fgp->palette_idx);
+	if (image->margins & 0x0f)
+		error |= fgp_receive_view_gif_copy(ctx);
+
+	return error;
+}
+
+static void fgp_receive_view_png_name(struct recv_ctx *ctx, FuriString *fs, unsigned int idx)
+{
+	furi_string_reset(fs);
+
+	if (ctx->fgp->png_xform != XFORM_NONE) {
+		furi_string_cat_printf(fs, "-%s", xform_name[ctx->fgp->png_xform]);
+		if (ctx->seg)
+			furi_string_cat_printf(fs, "%u", ctx->seg + 1);
+	}
+
+	furi_string_cat_printf(fs, "-%s", palette_shortname_get(idx));
+	if (ctx->fgp->png_scale != 1)
+		furi_string_cat_printf(fs, "-%ux", ctx->fgp->png_scale);
+	furi_string_cat_str(fs, ".png");
+}
+
+/* Copy the finished png_stream PNG in to each palette in png_copies. Only
+ * PLTE, at a fixed offset right after IHDR, is written over.
+ */
+static bool fgp_receive_view_png_copy(struct recv_ctx *ctx)
+{
+	unsigned int idx;
+	bool error = false;
+	FuriString *fs_tmp;
+	FuriString *fs_copy;
+
+	if (!ctx->png_copies)
+		return false;
+
+	fs_tmp = furi_string_alloc();
+	fs_copy = furi_string_alloc();
+	fgp_receive_view_png_name(ctx, fs_tmp, ctx->fgp->palette_idx);
+
+	for (idx = 0; idx < palette_count_get(); idx++) {
+		if (!(ctx->png_copies & (1UL << idx)))
+			continue;
+
+		fgp_receive_view_png_name(ctx, fs_copy, idx);
+		png_stream_palette_set(ctx->png_stream, fgp_receive_view_plte_get(ctx, idx));
+		error |= !fgp_storage_copy(ctx->file_handle, furi_string_get_cstr(fs_tmp), furi_string_get_cstr(fs_copy));
+		error |= !fgp_storage_open(ctx->file_handle, furi_string_get_cstr(fs_copy));
+		error |= !fgp_storage_seek(ctx->file_handle, PNG_PLTE_OFFS, true);
+		error |= !fgp_storage_write(ctx->file_handle, png_stream_buf_get(ctx->png_stream, PLTE), png_stream_len_get(ctx->png_stream, PLTE));
+		error |= !fgp_storage_close(ctx->file_handle);
+	}
+	png_stream_palette_set(ctx->png_stream, fgp_receive_view_plte_get(ctx, ctx->fgp->palette_idx));
+	ctx->png_copies = 0;
+
+	furi_string_free(fs_copy);
+	furi_string_free(fs_tmp);
+
+	return error;
+}
+
+/* The last image was left open to be extended, but the next print starts a
+ * new one, or the session is over. Make the palette copies of it that were
+ * held back.
+ */
+static bool fgp_receive_view_copies_finish(struct recv_ctx *ctx)
+{
+	bool error = false;
+
+	error |= fgp_receive_view_png_copy(ctx);
+	error |= fgp_receive_view_gif_copy(ctx);
+
+	return error;
+}
+
+/* Set up xf for the selected transform of image. Returns false if the result
+ * had to be cut short to fit.
+ */
+static bool fgp_receive_view_xform_get(struct recv_ctx *ctx, struct gb_image *image, struct tile_xform *xf)
+{
+	bool cut = false;
+
+	memset(xf, 0, sizeof(struct tile_xform));
+	xf->w = ctx->px_w / 8;
+	xf->h = image->data_sz / ctx->tile_row_sz;
+
+	switch (ctx->fgp->png_xform) {
+	case XFORM_PHOTO:
+		/* The photo sits 16 px in from the top left of the frame of
+		 * a 160x144 GB Camera print. Anything else isn't a photo and
+		 * is saved whole.
+		 */
+		if (xf->w == 20 && xf->h == 18) {
+			xf->x = 2;
+			xf->y = 2;
+			xf->w = 16;
+			xf->h = 14;
+		}
+		break;
+	case XFORM_TRIM:
+		tile_xform_trim(xf, image->data, ctx->px_w / 8);
+		break;
+	case XFORM_MIRROR:
+		xf->mirror = true;
+		break;
+	case XFORM_ROTATE:
+		/* Turned on its side, every row of tiles becomes a column.
+		 * Only a print taller than any GB sends is too wide for that.
+		 */
+		if (xf->h > XFORM_TILES_MAX) {
+			xf->h = XFORM_TILES_MAX;
+			cut = true;
+		}
+		xf->rotate = true;
+		break;
+	default:
+		break;
+	}
+
+	return !cut;
+}
+
+/* Save the image, after transform xf, as a compressed PNG, scaled up by
+ * png_scale, and at 1bpp if shades, the mask of shades used, allows it. Each
+ * band of tiles is transformed, then each row of it is converted, scaled,
+ * compressed, and written out on its own, so no more than a single row of the
+ * scaled image is ever in memory.
+ */
+static bool fgp_receive_view_save_png_stream(struct recv_ctx *ctx, struct gb_image *image, const struct tile_xform *xf, bool same_image, uint32_t palettes, unsigned int shades)
+{
+	const uint8_t *band;
+	size_t tiles_w;
+	size_t tiles_h;
+	size_t tile_y;
+	size_t row;
+	bool error = false;
+	FuriString *fs_tmp;
+
+	fs_tmp = furi_string_alloc();
+	fgp_receive_view_png_name(ctx, fs_tmp, ctx->fgp->palette_idx);
+
+	error |= !fgp_storage_open(ctx->file_handle, furi_string_get_cstr(fs_tmp));
+
+	/* Extending a scaled PNG works just like the unscaled one. Seek back
+	 * over the trailer, add the new rows, write a new trailer, then
+	 * rewrite IHDR with the new height.
+	 */
+	tile_xform_size_get(xf, &tiles_w, &tiles_h);
+	if (!same_image) {
+		png_stream_reset(ctx->png_stream, tiles_w * 8, ctx->fgp->png_scale);
+		png_stream_shades_set(ctx->png_stream, shades);
+		png_stream_palette_set(ctx->png_stream, fgp_receive_view_plte_get(ctx, ctx->fgp->palette_idx));
+	} else {
+		error |= !fgp_storage_seek(ctx->file_handle, -(png_stream_len_get(ctx->png_stream, TRAILER)), false);
+	}
+
+	/* Rows already converted as the packets arrived, at 1x and with no
+	 * transform, are taken as they are.
+	 */
+	png_stream_start(ctx->png_stream, fgp_storage_write, ctx->file_handle, same_image);
+	for (tile_y = 0; tile_y < tiles_h; tile_y++) {
+		band = tile_xform_band(ctx->band, image->data, ctx->px_w / 8, xf, tile_y);
+		for (row = 0; row < 8; row++) {
+			if (ctx->conv_sz) {
+				png_stream_row(ctx->png_stream, png_seg_row_get(ctx->png_handle, (tile_y * 8) + row));
+				continue;
+			}
+			tile_row_get(ctx->scan_row, band, tiles_w, row, ctx->remap);
+			png_stream_row(ctx->png_stream, ctx->scan_row);
+		}
+	}
+	error |= !png_stream_finish(ctx->png_stream);
+
+	error |= !fgp_storage_seek(ctx->file_handle, 0, true);
+	error |= !fgp_storage_write(ctx->file_handle, png_stream_buf_get(ctx->png_stream, IHDR), png_stream_len_get(ctx->png_stream, IHDR));
+	error |= !fgp_storage_close(ctx->file_handle);
+
+	furi_string_free(fs_tmp);
+
+	/* The file in the selected palette is the only one encoded. Every other
+	 * palette is a copy of it, made once the image is finished. A segment
+	 * of a transformed image is a file of its own and is always finished.
+	 */
+	ctx->png_copies = palettes & ~(1UL << ctx->fgp->palette_idx);
+	if ((image->margins & 0x0f) || ctx->fgp->png_xform != XFORM_NONE)
+		error |= fgp_receive_view_png_copy(ctx);
+
+	return error;
+}
+
+/* Export the selected image in the print cache, in the selected palette,
+ * scaled up by png_scale, as a PNG or GIF. It is named after the file the
+ * image was saved to. The image is entirely in RAM, the SD card is only
+ * written to.
+ */
+static bool fgp_receive_view_export(struct recv_ctx *ctx, bool gif)
+{
+	const struct print_cache_img *img;
+	unsigned int scale = ctx->fgp->png_scale;
+	size_t stride;
+	size_t row;
+	int sel = 0;
+	int pal = 0;
+	void *enc;
+	bool error = false;
+	FuriString *fs_tmp;
+
+	with_view_model(ctx->view,
+			struct recv_model * model,
+			{ sel = model->cache_sel; pal = model->export_pal; },
+			false);
+
+	if (!ctx->print_cache)
+		return false;
+	img = print_cache_get(ctx->print_cache, sel);
+	if (!img)
+		return false;
+	stride = img->px_w / 4;
+
+	/* Never the name of a file saved while receiving, one of those may
+	 * still be added to by a stacked print.
+	 */
+	fs_tmp = furi_string_alloc_printf("-exp-%s", palette_shortname_get(pal));
+	if (scale != 1)
+		furi_string_cat_printf(fs_tmp, "-%ux", scale);
+	furi_string_cat_str(fs_tmp, gif ? ".gif" : ".png");
+
+	error |= !fgp_storage_open_count(ctx->file_handle, img->count, furi_string_get_cstr(fs_tmp));
+
+	/* Encoders of their own, the ones used while receiving may still need
+	 * to extend the image saved last.
+	 */
+	if (gif) {
+		enc = gif_alloc();
+		gif_reset(enc, img->px_w, scale);
+		gif_palette_set(enc, palette_rgb16_get(pal));
+		gif_start(enc, img->px_h, fgp_storage_write, ctx->file_handle, false);
+		for (row = 0; row < img->px_h; row++)
+			gif_row(enc, img->data + (row * stride));
+		error |= !gif_finish(enc);
+
+		error |= !fgp_storage_seek(ctx->file_handle, 0, true);
+		error |= !fgp_storage_write(ctx->file_handle, gif_buf_get(enc, GIF_HEAD), gif_len_get(enc, GIF_HEAD));
+		gif_free(enc);
+	} else {
+		enc = png_stream_alloc(img->px_w * scale);
+		png_stream_reset(enc, img->px_w, scale);
+		png_stream_palette_set(enc, palette_plte_get(pal));
+		png_stream_start(enc, fgp_storage_write, ctx->file_handle, false);
+		for (row = 0; row < img->px_h; row++)
+			png_stream_row(enc, img->data + (row * stride));
+		error |= !png_stream_finish(enc);
+
+		error |= !fgp_storage_seek(ctx->file_handle, 0, true);
+		error |= !fgp_storage_write(ctx->file_handle, png_stream_buf_get(enc, IHDR), png_stream_len_get(enc, IHDR));
+		png_stream_free(enc);
+	}
+	error |= !fgp_storage_close(ctx->file_handle);
+
+	FURI_LOG_I("recv", "export %04lu%s", img->count, furi_string_get_cstr(fs_tmp));
+	furi_string_free(fs_tmp);
+
+	print_cache_touch(ctx->print_cache, sel);
+	with_view_model(ctx->view,
+			struct recv_model * model,
+			{ model->cache_sel = 0; },
+			false);
+
+	return error;
+}
+
+/* Add the image to the thumbnail index of its folder. A stacked image is
+ * thumbnailed again in full from the print cache and its record rewritten.
+ * If the print cache no longer has all of it, only the size is updated.
+ */
+static void fgp_receive_view_save_thumb(struct recv_ctx *ctx, struct gb_image *image, bool same_image, const uint8_t *lut)
+{
+	struct thumb_rec *rec = thumb_rec_get(ctx->thumb);
+	const struct print_cache_img *img = NULL;
+	size_t rows = (image->data_sz / ctx->tile_row_sz) * 8;
+	size_t row;
+	bool error = false;
+	FuriString *fs_tmp;
+
+	if (ctx->print_cache)
+		img = print_cache_last_get(ctx->print_cache);
+
+	if (same_image) {
+		if (img && img->px_h == (rec->px_h + rows)) {
+			thumb_start(ctx->thumb, img->px_w, img->px_h);
+			for (row = 0; row < img->px_h; row++)
+				thumb_row(ctx->thumb, img->data + (row * (img->px_w / 4)));
+		}
+		rec->px_h += rows;
+	} else {
+		thumb_start(ctx->thumb, ctx->px_w, rows);
+		for (row = 0; row < rows; row++) {
+			tile_row_get(ctx->scan_row, image->data, ctx->px_w / 8, row, lut);
+			thumb_row(ctx->thumb, ctx->scan_row);
+		}
+
+		rec->count = fgp_storage_count_get(ctx->file_handle);
+		rec->px_w = ctx->px_w;
+		rec->px_h = rows;
+		rec->palette = ctx->fgp->palette_idx;
+
+		fs_tmp = furi_string_alloc();
+		if (ctx->fgp->options & OPT_SAVE_PNG)
+			fgp_receive_view_png_name(ctx, fs_tmp, ctx->fgp->palette_idx);
+		snprintf(rec->ext, sizeof(rec->ext), "%s", furi_string_get_cstr(fs_tmp));
+		furi_string_free(fs_tmp);
+	}
+
+	error |= !fgp_storage_open_folder(ctx->file_handle, THUMB_FILE);
+	if (same_image)
+		error |= !fgp_storage_seek(ctx->file_handle, -(off_t)sizeof(struct thumb_rec), false);
+	error |= (fgp_storage_write(ctx->file_handle, rec, sizeof(struct thumb_rec)) != sizeof(struct thumb_rec));
+	error |= !fgp_storage_close(ctx->file_handle);
+
+	if (error)
+		FURI_LOG_E("recv", "thumbnail not saved");
+}
+
+/* A reprint only gets a small text file naming the image it is a reprint of */
+static bool fgp_receive_view_save_link(struct recv_ctx *ctx, const struct dedup_rec *dup)
+{
+	char folder[FGP_FOLDER_LEN];
+	FuriString *fs_tmp;
+	bool error = false;
+
+	fgp_storage_folder_get(ctx->file_handle, folder);
+	fs_tmp = furi_string_alloc_printf("GCIM_%s_%04u\n", folder, dup->count);
+
+	error |= !fgp_storage_open(ctx->file_handle, "-dup.txt");
+	error |= (fgp_storage_write(ctx->file_handle, furi_string_get_cstr(fs_tmp), furi_string_size(fs_tmp)) !=
+		  furi_string_size(fs_tmp));
+	error |= !fgp_storage_close(ctx->file_handle);
+
+	furi_string_free(fs_tmp);
+
+	return error;
+}
+
+/* Add the image just saved to the hash index of its folder */
+static void fgp_receive_view_dedup_add(struct recv_ctx *ctx)
+{
+	bool error = false;
+
+	ctx->dedup_rec.count = fgp_storage_count_get(ctx->file_handle);
+	dedup_add(ctx->dedup, &ctx->dedup_rec);
+
+	error |= !fgp_storage_open_folder(ctx->file_handle, DEDUP_FILE);
+	error |= (fgp_storage_write(ctx->file_handle, &ctx->dedup_rec, sizeof(struct dedup_rec)) !=
+		  sizeof(struct dedup_rec));
+	error |= !fgp_storage_close(ctx->file_handle);
+
+	if (error)
+		FURI_LOG_E("recv", "hash index not saved");
+}
+
 static bool fgp_receive_view_event(uint32_t event, void *context)
 {
 	struct recv_ctx *ctx = context;
@@ -100,16 +1032,45 @@ static bool fgp_receive_view_event(uint32_t event, void *context)
 	bool consumed = false;
 	bool error = false;
 	FuriString *fs_tmp;
-	uint8_t px_y = 0;
-	uint8_t px_x = 0;
 	bool last_margin_zero = false;
 	bool same_image = false;
 	enum png_chunks chunk;
+	uint32_t palettes;
+	uint32_t hist[4];
+	unsigned int shades;
+	unsigned int idx;
+	struct tile_xform xf;
+	const uint8_t *lut;
+	uint8_t seg_pal;
+	const struct dedup_rec *dup = NULL;
+	char folder[FGP_FOLDER_LEN];
+
+	if (event == LINE_XFER) {
+		fgp_receive_view_recomp_pause(ctx);
+		fgp_receive_view_convert(ctx, ctx->volatile_image);
+		consumed = true;
+	}
 
-	if (event == LINE_XFER)
+	if (event == IDLE) {
+		if (fgp_receive_view_idle(ctx)) {
+			recompress_resume(ctx->fgp->recompress, true);
+			ctx->recomp_running = true;
+		}
 		consumed = true;
+	}
+
+	if (event == EXPORT || event == EXPORT_GIF) {
+		fgp_receive_view_recomp_pause(ctx);
+		error = fgp_receive_view_export(ctx, (event == EXPORT_GIF));
+		with_view_model(ctx->view,
+				struct recv_model * model,
+				{ if (error) model->errors++; else model->converted++; },
+				true);
+		consumed = true;
+	}
 
 	if (event == PRINT) {
+		fgp_receive_view_recomp_pause(ctx);
 		fs_tmp = furi_string_alloc();
 
 		/* Before we clobber the image data, take note of the margins.
@@ -123,117 +1084,265 @@ static bool fgp_receive_view_event(uint32_t event, void *context)
 
 		/* Copy the volatile image from the printer protocol handler to
 		 * a buffer we can work with locally after the print is marked
-		 * as complete.
+		 * as complete. When looking for reprints, the tile data is
+		 * hashed as it is copied, only what was received is copied.
 		 */
-		memcpy(image, ctx->volatile_image, sizeof(struct gb_image));
+		if (ctx->dedup) {
+			image->data_sz = ctx->volatile_image->data_sz;
+			image->margins = ctx->volatile_image->margins;
+			image->palette = ctx->volatile_image->palette;
+			image->exposure = ctx->volatile_image->exposure;
+			ctx->dedup_rec.hash = dedup_copy(image->data, ctx->volatile_image->data, image->data_sz);
+		} else {
+			memcpy(image, ctx->volatile_image, sizeof(struct gb_image));
+		}
 		printer_receive_print_complete(ctx->printer_handle);
 
 		/* Now look at the margins of this image, if there is no margin
 		 * at the start, and there was no margin at the end of the last
 		 * image, then assume these are intended to be the same image.
 		 */
-		if (last_margin_zero && !(image->margins & 0xf0))
+		fgp_receive_view_geometry(ctx, image);
+		if (last_margin_zero && !(image->margins & 0xf0) &&
+		    ctx->px_w == ctx->last_px_w)
 			same_image = true;
 
 		/* If the last margin was zero, we didn't increment the file count.
 		 * So if the last margin was zero, but its not the same image,
 		 * then bump the file count now.
 		 */
-		if (last_margin_zero && !same_image)
+		if (last_margin_zero && !same_image) {
+			if (fgp_receive_view_copies_finish(ctx)) {
+				with_view_model(ctx->view,
+						struct recv_model * model,
+						{ model->errors++; },
+						false);
+			}
 			fgp_storage_next_count(ctx->file_handle);
+		}
 
-		/* Prep some image information */
-		px_x = 160; // TODO: Photo! transfer will be less than this
-		px_y = image->data_sz / 40; // 40 is bytes per line, 160 px / 4 (px/byte)
+		/* The count may have moved on before midnight, a new image
+		 * still goes in the folder of today, and reprints are looked
+		 * up there.
+		 */
+		if (!same_image)
+			fgp_storage_date_refresh(ctx->file_handle);
+
+		/* Formats converted straight from the tiles at print time only
+		 * need the palette byte remap for this one image.
+		 */
+		lut = tile_palette_lut(ctx->lut, image->palette) ? ctx->lut : NULL;
+
+		/* Only whole images are looked up, a print that continues an
+		 * image, or could be continued by the next one, is always saved.
+		 */
+		if (ctx->dedup && !same_image && (image->margins & 0x0f)) {
+			fgp_storage_folder_get(ctx->file_handle, folder);
+			dedup_folder_set(ctx->dedup, folder);
+			ctx->dedup_rec.len = image->data_sz;
+			ctx->dedup_rec.tiles_w = ctx->px_w / 8;
+			ctx->dedup_rec.palette = image->palette;
+			dup = dedup_find(ctx->dedup, &ctx->dedup_rec);
+		}
+
+		/* A skipped reprint is exported under the number of the image it
+		 * is a reprint of, the current number goes to the next print.
+		 */
+		if (ctx->print_cache)
+			print_cache_add(ctx->print_cache, image->data, ctx->px_w / 8, image->data_sz / ctx->tile_row_sz,
+					lut, (dup && ctx->fgp->dup_mode == DUP_SKIP) ? dup->count :
+					fgp_storage_count_get(ctx->file_handle), same_image);
 
 		with_view_model(ctx->view,
 				struct recv_model * model,
-				{ model->count++; },
+				{
+					model->count++;
+					if (ctx->print_cache)
+						model->cache_cnt = print_cache_count_get(ctx->print_cache);
+					model->cache_sel = 0;
+					if (dup)
+						model->dups++;
+				},
 				false);
 
-		/* Save binary version always */
-		/* We don't care if this was previously opened or not, we just
-		 * need to blindly append data to it and its fine.
-		 */
-		if (ctx->fgp->options & OPT_SAVE_BIN) {
-			error |= !fgp_storage_open(ctx->file_handle, ".bin");
-			error |= !fgp_storage_write(ctx->file_handle, image, image->data_sz);
-			error |= !fgp_storage_close(ctx->file_handle);
+		if (dup) {
+			FURI_LOG_I("recv", "reprint of %04u", dup->count);
+			/* Not streamed either, the PC would only get it under
+			 * the number the next print is saved as.
+			 */
+			if (ctx->fgp->dup_mode == DUP_SKIP)
+				goto dup_done;
+			if (fgp_receive_view_save_link(ctx, dup)) {
+				with_view_model(ctx->view,
+						struct recv_model * model,
+						{ model->errors++; },
+						false);
+			}
 		}
 
-		/* Similar above, we want to just append to this file, but, if
-		 * this is the same image, we don't want to re-add the header.
-		 */
-		if (ctx->fgp->options & OPT_SAVE_BIN_HDR) {
-			error |= !fgp_storage_open(ctx->file_handle, "-hdr.bin");
-			if (!same_image)
-				error |= !fgp_storage_write(ctx->file_handle, "GB-BIN01", 8);
-			error |= !fgp_storage_write(ctx->file_handle, image, image->data_sz);
-			error |= !fgp_storage_close(ctx->file_handle);
+		if (ctx->usb_stream &&
+		    !usb_stream_print(ctx->usb_stream, image, fgp_storage_count_get(ctx->file_handle),
+				      ctx->px_w / 8, image->data_sz / ctx->tile_row_sz, same_image)) {
+			with_view_model(ctx->view,
+					struct recv_model * model,
+					{ model->errors++; },
+					false);
+		}
+
+		if (dup)
+			goto dup_done;
+
+		if (ctx->fgp->options & OPT_FAST_CAPTURE) {
+			if (fgp_receive_view_save_capture(ctx, image, same_image)) {
+				with_view_model(ctx->view,
+						struct recv_model * model,
+						{ model->errors++; },
+						false);
+			}
+			goto skip_png;
 		}
 
+		error |= fgp_receive_view_save_bin(ctx, image, same_image);
+		/* A full sheet leaves off the rest of the session */
+		if (ctx->sheet && !error)
+			sheet_add(ctx->sheet, fgp_storage_count_get(ctx->file_handle), ctx->px_w / 8,
+				  image->data_sz / ctx->tile_row_sz, image->palette, same_image);
+		if (ctx->fgp->options & OPT_SAVE_TILES)
+			error |= fgp_receive_view_save_tiles(ctx, image, same_image);
+		if (ctx->fgp->options & OPT_SAVE_APNG)
+			error |= fgp_receive_view_save_apng(ctx, image, lut);
+		if (ctx->fgp->options & OPT_SAVE_GIF)
+			error |= fgp_receive_view_save_gif(ctx, image, same_image, lut);
+
 		if (!(ctx->fgp->options & OPT_SAVE_PNG))
 			goto skip_png;
 
-		/* For saving to a PNG, the image data needs to be converted from
-		 * tiles to scanlines.
+		/* The palette byte only comes with the print command, after
+		 * the image data was already converted as it arrived. A PNG at
+		 * 1x takes it as the order of its PLTE instead, PNG index n is
+		 * given the color of the shade the palette byte turns n in to,
+		 * and the converted data is left alone. The first segment of an
+		 * image sets that order. Only a stacked segment sent with some
+		 * other palette byte is converted again, remapped to the order
+		 * of the first. A palette byte that turns two shades in to one
+		 * couldn't be an order for the segments after it, an image that
+		 * may still be stacked on is remapped from the start then.
+		 * Scaled or transformed PNGs are remapped as each row is
+		 * converted, nothing was converted ahead of those.
 		 */
-		tile_to_scanline(image->data, px_x / 8, px_y / 8);
-
-		/* Save PNG */
 		if (!same_image) {
-			png_reset(ctx->png_handle, px_x, px_y);
-			png_dat_write(ctx->png_handle, image->data);
-			png_palette_set(ctx->png_handle, palette_rgb16_get(ctx->fgp->palette_idx));
-			furi_string_printf(fs_tmp, "-%s.png", palette_shortname_get(ctx->fgp->palette_idx));
-			error |= !fgp_storage_open(ctx->file_handle, furi_string_get_cstr(fs_tmp));
-			for (chunk = CHUNK_START; chunk < CHUNK_COUNT; chunk++)
-				error |= !fgp_storage_write(ctx->file_handle,
-							    png_buf_get(ctx->png_handle, chunk),
-							    png_len_get(ctx->png_handle, chunk));
-			error |= !fgp_storage_close(ctx->file_handle);
-		} else {
-			furi_string_printf(fs_tmp, "-%s.png", palette_shortname_get(ctx->fgp->palette_idx));
-
-			/* The PNGs are saved with multiple IDAT chunks to make
-			 * expanding the images "easier". The first IDAT chunk is
-			 * the zlib header. +n IDAT chunks are images, each with
-			 * their own DEFLATE header. These can be up to 144 px tall
-			 * but can also be less. The last IDAT chunk is the adler32
-			 * zlib checksum.
-			 *
-			 * In order to expand an existing PNG image all we have to
-			 * is:
-			 * - Unset the BFINAL flag in the last image IDAT section
-			 *   that we still have in memory.
-			 * - Seek to the start of the last IDAT chunk with image data,
-			 *   This is the special LAST_IDAT offset.
-			 * - Rewrite the previous image (with BFINAL unset)
-			 * - Update the image buffer with the new height, which
-			 *   is also added to the IHDR in memory.
-			 * - Write the new image data to the image buffer,
-			 *   which also updates the running adler32.
-			 * - Write the new image data to disk.
-			 * - Rewrite the IDAT_CHECK, adler32 IDAT section.
-			 * - Rewrite IEND (which is static anyway).
-			 * - Jump to start of file.
-			 * - Finally, rewrite IHDR with the updated height of
-			 *   the full image.
-			 */
-			png_deflate_unfinal(ctx->png_handle);
+			ctx->plte_pal = 0xe4;
+			if (image->palette && ctx->fgp->png_scale == 1 && ctx->fgp->png_xform == XFORM_NONE &&
+			    ((image->margins & 0x0f) || fgp_receive_view_pal_is_order(image->palette)))
+				ctx->plte_pal = image->palette;
+		}
+		seg_pal = fgp_receive_view_pal_rebase(ctx->plte_pal, image->palette);
+		/* Every shade to index 0 is 0x00, which tile_palette_lut()
+		 * takes for the default.
+		 */
+		if (!seg_pal)
+			memset(ctx->png_lut, 0x00, sizeof(ctx->png_lut));
+		if (!seg_pal || tile_palette_lut(ctx->png_lut, seg_pal)) {
+			ctx->remap = ctx->png_lut;
+			if (ctx->conv_sz) {
+				png_seg_reset(ctx->png_handle, ctx->px_w);
+				ctx->conv_sz = 0;
+			}
+		}
+
+		/* The selected palette, and any extra ones */
+		palettes = palette_set_mask_get(ctx->fgp->palette_set_idx) | (1UL << ctx->fgp->palette_idx);
+
+		/* A transform can't carry on across segments, a trim or a
+		 * rotate of the next segment has nothing to do with this one.
+		 * So each segment is transformed, and saved, on its own.
+		 */
+		if (ctx->fgp->png_xform != XFORM_NONE) {
+			ctx->seg = same_image ? ctx->seg + 1 : 0;
+			same_image = false;
+		}
+
+		/* Prints of only 2 shades, text, stamps, etc., can be saved at
+		 * 1bpp in half the size. This is only done for images that can't
+		 * be extended later, i.e. have a bottom margin or are saved one
+		 * segment at a time, as the next segment could use any shade.
+		 */
+		shades = 0x0f;
+		if (!same_image && ((image->margins & 0x0f) || ctx->fgp->png_xform != XFORM_NONE)) {
+			tile_histogram(image->data, (image->data_sz / ctx->tile_row_sz) * ctx->tile_row_sz, hist);
+			shades = tile_shades_get(hist, seg_pal);
+		}
+
+		/* For saving to a PNG, the image data is converted from tiles to
+		 * scanlines as it is written to the IDAT chunks. Most of that
+		 * already happened as packets arrived, only whatever came in
+		 * after the last conversion is left. image->data is left as it
+		 * was received. A 1bpp PNG at 1x is packed from these same rows.
+		 */
+		fgp_receive_view_convert(ctx, image);
+
+		if (ctx->fgp->png_scale != 1 || ctx->fgp->png_xform != XFORM_NONE ||
+		    __builtin_popcount(shades) <= 2) {
+			if (!fgp_receive_view_xform_get(ctx, image, &xf)) {
+				FURI_LOG_W("recv", "transform cut short to %u tiles", XFORM_TILES_MAX);
+				error = true;
+			}
+			error |= fgp_receive_view_save_png_stream(ctx, image, &xf, same_image, palettes, shades);
+			goto png_done;
+		}
+
+		/* Save PNG, one file per palette. The image data is encoded
+		 * only once above, indexed PNGs in different palettes differ
+		 * in nothing but PLTE.
+		 */
+		if (!same_image)
+			png_reset(ctx->png_handle, ctx->px_w);
+		png_seg_append(ctx->png_handle);
+
+		for (idx = 0; idx < palette_count_get(); idx++) {
+			if (!(palettes & (1UL << idx)))
+				continue;
+
+			furi_string_printf(fs_tmp, "-%s.png", palette_shortname_get(idx));
 			error |= !fgp_storage_open(ctx->file_handle, furi_string_get_cstr(fs_tmp));
-			error |= !fgp_storage_seek(ctx->file_handle, -(png_len_get(ctx->png_handle, LAST_IDAT)), false);
-			error |= !fgp_storage_write(ctx->file_handle, png_buf_get(ctx->png_handle, IDAT), png_len_get(ctx->png_handle, IDAT));
-			png_add_height(ctx->png_handle, px_y);
-			png_dat_write(ctx->png_handle, image->data);
-			error |= !fgp_storage_write(ctx->file_handle, png_buf_get(ctx->png_handle, IDAT), png_len_get(ctx->png_handle, IDAT));
-			error |= !fgp_storage_write(ctx->file_handle, png_buf_get(ctx->png_handle, IDAT_CHECK), png_len_get(ctx->png_handle, IDAT_CHECK));
-			error |= !fgp_storage_write(ctx->file_handle, png_buf_get(ctx->png_handle, IEND), png_len_get(ctx->png_handle, IEND));
-			error |= !fgp_storage_seek(ctx->file_handle, 0, true);
-			error |= !fgp_storage_write(ctx->file_handle, png_buf_get(ctx->png_handle, IHDR), png_len_get(ctx->png_handle, IHDR));
+			if (!same_image) {
+				png_palette_set(ctx->png_handle, fgp_receive_view_plte_get(ctx, idx));
+				for (chunk = CHUNK_START; chunk < CHUNK_COUNT; chunk++)
+					error |= !fgp_storage_write(ctx->file_handle,
+								    png_buf_get(ctx->png_handle, chunk),
+								    png_len_get(ctx->png_handle, chunk));
+			} else {
+				/* The PNGs are saved with multiple IDAT chunks to make
+				 * expanding the images "easier". The first IDAT chunk is
+				 * the zlib header. +n IDAT chunks are image data, each
+				 * a non-final stored DEFLATE block of up to 16 px. The last
+				 * IDAT chunk is an empty, final DEFLATE block followed by
+				 * the adler32 zlib checksum.
+				 *
+				 * In order to expand an existing PNG image all we have to
+				 * is:
+				 * - Add the new segment to the image in memory, which
+				 *   updates the IHDR height and the running adler32.
+				 * - Seek back over IDAT_CHECK and IEND at the end of the
+				 *   file, this is the special TRAILER offset.
+				 * - Write the new image data IDAT chunks to disk.
+				 * - Rewrite the IDAT_CHECK, adler32 IDAT section.
+				 * - Rewrite IEND (which is static anyway).
+				 * - Jump to start of file.
+				 * - Finally, rewrite IHDR with the updated height of
+				 *   the full image.
+				 */
+				error |= !fgp_storage_seek(ctx->file_handle, -(png_len_get(ctx->png_handle, TRAILER)), false);
+				error |= !fgp_storage_write(ctx->file_handle, png_buf_get(ctx->png_handle, IDAT), png_len_get(ctx->png_handle, IDAT));
+				error |= !fgp_storage_write(ctx->file_handle, png_buf_get(ctx->png_handle, IDAT_CHECK), png_len_get(ctx->png_handle, IDAT_CHECK));
+				error |= !fgp_storage_write(ctx->file_handle, png_buf_get(ctx->png_handle, IEND), png_len_get(ctx->png_handle, IEND));
+				error |= !fgp_storage_seek(ctx->file_handle, 0, true);
+				error |= !fgp_storage_write(ctx->file_handle, png_buf_get(ctx->png_handle, IHDR), png_len_get(ctx->png_handle, IHDR));
+			}
 			error |= !fgp_storage_close(ctx->file_handle);
 		}
 
+png_done:
 		if (!error) {
 			with_view_model(ctx->view,
 					struct recv_model * model,
@@ -247,12 +1356,34 @@ static bool fgp_receive_view_event(uint32_t event, void *context)
 		}
 
 skip_png:
-		/* Don't increment yet if the end margin is 0 */
-		if ((image->margins & 0x0f))
+		/* Only streamed, nothing on the SD card to show a thumbnail of.
+		 * A fast capture gets its thumbnail from Convert Pending.
+		 */
+		if ((ctx->fgp->options & SAVE_OPTS) && !(ctx->fgp->options & OPT_FAST_CAPTURE))
+			fgp_receive_view_save_thumb(ctx, image, same_image, lut);
+
+		if (ctx->dedup && !same_image && (image->margins & 0x0f) && !error)
+			fgp_receive_view_dedup_add(ctx);
+
+dup_done:
+		/* The next image starts converting from scratch */
+		png_seg_reset(ctx->png_handle, ctx->px_w);
+		ctx->conv_sz = 0;
+		ctx->remap = NULL;
+		ctx->last_px_w = ctx->px_w;
+		ctx->px_w = 0;
+
+		/* Don't increment yet if the end margin is 0. A skipped
+		 * reprint wasn't saved under the current number at all.
+		 */
+		if ((image->margins & 0x0f) && !(dup && ctx->fgp->dup_mode == DUP_SKIP))
 			fgp_storage_next_count(ctx->file_handle);
 
 		furi_string_free(fs_tmp);
 
+		ctx->idle_tick = furi_get_tick();
+		ctx->busy = false;
+
 		consumed = true;
 	}
 
@@ -284,6 +1415,48 @@ static void fgp_receive_view_enter(void *context)
 	printer_receive_start(ctx->printer_handle);
 
 	ctx->png_handle = png_alloc(160, 144);
+	ctx->png_stream = png_stream_alloc(160 * 4);
+	ctx->scan_row = malloc(XFORM_TILES_MAX * 2);
+	ctx->band = malloc(XFORM_TILES_MAX * 16);
+	ctx->seg = 0;
+	ctx->tile_dict = NULL;
+	ctx->apng = NULL;
+	ctx->apng_prev = NULL;
+	ctx->apng_num = 0;
+	ctx->gif = NULL;
+	ctx->png_copies = 0;
+	ctx->gif_copies = 0;
+	/* Fast capture keeps nothing around to export */
+	ctx->print_cache = NULL;
+	if (!(ctx->fgp->options & OPT_FAST_CAPTURE))
+		ctx->print_cache = print_cache_alloc(PRINT_CACHE_LEN);
+	ctx->thumb = thumb_alloc();
+	ctx->rle_buf = NULL;
+	if (ctx->fgp->options & OPT_FAST_CAPTURE)
+		ctx->rle_buf = malloc(RLE_ROWS_LEN_MAX(sizeof(ctx->image->data)));
+	ctx->usb_stream = NULL;
+	if (ctx->fgp->options & OPT_STREAM_USB)
+		ctx->usb_stream = usb_stream_alloc();
+	ctx->dedup = NULL;
+	if (ctx->fgp->dup_mode != DUP_SAVE && (ctx->fgp->options & (SAVE_OPTS | OPT_FAST_CAPTURE)))
+		ctx->dedup = dedup_alloc();
+	/* The sheet is put together from the raw tile data saved of each image */
+	ctx->sheet = NULL;
+	if (ctx->fgp->sheet != SHEET_NONE && (ctx->fgp->options & (OPT_SAVE_BIN | OPT_SAVE_BIN_HDR)))
+		ctx->sheet = sheet_alloc();
+	ctx->conv_sz = 0;
+	ctx->remap = NULL;
+	ctx->plte_pal = 0xe4;
+	ctx->px_w = 0;
+	ctx->last_px_w = 0;
+	ctx->idle_tick = furi_get_tick();
+	ctx->busy = false;
+	ctx->recomp_running = false;
+
+	with_view_model(ctx->view,
+			struct recv_model * model,
+			{ model->export_pal = ctx->fgp->palette_idx; },
+			false);
 
 	ctx->timer = furi_timer_alloc(fgp_receive_view_timer, FuriTimerTypePeriodic, ctx);
 	furi_timer_start(ctx->timer, furi_ms_to_ticks(200));
@@ -292,11 +1465,50 @@ static void fgp_receive_view_enter(void *context)
 static void fgp_receive_view_exit(void *context)
 {
 	struct recv_ctx *ctx = context;
+	bool bin = !!(ctx->fgp->options & OPT_SAVE_BIN);
 
-	fgp_storage_free(ctx->file_handle);
 	furi_timer_free(ctx->timer);
+	recompress_pause(ctx->fgp->recompress);
+
+	/* The last image never got a bottom margin */
+	if (fgp_receive_view_copies_finish(ctx))
+		FURI_LOG_E("recv", "palette copies not saved");
+
+	/* Every image of the session is on the SD card now. The sheet is
+	 * written by its own scene, with progress, so it takes the files of
+	 * the session along.
+	 */
+	if (ctx->sheet && sheet_count_get(ctx->sheet)) {
+		sheet_write_start(ctx->sheet, ctx->file_handle, bin ? ".bin" : "-hdr.bin", bin ? 0 : 8,
+				  (ctx->fgp->sheet == SHEET_POSTER), ctx->fgp->sheet_gap, ctx->fgp->palette_idx);
+		ctx->fgp->sheet_out = ctx->sheet;
+		ctx->fgp->sheet_storage = ctx->file_handle;
+	} else {
+		if (ctx->sheet)
+			sheet_free(ctx->sheet);
+		fgp_storage_free(ctx->file_handle);
+	}
+	ctx->sheet = NULL;
 
 	png_free(ctx->png_handle);
+	png_stream_free(ctx->png_stream);
+	free(ctx->scan_row);
+	free(ctx->band);
+	if (ctx->tile_dict)
+		tile_dict_free(ctx->tile_dict);
+	if (ctx->apng)
+		png_stream_free(ctx->apng);
+	free(ctx->apng_prev);
+	if (ctx->gif)
+		gif_free(ctx->gif);
+	if (ctx->print_cache)
+		print_cache_free(ctx->print_cache);
+	thumb_free(ctx->thumb);
+	free(ctx->rle_buf);
+	if (ctx->usb_stream)
+		usb_stream_free(ctx->usb_stream);
+	if (ctx->dedup)
+		dedup_free(ctx->dedup);
 
 	printer_stop(ctx->printer_handle);
 
@@ -305,12 +1517,52 @@ static void fgp_receive_view_exit(void *context)
 }
 
 
+/* Left and Right pick a cached image, Up and Down a palette. OK exports it as
+ * a PNG, holding OK as a GIF.
+ */
 static bool fgp_receive_view_input(InputEvent *event, void *context)
 {
-	UNUSED(event);
-	UNUSED(context);
+	struct recv_ctx *ctx = context;
 	bool ret = false;
 
+	if (event->type == InputTypeShort || event->type == InputTypeRepeat) {
+		ret = true;
+		with_view_model(ctx->view,
+				struct recv_model * model,
+				{
+					switch (event->key) {
+					case InputKeyLeft:
+						if (model->cache_sel)
+							model->cache_sel--;
+						break;
+					case InputKeyRight:
+						if ((model->cache_sel + 1) < model->cache_cnt)
+							model->cache_sel++;
+						break;
+					case InputKeyUp:
+						if (model->export_pal)
+							model->export_pal--;
+						break;
+					case InputKeyDown:
+						if ((unsigned int)(model->export_pal + 1) < palette_count_get())
+							model->export_pal++;
+						break;
+					default:
+						ret = false;
+						break;
+					}
+				},
+				true);
+	}
+
+	if (event->key == InputKeyOk) {
+		if (event->type == InputTypeShort)
+			view_dispatcher_send_custom_event(ctx->view_dispatcher, EXPORT);
+		else if (event->type == InputTypeLong)
+			view_dispatcher_send_custom_event(ctx->view_dispatcher, EXPORT_GIF);
+		ret = true;
+	}
+
 	return ret;
 }
 
@@ -330,6 +1582,18 @@ static void fgp_receive_view_draw(Canvas *canvas, void* view_model)
 	snprintf(string, sizeof(string), "%d", model->errors);
 	canvas_draw_str(canvas, 66, 46, string);
 
+	if (model->dups) {
+		canvas_draw_str(canvas, 38, 22, "Dup:");
+		snprintf(string, sizeof(string), "%d", model->dups);
+		canvas_draw_str(canvas, 66, 22, string);
+	}
+
+	if (model->cache_cnt) {
+		snprintf(string, sizeof(string), "<%d/%d %s>", model->cache_sel + 1, model->cache_cnt,
+			 palette_shortname_get(model->export_pal));
+		canvas_draw_str(canvas, 30, 58, string);
+	}
+
 	canvas_draw_icon(canvas, 96, 3, &I_gbc_32x58);
 	canvas_draw_icon(canvas, 0, 2, &I_flipper_w_cable_26x61);
 	canvas_draw_frame(canvas, 91, 16, 5, 6);
@@ -346,6 +1610,13 @@ View *fgp_receive_view_get_view(void *context)
 	return ctx->view;
 }
 
+bool fgp_receive_view_sheet_pending(void *context)
+{
+	struct recv_ctx *ctx = context;
+
+	return (ctx->sheet && sheet_count_get(ctx->sheet));
+}
+
 void *fgp_receive_view_alloc(struct fgp_app *fgp)
 {
 	struct recv_ctx *ctx = malloc(sizeof(struct recv_ctx));
@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/include/crc.h>
+#include <src/include/zip_export.h>
+
+#define NAME_LEN	128
+
+/* Every file is copied through this, a piece at a time */
+#define ZIP_BUF		512
+
+/* The central directory is built up in a file of its own as each file is
+ * added, then copied to the end of the ZIP in one go.
+ */
+#define ZIP_EXT		".zip"
+#define ZIP_CD_EXT	".zip.cd"
+
+#define ZIP_VERSION	10 // 1.0, stored files only
+
+/* Every field is little endian, same as the STM32 */
+struct __attribute__((__packed__)) zip_local {
+	uint32_t sig;
+	uint16_t version;
+	uint16_t flags;
+	uint16_t method;
+	uint16_t time;
+	uint16_t date;
+	uint32_t crc;
+	uint32_t size_comp;
+	uint32_t size;
+	uint16_t name_len;
+	uint16_t extra_len;
+};
+
+struct __attribute__((__packed__)) zip_central {
+	uint32_t sig;
+	uint16_t version_made;
+	uint16_t version;
+	uint16_t flags;
+	uint16_t method;
+	uint16_t time;
+	uint16_t date;
+	uint32_t crc;
+	uint32_t size_comp;
+	uint32_t size;
+	uint16_t name_len;
+	uint16_t extra_len;
+	uint16_t comment_len;
+	uint16_t disk;
+	uint16_t attr_int;
+	uint32_t attr_ext;
+	uint32_t offs; // Of the local header
+};
+
+struct __attribute__((__packed__)) zip_end {
+	uint32_t sig;
+	uint16_t disk;
+	uint16_t cd_disk;
+	uint16_t entries_disk;
+	uint16_t entries;
+	uint32_t cd_size;
+	uint32_t cd_offs;
+	uint16_t comment_len;
+};
+
+#define ZIP_LOCAL_SIG	0x04034b50
+#define ZIP_CENTRAL_SIG	0x02014b50
+#define ZIP_END_SIG	0x06054b50
+
+/* Where the CRC and sizes are in the local header, written once known */
+#define ZIP_LOCAL_CRC_OFFS	offsetof(struct zip_local, crc)
+#define ZIP_LOCAL_CRC_LEN	12
+
+struct zip_export {
+	Storage *storage;
+	File *zip;
+	File *cd;
+	File *in;
+	uint8_t *buf;
+	uint16_t time; // MS-DOS time and date every file is stamped with
+	uint16_t date;
+	uint16_t entries;
+	uint32_t cd_size;
+};
+
+/* Copy the rest of in to the ZIP, returns the CRC of what was copied, len is
+ * set to how much that was.
+ */
+static bool zip_export_copy(struct zip_export *zip, File *in, uint32_t *crc, uint32_t *len)
+{
+	size_t cnt;
+
+	*crc = 0;
+	*len = 0;
+
+	while ((cnt = storage_file_read(in, zip->buf, ZIP_BUF))) {
+		*crc = crc_update(*crc, zip->buf, cnt);
+		*len += cnt;
+		if (storage_file_write(zip->zip, zip->buf, cnt) != cnt)
+			return false;
+	}
+
+	return true;
+}
+
+/* Add the file at path as name. The local header goes out first with no CRC
+ * or size, the file is copied, then the header is fixed up. Returns false if
+ * the ZIP can no longer be written, a file that can't be read is skipped.
+ */
+static bool zip_export_add(struct zip_export *zip, const char *path, const char *name, struct zip_stats *stats)
+{
+	struct zip_local local = { 0 };
+	struct zip_central central = { 0 };
+	uint32_t offs = storage_file_tell(zip->zip);
+	uint32_t crc;
+	uint32_t len;
+	bool ok = true;
+
+	if (!storage_file_open(zip->in, path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+		storage_file_close(zip->in);
+		stats->errors++;
+		return true;
+	}
+
+	local.sig = ZIP_LOCAL_SIG;
+	local.version = ZIP_VERSION;
+	local.time = zip->time;
+	local.date = zip->date;
+	local.name_len = strlen(name);
+
+	ok &= (storage_file_write(zip->zip, &local, sizeof(local)) == sizeof(local));
+	ok &= (storage_file_write(zip->zip, name, local.name_len) == local.name_len);
+	ok &= zip_export_copy(zip, zip->in, &crc, &len);
+
+	/* A file that couldn't be read in full is dropped from the ZIP */
+	if (!storage_file_eof(zip->in) || storage_file_size(zip->in) != len) {
+		storage_file_close(zip->in);
+		stats->errors++;
+		return (ok && storage_file_seek(zip->zip, offs, true) && storage_file_truncate(zip->zip));
+	}
+	storage_file_close(zip->in);
+
+	local.crc = crc;
+	local.size_comp = len;
+	local.size = len;
+	ok &= storage_file_seek(zip->zip, offs + ZIP_LOCAL_CRC_OFFS, true);
+	ok &= (storage_file_write(zip->zip, &local.crc, ZIP_LOCAL_CRC_LEN) == ZIP_LOCAL_CRC_LEN);
+	ok &= storage_file_seek(zip->zip, offs + sizeof(local) + local.name_len + len, true);
+
+	central.sig = ZIP_CENTRAL_SIG;
+	central.version_made = ZIP_VERSION;
+	central.version = ZIP_VERSION;
+	central.time = zip->time;
+	central.date = zip->date;
+	central.crc = crc;
+	central.size_comp = len;
+	central.size = len;
+	central.name_len = local.name_len;
+	central.offs = offs;
+	ok &= (storage_file_write(zip->cd, &central, sizeof(central)) == sizeof(central));
+	ok &= (storage_file_write(zip->cd, name, central.name_len) == central.name_len);
+
+	zip->cd_size += sizeof(central) + central.name_len;
+	zip->entries++;
+	stats->files++;
+
+	return ok;
+}
+
+/* MS-DOS date of the folder, at noon */
+static void zip_export_date(struct zip_export *zip, const char *folder)
+{
+	unsigned int year = atoi(folder);
+	unsigned int month = atoi(folder + 5);
+	unsigned int day = atoi(folder + 8);
+
+	zip->date = ((year - 1980) << 9) | (month << 5) | day;
+	zip->time = 12 << 11;
+}
+
+bool zip_export_day(const char *folder, struct zip_stats *stats)
+{
+	struct zip_export zip = { 0 };
+	struct zip_end end = { 0 };
+	FuriString *base = furi_string_alloc_set(APP_DATA_PATH(""));
+	FuriString *path = furi_string_alloc();
+	FuriString *zip_path;
+	FuriString *cd_path;
+	File *dir;
+	FileInfo info;
+	char *name = malloc(NAME_LEN);
+	uint32_t cd_offs;
+	uint32_t crc;
+	uint32_t len;
+	bool ok = true;
+
+	memset(stats, 0, sizeof(struct zip_stats));
+
+	zip.storage = furi_record_open(RECORD_STORAGE);
+	storage_common_resolve_path_and_ensure_app_directory(zip.storage, base);
+	zip_path = furi_string_alloc_printf("%s%s%s", furi_string_get_cstr(base), folder, ZIP_EXT);
+	cd_path = furi_string_alloc_printf("%s%s%s", furi_string_get_cstr(base), folder, ZIP_CD_EXT);
+
+	zip.zip = storage_file_alloc(zip.storage);
+	zip.cd = storage_file_alloc(zip.storage);
+	zip.in = storage_file_alloc(zip.storage);
+	dir = storage_file_alloc(zip.storage);
+	zip.buf = malloc(ZIP_BUF);
+	zip_export_date(&zip, folder);
+
+	ok &= storage_file_open(zip.zip, furi_string_get_cstr(zip_path), FSAM_WRITE, FSOM_CREATE_ALWAYS);
+	ok &= storage_file_open(zip.cd, furi_string_get_cstr(cd_path), FSAM_READ_WRITE, FSOM_CREATE_ALWAYS);
+
+	furi_string_printf(path, "%s%s", furi_string_get_cstr(base), folder);
+	ok &= storage_dir_open(dir, furi_string_get_cstr(path));
+	while (ok && storage_dir_read(dir, &info, name, NAME_LEN)) {
+		if (file_info_is_dir(&info) || name[0] == '.')
+			continue;
+
+		/* ZIP32 can't hold any more than that */
+		if (zip.entries == 0xffff) {
+			stats->errors++;
+			continue;
+		}
+
+		furi_string_printf(path, "%s%s/%s", furi_string_get_cstr(base), folder, name);
+		ok &= zip_export_add(&zip, furi_string_get_cstr(path), name, stats);
+	}
+	storage_dir_close(dir);
+
+	/* The central directory, then its end record, finish the ZIP */
+	cd_offs = storage_file_tell(zip.zip);
+	ok &= storage_file_seek(zip.cd, 0, true);
+	ok &= zip_export_copy(&zip, zip.cd, &crc, &len);
+	ok &= (len == zip.cd_size);
+
+	end.sig = ZIP_END_SIG;
+	end.entries_disk = zip.entries;
+	end.entries = zip.entries;
+	end.cd_size = zip.cd_size;
+	end.cd_offs = cd_offs;
+	ok &= (storage_file_write(zip.zip, &end, sizeof(end)) == sizeof(end));
+	stats->bytes = storage_file_tell(zip.zip);
+
+	ok &= storage_file_close(zip.zip);
+	storage_file_close(zip.cd);
+	storage_simply_remove(zip.storage, furi_string_get_cstr(cd_path));
+	if (!ok)
+		storage_simply_remove(zip.storage, furi_string_get_cstr(zip_path));
+
+	FURI_LOG_I("zip", "%s: %u files, %lu bytes", folder, stats->files, stats->bytes);
+
+	free(zip.buf);
+	free(name);
+	storage_file_free(dir);
+	storage_file_free(zip.in);
+	storage_file_free(zip.cd);
+	storage_file_free(zip.zip);
+	furi_record_close(RECORD_STORAGE);
+	furi_string_free(cd_path);
+	furi_string_free(zip_path);
+	furi_string_free(path);
+	furi_string_free(base);
+
+	return ok;
+}
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2024 KBEmbedded
+"""Rebuild the -hdr.bin file of a Flipper GB Printer fast capture,
+GCIM_YYYY-MM-DD_XXXX-cap.bin.
+
+A capture holds every print of an image as a record of the print command
+margins, palette and exposure, then its tile data. Records of prints that
+compress are saved with each row of tiles in the Game Boy Printer's own RLE
+format. The image comes out exactly as the app saves it with Save hdr+bin,
+GB-BIN01 followed by the tile data of every print of the image.
+
+usage: cap_decode.py <capture>... [-o outdir]
+"""
+
+import os
+import struct
+import sys
+
+CAP_MAGIC = b'GB-CAP01'
+BIN_MAGIC = b'GB-BIN01'
+CAP_EXT = '-cap.bin'
+ROW_RAW = 0x8000
+REC = struct.Struct('<BBBBHH')
+ROW_LEN = struct.Struct('<H')
+
+
+def rle_decode(data, length):
+    """Game Boy Printer RLE, as sent over the link cable. A control byte with
+    bit 7 set is a run of the next byte, (ctrl & 0x7f) + 2 long, otherwise
+    ctrl + 1 literal bytes follow it."""
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        ctrl = data[pos]
+        pos += 1
+        if ctrl & 0x80:
+            if pos >= len(data):
+                raise ValueError('run with no data')
+            out += bytes([data[pos]]) * ((ctrl & 0x7f) + 2)
+            pos += 1
+        else:
+            if pos + ctrl + 1 > len(data):
+                raise ValueError('literal past the end')
+            out += data[pos:pos + ctrl + 1]
+            pos += ctrl + 1
+    if len(out) != length:
+        raise ValueError('decoded to %d bytes, expected %d' % (len(out), length))
+    return bytes(out)
+
+
+def cap_decode(data):
+    """Yield (margins, palette, exposure, tiles_w, tile data) for each print."""
+    if data[:8] != CAP_MAGIC:
+        raise ValueError('not a capture')
+    pos = 8
+    while pos < len(data):
+        rtype, margins, palette, exposure, tiles_w, tiles_h = REC.unpack_from(data, pos)
+        pos += REC.size
+        row_sz = tiles_w * 16
+        if rtype == ord('P'):
+            out = data[pos:pos + (row_sz * tiles_h)]
+            pos += row_sz * tiles_h
+        elif rtype == ord('R'):
+            out = b''
+            for _ in range(tiles_h):
+                length, = ROW_LEN.unpack_from(data, pos)
+                pos += ROW_LEN.size
+                if length == (row_sz | ROW_RAW):
+                    out += data[pos:pos + row_sz]
+                    pos += row_sz
+                elif length < row_sz:
+                    out += rle_decode(data[pos:pos + length], row_sz)
+                    pos += length
+                else:
+                    raise ValueError('bad row length %#x at %d' % (length, pos))
+        else:
+            raise ValueError('bad record at %d' % pos)
+        if len(out) != row_sz * tiles_h:
+            raise ValueError('capture cut short')
+        yield margins, palette, exposure, tiles_w, out
+
+
+def main():
+    args = sys.argv[1:]
+    outdir = None
+    if '-o' in args:
+        i = args.index('-o')
+        outdir = args[i + 1] if i + 1 < len(args) else None
+        del args[i:i + 2]
+        if not outdir:
+            sys.exit(__doc__)
+    if not args:
+        sys.exit(__doc__)
+
+    for path in args:
+        with open(path, 'rb') as f:
+            data = f.read()
+        base = os.path.basename(path)
+        if base.endswith(CAP_EXT):
+            base = base[:-len(CAP_EXT)]
+        name = os.path.join(outdir or os.path.dirname(path) or '.', base + '-hdr.bin')
+
+        tiles = b''
+        prints = 0
+        for *_, out in cap_decode(data):
+            tiles += out
+            prints += 1
+        if outdir:
+            os.makedirs(outdir, exist_ok=True)
+        with open(name, 'wb') as f:
+            f.write(BIN_MAGIC + tiles)
+        print('%s: %d prints, %d bytes from %d' % (name, prints, len(tiles) + len(BIN_MAGIC), len(data)))
+
+
+if __name__ == '__main__':
+    main()
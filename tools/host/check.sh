@@ -0,0 +1,104 @@
+#!/bin/sh
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2024 KBEmbedded
+#
+# Build the app sources that don't need a Flipper against the stand-ins in
+# tools/host/include, and run the host checks on them. Needs a C compiler and
+# python3, unzip is used too if it is installed.
+#
+# usage: tools/host/check.sh [builddir]
+
+set -e
+
+HOST=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$HOST/../.." && pwd)
+OUT=${1:-$(mktemp -d)}
+CC=${CC:-cc}
+CFLAGS="-std=gnu11 -O2 -Wall -Wno-unused-parameter -I$HOST/include -I$ROOT"
+
+mkdir -p "$OUT"
+
+echo "building in $OUT"
+$CC $CFLAGS -o "$OUT/tile_check" "$HOST/tile_check.c"
+$CC $CFLAGS -DFGP_HOST_DATA="\"$OUT/data/\"" -o "$OUT/zip_check" "$HOST/zip_check.c" "$HOST/host.c" \
+	"$ROOT/src/zip_export.c" "$ROOT/src/crc.c"
+$CC $CFLAGS -DFGP_HOST_DATA="\"$OUT/data/\"" -o "$OUT/rle_check" "$HOST/rle_check.c" "$ROOT/src/rle.c"
+$CC $CFLAGS -DFGP_HOST_DATA="\"$OUT/data/\"" -o "$OUT/dedup_check" "$HOST/dedup_check.c" "$HOST/host.c" \
+	"$ROOT/src/dedup.c"
+$CC $CFLAGS -o "$OUT/fgp_png" "$HOST/fgp_png.c" "$ROOT/src/png.c" "$ROOT/src/tile_tools.c" "$ROOT/src/crc.c"
+$CC $CFLAGS -DFGP_HOST_DATA="\"$OUT/data/\"" -o "$OUT/thumb_check" "$HOST/thumb_check.c" "$HOST/host.c" \
+	"$ROOT/src/thumb_build.c" "$ROOT/src/png_import.c" "$ROOT/src/png_read.c" "$ROOT/src/inflate.c" \
+	"$ROOT/src/thumb.c" "$ROOT/src/tile_tools.c"
+$CC $CFLAGS -DFGP_HOST_DATA="\"$OUT/data/\"" -o "$OUT/sheet_check" "$HOST/sheet_check.c" "$HOST/host.c" \
+	"$ROOT/src/sheet.c" "$ROOT/src/png.c" "$ROOT/src/png_read.c" "$ROOT/src/inflate.c" \
+	"$ROOT/src/tile_tools.c" "$ROOT/src/crc.c"
+$CC $CFLAGS -DFGP_HOST_DATA="\"$OUT/data/\"" -o "$OUT/repalette_check" "$HOST/repalette_check.c" "$HOST/host.c" \
+	"$ROOT/src/repalette.c" "$ROOT/src/png.c" "$ROOT/src/png_import.c" "$ROOT/src/png_read.c" \
+	"$ROOT/src/inflate.c" "$ROOT/src/tile_tools.c" "$ROOT/src/crc.c"
+
+"$OUT/tile_check"
+
+# The export is read back by unzip and Python, which know nothing of how it
+# was written, and every file has to come out as it went in.
+rm -rf "$OUT/data"
+mkdir -p "$OUT/data"
+"$OUT/zip_check"
+ZIP="$OUT/data/2024-05-01.zip"
+if command -v unzip >/dev/null; then
+	unzip -tq "$ZIP"
+else
+	echo "unzip not found, only checked with Python"
+fi
+python3 -m zipfile -t "$ZIP"
+python3 - "$ZIP" "$OUT/data/2024-05-01" <<'PY'
+import os
+import sys
+import zipfile
+
+zip_path, folder = sys.argv[1:]
+expect = sorted(n for n in os.listdir(folder)
+		if not n.startswith(".") and os.path.isfile(os.path.join(folder, n)))
+with zipfile.ZipFile(zip_path) as z:
+	assert sorted(z.namelist()) == expect, z.namelist()
+	for info in z.infolist():
+		assert info.compress_type == zipfile.ZIP_STORED, info.filename
+		assert info.date_time == (2024, 5, 1, 12, 0, 0), info.date_time
+		with open(os.path.join(folder, info.filename), "rb") as f:
+			assert z.read(info) == f.read(), info.filename
+print("zip contents: %u files ok" % len(expect))
+PY
+
+# RLE at the edges of a control byte, then a fast capture of RLE rows read
+# back by cap_decode.py, which has to give the same tiles as went in
+"$OUT/rle_check"
+python3 "$ROOT/tools/cap_decode.py" "$OUT/data/2024-05-04/GCIM_2024-05-04_0001-cap.bin" -o "$OUT/data/cap"
+cmp "$OUT/data/2024-05-04/GCIM_2024-05-04_0001-hdr.bin" "$OUT/data/cap/GCIM_2024-05-04_0001-hdr.bin"
+echo "cap_decode: tiles match"
+
+# Reprints found in the hash index of a day
+"$OUT/dedup_check"
+
+# Gallery thumbnails of a folder without any, rebuilt from PNGs saved every
+# way they can be
+python3 "$HOST/thumb_pngs.py" "$OUT/data/2024-05-02" "$OUT/data/thumb-raw"
+"$OUT/thumb_check"
+
+# A contact sheet written a few bands at a time, read back px by px, with an
+# image stacked from prints of different palettes
+"$OUT/sheet_check"
+
+# PNGs with PLTE in the order of their palette byte re-paletted, then back
+# again by repalette.py, which has to give the PNGs as they were saved
+"$OUT/repalette_check"
+python3 "$ROOT/tools/repalette.py" "$OUT/data/2024-05-06" bw
+for ref in "$OUT"/data/ref/*.png; do
+	cmp "$ref" "$OUT/data/2024-05-06/$(basename "$ref")"
+done
+test ! -e "$OUT/data/2024-05-06/.thumbs"
+
+# Stream USB, from usb_receive.py --send to usb_receive.py, with the PNGs saved
+# by the encoder of the app and by the fallback in usb_receive.py
+rm -rf "$OUT/usb"
+FGP_PNG="$OUT/fgp_png" python3 "$HOST/usb_check.py" "$OUT/usb"
+rm -rf "$OUT/usb"
+python3 "$HOST/usb_check.py" "$OUT/usb"
@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* Check the hash of dedup_copy() against published FNV-1a 64 vectors. Then
+ * load an index of more records than are kept, with a record cut short at the
+ * end as a save that didn't finish leaves it, and check only the newest
+ * DEDUP_MAX are matched, newest first. Last, the oldest goes once another is
+ * added, and a new day starts with nothing to match.
+ */
+
+#include <furi.h>
+
+#include <sys/stat.h>
+
+#include <src/include/dedup.h>
+
+#define FOLDER		"2024-05-05"
+#define FOLDER_NEXT	"2024-05-06"
+
+/* Records in the index, more than are kept */
+#define RECS		300
+
+static const struct {
+	const char *str;
+	uint64_t hash;
+} fnv_vectors[] = {
+	{ "", 0xcbf29ce484222325ULL },
+	{ "a", 0xaf63dc4c8601ec8cULL },
+	{ "foobar", 0x85944171f73967e8ULL },
+};
+
+static void rec_make(struct dedup_rec *rec, uint16_t count)
+{
+	memset(rec, 0, sizeof(*rec));
+	rec->hash = 0x9e3779b97f4a7c15ULL * (count + 1);
+	rec->len = 5760;
+	rec->count = count;
+	rec->tiles_w = 20;
+	rec->palette = 0xe4;
+}
+
+/* A reprint of the image of count is found as the one saved as saved_as */
+static bool found_as(void *dedup, uint16_t count, uint16_t saved_as)
+{
+	const struct dedup_rec *got;
+	struct dedup_rec rec;
+
+	rec_make(&rec, count);
+	rec.count = 0;
+	got = dedup_find(dedup, &rec);
+
+	return (got && got->count == saved_as);
+}
+
+static bool found(void *dedup, uint16_t count)
+{
+	return found_as(dedup, count, count);
+}
+
+static bool fnv_check(void)
+{
+	uint8_t buf[8];
+	size_t len;
+	size_t i;
+	bool ok = true;
+
+	for (i = 0; i < COUNT_OF(fnv_vectors); i++) {
+		len = strlen(fnv_vectors[i].str);
+		memset(buf, 0, sizeof(buf));
+		ok &= (dedup_copy(buf, (const uint8_t *)fnv_vectors[i].str, len) == fnv_vectors[i].hash);
+		ok &= !memcmp(buf, fnv_vectors[i].str, len);
+	}
+
+	return ok;
+}
+
+static bool index_write(void)
+{
+	struct dedup_rec rec;
+	char path[256];
+	FILE *fp;
+	uint16_t count;
+	bool ok = true;
+
+	snprintf(path, sizeof(path), "%s%s", FGP_HOST_DATA, FOLDER);
+	mkdir(path, 0777);
+	snprintf(path, sizeof(path), "%s%s/%s", FGP_HOST_DATA, FOLDER, DEDUP_FILE);
+	fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	for (count = 0; count < RECS; count++) {
+		rec_make(&rec, count);
+		ok &= (fwrite(&rec, sizeof(rec), 1, fp) == 1);
+	}
+	/* Torn, the save of the next image stopped part way */
+	rec_make(&rec, RECS);
+	ok &= (fwrite(&rec, sizeof(rec) / 2, 1, fp) == 1);
+	ok &= !fclose(fp);
+
+	return ok;
+}
+
+int main(void)
+{
+	struct dedup_rec rec;
+	void *dedup;
+	bool ok = true;
+
+	ok &= fnv_check();
+	ok &= index_write();
+
+	dedup = dedup_alloc();
+	dedup_folder_set(dedup, FOLDER);
+
+	/* Only the newest DEDUP_MAX, and not the torn one */
+	ok &= found(dedup, RECS - 1);
+	ok &= found(dedup, RECS - DEDUP_MAX);
+	ok &= !found(dedup, RECS - DEDUP_MAX - 1);
+	ok &= !found(dedup, 0);
+	ok &= !found(dedup, RECS);
+
+	/* Same tiles in another palette, or another width, isn't a reprint */
+	rec_make(&rec, RECS - 1);
+	rec.palette = 0x1b;
+	ok &= !dedup_find(dedup, &rec);
+	rec_make(&rec, RECS - 1);
+	rec.tiles_w = 10;
+	ok &= !dedup_find(dedup, &rec);
+
+	/* The oldest goes to make room, and the newest of two is matched */
+	rec_make(&rec, RECS - 1);
+	rec.count = RECS + 1;
+	dedup_add(dedup, &rec);
+	ok &= !found(dedup, RECS - DEDUP_MAX);
+	ok &= found(dedup, RECS - DEDUP_MAX + 1);
+	ok &= found_as(dedup, RECS - 1, RECS + 1);
+
+	/* The same folder again keeps what was added since the load */
+	dedup_folder_set(dedup, FOLDER);
+	ok &= found_as(dedup, RECS - 1, RECS + 1);
+
+	/* A new day has no index yet */
+	dedup_folder_set(dedup, FOLDER_NEXT);
+	ok &= !found(dedup, RECS - 1);
+	rec_make(&rec, 1);
+	dedup_add(dedup, &rec);
+	ok &= found(dedup, 1);
+
+	dedup_free(dedup);
+
+	printf("dedup_check: %s\n", ok ? "ok" : "FAILED");
+
+	return !ok;
+}
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* Write a PNG with the encoder of the app, png_stream, on a PC. Rows of 2bpp
+ * scanline data, px_w / 4 bytes each, are read from stdin until it ends. rgb
+ * is the 4 colors of the palette, shade 0 to 3, as 24 hex digits, the same as
+ * the Colors of a palette in palettes.txt.
+ *
+ * tools/usb_receive.py saves its PNGs with this when FGP_PNG is set to it.
+ *
+ * usage: fgp_png <out.png> <px_w> <rgb>
+ */
+
+#include <furi.h>
+
+#include <src/include/crc.h>
+#include <src/include/fgp_palette.h>
+#include <src/include/png.h>
+
+/* Widest print a Game Boy sends */
+#define FGP_PNG_WIDTH_MAX	160
+
+static uint8_t plte[PNG_PLTE_LEN];
+
+/* png_stream only asks for the default palette, before it is given this one */
+const uint8_t *palette_plte_get(unsigned int idx)
+{
+	UNUSED(idx);
+
+	return plte;
+}
+
+static size_t fgp_png_write(void *ctx, const void *buf, size_t len)
+{
+	return fwrite(buf, 1, len, ctx);
+}
+
+/* A complete PLTE chunk, length, type, 12 bytes of RGB, and CRC */
+static bool fgp_png_plte_build(const char *hex)
+{
+	uint32_t crc_be;
+	unsigned int byte;
+	size_t i;
+
+	if (strlen(hex) != 24)
+		return false;
+
+	memcpy(plte, "\x00\x00\x00\x0cPLTE", 8);
+	for (i = 0; i < 12; i++) {
+		if (sscanf(hex + (i * 2), "%2x", &byte) != 1)
+			return false;
+		plte[8 + i] = byte;
+	}
+	crc_be = __builtin_bswap32(crc(plte + 4, 16));
+	memcpy(plte + 20, &crc_be, sizeof(crc_be));
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	void *png_stream;
+	uint8_t row[FGP_PNG_WIDTH_MAX / 4];
+	size_t px_w;
+	size_t rows = 0;
+	FILE *fp;
+	bool ok = true;
+
+	if (argc != 4) {
+		fprintf(stderr, "usage: %s <out.png> <px_w> <rgb>\n", argv[0]);
+		return 2;
+	}
+
+	px_w = strtoul(argv[2], NULL, 10);
+	if (!px_w || px_w > FGP_PNG_WIDTH_MAX || (px_w % 4) || !fgp_png_plte_build(argv[3])) {
+		fprintf(stderr, "%s: bad px_w or rgb\n", argv[0]);
+		return 2;
+	}
+
+	fp = fopen(argv[1], "wb");
+	if (!fp) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	png_stream = png_stream_alloc(px_w);
+	png_stream_reset(png_stream, px_w, 1);
+	png_stream_palette_set(png_stream, plte);
+	png_stream_start(png_stream, fgp_png_write, fp, false);
+	while (fread(row, px_w / 4, 1, stdin) == 1) {
+		png_stream_row(png_stream, row);
+		rows++;
+	}
+	ok &= !!rows;
+
+	/* The height is only known now, IHDR at the start is written again */
+	ok &= png_stream_finish(png_stream);
+	ok &= !fseek(fp, 0, SEEK_SET);
+	ok &= (fwrite(png_stream_buf_get(png_stream, IHDR), 1, png_stream_len_get(png_stream, IHDR), fp) ==
+	       png_stream_len_get(png_stream, IHDR));
+	ok &= !fclose(fp);
+	png_stream_free(png_stream);
+
+	if (!ok) {
+		fprintf(stderr, "%s: failed to write %s\n", argv[0], argv[1]);
+		remove(argv[1]);
+	}
+
+	return !ok;
+}
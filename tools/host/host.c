@@ -0,0 +1,394 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* FuriString, the storage API, and two palettes for the host checks, on top
+ * of the C library and the filesystem of the PC. Only as much as the app
+ * sources built in tools/host call, and only as strict as they need.
+ */
+
+#define _GNU_SOURCE
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <src/include/fgp_palette.h>
+#include <src/include/png.h>
+
+#include <dirent.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+struct FuriString {
+	char *str;
+};
+
+struct File {
+	FILE *fp;
+	DIR *dir;
+};
+
+static char *host_vprintf(const char *fmt, va_list args)
+{
+	char *str;
+
+	furi_check(vasprintf(&str, fmt, args) >= 0);
+
+	return str;
+}
+
+FuriString *furi_string_alloc(void)
+{
+	return furi_string_alloc_set("");
+}
+
+FuriString *furi_string_alloc_set(const char *str)
+{
+	FuriString *fs = malloc(sizeof(FuriString));
+
+	fs->str = strdup(str);
+
+	return fs;
+}
+
+FuriString *furi_string_alloc_printf(const char *fmt, ...)
+{
+	FuriString *fs = malloc(sizeof(FuriString));
+	va_list args;
+
+	va_start(args, fmt);
+	fs->str = host_vprintf(fmt, args);
+	va_end(args);
+
+	return fs;
+}
+
+void furi_string_free(FuriString *fs)
+{
+	free(fs->str);
+	free(fs);
+}
+
+void furi_string_set_str(FuriString *fs, const char *str)
+{
+	char *tmp = strdup(str);
+
+	free(fs->str);
+	fs->str = tmp;
+}
+
+void furi_string_set_string(FuriString *fs, const FuriString *src)
+{
+	furi_string_set_str(fs, src->str);
+}
+
+void furi_string_printf(FuriString *fs, const char *fmt, ...)
+{
+	va_list args;
+
+	free(fs->str);
+	va_start(args, fmt);
+	fs->str = host_vprintf(fmt, args);
+	va_end(args);
+}
+
+void furi_string_cat_str(FuriString *fs, const char *str)
+{
+	size_t len = strlen(fs->str);
+
+	fs->str = realloc(fs->str, len + strlen(str) + 1);
+	strcpy(fs->str + len, str);
+}
+
+void furi_string_cat_string(FuriString *fs, const FuriString *src)
+{
+	furi_string_cat_str(fs, src->str);
+}
+
+void furi_string_cat_printf(FuriString *fs, const char *fmt, ...)
+{
+	va_list args;
+	char *tmp;
+
+	va_start(args, fmt);
+	tmp = host_vprintf(fmt, args);
+	va_end(args);
+	furi_string_cat_str(fs, tmp);
+	free(tmp);
+}
+
+const char *furi_string_get_cstr(const FuriString *fs)
+{
+	return fs->str;
+}
+
+size_t furi_string_size(const FuriString *fs)
+{
+	return strlen(fs->str);
+}
+
+void furi_string_left(FuriString *fs, size_t len)
+{
+	if (len < strlen(fs->str))
+		fs->str[len] = '\0';
+}
+
+/* Only B&W and DMG, palettes 0 and 1 of the app, are known to the host checks.
+ * Their PLTE chunks are the same as fgp_palette.c has, CRC and all.
+ */
+static const struct {
+	char *shortname;
+	uint8_t plte[PNG_PLTE_LEN];
+} palettes[] = {
+	{ "bw", {
+		0x00, 0x00, 0x00, 0x0c, 'P', 'L', 'T', 'E',
+		0xff, 0xff, 0xff, 0xaa, 0xaa, 0xaa, 0x55, 0x55, 0x55, 0x00, 0x00, 0x00,
+		0x01, 0x33, 0x5b, 0x34,
+	} },
+	{ "dmg", {
+		0x00, 0x00, 0x00, 0x0c, 'P', 'L', 'T', 'E',
+		0x9b, 0xbc, 0x0f, 0x77, 0xa1, 0x12, 0x30, 0x62, 0x30, 0x0f, 0x38, 0x0f,
+		0x15, 0x85, 0x5f, 0xd2,
+	} },
+};
+
+size_t palette_count_get(void)
+{
+	return COUNT_OF(palettes);
+}
+
+char *palette_shortname_get(unsigned int idx)
+{
+	return palettes[idx].shortname;
+}
+
+int palette_idx_get(const char *shortname)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < COUNT_OF(palettes); idx++) {
+		if (!strcmp(shortname, palettes[idx].shortname))
+			return idx;
+	}
+
+	return -1;
+}
+
+void *palette_rgb16_get(unsigned int idx)
+{
+	return (void *)(palettes[idx].plte + 8);
+}
+
+const uint8_t *palette_plte_get(unsigned int idx)
+{
+	return palettes[idx].plte;
+}
+
+/* There is only the one storage record, and nothing needs its contents */
+void *furi_record_open(const char *name)
+{
+	UNUSED(name);
+
+	return (void *)1;
+}
+
+void furi_record_close(const char *name)
+{
+	UNUSED(name);
+}
+
+uint32_t furi_get_tick(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+File *storage_file_alloc(Storage *storage)
+{
+	UNUSED(storage);
+
+	return calloc(1, sizeof(File));
+}
+
+void storage_file_free(File *file)
+{
+	free(file);
+}
+
+bool storage_file_open(File *file, const char *path, FS_AccessMode access_mode, FS_OpenMode open_mode)
+{
+	struct stat st;
+	bool exists = !stat(path, &st);
+	const char *mode;
+
+	switch (open_mode) {
+	case FSOM_OPEN_EXISTING:
+		if (!exists)
+			return false;
+		mode = (access_mode == FSAM_READ) ? "rb" : "r+b";
+		break;
+	case FSOM_CREATE_NEW:
+		if (exists)
+			return false;
+		mode = "w+b";
+		break;
+	case FSOM_CREATE_ALWAYS:
+		mode = "w+b";
+		break;
+	default:
+		mode = exists ? "r+b" : "w+b";
+		break;
+	}
+
+	file->fp = fopen(path, mode);
+	if (file->fp && open_mode == FSOM_OPEN_APPEND)
+		fseek(file->fp, 0, SEEK_END);
+
+	return !!file->fp;
+}
+
+bool storage_file_close(File *file)
+{
+	bool ret = (file->fp && !fclose(file->fp));
+
+	file->fp = NULL;
+
+	return ret;
+}
+
+bool storage_file_is_open(File *file)
+{
+	return !!file->fp;
+}
+
+size_t storage_file_read(File *file, void *buff, size_t bytes_to_read)
+{
+	return fread(buff, 1, bytes_to_read, file->fp);
+}
+
+/* Flushed right away, same as the SD card never holds anything back */
+size_t storage_file_write(File *file, const void *buff, size_t bytes_to_write)
+{
+	size_t ret = fwrite(buff, 1, bytes_to_write, file->fp);
+
+	fflush(file->fp);
+
+	return ret;
+}
+
+bool storage_file_seek(File *file, uint32_t offset, bool from_start)
+{
+	return !fseek(file->fp, offset, from_start ? SEEK_SET : SEEK_CUR);
+}
+
+uint64_t storage_file_tell(File *file)
+{
+	return ftell(file->fp);
+}
+
+uint64_t storage_file_size(File *file)
+{
+	struct stat st;
+
+	fflush(file->fp);
+	if (fstat(fileno(file->fp), &st))
+		return 0;
+
+	return st.st_size;
+}
+
+bool storage_file_truncate(File *file)
+{
+	fflush(file->fp);
+
+	return !ftruncate(fileno(file->fp), ftell(file->fp));
+}
+
+bool storage_file_eof(File *file)
+{
+	return storage_file_tell(file) >= storage_file_size(file);
+}
+
+bool storage_file_exists(Storage *storage, const char *path)
+{
+	struct stat st;
+
+	UNUSED(storage);
+
+	return (!stat(path, &st) && !S_ISDIR(st.st_mode));
+}
+
+bool storage_dir_open(File *file, const char *path)
+{
+	file->dir = opendir(path);
+
+	return !!file->dir;
+}
+
+bool storage_dir_close(File *file)
+{
+	if (file->dir)
+		closedir(file->dir);
+	file->dir = NULL;
+
+	return true;
+}
+
+/* The Flipper doesn't list . or .. either */
+bool storage_dir_read(File *file, FileInfo *fileinfo, char *name, uint16_t name_length)
+{
+	struct dirent *ent;
+
+	if (!file->dir)
+		return false;
+
+	do {
+		ent = readdir(file->dir);
+	} while (ent && (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")));
+	if (!ent)
+		return false;
+
+	if (fileinfo) {
+		fileinfo->flags = (ent->d_type == DT_DIR) ? FSF_DIRECTORY : 0;
+		fileinfo->size = 0;
+	}
+	snprintf(name, name_length, "%s", ent->d_name);
+
+	return true;
+}
+
+bool storage_simply_remove(Storage *storage, const char *path)
+{
+	UNUSED(storage);
+
+	return !remove(path);
+}
+
+/* FAT won't rename over a file, neither does this */
+FS_Error storage_common_rename(Storage *storage, const char *old_path, const char *new_path)
+{
+	struct stat st;
+
+	UNUSED(storage);
+
+	if (!stat(new_path, &st))
+		return FSE_EXIST;
+
+	return rename(old_path, new_path) ? FSE_NOT_EXIST : FSE_OK;
+}
+
+/* FGP_HOST_DATA is already a path of the host, and made by check.sh */
+void storage_common_resolve_path_and_ensure_app_directory(Storage *storage, FuriString *path)
+{
+	UNUSED(storage);
+	UNUSED(path);
+}
+
+bool file_info_is_dir(const FileInfo *file_info)
+{
+	return !!(file_info->flags & FSF_DIRECTORY);
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef FURI_H
+#define FURI_H
+
+#pragma once
+
+/* Just enough of furi for app sources that don't touch the GUI or the link
+ * cable to build and run on a PC, for the checks and tools in tools/host.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define UNUSED(x)	((void)(x))
+#define COUNT_OF(x)	(sizeof(x) / sizeof(x[0]))
+
+#ifndef MIN
+#define MIN(a, b)	((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)	((a) > (b) ? (a) : (b))
+#endif
+
+#define furi_check(x)	do { if (!(x)) abort(); } while (0)
+#define furi_assert(x)	furi_check(x)
+
+/* Errors and warnings go to stderr, the chatter is left out */
+#define FURI_LOG_E(tag, fmt, ...)	fprintf(stderr, tag ": " fmt "\n", ##__VA_ARGS__)
+#define FURI_LOG_W(tag, fmt, ...)	fprintf(stderr, tag ": " fmt "\n", ##__VA_ARGS__)
+#define FURI_LOG_I(tag, fmt, ...)	do { } while (0)
+#define FURI_LOG_D(tag, fmt, ...)	do { } while (0)
+
+/* FuriString, records, and ticks are in host.c */
+typedef struct FuriString FuriString;
+
+FuriString *furi_string_alloc(void);
+FuriString *furi_string_alloc_set(const char *str);
+FuriString *furi_string_alloc_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void furi_string_free(FuriString *fs);
+void furi_string_set_str(FuriString *fs, const char *str);
+void furi_string_set_string(FuriString *fs, const FuriString *src);
+void furi_string_printf(FuriString *fs, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void furi_string_cat_str(FuriString *fs, const char *str);
+void furi_string_cat_string(FuriString *fs, const FuriString *src);
+void furi_string_cat_printf(FuriString *fs, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+const char *furi_string_get_cstr(const FuriString *fs);
+size_t furi_string_size(const FuriString *fs);
+void furi_string_left(FuriString *fs, size_t len);
+
+/* Either a C string or another FuriString, same as on the Flipper */
+#define furi_string_set(fs, src)	_Generic((src),				\
+		FuriString *: furi_string_set_string,				\
+		const FuriString *: furi_string_set_string,			\
+		default: furi_string_set_str)(fs, src)
+#define furi_string_cat(fs, src)	_Generic((src),				\
+		FuriString *: furi_string_cat_string,				\
+		const FuriString *: furi_string_cat_string,			\
+		default: furi_string_cat_str)(fs, src)
+
+#define RECORD_STORAGE	"storage"
+
+void *furi_record_open(const char *name);
+void furi_record_close(const char *name);
+
+uint32_t furi_get_tick(void);
+
+/* The app data folder, set with -DFGP_HOST_DATA=\"path/\" */
+#ifndef FGP_HOST_DATA
+#define FGP_HOST_DATA	"./"
+#endif
+#define APP_DATA_PATH(path)	FGP_HOST_DATA path
+
+#endif // FURI_H
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef FURI_HAL_H
+#define FURI_HAL_H
+
+#pragma once
+
+#include <furi.h>
+
+/* The cycle counter never moves on a PC, every timing comes out as 0 */
+static struct {
+	uint32_t CYCCNT;
+} fgp_host_dwt;
+#define DWT	(&fgp_host_dwt)
+
+#endif // FURI_HAL_H
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#pragma once
+
+/* The storage API on top of stdio and the directory of the host, see host.c.
+ * Only the calls the app sources built in tools/host make are here.
+ */
+
+#include <furi.h>
+
+typedef struct Storage Storage;
+typedef struct File File;
+
+typedef enum {
+	FSAM_READ = (1 << 0),
+	FSAM_WRITE = (1 << 1),
+	FSAM_READ_WRITE = (FSAM_READ | FSAM_WRITE),
+} FS_AccessMode;
+
+typedef enum {
+	FSOM_OPEN_EXISTING = 1,
+	FSOM_OPEN_ALWAYS = 2,
+	FSOM_OPEN_APPEND = 4,
+	FSOM_CREATE_NEW = 8,
+	FSOM_CREATE_ALWAYS = 16,
+} FS_OpenMode;
+
+typedef enum {
+	FSE_OK = 0,
+	FSE_NOT_EXIST = 3,
+	FSE_EXIST = 4,
+} FS_Error;
+
+typedef enum {
+	FSF_DIRECTORY = (1 << 0),
+} FS_Flags;
+
+typedef struct {
+	uint8_t flags;
+	uint64_t size;
+} FileInfo;
+
+File *storage_file_alloc(Storage *storage);
+void storage_file_free(File *file);
+bool storage_file_open(File *file, const char *path, FS_AccessMode access_mode, FS_OpenMode open_mode);
+bool storage_file_close(File *file);
+bool storage_file_is_open(File *file);
+size_t storage_file_read(File *file, void *buff, size_t bytes_to_read);
+size_t storage_file_write(File *file, const void *buff, size_t bytes_to_write);
+bool storage_file_seek(File *file, uint32_t offset, bool from_start);
+uint64_t storage_file_tell(File *file);
+uint64_t storage_file_size(File *file);
+bool storage_file_truncate(File *file);
+bool storage_file_eof(File *file);
+bool storage_file_exists(Storage *storage, const char *path);
+
+bool storage_dir_open(File *file, const char *path);
+bool storage_dir_close(File *file);
+bool storage_dir_read(File *file, FileInfo *fileinfo, char *name, uint16_t name_length);
+
+bool storage_simply_remove(Storage *storage, const char *path);
+FS_Error storage_common_rename(Storage *storage, const char *old_path, const char *new_path);
+void storage_common_resolve_path_and_ensure_app_directory(Storage *storage, FuriString *path);
+
+bool file_info_is_dir(const FileInfo *file_info);
+
+#endif // STORAGE_H
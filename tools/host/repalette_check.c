@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* Save a folder of B&W PNGs the way receive_view.c does, each with its PLTE in
+ * the order of the palette byte of its print, along with their thumbnail
+ * index. Re-palette the folder to DMG, then check every PLTE kept its order,
+ * each PNG imports back as its print remapped with its palette byte, and the
+ * index names the new files. The PNGs as saved are kept in ref/ for
+ * tools/repalette.py to be checked against.
+ */
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <src/include/crc.h>
+#include <src/include/fgp_palette.h>
+#include <src/include/png.h>
+#include <src/include/png_import.h>
+#include <src/include/repalette.h>
+#include <src/include/thumb.h>
+#include <src/include/tile_tools.h>
+
+#define FOLDER	"2024-05-06"
+#define TILES_W	20
+#define TILES_H	3
+
+/* Each PNG of the folder, and the palette byte its PLTE is in the order of */
+static const struct {
+	uint16_t count;
+	const char *ext;
+	uint8_t order;
+	unsigned int pal;
+} pngs[] = {
+	{ 1, "-bw.png", 0x1b, 0 }, // Every shade inverted
+	{ 2, "-bw.png", 0xd2, 0 },
+	{ 3, "-bw.png", 0xe4, 0 },
+	{ 4, "-dmg.png", 0xe4, 1 }, // Already in DMG, left alone
+};
+#define PNG_DONE	3
+
+static uint8_t tiles[TILES_W * TILES_H * 16];
+
+struct import_ctx {
+	uint8_t order;
+	size_t bad;
+};
+
+static void path_get(char *path, size_t len, const char *dir, uint16_t count, const char *ext)
+{
+	snprintf(path, len, "%s%s/GCIM_" FOLDER "_%04u%s", FGP_HOST_DATA, dir, count, ext);
+}
+
+/* Shade of px x, y of tile data with tiles_w tiles in each band */
+static unsigned int shade_get(const uint8_t *data, size_t tiles_w, size_t x, size_t y)
+{
+	const uint8_t *line = data + ((((y / 8) * tiles_w) + (x / 8)) * 16) + ((y % 8) * 2);
+	unsigned int bit = 7 - (x % 8);
+
+	return (((line[1] >> bit) & 0x01) << 1) | ((line[0] >> bit) & 0x01);
+}
+
+static bool png_write(const char *dir, uint16_t count, const char *ext, uint8_t order, unsigned int pal)
+{
+	uint8_t plte[PNG_PLTE_LEN];
+	enum png_chunks chunk;
+	char path[256];
+	void *png;
+	FILE *fp;
+	bool ok = true;
+
+	path_get(path, sizeof(path), dir, count, ext);
+	fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+
+	png = png_alloc(TILES_W * 8, TILES_H * 8);
+	png_seg_reset(png, TILES_W * 8);
+	png_dat_write_tiles(png, tiles, TILES_H, NULL);
+	png_reset(png, TILES_W * 8);
+	png_seg_append(png);
+	png_plte_order_build(plte, palette_plte_get(pal), order);
+	png_palette_set(png, plte);
+	for (chunk = CHUNK_START; chunk < CHUNK_COUNT; chunk++)
+		ok &= (fwrite(png_buf_get(png, chunk), 1, png_len_get(png, chunk), fp) == png_len_get(png, chunk));
+	ok &= !fclose(fp);
+	png_free(png);
+
+	return ok;
+}
+
+static bool thumbs_write(void)
+{
+	struct thumb_rec rec;
+	char path[256];
+	FILE *fp;
+	size_t i;
+	bool ok = true;
+
+	snprintf(path, sizeof(path), "%s%s/%s", FGP_HOST_DATA, FOLDER, THUMB_FILE);
+	fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	for (i = 0; i <= COUNT_OF(pngs); i++) {
+		memset(&rec, 0, sizeof(rec));
+		/* One more, for a PNG that was since removed */
+		rec.count = (i < COUNT_OF(pngs)) ? pngs[i].count : 9;
+		rec.px_w = TILES_W * 8;
+		rec.px_h = TILES_H * 8;
+		rec.palette = (i < COUNT_OF(pngs)) ? pngs[i].pal : 0;
+		snprintf(rec.ext, sizeof(rec.ext), "%s", (i < COUNT_OF(pngs)) ? pngs[i].ext : "-bw.png");
+		ok &= (fwrite(&rec, sizeof(rec), 1, fp) == 1);
+	}
+	ok &= !fclose(fp);
+
+	return ok;
+}
+
+/* Every px of the band is the shade its print had, after the palette byte */
+static bool import_band(void *ctx, const uint8_t *band, size_t tiles_w, size_t tiles_h, size_t band_idx)
+{
+	struct import_ctx *ic = ctx;
+	unsigned int want;
+	size_t x;
+	size_t y;
+
+	if (tiles_w != TILES_W || tiles_h != TILES_H) {
+		ic->bad++;
+		return false;
+	}
+
+	for (y = 0; y < 8; y++) {
+		for (x = 0; x < TILES_W * 8; x++) {
+			want = (ic->order >> (shade_get(tiles, TILES_W, x, (band_idx * 8) + y) * 2)) & 0x03;
+			if (shade_get(band, TILES_W, x, y) != want)
+				ic->bad++;
+		}
+	}
+
+	return true;
+}
+
+/* The PLTE is DMG in the same order, CRC and all, and imports as it should */
+static bool png_check(void *imp, uint16_t count, uint8_t order)
+{
+	struct import_ctx ic = { .order = order, .bad = 0 };
+	uint8_t plte[PNG_PLTE_LEN];
+	uint8_t want[PNG_PLTE_LEN];
+	char path[256];
+	File *file;
+	bool ok = true;
+
+	path_get(path, sizeof(path), FOLDER, count, "-bw.png");
+	ok &= (access(path, F_OK) != 0);
+
+	path_get(path, sizeof(path), FOLDER, count, "-dmg.png");
+	file = storage_file_alloc(NULL);
+	ok &= storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING);
+	ok &= storage_file_seek(file, PNG_PLTE_OFFS, true);
+	ok &= (storage_file_read(file, plte, sizeof(plte)) == sizeof(plte));
+	png_plte_order_build(want, palette_plte_get(1), order);
+	ok &= !memcmp(plte, want, sizeof(plte));
+	ok &= (__builtin_bswap32(crc(plte + 4, 16)) == *(uint32_t *)(plte + 20));
+
+	ok &= storage_file_seek(file, 0, true);
+	ok &= png_import(imp, file, palette_plte_get(1), import_band, &ic);
+	ok &= !ic.bad;
+	storage_file_close(file);
+	storage_file_free(file);
+
+	if (!ok)
+		printf("FAIL %04u, %u px wrong\n", count, (unsigned int)ic.bad);
+
+	return ok;
+}
+
+/* Every record names the DMG PNG, other than that of the removed one */
+static bool thumbs_check(void)
+{
+	struct thumb_rec rec;
+	char path[256];
+	FILE *fp;
+	size_t i;
+	bool ok = true;
+
+	snprintf(path, sizeof(path), "%s%s/%s", FGP_HOST_DATA, FOLDER, THUMB_FILE);
+	fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+	for (i = 0; i <= COUNT_OF(pngs); i++) {
+		ok &= (fread(&rec, sizeof(rec), 1, fp) == 1);
+		if (i < COUNT_OF(pngs))
+			ok &= (rec.count == pngs[i].count && rec.palette == 1 && !strcmp(rec.ext, "-dmg.png"));
+		else
+			ok &= (rec.count == 9 && rec.palette == 0 && !strcmp(rec.ext, "-bw.png"));
+		ok &= (rec.px_w == TILES_W * 8 && rec.px_h == TILES_H * 8);
+	}
+	ok &= (fread(&rec, 1, 1, fp) == 0);
+	fclose(fp);
+
+	return ok;
+}
+
+int main(void)
+{
+	struct repalette_stats stats;
+	void *imp;
+	char path[256];
+	uint32_t rnd = 0x2545f491;
+	size_t i;
+	bool ok = true;
+
+	tile_tools_init();
+
+	snprintf(path, sizeof(path), "%s%s", FGP_HOST_DATA, FOLDER);
+	mkdir(path, 0777);
+	snprintf(path, sizeof(path), "%sref", FGP_HOST_DATA);
+	mkdir(path, 0777);
+
+	for (i = 0; i < sizeof(tiles); i++) {
+		rnd ^= rnd << 13;
+		rnd ^= rnd >> 17;
+		rnd ^= rnd << 5;
+		tiles[i] = rnd;
+	}
+
+	for (i = 0; i < COUNT_OF(pngs); i++) {
+		ok &= png_write(FOLDER, pngs[i].count, pngs[i].ext, pngs[i].order, pngs[i].pal);
+		ok &= png_write("ref", pngs[i].count, "-bw.png", pngs[i].order, 0);
+	}
+	ok &= thumbs_write();
+
+	snprintf(path, sizeof(path), "%s%s", FGP_HOST_DATA, FOLDER);
+	repalette_folder(path, 1, &stats);
+	ok &= (stats.done == PNG_DONE && !stats.errors);
+
+	imp = png_import_alloc();
+	for (i = 0; i < COUNT_OF(pngs); i++)
+		ok &= png_check(imp, pngs[i].count, pngs[i].order);
+	png_import_free(imp);
+
+	ok &= thumbs_check();
+
+	printf("repalette_check: %u done, %u skipped, %u errors, %s\n", stats.done, stats.skipped, stats.errors,
+	       ok ? "ok" : "FAILED");
+
+	return !ok;
+}
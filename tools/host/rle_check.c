@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* Round trip data with runs and literals right at the edges of what a control
+ * byte holds through rle_encode() and rle_decode(), and check that decode
+ * turns down anything that isn't exactly the length it is asked for. Then
+ * write a fast capture of 'R' and 'P' records with rle_rows_encode(), the way
+ * receive_view.c does, and the -hdr.bin it has to come out as, for
+ * tools/cap_decode.py to be checked against.
+ */
+
+#include <furi.h>
+
+#include <sys/stat.h>
+
+#include <src/include/convert.h>
+#include <src/include/rle.h>
+
+#define FOLDER	"2024-05-04"
+#define BUF_LEN	1024
+
+/* A row of tiles of a 160 px wide print */
+#define ROW_SZ	320
+
+static uint32_t rnd = 0x1b873593;
+
+static uint8_t rnd_byte(void)
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+
+	return rnd;
+}
+
+/* Bytes that never repeat the one before, literal all the way */
+static size_t lit_fill(uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = i & 0xff;
+
+	return len;
+}
+
+static size_t run_fill(uint8_t *buf, size_t len, uint8_t val)
+{
+	memset(buf, val, len);
+
+	return len;
+}
+
+/* Encode and decode len bytes of src, the encoded length has to be enc_len if
+ * that isn't 0
+ */
+static bool round_trip(const char *name, const uint8_t *src, size_t len, size_t enc_len)
+{
+	static uint8_t enc[RLE_LEN_MAX(BUF_LEN)];
+	static uint8_t dec[BUF_LEN + 1];
+	size_t got;
+	bool ok = true;
+
+	memset(enc, 0xa5, sizeof(enc));
+	got = rle_encode(enc, src, len);
+	ok &= (got <= RLE_LEN_MAX(len));
+	ok &= (!enc_len || got == enc_len);
+	ok &= (got == sizeof(enc) || enc[got] == 0xa5);
+
+	ok &= rle_decode(dec, len, enc, got);
+	ok &= !memcmp(dec, src, len);
+
+	/* One byte more or less than it decodes to, or cut short */
+	ok &= !rle_decode(dec, len + 1, enc, got);
+	ok &= (!len || !rle_decode(dec, len - 1, enc, got));
+	ok &= (!got || !rle_decode(dec, len, enc, got - 1));
+
+	if (!ok)
+		printf("FAIL %s, %u bytes to %u\n", name, (unsigned int)len, (unsigned int)got);
+
+	return ok;
+}
+
+static bool rle_vectors(void)
+{
+	static uint8_t buf[BUF_LEN];
+	size_t len;
+	size_t i;
+	bool ok = true;
+
+	ok &= round_trip("empty", buf, 0, 0);
+	ok &= round_trip("one byte", buf, lit_fill(buf, 1), 2);
+
+	/* Runs up to RLE_RUN_MAX are one control byte, one more needs another */
+	ok &= round_trip("run of 3", buf, run_fill(buf, 3, 0x00), 2);
+	ok &= round_trip("run of 128", buf, run_fill(buf, 128, 0xff), 2);
+	ok &= round_trip("run of 129", buf, run_fill(buf, RLE_RUN_MAX, 0xff), 2);
+	ok &= round_trip("run of 130", buf, run_fill(buf, RLE_RUN_MAX + 1, 0xff), 4);
+	ok &= round_trip("run of 131", buf, run_fill(buf, RLE_RUN_MAX + 2, 0xff), 5);
+	ok &= round_trip("run of 258", buf, run_fill(buf, RLE_RUN_MAX * 2, 0x55), 4);
+	ok &= round_trip("run of 1000", buf, run_fill(buf, 1000, 0xaa), 16);
+
+	/* Literals up to RLE_LIT_MAX are one control byte */
+	ok &= round_trip("literal of 127", buf, lit_fill(buf, 127), 128);
+	ok &= round_trip("literal of 128", buf, lit_fill(buf, RLE_LIT_MAX), 129);
+	ok &= round_trip("literal of 129", buf, lit_fill(buf, RLE_LIT_MAX + 1), 131);
+	ok &= round_trip("literal of 256", buf, lit_fill(buf, 256), 258);
+	ok &= round_trip("literal of 257", buf, lit_fill(buf, 257), 260);
+
+	/* A literal of 129 either side of a run of 129 */
+	len = lit_fill(buf, RLE_LIT_MAX + 1);
+	len += run_fill(buf + len, RLE_RUN_MAX, 0xff);
+	len += lit_fill(buf + len, RLE_LIT_MAX + 1);
+	ok &= round_trip("literal, run, literal", buf, len, 131 + 2 + 131);
+
+	/* Runs of 2 stay part of the literal around them */
+	len = lit_fill(buf, 10);
+	len += run_fill(buf + len, 2, 0xf0);
+	len += lit_fill(buf + len, 10);
+	ok &= round_trip("run of 2", buf, len, 23);
+
+	/* A run of 2 at the very end */
+	len = lit_fill(buf, 5);
+	len += run_fill(buf + len, 2, 0xf0);
+	ok &= round_trip("run of 2 at the end", buf, len, 8);
+
+	/* Short runs of few values, as much like tile data as random gets */
+	for (len = 1; len <= BUF_LEN; len += 37) {
+		for (i = 0; i < len; i++)
+			buf[i] = (rnd_byte() & 0x03) ? (i ? buf[i - 1] : 0) : (rnd_byte() & 0x07);
+		ok &= round_trip("random runs", buf, len, 0);
+		for (i = 0; i < len; i++)
+			buf[i] = rnd_byte();
+		ok &= round_trip("random", buf, len, 0);
+	}
+
+	/* A run with no byte to repeat, and a literal longer than what's left */
+	buf[0] = RLE_RUN | 5;
+	ok &= !rle_decode(buf + 8, 7, buf, 1);
+	buf[0] = 3;
+	ok &= !rle_decode(buf + 8, 4, buf, 3);
+
+	return ok;
+}
+
+static bool file_write(const char *name, const void *buf, size_t len, bool append)
+{
+	char path[256];
+	FILE *fp;
+	bool ok;
+
+	snprintf(path, sizeof(path), "%s%s/%s", FGP_HOST_DATA, FOLDER, name);
+	fp = fopen(path, append ? "ab" : "wb");
+	if (!fp)
+		return false;
+	ok = (!len || fwrite(buf, len, 1, fp) == 1);
+	ok &= !fclose(fp);
+
+	return ok;
+}
+
+/* One print of the capture, as a 'P' or 'R' record, whichever is smaller */
+static bool capture_rec_write(const char *cap, const char *bin, const uint8_t *tiles, size_t tiles_h,
+			      uint8_t palette, char type)
+{
+	static uint8_t rle[RLE_ROWS_LEN_MAX(ROW_SZ * 18)];
+	struct capture_rec rec;
+	size_t len = ROW_SZ * tiles_h;
+	size_t rle_len;
+	bool ok = true;
+
+	rec.type = 'P';
+	rec.margins = 0x00;
+	rec.palette = palette;
+	rec.exposure = 0x40;
+	rec.tiles_w = ROW_SZ / 16;
+	rec.tiles_h = tiles_h;
+
+	rle_len = rle_rows_encode(rle, tiles, ROW_SZ, tiles_h);
+	ok &= (rle_len <= RLE_ROWS_LEN_MAX(len));
+	if (rle_len < len)
+		rec.type = 'R';
+	ok &= (rec.type == type);
+
+	ok &= file_write(cap, &rec, sizeof(rec), true);
+	ok &= file_write(cap, (rec.type == 'R') ? rle : tiles, (rec.type == 'R') ? rle_len : len, true);
+	ok &= file_write(bin, tiles, len, true);
+
+	return ok;
+}
+
+/* A capture of two prints stacked. The first compresses, blank rows, rows of
+ * long runs, and one row of noise stored as is. The second is all noise.
+ */
+static bool capture_write(void)
+{
+	static uint8_t tiles[ROW_SZ * 6];
+	const char *cap = "GCIM_" FOLDER "_0001" CAPTURE_EXT;
+	const char *bin = "GCIM_" FOLDER "_0001-hdr.bin";
+	uint8_t *row;
+	size_t i;
+	bool ok = true;
+
+	ok &= file_write(cap, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1, false);
+	ok &= file_write(bin, "GB-BIN01", 8, false);
+
+	memset(tiles, 0x00, sizeof(tiles));
+	row = tiles + ROW_SZ;
+	for (i = 0; i < ROW_SZ; i++)
+		row[i] = (i < 140) ? 0xff : (i < 270) ? 0x3c : (i & 0xff);
+	row += ROW_SZ;
+	for (i = 0; i < ROW_SZ; i++)
+		row[i] = rnd_byte();
+	row += ROW_SZ;
+	for (i = 0; i < ROW_SZ; i++)
+		row[i] = (i % 64) < 60 ? 0x81 : i;
+	ok &= capture_rec_write(cap, bin, tiles, 5, 0xe4, 'R');
+
+	for (i = 0; i < ROW_SZ * 2; i++)
+		tiles[i] = rnd_byte();
+	ok &= capture_rec_write(cap, bin, tiles, 2, 0x1b, 'P');
+
+	return ok;
+}
+
+int main(void)
+{
+	char path[256];
+	bool ok = true;
+
+	snprintf(path, sizeof(path), "%s%s", FGP_HOST_DATA, FOLDER);
+	mkdir(path, 0777);
+
+	ok &= rle_vectors();
+	ok &= capture_write();
+
+	printf("rle_check: %s\n", ok ? "ok" : "FAILED");
+
+	return !ok;
+}
@@ -0,0 +1,279 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* Write a contact sheet of a few images saved as -hdr.bin, one of them stacked
+ * from prints with different palette bytes, a few bands at a time the way the
+ * scene does. Then read the PNG back and check every px against the tile data
+ * of the images, each print remapped with its own palette byte. Last, a sheet
+ * with an image that isn't there has to say so.
+ *
+ * The few calls sheet.c makes to file_handling.c are here, on host.c, as the
+ * rest of file_handling.c needs the RTC and flipper_format.
+ */
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <src/include/file_handling.h>
+#include <src/include/png.h>
+#include <src/include/png_read.h>
+#include <src/include/sheet.h>
+
+#define FOLDER	"2024-05-03"
+#define GAP	1
+
+/* Each print of the session, prints of the same count are stacked */
+static const struct {
+	uint32_t count;
+	size_t tiles_w;
+	size_t tiles_h;
+	uint8_t palette;
+} prints[] = {
+	{ 1, 20, 18, 0xe4 },
+	{ 2, 20, 2, 0xe4 },
+	{ 2, 20, 3, 0x1b }, // Every shade inverted
+	{ 2, 20, 1, 0xe4 },
+	{ 3, 16, 4, 0xd2 },
+};
+
+/* Laid out 2 across, each column 20 tiles wide */
+#define COLS	2
+#define CELL_W	20
+
+static uint8_t *tiles[4];
+
+static File *out_file;
+static uint32_t out_count;
+
+static void path_get(char *path, size_t len, uint32_t count, const char *extension)
+{
+	snprintf(path, len, "%s%s/GCIM_%s_%04u%s", FGP_HOST_DATA, FOLDER, FOLDER, (unsigned int)count, extension);
+}
+
+bool fgp_storage_open_count(void *fgp_storage, uint32_t count, const char *extension)
+{
+	char path[256];
+
+	UNUSED(fgp_storage);
+
+	out_count = count;
+	path_get(path, sizeof(path), count, extension);
+
+	return storage_file_open(out_file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS);
+}
+
+bool fgp_storage_open_count_read(void *fgp_storage, File *file, uint32_t count, const char *extension)
+{
+	char path[256];
+
+	UNUSED(fgp_storage);
+
+	path_get(path, sizeof(path), count, extension);
+
+	return storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING);
+}
+
+size_t fgp_storage_write(void *fgp_storage, const void *buf, size_t len)
+{
+	UNUSED(fgp_storage);
+
+	return storage_file_write(out_file, buf, len);
+}
+
+bool fgp_storage_seek(void *fgp_storage, off_t offs, bool from_start)
+{
+	UNUSED(fgp_storage);
+
+	return storage_file_seek(out_file, offs, from_start);
+}
+
+bool fgp_storage_close(void *fgp_storage)
+{
+	UNUSED(fgp_storage);
+
+	return storage_file_close(out_file);
+}
+
+static bool bin_make(uint32_t count, const uint8_t *data, size_t len)
+{
+	char path[256];
+	FILE *fp;
+	bool ok;
+
+	path_get(path, sizeof(path), count, "-hdr.bin");
+	fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	ok = (fwrite("GB-BIN01", 8, 1, fp) == 1);
+	ok &= (fwrite(data, len, 1, fp) == 1);
+	ok &= !fclose(fp);
+
+	return ok;
+}
+
+/* Shade of px x, y of the image of count, as saved in its PNG */
+static unsigned int ref_px(uint32_t count, size_t x, size_t y)
+{
+	const uint8_t *line;
+	size_t tiles_w = 0;
+	size_t band = y / 8;
+	unsigned int bit = 7 - (x % 8);
+	unsigned int shade;
+	uint8_t palette = 0xe4;
+	size_t i;
+
+	for (i = 0; i < COUNT_OF(prints); i++) {
+		if (prints[i].count != count)
+			continue;
+		tiles_w = prints[i].tiles_w;
+		palette = prints[i].palette;
+		if (band < prints[i].tiles_h)
+			break;
+		band -= prints[i].tiles_h;
+	}
+
+	line = tiles[count] + ((((y / 8) * tiles_w) + (x / 8)) * 16) + ((y % 8) * 2);
+	shade = (((line[1] >> bit) & 0x01) << 1) | ((line[0] >> bit) & 0x01);
+
+	return (palette >> (shade * 2)) & 0x03;
+}
+
+struct sheet_read {
+	size_t y;
+	size_t bad;
+	size_t img_w[4];
+	size_t img_h[4];
+	size_t row_y[2]; // First px row of each row of images
+};
+
+/* Every px of the row, against what the layout puts there */
+static bool sheet_read_row(void *ctx, const uint8_t *row, size_t len)
+{
+	struct sheet_read *rd = ctx;
+	unsigned int want;
+	unsigned int got;
+	uint32_t count;
+	size_t x;
+	size_t cx;
+	size_t cy;
+	size_t r;
+
+	for (x = 0; x < len * 4; x++) {
+		got = (row[x / 4] >> (6 - ((x % 4) * 2))) & 0x03;
+		want = 0;
+
+		r = (rd->y >= rd->row_y[1]) ? 1 : 0;
+		cy = rd->y - rd->row_y[r];
+		if (x >= GAP * 8 && ((x / 8) - GAP) % (CELL_W + GAP) < CELL_W) {
+			count = 1 + (r * COLS) + (((x / 8) - GAP) / (CELL_W + GAP));
+			cx = x - (GAP * 8) - ((((x / 8) - GAP) / (CELL_W + GAP)) * (CELL_W + GAP) * 8);
+			if (count <= 3 && rd->y >= rd->row_y[r] && cx < rd->img_w[count] && cy < rd->img_h[count])
+				want = ref_px(count, cx, cy);
+		}
+
+		if (got != want)
+			rd->bad++;
+	}
+	rd->y++;
+
+	return true;
+}
+
+static size_t read_cb(void *ctx, void *buf, size_t len)
+{
+	return fread(buf, 1, len, ctx);
+}
+
+int main(void)
+{
+	struct sheet_read rd;
+	const struct png_info *info;
+	void *sheet;
+	void *png_read;
+	char path[256];
+	size_t done;
+	size_t total;
+	size_t steps = 0;
+	size_t len[4] = { 0 };
+	size_t i;
+	uint32_t rnd = 0x13579bdf;
+	FILE *fp;
+	bool ok = true;
+
+	snprintf(path, sizeof(path), "%s%s", FGP_HOST_DATA, FOLDER);
+	mkdir(path, 0777);
+	out_file = storage_file_alloc(NULL);
+
+	memset(&rd, 0, sizeof(rd));
+	for (i = 0; i < COUNT_OF(prints); i++) {
+		len[prints[i].count] += prints[i].tiles_w * prints[i].tiles_h * 16;
+		rd.img_w[prints[i].count] = prints[i].tiles_w * 8;
+		rd.img_h[prints[i].count] += prints[i].tiles_h * 8;
+	}
+	for (i = 1; i < 4; i++) {
+		tiles[i] = malloc(len[i]);
+		for (done = 0; done < len[i]; done++) {
+			rnd ^= rnd << 13;
+			rnd ^= rnd >> 17;
+			rnd ^= rnd << 5;
+			tiles[i][done] = rnd;
+		}
+		ok &= bin_make(i, tiles[i], len[i]);
+	}
+
+	/* Written a few bands at a time, as the scene does */
+	sheet = sheet_alloc();
+	for (i = 0; i < COUNT_OF(prints); i++)
+		ok &= sheet_add(sheet, prints[i].count, prints[i].tiles_w, prints[i].tiles_h, prints[i].palette,
+				i && prints[i].count == prints[i - 1].count);
+	ok &= (sheet_count_get(sheet) == 3);
+	sheet_write_start(sheet, NULL, "-hdr.bin", 8, false, GAP, 0);
+	while (sheet_write_next(sheet, 3))
+		steps++;
+	sheet_progress_get(sheet, &done, &total);
+	ok &= (done == total && total == GAP + 18 + GAP + 4 + GAP);
+	ok &= (steps == (18 + 4) / 3); // Gap bands come free with the others
+	ok &= sheet_write_finish(sheet);
+	sheet_free(sheet);
+	ok &= (out_count == 1);
+
+	/* The sheet as any PNG reader sees it */
+	rd.row_y[0] = GAP * 8;
+	rd.row_y[1] = (GAP + 18 + GAP) * 8;
+	path_get(path, sizeof(path), 1, "-sheet-bw.png");
+	fp = fopen(path, "rb");
+	png_read = png_read_alloc(PNG_WINDOW_MAX);
+	ok &= (fp && png_read_head(png_read, read_cb, fp));
+	info = png_read_info_get(png_read);
+	ok &= (info->width == ((COLS * CELL_W) + ((COLS + 1) * GAP)) * 8 && info->height == total * 8);
+	ok &= (fp && png_read_rows(png_read, sheet_read_row, &rd));
+	ok &= (rd.y == total * 8 && !rd.bad);
+	png_read_free(png_read);
+	if (fp)
+		fclose(fp);
+	if (rd.bad)
+		printf("FAIL %u px wrong\n", (unsigned int)rd.bad);
+
+	/* Count 4 was never saved, the rest of the sheet is still written */
+	sheet = sheet_alloc();
+	ok &= sheet_add(sheet, 3, 16, 4, 0xe4, false);
+	ok &= sheet_add(sheet, 4, 20, 2, 0xe4, false);
+	sheet_write_start(sheet, NULL, "-hdr.bin", 8, true, 0, 0);
+	while (sheet_write_next(sheet, 100));
+	ok &= !sheet_write_finish(sheet);
+	sheet_free(sheet);
+	path_get(path, sizeof(path), 3, "-sheet-bw.png");
+	ok &= !access(path, F_OK);
+
+	for (i = 1; i < 4; i++)
+		free(tiles[i]);
+	storage_file_free(out_file);
+
+	printf("sheet_check: %u bands in %u steps, %s\n", (unsigned int)total, (unsigned int)steps + 1,
+	       ok ? "ok" : "FAILED");
+
+	return !ok;
+}
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* Rebuild the thumbnail index of the folder thumb_pngs.py filled, and check
+ * there is a record for each image, in order, each the same as thumb.c makes
+ * from the rows of the image. Then check a folder that has an index is left
+ * alone, and a rebuild stopped part way leaves nothing behind.
+ */
+
+#include <furi.h>
+
+#include <sys/stat.h>
+
+#include <src/include/thumb.h>
+#include <src/include/thumb_build.h>
+#include <src/include/tile_tools.h>
+
+#define FOLDER	"2024-05-02"
+
+/* Images with a thumbnail, in order, and those that can't be read back */
+static const struct {
+	uint16_t count;
+	uint16_t px_h;
+} images[] = {
+	{ 1, 432 },
+	{ 3, 144 },
+	{ 5, 16 },
+	{ 7, 24 },
+};
+#define IMAGE_ERRORS	1
+
+static bool exists(const char *name)
+{
+	char path[256];
+	struct stat st;
+
+	snprintf(path, sizeof(path), "%s%s/%s", FGP_HOST_DATA, FOLDER, name);
+
+	return !stat(path, &st);
+}
+
+/* The thumbnail thumb.c makes of the rows thumb_pngs.py saved of the image */
+static bool ref_check(void *thumb, const struct thumb_rec *got, uint16_t count, uint16_t px_h)
+{
+	struct thumb_rec *rec = thumb_rec_get(thumb);
+	uint8_t row[160 / 4];
+	char path[256];
+	FILE *fp;
+	size_t y;
+
+	snprintf(path, sizeof(path), "%sthumb-raw/%04u.raw", FGP_HOST_DATA, count);
+	fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+	thumb_start(thumb, 160, px_h);
+	for (y = 0; y < px_h && fread(row, sizeof(row), 1, fp) == 1; y++)
+		thumb_row(thumb, row);
+	fclose(fp);
+
+	return (y == px_h && got->count == count && got->px_w == 160 && got->px_h == px_h &&
+		got->palette == 0 && !strcmp(got->ext, "-bw.png") && got->thumb_w == rec->thumb_w &&
+		got->thumb_h == rec->thumb_h && !memcmp(got->data, rec->data, sizeof(rec->data)));
+}
+
+int main(void)
+{
+	struct thumb_build_stats stats;
+	struct thumb_rec rec;
+	void *thumb_build;
+	void *thumb;
+	char path[256];
+	FILE *fp;
+	size_t i;
+	bool ok = true;
+
+	tile_tools_init();
+	thumb = thumb_alloc();
+
+	thumb_build = thumb_build_alloc(FOLDER);
+	if (!thumb_build) {
+		printf("thumb_check: nothing to rebuild\n");
+		return 1;
+	}
+	while (thumb_build_next(thumb_build, 2));
+	thumb_build_stats_get(thumb_build, &stats);
+	thumb_build_free(thumb_build);
+
+	ok &= (stats.total == COUNT_OF(images) + IMAGE_ERRORS);
+	ok &= (stats.done == COUNT_OF(images));
+	ok &= (stats.errors == IMAGE_ERRORS);
+	ok &= !exists(THUMB_FILE ".tmp");
+
+	snprintf(path, sizeof(path), "%s%s/%s", FGP_HOST_DATA, FOLDER, THUMB_FILE);
+	fp = fopen(path, "rb");
+	for (i = 0; fp && i < COUNT_OF(images); i++) {
+		if (fread(&rec, sizeof(rec), 1, fp) != 1 || !ref_check(thumb, &rec, images[i].count, images[i].px_h)) {
+			printf("FAIL record %u\n", (unsigned int)i);
+			ok = false;
+		}
+	}
+	ok &= (fp && fread(&rec, 1, 1, fp) == 0);
+	if (fp)
+		fclose(fp);
+
+	/* Already has an index */
+	thumb_build = thumb_build_alloc(FOLDER);
+	ok &= !thumb_build;
+	if (thumb_build)
+		thumb_build_free(thumb_build);
+
+	/* Stopped part way, as with Back */
+	remove(path);
+	thumb_build = thumb_build_alloc(FOLDER);
+	ok &= !!thumb_build;
+	if (thumb_build) {
+		ok &= thumb_build_next(thumb_build, 1);
+		thumb_build_free(thumb_build);
+	}
+	ok &= !exists(THUMB_FILE) && !exists(THUMB_FILE ".tmp");
+
+	thumb_free(thumb);
+
+	printf("thumb_check: %u of %u images, %u errors, %s\n", stats.done, stats.total, stats.errors,
+	       ok ? "ok" : "FAILED");
+
+	return !ok;
+}
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2024 KBEmbedded
+"""Fill a dated folder with PNGs for thumb_check, the way they end up on the SD
+card: saved by the app, recompressed, or re-saved on a computer, plus files
+that aren't an image of their own. The 2bpp rows of each image, in shades, go
+in <rawdir>/XXXX.raw for thumb_check to make the same thumbnail from.
+
+usage: thumb_pngs.py <folder> <rawdir>
+"""
+
+import os
+import random
+import struct
+import sys
+import zlib
+
+BW = bytes.fromhex('ffffffaaaaaa555555000000')
+WIDTH = 160
+STRIDE = WIDTH // 4
+
+
+def chunk(ctype, body):
+    return struct.pack('>I', len(body)) + ctype + body + struct.pack('>I', zlib.crc32(ctype + body))
+
+
+def png(bit_depth, plte, height, idat):
+    ihdr = struct.pack('>IIBBBBB', WIDTH, height, bit_depth, 3, 0, 0, 0)
+    return (b'\x89PNG\r\n\x1a\n' + chunk(b'IHDR', ihdr) + chunk(b'PLTE', plte) +
+            b''.join(chunk(b'IDAT', body) for body in idat) + chunk(b'IEND', b''))
+
+
+def sub(row):
+    """Filter type 1, each byte less the one before"""
+    return bytes([1]) + bytes((row[i] - (row[i - 1] if i else 0)) & 0xff for i in range(len(row)))
+
+
+def stored(rows):
+    """The layout png_handle writes, a zlib header on its own, a stored block
+    per row, then an empty final block and adler32"""
+    raw = b''.join(b'\x00' + row for row in rows)
+    idat = [b'\x78\x01']
+    for row in rows:
+        data = b'\x00' + row
+        idat.append(b'\x00' + struct.pack('<HH', len(data), len(data) ^ 0xffff) + data)
+    idat.append(b'\x01\x00\x00\xff\xff' + struct.pack('>I', zlib.adler32(raw)))
+    return idat
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    folder, rawdir = sys.argv[1:]
+    date = os.path.basename(folder.rstrip('/'))
+    os.makedirs(folder, exist_ok=True)
+    os.makedirs(rawdir, exist_ok=True)
+    rnd = random.Random(2)
+
+    def rows(n):
+        return [bytes(rnd.randrange(256) for _ in range(STRIDE)) for _ in range(n)]
+
+    def save(count, ext, data, raw=None):
+        with open(os.path.join(folder, 'GCIM_%s_%04u%s' % (date, count, ext)), 'wb') as f:
+            f.write(data)
+        if raw is not None:
+            with open(os.path.join(rawdir, '%04u.raw' % count), 'wb') as f:
+                f.write(b''.join(raw))
+
+    # Taller than any print, its matches reach back past 8 KiB
+    img = rows(200)
+    img = img + img + rows(32)
+    save(1, '-bw.png', png(2, BW, len(img), [zlib.compress(b''.join(b'\x00' + r for r in img), 9)]), img)
+    # A transform of the same image, the one with no transform is used
+    save(1, '-photo-bw.png', b'not a png')
+
+    # Nothing but a scaled PNG and an export, no thumbnail
+    save(2, '-bw-2x.png', b'not a png')
+    save(2, '-exp-bw.png', b'not a png')
+
+    # Filtered, with a small window, and cut in to 3 IDAT chunks
+    img = rows(144)
+    z = zlib.compressobj(9, zlib.DEFLATED, 13)
+    data = z.compress(b''.join(sub(r) for r in img)) + z.flush()
+    third = len(data) // 3
+    save(3, '-bw.png', png(2, BW, len(img), [data[:third], data[third:2 * third], data[2 * third:]]), img)
+
+    save(4, '-sheet-bw.png', b'not a png')
+
+    # 1bpp, white and black are shades 0 and 3 of the palette
+    bits = [bytes(rnd.randrange(256) for _ in range(WIDTH // 8)) for _ in range(16)]
+    img = []
+    for line in bits:
+        row = bytearray(STRIDE)
+        for x in range(WIDTH):
+            if (line[x // 8] >> (7 - (x % 8))) & 1:
+                row[x // 4] |= 3 << (6 - ((x % 4) * 2))
+        img.append(bytes(row))
+    save(5, '-bw.png', png(1, BW[:3] + BW[9:], 16, [zlib.compress(b''.join(b'\x00' + r for r in bits))]), img)
+
+    # Cut short, it can't be read back
+    save(6, '-bw.png', png(2, BW, 144, [zlib.compress(bytes(STRIDE + 1) * 144)])[:-24])
+
+    img = rows(24)
+    save(7, '-bw.png', png(2, BW, len(img), stored(img)), img)
+
+    # Not a palette the app knows
+    save(8, '-zz.png', b'not a png')
+
+
+if __name__ == '__main__':
+    main()
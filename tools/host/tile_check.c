@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* Round trip gb tile data through tile_to_scanline_copy() and back through
+ * scanline_to_tile(), and check every conversion against a px by px decode of
+ * the tiles, for each kernel, over a range of widths and odd heights.
+ *
+ * tile_tools.c is built right in to this so each kernel can be picked in turn,
+ * rather than only the one tile_tools_init() would settle on.
+ */
+
+#include <src/tile_tools.c>
+
+#define TILES_W_MAX	20
+#define TILES_H_MAX	19
+
+static const size_t widths[] = { 1, 2, 3, 5, 7, 8, 16, 19, 20 };
+static const size_t heights[] = { 1, 2, 3, 7, 17, 18, 19 };
+
+static uint32_t rnd = 0x2468ace1;
+
+static uint8_t rnd_byte(void)
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+
+	return rnd;
+}
+
+/* Shade of px x, y straight from the two bit planes of its tile */
+static unsigned int ref_px(const uint8_t *tiles, size_t tiles_w, size_t x, size_t y)
+{
+	const uint8_t *line = tiles + ((((y / 8) * tiles_w) + (x / 8)) * 16) + ((y % 8) * 2);
+	unsigned int bit = 7 - (x % 8);
+
+	return (((line[1] >> bit) & 0x01) << 1) | ((line[0] >> bit) & 0x01);
+}
+
+/* Check scanlines of tiles_w wide tiles, each stride bytes apart, against the
+ * px by px decode, remapped with lut if not NULL.
+ */
+static bool ref_check(const uint8_t *scan, size_t stride, const uint8_t *tiles, size_t tiles_w,
+		      size_t y0, size_t rows, const uint8_t *lut)
+{
+	unsigned int px;
+	unsigned int shade;
+	size_t x;
+	size_t y;
+
+	for (y = 0; y < rows; y++) {
+		for (x = 0; x < tiles_w * 8; x++) {
+			px = (scan[(y * stride) + (x / 4)] >> (6 - ((x % 4) * 2))) & 0x03;
+			shade = ref_px(tiles, tiles_w, x, y0 + y);
+			if (lut)
+				shade = lut[shade] & 0x03;
+			if (px != shade)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool check(size_t tiles_w, size_t tiles_h, const uint8_t *lut)
+{
+	size_t len = tiles_w * tiles_h * 16;
+	size_t stride = (tiles_w * 2) + 3;
+	static uint8_t tiles[TILES_W_MAX * TILES_H_MAX * 16];
+	static uint8_t buf[TILES_W_MAX * TILES_H_MAX * 16];
+	static uint8_t copy[TILES_W_MAX * TILES_H_MAX * 8 * ((TILES_W_MAX * 2) + 3)];
+	static uint8_t back[TILES_W_MAX * TILES_H_MAX * 16];
+	uint8_t row[TILES_W_MAX * 2];
+	size_t y;
+	size_t i;
+	bool ok = true;
+
+	for (i = 0; i < len; i++)
+		tiles[i] = rnd_byte();
+
+	/* Packed lines, the way png_import hands them back */
+	tile_to_scanline_copy(buf, tiles_w * 2, tiles, tiles_w, tiles_h, NULL);
+	ok &= ref_check(buf, tiles_w * 2, tiles, tiles_w, 0, tiles_h * 8, NULL);
+
+	/* And back again, which is what PNG import leans on */
+	scanline_to_tile(back, buf, tiles_w, tiles_h);
+	ok &= !memcmp(back, tiles, len);
+
+	/* Strided copy, with a remap and room around each line */
+	memset(copy, 0xa5, sizeof(copy));
+	tile_to_scanline_copy(copy, stride, tiles, tiles_w, tiles_h, lut);
+	ok &= ref_check(copy, stride, tiles, tiles_w, 0, tiles_h * 8, lut);
+	for (y = 0; y < tiles_h * 8; y++)
+		ok &= (copy[(y * stride) + (tiles_w * 2)] == 0xa5);
+
+	/* One row at a time, as png_stream and GIF get them */
+	for (y = 0; y < tiles_h * 8; y++) {
+		tile_row_get(row, tiles, tiles_w, y, lut);
+		ok &= ref_check(row, 0, tiles, tiles_w, y, 1, lut);
+	}
+
+	return ok;
+}
+
+int main(void)
+{
+	uint8_t lut[256];
+	size_t k;
+	size_t w;
+	size_t h;
+	int failed = 0;
+
+	/* Every shade one darker, shade 3 wraps around to 0 */
+	tile_palette_lut(lut, 0x39);
+
+	for (k = 0; k < COUNT_OF(kernels); k++) {
+		kernel = &kernels[k];
+		for (w = 0; w < COUNT_OF(widths); w++) {
+			for (h = 0; h < COUNT_OF(heights); h++) {
+				if (check(widths[w], heights[h], NULL) && check(widths[w], heights[h], lut))
+					continue;
+				printf("FAIL %s %ux%u tiles\n", kernel->name, (unsigned int)widths[w],
+				       (unsigned int)heights[h]);
+				failed++;
+			}
+		}
+	}
+
+	printf("tile_check: %u kernels, %s\n", (unsigned int)COUNT_OF(kernels), failed ? "FAILED" : "ok");
+
+	return !!failed;
+}
@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2024 KBEmbedded
+"""Send -hdr.bin files with usb_receive.py --send over a pair of
+pseudo-terminals standing in for the USB link, to usb_receive.py receiving on
+the other end, and check every image comes out as it went in. The two ends are
+joined here, the same as socat would, so nothing else needs installing.
+
+If FGP_PNG is set, the PNGs received must also be byte for byte what fgp_png
+writes for the same rows. check.sh runs this with and without it.
+
+usage: usb_check.py <workdir>
+"""
+
+import os
+import pty
+import random
+import select
+import signal
+import subprocess
+import sys
+import threading
+import tty
+import zlib
+
+TOOLS = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+USB_RECEIVE = os.path.join(TOOLS, 'usb_receive.py')
+BIN_MAGIC = b'GB-BIN01'
+BW = 'ffffffaaaaaa555555000000'
+
+# Count and rows of tiles of each image sent, 20 tiles wide
+IMAGES = ((7, 18), (8, 2), (9, 1))
+
+# Longest to wait on the receiver for each image, in seconds
+TIMEOUT = 10
+
+
+def bridge(src, dst):
+    """Copy everything written to one terminal to the other"""
+    while True:
+        try:
+            data = os.read(src, 4096)
+        except OSError:
+            return
+        if not data:
+            return
+        os.write(dst, data)
+
+
+def tiles_to_scan(tiles):
+    """2bpp scanlines, 40 bytes each, straight from the bit planes"""
+    scan = bytearray()
+    for ty in range(len(tiles) // 320):
+        for y in range(8):
+            for tx in range(20):
+                offs = ((ty * 20) + tx) * 16 + (y * 2)
+                lo, hi = tiles[offs], tiles[offs + 1]
+                for x in range(0, 8, 4):
+                    byte = 0
+                    for bit in range(7 - x, 3 - x, -1):
+                        byte = (byte << 2) | (((hi >> bit) & 1) << 1) | ((lo >> bit) & 1)
+                    scan.append(byte)
+    return bytes(scan)
+
+
+def png_scan(path):
+    """2bpp scanlines of an indexed PNG, with every row unfiltered"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    assert data[:8] == b'\x89PNG\r\n\x1a\n', path
+    pos = 8
+    idat = b''
+    while pos < len(data):
+        length = int.from_bytes(data[pos:pos + 4], 'big')
+        ctype = data[pos + 4:pos + 8]
+        body = data[pos + 8:pos + 8 + length]
+        assert zlib.crc32(ctype + body) == int.from_bytes(data[pos + 8 + length:pos + 12 + length], 'big')
+        if ctype == b'IHDR':
+            width, height = int.from_bytes(body[:4], 'big'), int.from_bytes(body[4:8], 'big')
+            assert body[8:10] == b'\x02\x03', 'not 2bpp indexed'
+        elif ctype == b'IDAT':
+            idat += body
+        pos += 12 + length
+    raw = zlib.decompress(idat)
+    stride = width // 4
+    scan = bytearray()
+    prev = bytearray(stride)
+    for y in range(height):
+        ftype = raw[y * (stride + 1)]
+        line = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for x in range(stride):
+            a = line[x - 1] if x else 0
+            b = prev[x]
+            c = prev[x - 1] if x else 0
+            if ftype == 1:
+                line[x] = (line[x] + a) & 0xff
+            elif ftype == 2:
+                line[x] = (line[x] + b) & 0xff
+            elif ftype == 3:
+                line[x] = (line[x] + ((a + b) >> 1)) & 0xff
+            elif ftype == 4:
+                p = a + b - c
+                pred = a if abs(p - a) <= abs(p - b) and abs(p - a) <= abs(p - c) else \
+                    (b if abs(p - b) <= abs(p - c) else c)
+                line[x] = (line[x] + pred) & 0xff
+        scan += line
+        prev = line
+    return bytes(scan)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    work = sys.argv[1]
+    indir = os.path.join(work, 'in')
+    outdir = os.path.join(work, 'out')
+    os.makedirs(indir, exist_ok=True)
+    os.makedirs(outdir, exist_ok=True)
+
+    rnd = random.Random(1)
+    paths = []
+    for count, tiles_h in IMAGES:
+        path = os.path.join(indir, 'GCIM_%04d-hdr.bin' % count)
+        with open(path, 'wb') as f:
+            f.write(BIN_MAGIC + bytes(rnd.randrange(256) for _ in range(tiles_h * 320)))
+        paths.append(path)
+
+    send_master, send_slave = pty.openpty()
+    recv_master, recv_slave = pty.openpty()
+    tty.setraw(send_slave)
+    tty.setraw(recv_slave)
+    threading.Thread(target=bridge, args=(send_master, recv_master), daemon=True).start()
+
+    # Each line it prints is a whole image received
+    recv = subprocess.Popen([sys.executable, USB_RECEIVE, os.ttyname(recv_slave), outdir, 'bw'],
+                            stdout=subprocess.PIPE, env=dict(os.environ, PYTHONUNBUFFERED='1'))
+    subprocess.run([sys.executable, USB_RECEIVE, '--send', os.ttyname(send_slave)] + paths,
+                   check=True, stdout=subprocess.DEVNULL)
+
+    # Read straight from the pipe, a line already buffered by readline()
+    # would never show up to select()
+    out = b''
+    while out.count(b'\n') < len(IMAGES):
+        ready, _, _ = select.select([recv.stdout], [], [], TIMEOUT)
+        data = os.read(recv.stdout.fileno(), 4096) if ready else b''
+        if not data:
+            break
+        out += data
+    recv.send_signal(signal.SIGINT)
+    recv.wait(TIMEOUT)
+
+    failed = out.count(b'\n') != len(IMAGES)
+    if failed:
+        print('FAIL only %d of %d images received' % (out.count(b'\n'), len(IMAGES)))
+    for path in paths:
+        name = os.path.basename(path)
+        with open(path, 'rb') as f:
+            sent = f.read()
+        try:
+            with open(os.path.join(outdir, name), 'rb') as f:
+                got = f.read()
+            png = os.path.join(outdir, name.replace('-hdr.bin', '-bw.png'))
+            ok = (got == sent and png_scan(png) == tiles_to_scan(sent[len(BIN_MAGIC):]))
+            if ok and os.environ.get('FGP_PNG'):
+                ref = os.path.join(work, 'ref.png')
+                subprocess.run([os.environ['FGP_PNG'], ref, '160', BW],
+                               input=tiles_to_scan(sent[len(BIN_MAGIC):]), check=True)
+                with open(ref, 'rb') as f, open(png, 'rb') as g:
+                    ok = (f.read() == g.read())
+        except (OSError, AssertionError, zlib.error):
+            ok = False
+        if not ok:
+            print('FAIL %s' % name)
+            failed = True
+
+    print('usb_check: %d images%s, %s' % (len(IMAGES), ', fgp_png' if os.environ.get('FGP_PNG') else '',
+                                          'FAILED' if failed else 'ok'))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
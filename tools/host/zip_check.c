@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (c) 2024 KBEmbedded
+
+/* Fill a dated folder in FGP_HOST_DATA with files of awkward sizes, around and
+ * across the copy buffer, plus a dot file and a folder that must be left out,
+ * then bundle it with zip_export_day(). The ZIP itself is checked by check.sh
+ * with tools other than ours, this only checks what the export reports.
+ */
+
+#include <furi.h>
+
+#include <sys/stat.h>
+
+#include <src/include/zip_export.h>
+
+#define FOLDER	"2024-05-01"
+
+static const size_t sizes[] = { 0, 1, 511, 512, 513, 5000 };
+
+static bool file_make(const char *name, size_t len, uint8_t seed)
+{
+	char path[256];
+	FILE *fp;
+	size_t i;
+	bool ok;
+
+	snprintf(path, sizeof(path), "%s%s/%s", FGP_HOST_DATA, FOLDER, name);
+	fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	for (i = 0; i < len; i++)
+		fputc((uint8_t)((i * 31) + seed), fp);
+	ok = !ferror(fp);
+	ok &= !fclose(fp);
+
+	return ok;
+}
+
+int main(void)
+{
+	struct zip_stats stats;
+	char name[64];
+	char path[256];
+	struct stat st;
+	size_t i;
+	bool ok = true;
+
+	snprintf(path, sizeof(path), "%s%s", FGP_HOST_DATA, FOLDER);
+	mkdir(path, 0777);
+	snprintf(path, sizeof(path), "%s%s/subdir", FGP_HOST_DATA, FOLDER);
+	mkdir(path, 0777);
+
+	for (i = 0; i < COUNT_OF(sizes); i++) {
+		snprintf(name, sizeof(name), "GCIM_%s_%04u-bw.png", FOLDER, (unsigned int)i);
+		ok &= file_make(name, sizes[i], i);
+	}
+	ok &= file_make(".thumbs", 100, 0);
+	if (!ok) {
+		printf("zip_check: couldn't make the files to export\n");
+		return 1;
+	}
+
+	ok &= zip_export_day(FOLDER, &stats);
+	ok &= (stats.files == COUNT_OF(sizes));
+	ok &= (stats.errors == 0);
+
+	snprintf(path, sizeof(path), "%s%s.zip", FGP_HOST_DATA, FOLDER);
+	ok &= (!stat(path, &st) && (uint32_t)st.st_size == stats.bytes);
+
+	/* The central directory is only ever kept while exporting */
+	snprintf(path, sizeof(path), "%s%s.zip.cd", FGP_HOST_DATA, FOLDER);
+	ok &= !!stat(path, &st);
+
+	printf("zip_check: %u files, %u errors, %lu bytes, %s\n", stats.files, stats.errors,
+	       (unsigned long)stats.bytes, ok ? "ok" : "FAILED");
+
+	return !ok;
+}
@@ -0,0 +1,18 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2024 KBEmbedded
+"""Print the PLTE chunk CRC of every built-in palette in src/fgp_palette.c.
+
+The CRCs are stored in the palettes[] table, in the byte order the app keeps
+them in memory, so each PLTE chunk can be written to a PNG without any work.
+Run this after adding or changing a palette and copy the CRC in to its entry.
+"""
+
+import struct
+import zlib
+
+from repalette import palettes_load
+
+for shortname, rgb in palettes_load().items():
+    crc = zlib.crc32(b'PLTE' + rgb)
+    print('%-8s 0x%08x' % (shortname, struct.unpack('<I', struct.pack('>I', crc))[0]))
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2024 KBEmbedded
+"""Recolor a folder of PNGs saved by Flipper GB Printer, in place.
+
+Every PNG the app writes has its PLTE chunk right after IHDR, at a fixed
+offset. Changing the palette of a file is a single write of PLTE, the image
+data is never touched. Files are then renamed from their -<shortname> suffix
+to that of the new palette. The Gallery thumbnail index of the folder,
+.thumbs, names the old files, so it is removed for the app to rebuild it the
+next time the folder is opened.
+
+Palettes are read from src/fgp_palette.c so they always match the app, plus
+any in a palettes.txt palette pack, as loaded by the app from the SD card.
+
+usage: repalette.py <folder> <shortname> [palettes.txt]
+"""
+
+import os
+import re
+import struct
+import sys
+import zlib
+
+PNG_MAGIC = b'\x89PNG\r\n\x1a\n'
+PLTE_OFFS = 33
+HEAD_LEN = PLTE_OFFS + 8
+NAME_RE = re.compile(r'^(.*?-)([^-]+)(-[1-9]x)?\.png$')
+
+
+def palettes_load(pack=None):
+    src = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'src', 'fgp_palette.c')
+    pals = {}
+    with open(src) as f:
+        for m in re.finditer(r'PALETTE\("[^"]*",\s*"([^"]+)",\s*0x[0-9a-fA-F]+,\s*\{((?:\s*\{[^}]*\},?){4})\s*\}\)', f.read()):
+            rgb = bytes(int(x, 16) for x in re.findall(r'0x([0-9a-fA-F]{2})', m.group(2)))
+            pals[m.group(1)] = rgb
+    if pack:
+        with open(pack) as f:
+            short = None
+            for line in f:
+                key, _, val = line.partition(':')
+                if key == 'Short':
+                    short = val.strip()
+                elif key == 'Colors' and short and short not in pals:
+                    pals[short] = bytes.fromhex(val)
+    return pals
+
+
+def head_check(head):
+    """Number of colors in PLTE, 4 at 2bpp or 2 at 1bpp, or 0 if not ours"""
+    if len(head) != HEAD_LEN or head[:8] != PNG_MAGIC:
+        return 0
+    length, ctype = struct.unpack('>I4s', head[8:16])
+    if length != 13 or ctype != b'IHDR':
+        return 0
+    bit_depth, color_type = head[24], head[25]
+    crc, = struct.unpack('>I', head[29:33])
+    if bit_depth not in (1, 2) or color_type != 3 or zlib.crc32(head[12:29]) != crc:
+        return 0
+    colors = 1 << bit_depth
+    if head[33:41] != struct.pack('>I4s', colors * 3, b'PLTE'):
+        return 0
+    return colors
+
+
+def plte_build(rgb):
+    return struct.pack('>I4s', len(rgb), b'PLTE') + rgb + struct.pack('>I', zlib.crc32(b'PLTE' + rgb))
+
+
+def plte_shades_build(rgb, old, new):
+    """Give each color of rgb the color of the same shade in the new palette.
+    1bpp PNGs only have the 2 shades used, and 2bpp PNGs can have the shades
+    in the order of the palette byte of the print. None if the colors aren't
+    in the old palette."""
+    out = b''
+    for i in range(0, len(rgb), 3):
+        # Shade n at index n, even if a palette has a color twice
+        shades = [i // 3] if len(rgb) == 12 else []
+        for shade in shades + list(range(4)):
+            if old[shade * 3:shade * 3 + 3] == rgb[i:i + 3]:
+                out += new[shade * 3:shade * 3 + 3]
+                break
+        else:
+            return None
+    return plte_build(out)
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        sys.exit(__doc__)
+    folder, shortname = sys.argv[1], sys.argv[2]
+    pals = palettes_load(sys.argv[3] if len(sys.argv) == 4 else None)
+    if shortname not in pals:
+        sys.exit('unknown palette %s, one of: %s' % (shortname, ' '.join(pals)))
+    done = skipped = errors = 0
+
+    for name in sorted(os.listdir(folder)):
+        m = NAME_RE.match(name)
+        if not m or m.group(2) not in pals or m.group(2) == shortname:
+            skipped += 1
+            continue
+        old = os.path.join(folder, name)
+        new = os.path.join(folder, m.group(1) + shortname + (m.group(3) or '') + '.png')
+        if os.path.exists(new):
+            skipped += 1
+            continue
+        try:
+            with open(old, 'r+b') as f:
+                colors = head_check(f.read(HEAD_LEN))
+                plte = None
+                if colors:
+                    plte = plte_shades_build(f.read(colors * 3), pals[m.group(2)], pals[shortname])
+                if not plte:
+                    skipped += 1
+                    continue
+                f.seek(PLTE_OFFS)
+                f.write(plte)
+            os.rename(old, new)
+            done += 1
+        except OSError as e:
+            print('%s: %s' % (name, e), file=sys.stderr)
+            errors += 1
+
+    thumbs = os.path.join(folder, '.thumbs')
+    if done and os.path.exists(thumbs):
+        os.remove(thumbs)
+
+    print('%d recolored, %d skipped, %d errors' % (done, skipped, errors))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2024 KBEmbedded
+"""Rebuild the -hdr.bin files of a session from its Flipper GB Printer tile
+archive, GCIM_YYYY-MM-DD_XXXX-tiles.tda.
+
+The archive holds every print of a session as a map of tile indexes, and only
+the data of tiles that weren't seen earlier in the session. Each image comes
+out exactly as the app saves it with Save hdr+bin, GB-BIN01 followed by the
+tile data of every print of the image, named after the file number each print
+was saved under.
+
+usage: tda_decode.py <archive> [outdir]
+"""
+
+import os
+import re
+import struct
+import sys
+
+TDA_MAGIC = b'GB-TDA01'
+BIN_MAGIC = b'GB-BIN01'
+TILE_DICT_LITERAL = 0xffff
+REC = struct.Struct('<BBHHHH')
+NAME_RE = re.compile(r'^(.*_)\d{4}-tiles\.tda$')
+
+
+def tda_decode(data):
+    """Yield (count, same_image, tiles_w, tile data) for each print."""
+    if data[:8] != TDA_MAGIC:
+        raise ValueError('not a tile archive')
+    pos = 8
+    tiles = []
+    while pos < len(data):
+        rtype, same_image, count, tiles_w, ntiles, new_tiles = REC.unpack_from(data, pos)
+        if rtype != ord('P'):
+            raise ValueError('bad record at %d' % pos)
+        pos += REC.size
+        idx = struct.unpack_from('<%dH' % ntiles, data, pos)
+        pos += ntiles * 2
+        new = data[pos:pos + (new_tiles * 16)]
+        pos += new_tiles * 16
+
+        out = bytearray()
+        n = 0
+        for i in idx:
+            if i == TILE_DICT_LITERAL or i == len(tiles):
+                tile = new[n * 16:(n + 1) * 16]
+                n += 1
+                if i != TILE_DICT_LITERAL:
+                    tiles.append(tile)
+            else:
+                tile = tiles[i]
+            out += tile
+        if n != new_tiles:
+            raise ValueError('record at %d has %d new tiles, expected %d' % (pos, n, new_tiles))
+        yield count, bool(same_image), tiles_w, bytes(out)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+
+    path = sys.argv[1]
+    outdir = sys.argv[2] if len(sys.argv) > 2 else os.path.dirname(path) or '.'
+    m = NAME_RE.match(os.path.basename(path))
+    prefix = m.group(1) if m else 'GCIM_'
+
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    os.makedirs(outdir, exist_ok=True)
+    name = None
+    size = 0
+    for count, same_image, tiles_w, tiles in tda_decode(data):
+        if not same_image or name is None:
+            name = os.path.join(outdir, '%s%04d-hdr.bin' % (prefix, count))
+            with open(name, 'wb') as f:
+                f.write(BIN_MAGIC)
+            size += len(BIN_MAGIC)
+            print(name)
+        with open(name, 'ab') as f:
+            f.write(tiles)
+        size += len(tiles)
+
+    print('%d bytes rebuilt from %d' % (size, len(data)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2024 KBEmbedded
+"""Receive prints streamed by Flipper GB Printer over USB serial, as they are
+printed.
+
+With Stream USB on, the Flipper shows up as a second serial port, e.g.
+/dev/ttyACM1 next to the CLI on /dev/ttyACM0. Every print is sent as a frame
+of a header, the payload Save hdr+bin would append to the -hdr.bin of the
+image, and a CRC. Each image is saved to outdir exactly as Save hdr+bin does,
+GCIM_XXXX-hdr.bin, and as a PNG in the given palette, GCIM_XXXX-zzz.png.
+Prints stacked without margins are joined in to one image, same as the app.
+
+Palettes are read from src/fgp_palette.c, plus any in a palettes.txt palette
+pack, same as tools/repalette.py.
+
+PNGs are written by the encoder of the app itself if FGP_PNG is set to the
+fgp_png host tool, e.g. FGP_PNG=build/fgp_png after tools/host/check.sh build.
+Otherwise they are written here, the same format but not the same bytes.
+
+With --send, the -hdr.bin files given are sent to the port as frames instead,
+the same as the Flipper would. With a pseudo-terminal pair standing in for the
+USB link, e.g. from socat -d -d pty,raw,echo=0 pty,raw,echo=0, run the
+receiver on one end and --send on the other.
+
+usage: usb_receive.py <port> [outdir] [shortname] [palettes.txt]
+       usb_receive.py --send <port> <GCIM_XXXX-hdr.bin>...
+"""
+
+import os
+import re
+import struct
+import subprocess
+import sys
+import termios
+import tty
+import zlib
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from repalette import palettes_load  # noqa: E402
+
+MAGIC = b'GBPF'
+VERSION = 1
+SAME_IMAGE = 0x01
+BIN_MAGIC = b'GB-BIN01'
+HDR = struct.Struct('<4sBBHBBBBHI')
+CRC = struct.Struct('<I')
+TILE_LEN = 16
+NAME_RE = re.compile(r'^(.*?)(\d{4})-hdr\.bin$')
+
+# Nothing printed is ever bigger than this, anything longer is noise
+LEN_MAX = 0x10000
+
+# A frame cut short stops being waited on after this many 1/10 s without data
+READ_TIMEOUT = 10
+
+
+def port_open(path):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd, termios.TCSANOW)
+        attr = termios.tcgetattr(fd)
+        attr[6][termios.VMIN] = 0
+        attr[6][termios.VTIME] = READ_TIMEOUT
+        termios.tcsetattr(fd, termios.TCSANOW, attr)
+    return fd
+
+
+def frames_read(fd):
+    """Yield (header fields, payload) of each good frame. Bad frames are
+    reported and skipped, the stream is searched for the next header."""
+    buf = b''
+    while True:
+        pos = buf.find(MAGIC)
+        if pos < 0:
+            buf = buf[-(len(MAGIC) - 1):]
+        else:
+            buf = buf[pos:]
+            if len(buf) >= HDR.size:
+                hdr = HDR.unpack_from(buf)
+                ver, length = hdr[1], hdr[9]
+                if ver != VERSION or length > LEN_MAX:
+                    print('bad header, version %d len %d' % (ver, length), file=sys.stderr)
+                    buf = buf[1:]
+                    continue
+                end = HDR.size + length + CRC.size
+                if len(buf) >= end:
+                    crc, = CRC.unpack_from(buf, end - CRC.size)
+                    if zlib.crc32(buf[:end - CRC.size]) != crc:
+                        print('bad CRC, frame dropped', file=sys.stderr)
+                        buf = buf[1:]
+                        continue
+                    yield hdr, buf[HDR.size:end - CRC.size]
+                    buf = buf[end:]
+                    continue
+        try:
+            data = os.read(fd, 4096)
+        except OSError:
+            return  # The other end of the port went away
+        if not data:
+            if not os.isatty(fd):
+                return
+            # Whatever frame was started isn't going to be finished
+            if len(buf) >= len(MAGIC):
+                print('frame cut short, dropped', file=sys.stderr)
+                buf = buf[1:]
+        buf += data
+
+
+def palette_lut(palette):
+    """Shade n becomes bits 2n+1:2n of the print command palette byte, 0x00 is
+    taken to mean the default."""
+    if palette in (0x00, 0xe4):
+        return bytes(range(4))
+    return bytes((palette >> (shade * 2)) & 0x03 for shade in range(4))
+
+
+def tiles_to_rows(tiles, tiles_w, lut):
+    """Rows of px shades, 0 white to 3 black, from GB 2bpp tiles"""
+    rows = []
+    for ty in range(len(tiles) // (tiles_w * TILE_LEN)):
+        for y in range(8):
+            row = bytearray()
+            for tx in range(tiles_w):
+                offs = ((ty * tiles_w) + tx) * TILE_LEN + (y * 2)
+                lo, hi = tiles[offs], tiles[offs + 1]
+                for bit in range(7, -1, -1):
+                    row.append(lut[(((hi >> bit) & 1) << 1) | ((lo >> bit) & 1)])
+            rows.append(row)
+    return rows
+
+
+def png_chunk(ctype, data):
+    return struct.pack('>I', len(data)) + ctype + data + struct.pack('>I', zlib.crc32(ctype + data))
+
+
+def png_write(path, rows, rgb):
+    """2bpp indexed PNG, by fgp_png if FGP_PNG is set"""
+    width = len(rows[0])
+    scan = bytearray()
+    for row in rows:
+        for x in range(0, width, 4):
+            scan.append((row[x] << 6) | (row[x + 1] << 4) | (row[x + 2] << 2) | row[x + 3])
+    if os.environ.get('FGP_PNG'):
+        subprocess.run([os.environ['FGP_PNG'], path, str(width), rgb.hex()], input=bytes(scan), check=True)
+        return
+    stride = width // 4
+    raw = b''.join(b'\x00' + scan[y * stride:(y + 1) * stride] for y in range(len(rows)))
+    with open(path, 'wb') as f:
+        f.write(b'\x89PNG\r\n\x1a\n')
+        f.write(png_chunk(b'IHDR', struct.pack('>IIBBBBB', width, len(rows), 2, 3, 0, 0, 0)))
+        f.write(png_chunk(b'PLTE', rgb))
+        f.write(png_chunk(b'IDAT', zlib.compress(bytes(raw), 9)))
+        f.write(png_chunk(b'IEND', b''))
+
+
+def receive(port, outdir, shortname, pack):
+    pals = palettes_load(pack)
+    if shortname not in pals:
+        sys.exit('unknown palette %s, one of: %s' % (shortname, ' '.join(pals)))
+    os.makedirs(outdir, exist_ok=True)
+
+    fd = port_open(port)
+    rows = []
+    name = None
+    try:
+        for hdr, payload in frames_read(fd):
+            _, _, flags, count, margins, palette, exposure, tiles_w, tiles_h, _ = hdr
+            same_image = bool(flags & SAME_IMAGE) and name is not None
+            tiles = payload if flags & SAME_IMAGE else payload[len(BIN_MAGIC):]
+
+            if not same_image:
+                name = os.path.join(outdir, 'GCIM_%04d' % count)
+                rows = []
+                with open(name + '-hdr.bin', 'wb') as f:
+                    f.write(BIN_MAGIC)
+            with open(name + '-hdr.bin', 'ab') as f:
+                f.write(tiles)
+
+            rows += tiles_to_rows(tiles, tiles_w, palette_lut(palette))
+            if rows:
+                png_write('%s-%s.png' % (name, shortname), rows, pals[shortname])
+            print('%s: %dx%d, margins %02x palette %02x exposure %02x%s' %
+                  (name, tiles_w * 8, len(rows), margins, palette, exposure,
+                   ', continued' if same_image else ''))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.close(fd)
+
+
+def send(port, paths):
+    """Frame each -hdr.bin the same as the Flipper does, as one print"""
+    fd = port_open(port)
+    for path in paths:
+        with open(path, 'rb') as f:
+            data = f.read()
+        m = NAME_RE.match(os.path.basename(path))
+        if data[:len(BIN_MAGIC)] != BIN_MAGIC or not m:
+            print('%s: not a -hdr.bin' % path, file=sys.stderr)
+            continue
+        tiles_w = 20
+        tiles_h = (len(data) - len(BIN_MAGIC)) // (tiles_w * TILE_LEN)
+        payload = data[:len(BIN_MAGIC) + (tiles_w * tiles_h * TILE_LEN)]
+        frame = HDR.pack(MAGIC, VERSION, 0, int(m.group(2)), 0x13, 0xe4, 0x40,
+                         tiles_w, tiles_h, len(payload)) + payload
+        os.write(fd, frame + CRC.pack(zlib.crc32(frame)))
+        print('%s: %d bytes' % (path, len(frame) + CRC.size))
+    if os.isatty(fd):
+        termios.tcdrain(fd)
+    os.close(fd)
+
+
+def main():
+    if len(sys.argv) > 3 and sys.argv[1] == '--send':
+        send(sys.argv[2], sys.argv[3:])
+    elif 2 <= len(sys.argv) <= 5 and not sys.argv[1].startswith('-'):
+        receive(sys.argv[1],
+                sys.argv[2] if len(sys.argv) > 2 else '.',
+                sys.argv[3] if len(sys.argv) > 3 else 'bw',
+                sys.argv[4] if len(sys.argv) > 4 else None)
+    else:
+        sys.exit(__doc__)
+
+
+if __name__ == '__main__':
+    main()